@@ -1,6 +1,13 @@
 #ifndef ARCH_DEVICE_HOST_H
 #define ARCH_DEVICE_HOST_H
 
+/* Include required headers */
+#include <algorithm>
+#include <vector>
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
 /* Define architecture-specific macros */
 #define ARCH_LOOP_LAMBDA [=]
 #define ARCH_INNER_BODY2(i, j, aggregate) return [=](auto i, auto j, auto *aggregate)
@@ -61,110 +68,181 @@ inline static void host_register(T* ptr, size_t bytes){}
 template <typename T>
 inline static void host_unregister(T* ptr){}
 
-/* Parallel reduce driver function - specialization for 1D case */
-template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T>
-inline static void parallel_reduce_driver(const uint (&limits)[1], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
+/* Minimum number of iterations for which a reduction called outside of an
+ * OpenMP parallel region spawns its own thread team. Below this the fork/join
+ * overhead outweighs the work, and the reduction is run on the calling thread. */
+constexpr uint64_t host_min_threaded_iterations = 1 << 14;
+
+/* Initial value of a private partial result. For max and min the partials are
+ * seeded with the value of the reduction variable, like in the device backends. */
+template <reduce_op Op, typename T>
+inline static T reduce_init(const T &value) {
+  if (Op == reduce_op::sum) return T(0);
+  if (Op == reduce_op::prod) return T(1);
+  return value;
+}
 
-  uint idx[1];
-         
-  //#pragma omp for
-  for (idx[0] = 0; idx[0] < limits[0]; ++idx[0])
-    loop_body(idx[0], sum);
+/* Combine a partial result into the reduction variable */
+template <reduce_op Op, typename T>
+inline static void reduce_combine(T &value, const T &partial) {
+  if (Op == reduce_op::sum) value += partial;
+  else if (Op == reduce_op::prod) value *= partial;
+  else if (Op == reduce_op::max) value = partial > value ? partial : value;
+  else value = partial < value ? partial : value;
+}
 
-  (void) n_redu_dynamic;
+/* Innermost (fastest running) loop of a reduction. When the number of reduction
+ * variables is known at compile time the loop is vectorized, each SIMD lane
+ * accumulating into its own copy of the partial results. */
+template <reduce_op Op, uint NReductions, typename Body, typename T>
+inline static void reduce_simd(const uint first, const uint last, Body body, T *partial) {
+  if constexpr (NReductions == 0) {
+    for (uint i = first; i < last; ++i)
+      body(i, partial);
+  } else if constexpr (Op == reduce_op::sum) {
+    #pragma omp simd reduction(+:partial[:NReductions])
+    for (uint i = first; i < last; ++i)
+      body(i, partial);
+  } else if constexpr (Op == reduce_op::prod) {
+    #pragma omp simd reduction(*:partial[:NReductions])
+    for (uint i = first; i < last; ++i)
+      body(i, partial);
+  } else if constexpr (Op == reduce_op::max) {
+    #pragma omp simd reduction(max:partial[:NReductions])
+    for (uint i = first; i < last; ++i)
+      body(i, partial);
+  } else {
+    #pragma omp simd reduction(min:partial[:NReductions])
+    for (uint i = first; i < last; ++i)
+      body(i, partial);
+  }
 }
 
-/* Parallel reduce driver function - specialization for 2D case */
-template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T, typename = typename std::enable_if<std::is_void<typename std::result_of<Lambda(uint, uint, T*)>::type>::value>::type>
-inline static void parallel_reduce_driver(const uint (&limits)[2], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
+/* Reduce over the slab [first, last) of the slowest running dimension - specialization for 1D case */
+template <reduce_op Op, uint NReductions, typename Lambda, typename T>
+inline static void reduce_slab(const uint (&limits)[1], Lambda &loop_body, T *partial, const uint first, const uint last) {
 
-  uint idx[2];
-         
-  //#pragma omp for collapse(2)
-  for (idx[1] = 0; idx[1] < limits[1]; ++idx[1]) 
-    for (idx[0] = 0; idx[0] < limits[0]; ++idx[0])
-      loop_body(idx[0], idx[1], sum);
+  reduce_simd<Op, NReductions>(first, last, [&](const uint i, T *lsum) { loop_body(i, lsum); }, partial);
+  (void) limits;
+}
+
+/* Reduce over the slab [first, last) of the slowest running dimension - specialization for 2D case */
+template <reduce_op Op, uint NReductions, typename Lambda, typename T, typename = typename std::enable_if<std::is_void<typename std::result_of<Lambda(uint, uint, T*)>::type>::value>::type>
+inline static void reduce_slab(const uint (&limits)[2], Lambda &loop_body, T *partial, const uint first, const uint last) {
 
-  (void) n_redu_dynamic;
+  for (uint j = first; j < last; ++j)
+    reduce_simd<Op, NReductions>(0, limits[0], [&](const uint i, T *lsum) { loop_body(i, j, lsum); }, partial);
 }
 
-/* Parallel reduce driver function - specialization for 2D case with nested bodies */
-template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T, typename = typename std::enable_if<!std::is_void<typename std::result_of<Lambda(uint, uint, T*)>::type>::value>::type, typename = void>
-inline static void parallel_reduce_driver(const uint (&limits)[2], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
-
-  uint idx[2];
-         
-  //#pragma omp for collapse(2)
-  for (idx[1] = 0; idx[1] < limits[1]; ++idx[1]) {
-    auto inner_loop = loop_body(idx[0], idx[1], sum);
-    for (idx[0] = 0; idx[0] < limits[0]; ++idx[0])
-      inner_loop(idx[0], idx[1], sum);
+/* Reduce over the slab [first, last) of the slowest running dimension - specialization for 2D case with nested bodies */
+template <reduce_op Op, uint NReductions, typename Lambda, typename T, typename = typename std::enable_if<!std::is_void<typename std::result_of<Lambda(uint, uint, T*)>::type>::value>::type, typename = void>
+inline static void reduce_slab(const uint (&limits)[2], Lambda &loop_body, T *partial, const uint first, const uint last) {
+
+  for (uint j = first; j < last; ++j) {
+    auto inner_loop = loop_body(0, j, partial);
+    reduce_simd<Op, NReductions>(0, limits[0], [&](const uint i, T *lsum) { inner_loop(i, j, lsum); }, partial);
   }
-  (void) n_redu_dynamic;
 }
 
-/* Parallel reduce driver function - specialization for 3D case */
-template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T, typename = typename std::enable_if<std::is_void<typename std::result_of<Lambda(uint, uint, uint, T*)>::type>::value>::type>
-inline static void parallel_reduce_driver(const uint (&limits)[3], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
+/* Reduce over the slab [first, last) of the slowest running dimension - specialization for 3D case */
+template <reduce_op Op, uint NReductions, typename Lambda, typename T, typename = typename std::enable_if<std::is_void<typename std::result_of<Lambda(uint, uint, uint, T*)>::type>::value>::type>
+inline static void reduce_slab(const uint (&limits)[3], Lambda &loop_body, T *partial, const uint first, const uint last) {
+
+  for (uint k = first; k < last; ++k)
+    for (uint j = 0; j < limits[1]; ++j)
+      reduce_simd<Op, NReductions>(0, limits[0], [&](const uint i, T *lsum) { loop_body(i, j, k, lsum); }, partial);
+}
 
-  uint idx[3];
-         
-  //#pragma omp for collapse(3)
-  for (idx[2] = 0; idx[2] < limits[2]; ++idx[2]) 
-    for (idx[1] = 0; idx[1] < limits[1]; ++idx[1]) 
-      for (idx[0] = 0; idx[0] < limits[0]; ++idx[0])
-        loop_body(idx[0], idx[1], idx[2], sum);
+/* Reduce over the slab [first, last) of the slowest running dimension - specialization for 3D case with nested bodies */
+template <reduce_op Op, uint NReductions, typename Lambda, typename T, typename = typename std::enable_if<!std::is_void<typename std::result_of<Lambda(uint, uint, uint, T*)>::type>::value>::type, typename = void>
+inline static void reduce_slab(const uint (&limits)[3], Lambda &loop_body, T *partial, const uint first, const uint last) {
 
-  (void) n_redu_dynamic;
+  for (uint k = first; k < last; ++k) {
+    auto inner_loop = loop_body(0, 0, k, partial);
+    for (uint j = 0; j < limits[1]; ++j)
+      reduce_simd<Op, NReductions>(0, limits[0], [&](const uint i, T *lsum) { inner_loop(i, j, k, lsum); }, partial);
+  }
 }
 
-/* Parallel reduce driver function - specialization for 3D case with nested bodies */
-template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T, typename = typename std::enable_if<!std::is_void<typename std::result_of<Lambda(uint, uint, uint, T*)>::type>::value>::type, typename = void>
-inline static void parallel_reduce_driver(const uint (&limits)[3], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
-
-  uint idx[3];
-         
-  //#pragma omp for collapse(3)
-  for (idx[2] = 0; idx[2] < limits[2]; ++idx[2]) {
-    auto inner_loop = loop_body(idx[0], idx[1], idx[2], sum);
-    for (idx[1] = 0; idx[1] < limits[1]; ++idx[1]) 
-      for (idx[0] = 0; idx[0] < limits[0]; ++idx[0])
-        inner_loop(idx[0], idx[1], idx[2], sum);
+/* Reduce over the slab [first, last) of the slowest running dimension - specialization for 4D case */
+template <reduce_op Op, uint NReductions, typename Lambda, typename T, typename = typename std::enable_if<std::is_void<typename std::result_of<Lambda(uint, uint, uint, uint, T*)>::type>::value>::type>
+inline static void reduce_slab(const uint (&limits)[4], Lambda &loop_body, T *partial, const uint first, const uint last) {
+
+  for (uint l = first; l < last; ++l)
+    for (uint k = 0; k < limits[2]; ++k)
+      for (uint j = 0; j < limits[1]; ++j)
+        reduce_simd<Op, NReductions>(0, limits[0], [&](const uint i, T *lsum) { loop_body(i, j, k, l, lsum); }, partial);
+}
+
+/* Reduce over the slab [first, last) of the slowest running dimension - specialization for 4D case with nested bodies */
+template <reduce_op Op, uint NReductions, typename Lambda, typename T, typename = typename std::enable_if<!std::is_void<typename std::result_of<Lambda(uint, uint, uint, uint, T*)>::type>::value>::type, typename = void>
+inline static void reduce_slab(const uint (&limits)[4], Lambda &loop_body, T *partial, const uint first, const uint last) {
+
+  for (uint l = first; l < last; ++l) {
+    auto inner_loop = loop_body(0, 0, 0, l, partial);
+    for (uint k = 0; k < limits[2]; ++k)
+      for (uint j = 0; j < limits[1]; ++j)
+        reduce_simd<Op, NReductions>(0, limits[0], [&](const uint i, T *lsum) { inner_loop(i, j, k, l, lsum); }, partial);
   }
-  (void) n_redu_dynamic;
 }
 
-/* Parallel reduce driver function - specialization for 4D case */
-template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T, typename = typename std::enable_if<std::is_void<typename std::result_of<Lambda(uint, uint, uint, uint, T*)>::type>::value>::type>
-inline static void parallel_reduce_driver(const uint (&limits)[4], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
+/* Reduce the slab [first, last) into private partials seeded from init, and
+ * combine the partials into result */
+template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T>
+inline static void reduce_partial(const uint (&limits)[NDim], Lambda &loop_body, const T *init, T *result, const uint n_redu, const uint first, const uint last) {
 
-  uint idx[4];
-         
-  //#pragma omp for collapse(4)
-  for (idx[3] = 0; idx[3] < limits[3]; ++idx[3]) 
-    for (idx[2] = 0; idx[2] < limits[2]; ++idx[2]) 
-      for (idx[1] = 0; idx[1] < limits[1]; ++idx[1]) 
-        for (idx[0] = 0; idx[0] < limits[0]; ++idx[0])
-          loop_body(idx[0], idx[1], idx[2], idx[3], sum);
+  T static_partial[NReductions > 0 ? NReductions : 1];
+  std::vector<T> dynamic_partial(NReductions > 0 ? 0 : n_redu);
+  T *partial = NReductions > 0 ? static_partial : dynamic_partial.data();
 
-  (void) n_redu_dynamic;
+  for (uint r = 0; r < n_redu; ++r)
+    partial[r] = reduce_init<Op>(init[r]);
+  reduce_slab<Op, NReductions>(limits, loop_body, partial, first, last);
+  for (uint r = 0; r < n_redu; ++r)
+    reduce_combine<Op>(result[r], partial[r]);
 }
 
-/* Parallel reduce driver function - specialization for 4D case with nested bodies */
-template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T, typename = typename std::enable_if<!std::is_void<typename std::result_of<Lambda(uint, uint, uint, uint, T*)>::type>::value>::type, typename = void>
-inline static void parallel_reduce_driver(const uint (&limits)[4], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
-
-  uint idx[4];
-         
-  //#pragma omp for collapse(4)
-  for (idx[3] = 0; idx[3] < limits[3]; ++idx[3]) { 
-    auto inner_loop = loop_body(idx[0], idx[1], idx[2], idx[3], sum);
-    for (idx[2] = 0; idx[2] < limits[2]; ++idx[2]) 
-      for (idx[1] = 0; idx[1] < limits[1]; ++idx[1]) 
-        for (idx[0] = 0; idx[0] < limits[0]; ++idx[0])
-          inner_loop(idx[0], idx[1], idx[2], idx[3], sum);
-  } 
-  (void) n_redu_dynamic;
+/* Parallel reduce driver function. The number of reduction variables is
+ * NReductions, or n_redu_dynamic if NReductions is zero. Called outside of an
+ * OpenMP parallel region, the slowest running dimension is split statically
+ * over a thread team, and the per-thread partials are combined in thread order
+ * so that the result only depends on the number of threads. Called inside a
+ * parallel region (eg. from a parallel loop over spatial cells) the reduction
+ * runs on the calling thread only. */
+template <reduce_op Op, uint NReductions, uint NDim, typename Lambda, typename T>
+inline static void parallel_reduce_driver(const uint (&limits)[NDim], Lambda loop_body, T *sum, const uint n_redu_dynamic) {
+
+  const uint n_redu = NReductions > 0 ? NReductions : n_redu_dynamic;
+  const uint n_slabs = limits[NDim - 1];
+
+#ifdef _OPENMP
+  uint64_t n_iterations = 1;
+  for (uint d = 0; d < NDim; ++d)
+    n_iterations *= limits[d];
+
+  const uint n_threads = std::min<uint64_t>(omp_get_max_threads(), n_slabs);
+  if (!omp_in_parallel() && n_threads > 1 && n_iterations >= host_min_threaded_iterations) {
+    std::vector<T> partials(n_threads * n_redu);
+    for (uint t = 0; t < n_threads; ++t)
+      for (uint r = 0; r < n_redu; ++r)
+        partials[t * n_redu + r] = reduce_init<Op>(sum[r]);
+
+    #pragma omp parallel num_threads(n_threads)
+    {
+      const uint t = omp_get_thread_num();
+      const uint first = (uint64_t)n_slabs * t / n_threads;
+      const uint last = (uint64_t)n_slabs * (t + 1) / n_threads;
+      reduce_partial<Op, NReductions>(limits, loop_body, sum, &partials[t * n_redu], n_redu, first, last);
+    }
+
+    for (uint t = 0; t < n_threads; ++t)
+      for (uint r = 0; r < n_redu; ++r)
+        reduce_combine<Op>(sum[r], partials[t * n_redu + r]);
+    return;
+  }
+#endif
+
+  reduce_partial<Op, NReductions>(limits, loop_body, sum, sum, n_redu, 0, n_slabs);
 }
 }
 #endif // !ARCH_DEVICE_HOST_H
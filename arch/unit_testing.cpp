@@ -347,6 +347,118 @@ typename std::enable_if<I == 8, std::tuple<bool, double, double>>::type test(){
   return std::make_tuple(success, arch_time, host_time);
 }
 
+template<uint I>
+typename std::enable_if<I == 9, std::tuple<bool, double, double>>::type test(){
+  
+  /* Unsigned products wrap around modulo 2^32, so the result is exact 
+   * regardless of the order in which the partial products are combined */
+  constexpr uint n_redu = 2;
+  volatile uint size = 1e3;
+  const uint ni = size, nj = size;
+  uint prod_arch[n_redu] = {1, 3};
+  uint prod_host[n_redu] = {1, 3};
+
+  clock_t arch_start = clock();
+  arch::parallel_reduce<arch::prod>({ni, nj}, 
+    ARCH_LOOP_LAMBDA(uint i, uint j, uint *lprod ){ 
+      lprod[0] *= 2 * (ni * j + i) + 1;
+      lprod[1] *= i + j + 1;
+    }, prod_arch);
+  double arch_time = (double)((clock() - arch_start) * 1e6 / CLOCKS_PER_SEC);
+
+  clock_t host_start = clock();
+  for (uint j = 0; j < nj; ++j) 
+    for (uint i = 0; i < ni; ++i){
+      prod_host[0] *= 2 * (ni * j + i) + 1;
+      prod_host[1] *= i + j + 1;
+    }
+  double host_time = (double)((clock() - host_start) * 1e6 / CLOCKS_PER_SEC);  
+  
+  std::vector<uint> v_arch(prod_arch, prod_arch + n_redu);
+  std::vector<uint> v_host(prod_host, prod_host + n_redu);
+  bool success = (v_arch == v_host) ? true : false;
+
+  return std::make_tuple(success, arch_time, host_time);
+}
+
+template<uint I>
+typename std::enable_if<I == 10, std::tuple<bool, double, double>>::type test(){
+  
+  /* The number of reductions known only at runtime */
+  volatile uint n_redu = 3;
+  volatile uint size = 2e2;
+  const uint ni = size, nj = size, nk = size;
+  std::vector<int> max_arch(n_redu, std::numeric_limits<int>::min());
+  std::vector<int> max_host(n_redu, std::numeric_limits<int>::min());
+  max_arch[2] = max_host[2] = std::numeric_limits<int>::max();
+
+  clock_t arch_start = clock();
+  arch::parallel_reduce<arch::max>({ni, nj, nk}, 
+    ARCH_LOOP_LAMBDA(uint i, uint j, uint k, int *lmax ){ 
+      const int val = (int)((i * 7919 + j * 104729 + k * 1299709) % 1000003);
+      lmax[0] = max(val, lmax[0]);
+      lmax[1] = max(-val, lmax[1]);
+      lmax[2] = max(val, lmax[2]);
+    }, max_arch);
+  double arch_time = (double)((clock() - arch_start) * 1e6 / CLOCKS_PER_SEC);
+
+  clock_t host_start = clock();
+  for (uint k = 0; k < nk; ++k) 
+    for (uint j = 0; j < nj; ++j) 
+      for (uint i = 0; i < ni; ++i){
+        const int val = (int)((i * 7919 + j * 104729 + k * 1299709) % 1000003);
+        max_host[0] = max(val, max_host[0]);
+        max_host[1] = max(-val, max_host[1]);
+        max_host[2] = max(val, max_host[2]);
+      }
+  double host_time = (double)((clock() - host_start) * 1e6 / CLOCKS_PER_SEC);  
+  
+  bool success = (max_arch == max_host) ? true : false;
+
+  return std::make_tuple(success, arch_time, host_time);
+}
+
+template<uint I>
+typename std::enable_if<I == 11, std::tuple<bool, double, double>>::type test(){
+  
+  /* The number of reductions known only at runtime */
+  volatile uint n_redu = 2;
+  volatile uint size = 64;
+  const uint ni = size, nj = size, nk = size, nl = size;
+  std::vector<double> min_arch(n_redu, std::numeric_limits<double>::max());
+  std::vector<double> min_host(n_redu, std::numeric_limits<double>::max());
+  min_arch[1] = min_host[1] = -1.0;
+
+  clock_t arch_start = clock();
+  arch::parallel_reduce<arch::min>({ni, nj, nk, nl}, 
+    ARCH_LOOP_LAMBDA(uint i, uint j, uint k, uint l, double *lmin ){ 
+      const double offset = 0.5 * l;
+      ARCH_INNER_BODY(i, j, k, l, lmin) { 
+        const double val = offset + (double)((i * 31 + j * 17 + k * 13 + l * 7) % 101) - 50.0;
+        lmin[0] = min(val, lmin[0]);
+        lmin[1] = min(val, lmin[1]);
+      };
+    }, min_arch);
+  double arch_time = (double)((clock() - arch_start) * 1e6 / CLOCKS_PER_SEC);
+
+  clock_t host_start = clock();
+  for (uint l = 0; l < nl; ++l){
+    const double offset = 0.5 * l;
+    for (uint k = 0; k < nk; ++k) 
+      for (uint j = 0; j < nj; ++j) 
+        for (uint i = 0; i < ni; ++i){
+          const double val = offset + (double)((i * 31 + j * 17 + k * 13 + l * 7) % 101) - 50.0;
+          min_host[0] = min(val, min_host[0]);
+          min_host[1] = min(val, min_host[1]);
+        }
+  }
+  double host_time = (double)((clock() - host_start) * 1e6 / CLOCKS_PER_SEC);  
+  
+  bool success = (min_arch == min_host) ? true : false;
+
+  return std::make_tuple(success, arch_time, host_time);
+}
+
 /* Instantiate each test function by recursively calling the
  * driver function in a descending order beginning from `N - 1`
  */
@@ -368,7 +480,7 @@ struct test_instatiator<N, 0> {
 int main(){
     
   /* Specify the number of tests and set function pointers */
-  constexpr uint n_tests = 9;
+  constexpr uint n_tests = 12;
   std::tuple<bool, double, double>(*fptr_test[n_tests])();
   test_instatiator<n_tests, n_tests>::driver(fptr_test);
 
@@ -27,111 +27,164 @@
 #include "backgroundfield.h"
 #include "fieldfunction.hpp"
 #include "integratefunction.hpp"
+#include "dipole.hpp"
+#include "linedipole.hpp"
+#include "vectordipole.hpp"
+#include "constantfield.hpp"
+#include "backgroundfieldcache.h"
 
-//FieldFunction should be initialized
-void setBackgroundField(
-   const FieldFunction& bgFunction,
+/*! Adds the cell averages computed by cellAverages(start, dx, averages) to
+ * every local cell of BgBGrid. Cells are independent, so they are computed in
+ * parallel; the cost per cell varies a lot (Romberg near the dipole, closed
+ * forms elsewhere), hence the dynamic schedule. If contribution is given, the
+ * averages are also stored there in the layout of the background field cache.*/
+template<typename CellAverages> static void addBackgroundField(
    FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
-   bool append) {
-   
-   using namespace std::placeholders;
-
-   /*if we do not add a new background to the existing one we first put everything to zero*/
-   if(append==false) {
-      setBackgroundFieldToZero(BgBGrid);
-   }
-   
-   //these are doubles, as the averaging functions copied from Gumics
-   //use internally doubles. In any case, it should provide more
-   //accurate results also for float simulations
-   double accuracy = 1e-17;
-   double start[3];
-   double end[3];
-   double dx[3];
-   unsigned int faceCoord1[3];
-   unsigned int faceCoord2[3];
-   
-   //the coordinates of the edges face with a normal in the third coordinate direction, stored here to enable looping
-   faceCoord1[0]=1;
-   faceCoord2[0]=2;
-   faceCoord1[1]=0;
-   faceCoord2[1]=2;
-   faceCoord1[2]=0;
-   faceCoord2[2]=1;
-   
+   const CellAverages& cellAverages,
+   Real* contribution = NULL
+) {
    auto localSize = BgBGrid.getLocalSize();
+   const double dx[3] = {BgBGrid.DX, BgBGrid.DY, BgBGrid.DZ};
    
-   // TODO: These can be threaded now that the dipole field is threadsafe
+   #pragma omp parallel for collapse(3) schedule(dynamic,16)
    for (int x = 0; x < localSize[0]; ++x) {
       for (int y = 0; y < localSize[1]; ++y) {
          for (int z = 0; z < localSize[2]; ++z) {
             std::array<double, 3> start3 = BgBGrid.getPhysicalCoords(x, y, z);
-            start[0] = start3[0];
-            start[1] = start3[1];
-            start[2] = start3[2];
-            
-            dx[0] = BgBGrid.DX;
-            dx[1] = BgBGrid.DY;
-            dx[2] = BgBGrid.DZ;
-            
-            end[0]=start[0]+dx[0];
-            end[1]=start[1]+dx[1];
-            end[2]=start[2]+dx[2];
-            
-            //Face averages
-            for(uint fComponent=0; fComponent<3; fComponent++){
-               T3DFunction valueFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 0, (coordinate)0);
-               BgBGrid.get(x,y,z)->at(fsgrids::bgbfield::BGBX+fComponent) += 
-                  surfaceAverage(valueFunction,
-                     (coordinate)fComponent,
-                                 accuracy,
-                                 start,
-                                 dx[faceCoord1[fComponent]],
-                                 dx[faceCoord2[fComponent]]
-                                );
-               
-               //Compute derivatives. Note that we scale by dx[] as the arrays are assumed to contain differences, not true derivatives!
-               T3DFunction derivFunction1 = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord1[fComponent]);
-               BgBGrid.get(x,y,z)->at(fsgrids::bgbfield::dBGBxdy+2*fComponent) +=
-                  dx[faceCoord1[fComponent]] * 
-                  surfaceAverage(derivFunction1,
-                     (coordinate)fComponent,
-                                 accuracy,
-                                 start,
-                                 dx[faceCoord1[fComponent]],
-                                 dx[faceCoord2[fComponent]]
-                                );
-
-               T3DFunction derivFunction2 = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord2[fComponent]);
-               BgBGrid.get(x,y,z)->at(fsgrids::bgbfield::dBGBxdy+1+2*fComponent) +=
-                  dx[faceCoord2[fComponent]] *
-                  surfaceAverage(derivFunction2,
-                     (coordinate)fComponent,
-                                 accuracy,
-                                 start,
-                                 dx[faceCoord1[fComponent]],
-                                 dx[faceCoord2[fComponent]]
-                                );
+            const double start[3] = {start3[0], start3[1], start3[2]};
+            double averages[fsgrids::bgbfield::N_BGB];
+            cellAverages(start, dx, averages);
+            std::array<Real, fsgrids::bgbfield::N_BGB>* cell = BgBGrid.get(x,y,z);
+            for (int i = 0; i < fsgrids::bgbfield::N_BGB; ++i) {
+               cell->at(i) += averages[i];
             }
-            
-            //Volume averages
-            for(unsigned int fComponent=0;fComponent<3;fComponent++){
-               T3DFunction valueFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 0, (coordinate)0);
-               BgBGrid.get(x,y,z)->at(fsgrids::bgbfield::BGBXVOL+fComponent) += volumeAverage(valueFunction,accuracy,start,end);
-               
-               //Compute derivatives. Note that we scale by dx[] as the arrays are assumed to contain differences, not true derivatives!      
-               T3DFunction derivFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord1[fComponent]);
-               BgBGrid.get(x,y,z)->at(fsgrids::bgbfield::dBGBXVOLdy+2*fComponent) += dx[faceCoord1[fComponent]] * volumeAverage(derivFunction,accuracy,start,end);
-               derivFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord2[fComponent]);
-               BgBGrid.get(x,y,z)->at(fsgrids::bgbfield::dBGBXVOLdy+1+2*fComponent) += dx[faceCoord2[fComponent]] * volumeAverage(derivFunction,accuracy,start,end);
+            if (contribution != NULL) {
+               Real* stored = contribution + ((size_t)(z*localSize[1] + y)*localSize[0] + x)*fsgrids::bgbfield::N_BGB;
+               for (int i = 0; i < fsgrids::bgbfield::N_BGB; ++i) {
+                  stored[i] = averages[i];
+               }
             }
          }
       }
    }
+}
+
+/*! Adds a background field contribution read from the cache to BgBGrid.*/
+static void addBackgroundFieldBuffer(
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   const std::vector<Real>& contribution
+) {
+   auto localSize = BgBGrid.getLocalSize();
+   
+   #pragma omp parallel for collapse(3)
+   for (int x = 0; x < localSize[0]; ++x) {
+      for (int y = 0; y < localSize[1]; ++y) {
+         for (int z = 0; z < localSize[2]; ++z) {
+            const Real* stored = contribution.data() + ((size_t)(z*localSize[1] + y)*localSize[0] + x)*fsgrids::bgbfield::N_BGB;
+            std::array<Real, fsgrids::bgbfield::N_BGB>* cell = BgBGrid.get(x,y,z);
+            for (int i = 0; i < fsgrids::bgbfield::N_BGB; ++i) {
+               cell->at(i) += stored[i];
+            }
+         }
+      }
+   }
+}
+
+/*! Background field of one of the analytic field classes. By default every
+ * cell is averaged with the adaptive Romberg integration. With
+ * fieldsolver.fastBackgroundAverages the cells use fastCellAverages() instead,
+ * the closed-form or Gauss-Legendre averages where they apply.
+ *
+ * With io.bgb_cache_path set, cacheable fields are read from the background
+ * field cache if a file for this field and grid exists, and written there
+ * after computing them otherwise.*/
+template<typename F> static void setAnalyticBackgroundField(
+   const F& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append,
+   bool cacheable) {
+   
+   /*if we do not add a new background to the existing one we first put everything to zero*/
+   if(append==false) {
+      setBackgroundFieldToZero(BgBGrid);
+   }
+   
+   uint64_t key = 0;
+   std::vector<Real> contribution;
+   const bool useCache = cacheable && Parameters::bgbCachePath.size() > 0;
+   if (useCache) {
+      key = backgroundFieldCacheKey(bgFunction.parameterHash(), BgBGrid);
+      if (readBackgroundFieldCache(key, BgBGrid, contribution)) {
+         addBackgroundFieldBuffer(BgBGrid, contribution);
+         return;
+      }
+   }
+   
+   if (useCache) {
+      auto localSize = BgBGrid.getLocalSize();
+      contribution.resize((size_t)localSize[0]*localSize[1]*localSize[2]*fsgrids::bgbfield::N_BGB);
+   }
+   const FieldFunction fieldFunction(bgFunction);
+   const bool fast = Parameters::fastBackgroundAverages;
+   addBackgroundField(BgBGrid, [&](const double start[3], const double dx[3], double averages[]) {
+      if (fast) {
+         fastCellAverages(bgFunction, fieldFunction, start, dx, averages);
+      } else {
+         rombergCellAverages(fieldFunction, start, dx, averages);
+      }
+   }, useCache ? contribution.data() : NULL);
+   
+   if (useCache) {
+      writeBackgroundFieldCache(key, BgBGrid, contribution);
+   }
+}
+
+//FieldFunction should be initialized
+void setBackgroundField(
+   const FieldFunction& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append) {
+   
+   /*if we do not add a new background to the existing one we first put everything to zero*/
+   if(append==false) {
+      setBackgroundFieldToZero(BgBGrid);
+   }
+   addBackgroundField(BgBGrid, [&](const double start[3], const double dx[3], double averages[]) {
+      rombergCellAverages(bgFunction, start, dx, averages);
+   });
    //TODO
    //COmpute divergence and curl of volume averaged field and check that both are zero. 
 }
 
+void setBackgroundField(
+   const Dipole& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append) {
+   setAnalyticBackgroundField(bgFunction, BgBGrid, append, true);
+}
+
+void setBackgroundField(
+   const LineDipole& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append) {
+   setAnalyticBackgroundField(bgFunction, BgBGrid, append, true);
+}
+
+void setBackgroundField(
+   const VectorDipole& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append) {
+   setAnalyticBackgroundField(bgFunction, BgBGrid, append, true);
+}
+
+void setBackgroundField(
+   const ConstantField& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append) {
+   // Cheaper to compute than to read, so never cached
+   setAnalyticBackgroundField(bgFunction, BgBGrid, append, false);
+}
+
 void setBackgroundFieldToZero(
    FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid
 ) {
@@ -165,40 +218,22 @@ void setPerturbedField(
    //these are doubles, as the averaging functions copied from Gumics
    //use internally doubles. In any case, it should provide more
    //accurate results also for float simulations
-   double accuracy = 1e-17;
-   double start[3];
-   //double end[3];
-   double dx[3];
-   unsigned int faceCoord1[3];
-   unsigned int faceCoord2[3];
-   
+   const double accuracy = 1e-17;
+   const double dx[3] = {perBGrid.DX, perBGrid.DY, perBGrid.DZ};
    //the coordinates of the edges face with a normal in the third coordinate direction, stored here to enable looping
-   faceCoord1[0]=1;
-   faceCoord2[0]=2;
-   faceCoord1[1]=0;
-   faceCoord2[1]=2;
-   faceCoord1[2]=0;
-   faceCoord2[2]=1;
+   const unsigned int faceCoord1[3] = {1, 0, 0};
+   const unsigned int faceCoord2[3] = {2, 2, 1};
    
    auto localSize = perBGrid.getLocalSize();
    
-   // Do not thread this blindly, the bfFunction.set* calls below are not thread-safe at the moment.
+   // The field functions are const and the averaging functions re-entrant, so cells can be done in parallel
+   #pragma omp parallel for collapse(3) schedule(dynamic,16)
    for (int x = 0; x < localSize[0]; ++x) {
       for (int y = 0; y < localSize[1]; ++y) {
          for (int z = 0; z < localSize[2]; ++z) {
             std::array<double, 3> start3 = perBGrid.getPhysicalCoords(x, y, z);
-            start[0] = start3[0];
-            start[1] = start3[1];
-            start[2] = start3[2];
-            
-            dx[0] = perBGrid.DX;
-            dx[1] = perBGrid.DY;
-            dx[2] = perBGrid.DZ;
+            const double start[3] = {start3[0], start3[1], start3[2]};
             
-            //end[0]=start[0]+dx[0];
-            //end[1]=start[1]+dx[1];
-            //end[2]=start[2]+dx[2];
-
             //Face averages
             for(uint fComponent=0; fComponent<3; fComponent++){
                T3DFunction valueFunction = std::bind(bfFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 0, (coordinate)0);
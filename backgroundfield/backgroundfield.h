@@ -28,12 +28,43 @@
 #include "../common.h"
 #include "fsgrid.hpp"
 
+class Dipole;
+class LineDipole;
+class VectorDipole;
+class ConstantField;
+
 void setBackgroundField(
    const FieldFunction& bgFunction,
    FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
    bool append=false
 );
 
+/* Overloads for the analytic fields, which use closed-form or batched
+   Gauss-Legendre averages where possible instead of Romberg integration. */
+void setBackgroundField(
+   const Dipole& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append=false
+);
+
+void setBackgroundField(
+   const LineDipole& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append=false
+);
+
+void setBackgroundField(
+   const VectorDipole& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append=false
+);
+
+void setBackgroundField(
+   const ConstantField& bgFunction,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   bool append=false
+);
+
 void setBackgroundFieldToZero(
    FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid
 );
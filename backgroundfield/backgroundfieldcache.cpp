@@ -0,0 +1,195 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cstdio>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "vlsv_reader_parallel.h"
+#include "vlsv_writer.h"
+#include "../parameters.h"
+#include "../logger.h"
+#include "backgroundfieldcache.h"
+
+extern Logger logFile;
+
+// Bump when the averaging of the background field changes, so that files
+// written by older versions are not picked up.
+static const uint64_t BGB_CACHE_VERSION = 1;
+
+/*! Number of values in the local part of the cache buffer.*/
+static std::size_t localBufferSize(FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid) {
+   const std::array<int32_t,3>& localSize = BgBGrid.getLocalSize();
+   return (std::size_t)localSize[0]*localSize[1]*localSize[2]*fsgrids::bgbfield::N_BGB;
+}
+
+static std::string cacheFileName(const uint64_t key) {
+   std::ostringstream name;
+   name << Parameters::bgbCachePath << "/bgb_cache_" << std::hex << std::setw(16) << std::setfill('0') << key << ".vlsv";
+   return name.str();
+}
+
+/*! Key of the cache file for a field with the given parameter hash. Covers
+ * everything the stored values depend on: the field, the cell geometry and
+ * the domain decomposition, which sets the order of the data in the file.
+ * Collective over MPI_COMM_WORLD, all ranks get the same key.*/
+uint64_t backgroundFieldCacheKey(
+   const uint64_t fieldHash,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid
+) {
+   int size;
+   MPI_Comm_size(MPI_COMM_WORLD, &size);
+   const std::array<int32_t,3>& localStart = BgBGrid.getLocalStart();
+   const std::array<int32_t,3>& localSize = BgBGrid.getLocalSize();
+   const int32_t domain[6] = {localStart[0], localStart[1], localStart[2], localSize[0], localSize[1], localSize[2]};
+   std::vector<int32_t> domains(6*size);
+   MPI_Allgather(domain, 6, MPI_INT32_T, domains.data(), 6, MPI_INT32_T, MPI_COMM_WORLD);
+
+   const std::array<int32_t,3>& globalSize = BgBGrid.getGlobalSize();
+   const double geometry[6] = {BgBGrid.DX, BgBGrid.DY, BgBGrid.DZ,
+                               BgBGrid.physicalGlobalStart[0], BgBGrid.physicalGlobalStart[1], BgBGrid.physicalGlobalStart[2]};
+   // The averaging method changes the values slightly, so it is part of the key
+   const uint64_t layout[4] = {BGB_CACHE_VERSION, sizeof(Real), fsgrids::bgbfield::N_BGB, Parameters::fastBackgroundAverages};
+
+   uint64_t key = hashBytes(HASH_SEED, &fieldHash, sizeof(fieldHash));
+   key = hashBytes(key, layout, sizeof(layout));
+   key = hashBytes(key, globalSize.data(), 3*sizeof(int32_t));
+   key = hashBytes(key, geometry, sizeof(geometry));
+   key = hashBytes(key, domains.data(), domains.size()*sizeof(int32_t));
+   return key;
+}
+
+/*! Read the cached background field contribution with the given key into
+ * buffer. Collective; returns false on all ranks if the file is missing or
+ * does not match, in which case the field has to be recomputed.*/
+bool readBackgroundFieldCache(
+   const uint64_t key,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   std::vector<Real>& buffer
+) {
+   int myRank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+   const std::string fileName = cacheFileName(key);
+
+   // Only try to open files that exist, the reader would complain loudly otherwise
+   int exists = 0;
+   if (myRank == MASTER_RANK) {
+      exists = (access(fileName.c_str(), R_OK) == 0) ? 1 : 0;
+   }
+   MPI_Bcast(&exists, 1, MPI_INT, MASTER_RANK, MPI_COMM_WORLD);
+   if (exists == 0) {
+      return false;
+   }
+
+   vlsv::ParallelReader file;
+   if (file.open(fileName, MPI_COMM_WORLD, MASTER_RANK, MPI_INFO_NULL) == false) {
+      logFile << "(BGB CACHE) WARNING: could not open " << fileName << ", recomputing background field" << std::endl << write;
+      return false;
+   }
+
+   uint64_t fileKey = 0;
+   bool success = file.readParameter("bgbCacheKey", fileKey) && fileKey == key;
+
+   std::list<std::pair<std::string,std::string> > attribs;
+   attribs.push_back(std::make_pair("name","bgb_cache"));
+   uint64_t arraySize, vectorSize, byteSize;
+   vlsv::datatype::type dataType;
+   if (success) {
+      success = file.getArrayInfo("VARIABLE", attribs, arraySize, vectorSize, dataType, byteSize)
+         && dataType == vlsv::datatype::type::FLOAT && byteSize == sizeof(Real) && vectorSize == fsgrids::bgbfield::N_BGB;
+   }
+
+   // Our part of the file starts after the cells of all lower ranks
+   const std::array<int32_t,3>& localSize = BgBGrid.getLocalSize();
+   const uint64_t localCells = (uint64_t)localSize[0]*localSize[1]*localSize[2];
+   uint64_t offset = 0;
+   MPI_Exscan(&localCells, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+   if (myRank == MASTER_RANK) {
+      offset = 0;
+   }
+
+   // All ranks have to take part in the read, a mismatch on one rank makes the whole read fail
+   buffer.resize(localBufferSize(BgBGrid));
+   if (success) {
+      success = offset + localCells <= arraySize;
+   }
+   const bool readSuccess = file.readArray("VARIABLE", attribs, success ? offset : 0, success ? localCells : 0, buffer.data());
+   success = success && readSuccess;
+   file.close();
+
+   int localSuccess = success ? 1 : 0;
+   int globalSuccess = 0;
+   MPI_Allreduce(&localSuccess, &globalSuccess, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+   if (globalSuccess == 0) {
+      logFile << "(BGB CACHE) WARNING: " << fileName << " does not match this run, recomputing background field" << std::endl << write;
+      return false;
+   }
+   logFile << "(BGB CACHE) Read background field from " << fileName << std::endl << writeVerbose;
+   return true;
+}
+
+/*! Write a computed background field contribution under the given key.
+ * Written to a temporary name and renamed once complete, so that a run
+ * starting meanwhile never reads a partial file. Collective.*/
+bool writeBackgroundFieldCache(
+   const uint64_t key,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   const std::vector<Real>& buffer
+) {
+   int myRank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+   const std::string fileName = cacheFileName(key);
+   const std::string tmpName = fileName + ".tmp";
+
+   vlsv::Writer writer;
+   if (writer.open(tmpName, MPI_COMM_WORLD, MASTER_RANK, MPI_INFO_NULL) == false) {
+      logFile << "(BGB CACHE) WARNING: could not open " << tmpName << " for writing" << std::endl << write;
+      return false;
+   }
+   writer.setBuffer(Parameters::vlsvBufferSize);
+
+   bool success = writer.writeParameter("bgbCacheKey", &key);
+
+   std::map<std::string,std::string> attribs;
+   attribs["name"] = "bgb_cache";
+   const uint64_t localCells = buffer.size() / fsgrids::bgbfield::N_BGB;
+   success = writer.writeArray("VARIABLE", attribs, localCells, fsgrids::bgbfield::N_BGB, buffer.data()) && success;
+   success = writer.close() && success;
+
+   int localSuccess = success ? 1 : 0;
+   int globalSuccess = 0;
+   MPI_Allreduce(&localSuccess, &globalSuccess, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+   if (myRank == MASTER_RANK) {
+      if (globalSuccess == 1 && rename(tmpName.c_str(), fileName.c_str()) == 0) {
+         logFile << "(BGB CACHE) Wrote background field to " << fileName << std::endl << writeVerbose;
+      } else {
+         remove(tmpName.c_str());
+         logFile << "(BGB CACHE) WARNING: failed to write " << fileName << std::endl << write;
+         globalSuccess = 0;
+      }
+   }
+   MPI_Bcast(&globalSuccess, 1, MPI_INT, MASTER_RANK, MPI_COMM_WORLD);
+   return globalSuccess == 1;
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef BACKGROUNDFIELDCACHE_H
+#define BACKGROUNDFIELDCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../definitions.h"
+#include "../common.h"
+#include "fsgrid.hpp"
+#include "functions.hpp"
+
+/* Cache of computed background field contributions in VLSV sidecar files.
+ *
+ * Each analytic field added with setBackgroundField() is stored as its own
+ * file in Parameters::bgbCachePath, named after a key that hashes the field
+ * parameters, the fsgrid geometry and its domain decomposition. The buffers
+ * hold the N_BGB values of the local cells in (z,y,x) order, as the fsgrid
+ * restart variables, and every rank reads or writes its own contiguous part.
+ * Any mismatch (missing file, different key or size) makes the read fail on
+ * all ranks, and the caller recomputes the field and rewrites the file. */
+
+uint64_t backgroundFieldCacheKey(
+   const uint64_t fieldHash,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid
+);
+
+bool readBackgroundFieldCache(
+   const uint64_t key,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   std::vector<Real>& buffer
+);
+
+bool writeBackgroundFieldCache(
+   const uint64_t key,
+   FsGrid< std::array<Real, fsgrids::bgbfield::N_BGB>, FS_STENCIL_WIDTH> & BgBGrid,
+   const std::vector<Real>& buffer
+);
+
+#endif
@@ -25,6 +25,7 @@ Background magnetic field class of Vlasiator.
 
 #include <stdlib.h>
 #include <math.h>
+#include <limits>
 #include "constantfield.hpp"
 #include "../common.h"
 
@@ -48,8 +49,32 @@ double ConstantField::operator()( double x, double y, double z, coordinate compo
    }
 }
 
+void ConstantField::evaluate(const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) const {
+   const double value = (derivative == 0) ? _B[component] : 0.0;
+   for (int i = 0; i < n; i++) {
+      result[i] = value;
+   }
+}
 
+double ConstantField::smoothDistance(const double start[3], const double dx[3]) const {
+   return std::numeric_limits<double>::max();
+}
 
+/*! The averages of a constant field are the field itself, all derivatives are zero.*/
+bool ConstantField::cellAverages(const double start[3], const double dx[3], double averages[]) const {
+   for (int i = 0; i < fsgrids::bgbfield::N_BGB; i++) {
+      averages[i] = 0.0;
+   }
+   for (int c = 0; c < 3; c++) {
+      averages[fsgrids::bgbfield::BGBX+c] = _B[c];
+      averages[fsgrids::bgbfield::BGBXVOL+c] = _B[c];
+   }
+   return true;
+}
 
-
-
+/*! Hash of the field parameters, used as part of the background field cache key.*/
+uint64_t ConstantField::parameterHash() const {
+   uint64_t hash = hashBytes(HASH_SEED, "ConstantField", 13);
+   hash = hashBytes(hash, &_initialized, sizeof(_initialized));
+   return hashBytes(hash, _B, sizeof(_B));
+}
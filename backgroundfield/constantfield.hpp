@@ -41,6 +41,10 @@ public:
 
    void initialize(const double Bx,const double By, const double Bz);
    Real operator()( Real x, Real y, Real z, coordinate component, unsigned int derivative, coordinate dcomponent) const;
+   void evaluate(const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) const;
+   double smoothDistance(const double start[3], const double dx[3]) const;
+   bool cellAverages(const double start[3], const double dx[3], double averages[]) const;
+   uint64_t parameterHash() const;
 };
 
 #endif
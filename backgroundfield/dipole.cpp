@@ -25,7 +25,10 @@ Background magnetic field class of Vlasiator.
 
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <limits>
 #include "dipole.hpp"
+#include "integratefunction.hpp"
 #include "../common.h"
 
 //tilt_angle is agains the z axis in the x-z plane. In radians*/
@@ -39,54 +42,295 @@ void Dipole::initialize(const double moment,const double center_x, const double
    center[2]=center_z;
 }
 
-
+/*! Field of a dipole with moment q at offset r from the dipole, or its first
+ * derivative. Shared by the scalar and the batched evaluation, and written
+ * without branches so that the batched loop vectorizes: the components are
+ * picked with unit vector weights and all results are computed and selected.*/
+static inline double dipoleValue(const double q[3], const double rx, const double ry, const double rz, coordinate component, unsigned int derivative, coordinate dcomponent) {
+   const double minimumR=1e-3*physicalconstants::R_E; //The dipole field is defined to be outside of Earth, and units are in meters     
+   const double r2 = rx*rx+ry*ry+rz*rz;
+   const bool inside = r2<minimumR*minimumR;
+   // evaluate at minimumR inside the dipole so that no division by zero is done, the result is discarded
+   const double safeR2 = inside ? minimumR*minimumR : r2;
+   const double rc = (component==X)*rx + (component==Y)*ry + (component==Z)*rz;
+   const double rd = (dcomponent==X)*rx + (dcomponent==Y)*ry + (dcomponent==Z)*rz;
+   const double qc = (component==X)*q[0] + (component==Y)*q[1] + (component==Z)*q[2];
+   const double qd = (dcomponent==X)*q[0] + (dcomponent==Y)*q[1] + (dcomponent==Z)*q[2];
+   
+   const double r5 = (safeR2*safeR2*sqrt(safeR2));
+   const double rdotq=q[0]*rx + q[1]*ry +q[2]*rz;
+   
+   //Value of B
+   const double B=( 3*rc*rdotq-qc*safeR2)/r5;
+   
+   //first derivatives       
+   const unsigned int sameComponent = (dcomponent==component) ? 1 : 0;
+   const double dB = -5*B*rd/safeR2+
+      (3*qd*rc -
+       2*qc*rd +
+       3*rdotq*sameComponent)/r5;
+   
+   // derivatives other than first ones are not defined
+   const double value = (derivative == 0)*B + (derivative == 1)*dB;
+   return inside ? 0.0 : value; //set zero field inside dipole
+}
 
 double Dipole::operator()( double x, double y, double z, coordinate component, unsigned int derivative, coordinate dcomponent) const {
-   const double minimumR=1e-3*physicalconstants::R_E; //The dipole field is defined to be outside of Earth, and units are in meters     
    if(this->initialized==false) {
       return 0.0;
    }
-   double r[3];
-   
-   r[0]= x-center[0];
-   r[1]= y-center[1];
-   r[2]= z-center[2];
-   
-   double r2 = r[0]*r[0]+r[1]*r[1]+r[2]*r[2];
-   
-   if(r2<minimumR*minimumR) {
-      //  r2=minimumR*minimumR;
-      return 0.0; //set zero field inside dipole
+   return dipoleValue(q, x-center[0], y-center[1], z-center[2], component, derivative, dcomponent);
+}
+
+/*! Evaluate the dipole field (or its first derivative) at n points at once.*/
+void dipoleEvaluate(const double q[3], const double center[3], const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) {
+   // local copies, so that the compiler knows they do not alias result
+   const double localQ[3] = {q[0], q[1], q[2]};
+   const double localCenter[3] = {center[0], center[1], center[2]};
+   #pragma omp simd
+   for (int i = 0; i < n; i++) {
+      result[i] = dipoleValue(localQ, x[i]-localCenter[0], y[i]-localCenter[1], z[i]-localCenter[2], component, derivative, dcomponent);
    }
-   
-   const double r5 = (r2*r2*sqrt(r2));
-   const double rdotq=q[0]*r[0] + q[1]*r[1] +q[2]*r[2];
-   
-   const double B=( 3*r[component]*rdotq-q[component]*r2)/r5;
-   
-   if(derivative == 0) {
-      //Value of B
-      return B;
-   } else if(derivative == 1) {
-      //first derivatives       
-      unsigned int sameComponent;
-      if(dcomponent==component) {
-         sameComponent=1;
-      } else {
-         sameComponent=0;
+}
+
+/*! Batched version of operator(), used by the Gauss-Legendre cell averages.*/
+void Dipole::evaluate(const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) const {
+   if(this->initialized==false) {
+      for (int i = 0; i < n; i++) {
+         result[i] = 0.0;
       }
-      
-      return -5*B*r[dcomponent]/r2+
-         (3*q[dcomponent]*r[component] -
-          2*q[component]*r[dcomponent] +
-          3*rdotq*sameComponent)/r5;
+      return;
    }
+   dipoleEvaluate(q, center, n, x, y, z, component, derivative, dcomponent, result);
+}
 
-   return 0; // dummy, but prevents gcc from yelling
+/*! Distance from the cell to the dipole in units of the largest cell edge.*/
+double Dipole::smoothDistance(const double start[3], const double dx[3]) const {
+   if(this->initialized==false) {
+      return std::numeric_limits<double>::max();
+   }
+   return cellDistance(center, start, dx) / std::max(dx[0], std::max(dx[1], dx[2]));
 }
 
+/*! Closed-form cell averages, see dipoleCellAverages().*/
+bool Dipole::cellAverages(const double start[3], const double dx[3], double averages[]) const {
+   if(this->initialized==false) {
+      for (int i = 0; i < fsgrids::bgbfield::N_BGB; i++) {
+         averages[i] = 0.0;
+      }
+      return true;
+   }
+   return dipoleCellAverages(q, center, start, dx, averages);
+}
 
+/*! Hash of the field parameters, used as part of the background field cache key.*/
+uint64_t Dipole::parameterHash() const {
+   uint64_t hash = hashBytes(HASH_SEED, "Dipole", 6);
+   hash = hashBytes(hash, &initialized, sizeof(initialized));
+   hash = hashBytes(hash, q, sizeof(q));
+   return hashBytes(hash, center, sizeof(center));
+}
 
+/* The dipole field is B_i = q_j d_i d_j G with G = 1/r, so all face and
+ * volume averages of B and its first derivatives are integrals of partial
+ * derivatives of G over rectangles and boxes. These reduce to sums over the
+ * corners of antiderivatives of G, which are elementary functions.
+ *
+ * greenKernel returns d^m G at p, where m[i] is the derivative order along
+ * axis i and -1 stands for integration along it. Only the orders needed for
+ * the averages are implemented. All coordinates are non-negative and no two
+ * of them are close to zero, i.e. p is away from the coordinate axes through
+ * the dipole where some of the terms diverge.
+ */
+static double greenKernel(const int m[3], const double p[3]) {
+   const double r2 = p[0]*p[0]+p[1]*p[1]+p[2]*p[2];
+   const double r = sqrt(r2);
+   int integrated = 0;
+   for (int i=0; i<3; i++) {
+      if (m[i] < 0) {
+         integrated++;
+      }
+   }
+   
+   if (integrated == 0) {
+      // G or its gradient
+      for (int i=0; i<3; i++) {
+         if (m[i] == 1) {
+            return -p[i]/(r2*r);
+         }
+      }
+      return 1.0/r;
+   } else if (integrated == 1) {
+      // Derivatives of the line integral ln(c+r) of G along axis c
+      const int c = (m[0] < 0) ? 0 : ((m[1] < 0) ? 1 : 2);
+      const int a = (c+1)%3;
+      const int b = (c+2)%3;
+      const double cr = p[c] + r;
+      if (m[a] + m[b] == 0) {
+         return log(cr);
+      } else if (m[a] + m[b] == 1) {
+         const double d = (m[a] == 1) ? p[a] : p[b];
+         return d/(r*cr);
+      } else if (m[a] == 1 && m[b] == 1) {
+         return -p[a]*p[b]*(p[c]+2*r)/(r2*r*cr*cr);
+      } else {
+         const double d = (m[a] == 2) ? p[a] : p[b];
+         return 1.0/(r*cr) - d*d*(p[c]+2*r)/(r2*r*cr*cr);
+      }
+   } else {
+      // Derivatives along c of the surface integral of G over axes a and b
+      const int c = (m[0] >= 0) ? 0 : ((m[1] >= 0) ? 1 : 2);
+      const double A = p[(c+1)%3];
+      const double B = p[(c+2)%3];
+      const double C = p[c];
+      if (m[c] == 1) {
+         return -atan2(A*B, C*r);
+      } else {
+         return A*B*(r2+C*C)/(r*(A*A+C*C)*(B*B+C*C));
+      }
+   }
+}
 
+/* Integral of d^alpha G over the box lo..hi given relative to the dipole.
+ * Axes with integrate[i] false are not integrated over but evaluated at
+ * lo[i]. Ranges crossing zero are split and negative ranges mirrored using
+ * the parity of G. Returns false if the box gets closer than tolerance to a
+ * coordinate axis through the dipole, where the corner terms diverge.
+ */
+static bool greenBoxIntegral(const int alpha[3], const bool integrate[3], const double lo[3], const double hi[3], const double tolerance, double& result) {
+   for (int i=0; i<3; i++) {
+      if (integrate[i] && lo[i] < 0 && hi[i] > 0) {
+         double splitLo[3] = {lo[0], lo[1], lo[2]};
+         double splitHi[3] = {hi[0], hi[1], hi[2]};
+         double lower, upper;
+         splitHi[i] = 0;
+         splitLo[i] = 0;
+         if (!greenBoxIntegral(alpha, integrate, lo, splitHi, tolerance, lower) ||
+             !greenBoxIntegral(alpha, integrate, splitLo, hi, tolerance, upper)) {
+            return false;
+         }
+         result = lower + upper;
+         return true;
+      }
+   }
 
+   double l[3], h[3];
+   double sign = 1.0;
+   int nearAxis = 0;
+   int m[3];
+   for (int i=0; i<3; i++) {
+      l[i] = lo[i];
+      h[i] = integrate[i] ? hi[i] : lo[i];
+      if (h[i] <= 0 && l[i] < 0) {
+         // mirror, d/dx changes sign
+         const double t = -h[i];
+         h[i] = -l[i];
+         l[i] = t;
+         if (alpha[i] % 2 == 1) {
+            sign = -sign;
+         }
+      }
+      if (l[i] < tolerance) {
+         nearAxis++;
+      }
+      m[i] = integrate[i] ? alpha[i]-1 : alpha[i];
+   }
+   if (nearAxis > 1) {
+      return false;
+   }
+
+   double sum = 0.0;
+   for (int corner=0; corner<8; corner++) {
+      double p[3];
+      double cornerSign = 1.0;
+      bool duplicate = false;
+      for (int i=0; i<3; i++) {
+         const bool upper = (corner >> i) & 1;
+         if (!integrate[i] && upper) {
+            duplicate = true;
+         }
+         p[i] = upper ? h[i] : l[i];
+         if (integrate[i] && !upper) {
+            cornerSign = -cornerSign;
+         }
+      }
+      if (!duplicate) {
+         sum += cornerSign * greenKernel(m, p);
+      }
+   }
+   result = sign * sum;
+   return true;
+}
 
+/*! Closed-form face and volume averages of the field of a dipole with moment
+ * q at center over the cell with lower corner start and size dx, together
+ * with their derivatives scaled by the cell size, indexed as in
+ * fsgrids::bgbfield. Returns false if the closed form is not applicable: the
+ * cell is inside or next to the zero-field region of the dipole, its corners
+ * are too close to a coordinate axis through the dipole, or it is so far
+ * away that the corner sums lose accuracy to cancellation (relative error
+ * grows as eps*(distance/dx)^3) and the Gauss-Legendre rule is better.
+ */
+bool dipoleCellAverages(const double q[3], const double center[3], const double start[3], const double dx[3], double averages[]) {
+   const double minimumR=1e-3*physicalconstants::R_E;
+   const double maxClosedFormDistance = 12.0; // in cells, see GAUSS_MIN_DISTANCE
+   const double maxDx = std::max(dx[0], std::max(dx[1], dx[2]));
+   const double distance = cellDistance(center, start, dx);
+   if (distance <= minimumR || distance >= maxClosedFormDistance*maxDx) {
+      return false;
+   }
+   // Corners closer than this to an axis through the dipole go to Romberg
+   const double tolerance = 1e-2*maxDx;
+   const unsigned int faceCoord1[3] = {1, 0, 0};
+   const unsigned int faceCoord2[3] = {2, 2, 1};
+   double lo[3], hi[3];
+   for (int i=0; i<3; i++) {
+      lo[i] = start[i] - center[i];
+      hi[i] = lo[i] + dx[i];
+   }
+   const bool volume[3] = {true, true, true};
+   
+   for (int c=0; c<3; c++) {
+      const int d1 = faceCoord1[c];
+      const int d2 = faceCoord2[c];
+      bool face[3] = {true, true, true};
+      face[c] = false;
+      double faceB = 0, faceD1 = 0, faceD2 = 0;
+      double volB = 0, volD1 = 0, volD2 = 0;
+      for (int j=0; j<3; j++) {
+         if (q[j] == 0.0) {
+            continue;
+         }
+         // B_c = q_j d_c d_j G, its derivatives add d_d1 or d_d2
+         int alpha[3] = {0, 0, 0};
+         alpha[c]++;
+         alpha[j]++;
+         double value;
+         if (!greenBoxIntegral(alpha, face, lo, hi, tolerance, value)) return false;
+         faceB += q[j]*value;
+         if (!greenBoxIntegral(alpha, volume, lo, hi, tolerance, value)) return false;
+         volB += q[j]*value;
+         alpha[d1]++;
+         if (!greenBoxIntegral(alpha, face, lo, hi, tolerance, value)) return false;
+         faceD1 += q[j]*value;
+         if (!greenBoxIntegral(alpha, volume, lo, hi, tolerance, value)) return false;
+         volD1 += q[j]*value;
+         alpha[d1]--;
+         alpha[d2]++;
+         if (!greenBoxIntegral(alpha, face, lo, hi, tolerance, value)) return false;
+         faceD2 += q[j]*value;
+         if (!greenBoxIntegral(alpha, volume, lo, hi, tolerance, value)) return false;
+         volD2 += q[j]*value;
+      }
+      const double area = dx[d1]*dx[d2];
+      const double cellVolume = dx[0]*dx[1]*dx[2];
+      //Note that we scale the derivatives by dx[] as the arrays are assumed to contain differences, not true derivatives!
+      averages[fsgrids::bgbfield::BGBX+c] = faceB/area;
+      averages[fsgrids::bgbfield::dBGBxdy+2*c] = dx[d1]*faceD1/area;
+      averages[fsgrids::bgbfield::dBGBxdy+1+2*c] = dx[d2]*faceD2/area;
+      averages[fsgrids::bgbfield::BGBXVOL+c] = volB/cellVolume;
+      averages[fsgrids::bgbfield::dBGBXVOLdy+2*c] = dx[d1]*volD1/cellVolume;
+      averages[fsgrids::bgbfield::dBGBXVOLdy+1+2*c] = dx[d2]*volD2/cellVolume;
+   }
+   return true;
+}
@@ -22,6 +22,8 @@
 
 #ifndef FUNCTIONS_HPP
 #define FUNCTIONS_HPP
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include "../definitions.h"
 
@@ -31,4 +33,18 @@ typedef std::function<double(double)> T1DFunction;
 typedef std::function<double(double,double)> T2DFunction;
 typedef std::function<double(double,double,double)> T3DFunction;
 
+/*! Initial value for hashBytes() (64-bit FNV-1a offset basis).*/
+const uint64_t HASH_SEED = 14695981039346656037ull;
+
+/*! 64-bit FNV-1a hash of the given bytes, continuing from hash. Used to key
+ * the background field cache on the field parameters.*/
+inline uint64_t hashBytes(uint64_t hash, const void* data, const std::size_t bytes) {
+   const unsigned char* p = static_cast<const unsigned char*>(data);
+   for (std::size_t i = 0; i < bytes; i++) {
+      hash ^= p[i];
+      hash *= 1099511628211ull;
+   }
+   return hash;
+}
+
 #endif
@@ -43,8 +43,6 @@ double lineAverage(
 ) {
    using namespace std::placeholders;
    double value;
-   //subroutines not threadsafe 
-#pragma omp critical
       {
          const double norm = 1/L;
          const double acc = accuracy*L;
@@ -89,7 +87,6 @@ double surfaceAverage(
 ) {
    using namespace std::placeholders;
    double value;
-#pragma omp critical
    {
       const double acc = accuracy*L1*L2;
       const double norm = 1/(L1*L2);
@@ -129,7 +126,6 @@ double volumeAverage(
    const double r2[3]
 ) {
    double value;
-#pragma omp critical
    {
       const double acc = accuracy*(r2[0]-r1[0])*(r2[1]-r1[1])*(r2[2]-r1[2]);
       const double norm = 1.0/((r2[0]-r1[0])*(r2[1]-r1[1])*(r2[2]-r1[2]));
@@ -138,3 +134,103 @@ double volumeAverage(
    return value;
 }
 
+
+
+const double gaussNodes[GAUSS_NODES] = {
+   0.5 - 0.5*0.9061798459386640,
+   0.5 - 0.5*0.5384693101056831,
+   0.5,
+   0.5 + 0.5*0.5384693101056831,
+   0.5 + 0.5*0.9061798459386640
+};
+
+const double gaussWeights[GAUSS_NODES] = {
+   0.5*0.2369268850561891,
+   0.5*0.4786286704993665,
+   0.5*0.5688888888888889,
+   0.5*0.4786286704993665,
+   0.5*0.2369268850561891
+};
+
+
+double cellDistance(
+   const double p[3],
+   const double r1[3],
+   const double L[3]
+) {
+   double d2 = 0.0;
+   for (int i = 0; i < 3; i++) {
+      double d = 0.0;
+      if (p[i] < r1[i]) {
+         d = r1[i] - p[i];
+      } else if (p[i] > r1[i] + L[i]) {
+         d = p[i] - r1[i] - L[i];
+      }
+      d2 += d*d;
+   }
+   return sqrt(d2);
+}
+
+void rombergCellAverages(
+   const FieldFunction& bgFunction,
+   const double start[3],
+   const double dx[3],
+   double averages[]
+) {
+   //these are doubles, as the averaging functions copied from Gumics
+   //use internally doubles. In any case, it should provide more
+   //accurate results also for float simulations
+   const double accuracy = 1e-17;
+   //the coordinates of the edges face with a normal in the third coordinate direction, stored here to enable looping
+   const unsigned int faceCoord1[3] = {1, 0, 0};
+   const unsigned int faceCoord2[3] = {2, 2, 1};
+   const double end[3] = {start[0]+dx[0], start[1]+dx[1], start[2]+dx[2]};
+   
+   //Face averages
+   for(uint fComponent=0; fComponent<3; fComponent++){
+      T3DFunction valueFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 0, (coordinate)0);
+      averages[fsgrids::bgbfield::BGBX+fComponent] =
+         surfaceAverage(valueFunction,
+            (coordinate)fComponent,
+                        accuracy,
+                        start,
+                        dx[faceCoord1[fComponent]],
+                        dx[faceCoord2[fComponent]]
+                       );
+      
+      //Compute derivatives. Note that we scale by dx[] as the arrays are assumed to contain differences, not true derivatives!
+      T3DFunction derivFunction1 = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord1[fComponent]);
+      averages[fsgrids::bgbfield::dBGBxdy+2*fComponent] =
+         dx[faceCoord1[fComponent]] * 
+         surfaceAverage(derivFunction1,
+            (coordinate)fComponent,
+                        accuracy,
+                        start,
+                        dx[faceCoord1[fComponent]],
+                        dx[faceCoord2[fComponent]]
+                       );
+
+      T3DFunction derivFunction2 = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord2[fComponent]);
+      averages[fsgrids::bgbfield::dBGBxdy+1+2*fComponent] =
+         dx[faceCoord2[fComponent]] *
+         surfaceAverage(derivFunction2,
+            (coordinate)fComponent,
+                        accuracy,
+                        start,
+                        dx[faceCoord1[fComponent]],
+                        dx[faceCoord2[fComponent]]
+                       );
+   }
+   
+   //Volume averages
+   for(unsigned int fComponent=0;fComponent<3;fComponent++){
+      T3DFunction valueFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 0, (coordinate)0);
+      averages[fsgrids::bgbfield::BGBXVOL+fComponent] = volumeAverage(valueFunction,accuracy,start,end);
+      
+      //Compute derivatives. Note that we scale by dx[] as the arrays are assumed to contain differences, not true derivatives!      
+      T3DFunction derivFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord1[fComponent]);
+      averages[fsgrids::bgbfield::dBGBXVOLdy+2*fComponent] = dx[faceCoord1[fComponent]] * volumeAverage(derivFunction,accuracy,start,end);
+      derivFunction = std::bind(bgFunction, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, (coordinate)fComponent, 1, (coordinate)faceCoord2[fComponent]);
+      averages[fsgrids::bgbfield::dBGBXVOLdy+1+2*fComponent] = dx[faceCoord2[fComponent]] * volumeAverage(derivFunction,accuracy,start,end);
+   }
+}
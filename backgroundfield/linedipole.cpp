@@ -25,7 +25,10 @@ Background magnetic field class of Vlasiator.
 
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <limits>
 #include "linedipole.hpp"
+#include "integratefunction.hpp"
 #include "../common.h"
 
 
@@ -39,66 +42,146 @@ void LineDipole::initialize(const double moment,const double center_x, const dou
    center[2]=center_z;
 }
 
-double LineDipole::operator()( double x, double y, double z, coordinate component, unsigned int derivative, coordinate dcomponent) const {
-   const double minimumR=1e-3*physicalconstants::R_E; //The dipole field is defined to be outside of Earth, and units are in meters     
-   if(this->initialized==false) {
-      return 0.0;
-   }
-   double r[3];
-   
-   r[0]= x-center[0];
-   r[1]= y-center[1];
-   r[2]= z-center[2];
-   
-   double r2 = r[0]*r[0]+r[2]*r[2]; // r[1] not necessary in this case, removed to enable proper cylindrical ionosphere (ionosphere.geometry = 3)
-   
-   if(r2<minimumR*minimumR) {
-      //  r2=minimumR*minimumR;
-      return 0.0; //set zero field inside dipole
+/*! Terms of the line dipole field, all other components and derivatives are zero.*/
+enum LineDipoleTerm { LINEDIPOLE_ZERO, LINEDIPOLE_BX, LINEDIPOLE_BZ, LINEDIPOLE_DSAME, LINEDIPOLE_DDIFF };
+
+/*! Returns which term the requested component or derivative is, sign is -1 for d/dz Bz = -d/dx Bx.*/
+static LineDipoleTerm lineDipoleTerm(coordinate component, unsigned int derivative, coordinate dcomponent, double& sign) {
+   sign = 1.0;
+   if (component == Y) {
+      return LINEDIPOLE_ZERO;
    }
-   
-   const double r6 = (r2*r2*r2);
-   // const double rdotq=q[0]*r[0] + q[1]*r[1] +q[2]*r[2];
-   const double D = -q[2]; 
-   
-   const double DerivativeSameComponent=D*( 2*r[2]*(r[2]*r[2]-3*r[0]*r[0]))/r6;
-   const double DerivativeDiffComponent=D*( 2*r[0]*(r[0]*r[0]-3*r[2]*r[2]))/r6;
-   //const double B;
-   //const double der;
-   
    switch (derivative) {
       case 0:
-         switch (component) {
-            case 0:
-               return D*2*r[0]*r[2]/(r2*r2);
-            case 2:
-               return D*(r[2]*r[2]-r[0]*r[0])/(r2*r2); 
-            default:
-               return 0;
-         }
+         return component == X ? LINEDIPOLE_BX : LINEDIPOLE_BZ;
       case 1:
          //first derivatives
-         if(dcomponent == 1 || component == 1) {
-            return 0;
+         if(dcomponent == Y) {
+            return LINEDIPOLE_ZERO;
          } else if(dcomponent == component) {
-            switch (component) {
-               case 0:
-                  return DerivativeSameComponent;
-               case 2:
-                  return -DerivativeSameComponent;
-               default:
-                  return 0; // Redundant for warning
-            }
-         } else { 
-            return DerivativeDiffComponent;
+            sign = (component == X) ? 1.0 : -1.0;
+            return LINEDIPOLE_DSAME;
+         } else {
+            return LINEDIPOLE_DDIFF;
          }
       default:
-         return 0;   // dummy, but prevents gcc from yelling
+         return LINEDIPOLE_ZERO;
    }
 }
 
+/*! Value of one term of the line dipole field with D=-q[2] at offset r from
+ * the dipole line. Written without branches so that the batched loops
+ * vectorize; the term is a compile time constant in each of them.*/
+template<LineDipoleTerm term>
+static inline double lineDipoleValue(const double D, const double rx, const double rz) {
+   const double minimumR=1e-3*physicalconstants::R_E; //The dipole field is defined to be outside of Earth, and units are in meters     
+   const double r2 = rx*rx+rz*rz; // r[1] not necessary in this case, removed to enable proper cylindrical ionosphere (ionosphere.geometry = 3)
+   const bool inside = r2<minimumR*minimumR;
+   // evaluate at minimumR inside the dipole so that no division by zero is done, the result is discarded
+   const double safeR2 = inside ? minimumR*minimumR : r2;
+   const double r6 = (safeR2*safeR2*safeR2);
+   
+   double value = 0.0;
+   switch (term) {
+      case LINEDIPOLE_BX:
+         value = D*2*rx*rz/(safeR2*safeR2);
+         break;
+      case LINEDIPOLE_BZ:
+         value = D*(rz*rz-rx*rx)/(safeR2*safeR2);
+         break;
+      case LINEDIPOLE_DSAME:
+         value = D*( 2*rz*(rz*rz-3*rx*rx))/r6;
+         break;
+      case LINEDIPOLE_DDIFF:
+         value = D*( 2*rx*(rx*rx-3*rz*rz))/r6;
+         break;
+      default:
+         break;
+   }
+   return inside ? 0.0 : value; //set zero field inside dipole
+}
 
+/*! Evaluates one term at n points, scaled by sign.*/
+template<LineDipoleTerm term>
+static void lineDipoleLoop(const int n, const double D, const double sign, const double centerX, const double centerZ, const double* x, const double* z, double* result) {
+   #pragma omp simd
+   for (int i = 0; i < n; i++) {
+      result[i] = sign*lineDipoleValue<term>(D, x[i]-centerX, z[i]-centerZ);
+   }
+}
 
+double LineDipole::operator()( double x, double y, double z, coordinate component, unsigned int derivative, coordinate dcomponent) const {
+   if(this->initialized==false) {
+      return 0.0;
+   }
+   // const double rdotq=q[0]*r[0] + q[1]*r[1] +q[2]*r[2];
+   const double D = -q[2]; 
+   double sign;
+   switch (lineDipoleTerm(component, derivative, dcomponent, sign)) {
+      case LINEDIPOLE_BX:
+         return sign*lineDipoleValue<LINEDIPOLE_BX>(D, x-center[0], z-center[2]);
+      case LINEDIPOLE_BZ:
+         return sign*lineDipoleValue<LINEDIPOLE_BZ>(D, x-center[0], z-center[2]);
+      case LINEDIPOLE_DSAME:
+         return sign*lineDipoleValue<LINEDIPOLE_DSAME>(D, x-center[0], z-center[2]);
+      case LINEDIPOLE_DDIFF:
+         return sign*lineDipoleValue<LINEDIPOLE_DDIFF>(D, x-center[0], z-center[2]);
+      default:
+         return 0;
+   }
+}
 
+/*! Batched version of operator(), used by the Gauss-Legendre cell averages.*/
+void LineDipole::evaluate(const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) const {
+   double sign = 1.0;
+   const LineDipoleTerm term = this->initialized ? lineDipoleTerm(component, derivative, dcomponent, sign) : LINEDIPOLE_ZERO;
+   const double D = -q[2];
+   switch (term) {
+      case LINEDIPOLE_BX:
+         lineDipoleLoop<LINEDIPOLE_BX>(n, D, sign, center[0], center[2], x, z, result);
+         break;
+      case LINEDIPOLE_BZ:
+         lineDipoleLoop<LINEDIPOLE_BZ>(n, D, sign, center[0], center[2], x, z, result);
+         break;
+      case LINEDIPOLE_DSAME:
+         lineDipoleLoop<LINEDIPOLE_DSAME>(n, D, sign, center[0], center[2], x, z, result);
+         break;
+      case LINEDIPOLE_DDIFF:
+         lineDipoleLoop<LINEDIPOLE_DDIFF>(n, D, sign, center[0], center[2], x, z, result);
+         break;
+      default:
+         for (int i = 0; i < n; i++) {
+            result[i] = 0.0;
+         }
+         break;
+   }
+}
+
+double LineDipole::smoothDistance(const double start[3], const double dx[3]) const {
+   if(this->initialized==false) {
+      return std::numeric_limits<double>::max();
+   }
+   // The line is along y, so measure the distance from the point of the line inside the cell y range
+   const double point[3] = {center[0], start[1], center[2]};
+   return cellDistance(point, start, dx) / std::max(dx[0], std::max(dx[1], dx[2]));
+}
 
+/*! No closed form is implemented for the line dipole, the cell averages are
+ * computed with Gauss-Legendre away from the line and with Romberg near it.*/
+bool LineDipole::cellAverages(const double start[3], const double dx[3], double averages[]) const {
+   if(this->initialized==false) {
+      for (int i = 0; i < fsgrids::bgbfield::N_BGB; i++) {
+         averages[i] = 0.0;
+      }
+      return true;
+   }
+   return false;
+}
 
+/*! Hash of the field parameters, used as part of the background field cache key.*/
+uint64_t LineDipole::parameterHash() const {
+   uint64_t hash = hashBytes(HASH_SEED, "LineDipole", 10);
+   hash = hashBytes(hash, &initialized, sizeof(initialized));
+   hash = hashBytes(hash, q, sizeof(q));
+   return hashBytes(hash, center, sizeof(center));
+}
@@ -41,6 +41,10 @@ public:
    void initialize(const double moment, const double center_x, const double center_y, const double center_z);
   
    double operator()(double x, double y, double z, coordinate component, unsigned int derivative=0, coordinate dcomponent=X) const;
+   void evaluate(const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) const;
+   double smoothDistance(const double start[3], const double dx[3]) const;
+   bool cellAverages(const double start[3], const double dx[3], double averages[]) const;
+   uint64_t parameterHash() const;
 };
 
 #endif
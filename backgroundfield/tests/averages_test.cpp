@@ -0,0 +1,165 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+Test of the closed-form and Gauss-Legendre background field averages
+(fieldsolver.fastBackgroundAverages) against the Romberg averages.
+
+For every cell of a few grids around each analytic field, the closed-form
+averages (where the field provides them) and the Gauss-Legendre averages
+(where the cell is at least GAUSS_MIN_DISTANCE cells from a singularity)
+are compared separately to rombergCellAverages(). Differences are relative
+to the largest of the 18 entries of the cell. The face and volume averages
+have to agree to VALUE_TOLERANCE and the derivatives to
+DERIVATIVE_TOLERANCE.
+
+The Romberg derivatives are the least accurate of the three: on coarse
+cells they are off by a few 1e-3. Where both the closed form and the
+Gauss-Legendre rule apply, the test therefore also checks that they agree
+with each other to CROSS_TOLERANCE, which bounds the error of the fast
+paths much more tightly.
+
+Build with "make averages_test" and run ./averages_test, which returns
+nonzero on failure.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../integratefunction.hpp"
+#include "../dipole.hpp"
+#include "../linedipole.hpp"
+#include "../vectordipole.hpp"
+#include "../constantfield.hpp"
+
+using namespace std;
+
+static const double R_E = 6.371e6;
+
+// Largest allowed differences, relative to the largest entry of the cell
+static const double VALUE_TOLERANCE = 1e-4;      // face and volume averages against Romberg
+static const double DERIVATIVE_TOLERANCE = 1e-2; // derivatives against Romberg
+static const double CROSS_TOLERANCE = 1e-7;      // closed form against Gauss-Legendre
+
+// Largest relative differences of the face and volume averages and of the derivatives
+struct Difference {
+   double value = 0.0;
+   double derivative = 0.0;
+
+   void add(const double a[], const double reference[]) {
+      double scale = 0.0;
+      for (int i = 0; i < fsgrids::bgbfield::N_BGB; i++) {
+         scale = max(scale, fabs(reference[i]));
+      }
+      if (scale == 0.0) {
+         scale = 1.0;
+      }
+      for (int i = 0; i < fsgrids::bgbfield::N_BGB; i++) {
+         const double d = fabs(a[i] - reference[i]) / scale;
+         if (i < fsgrids::bgbfield::dBGBxdy) {
+            value = max(value, d);
+         } else {
+            derivative = max(derivative, d);
+         }
+      }
+   }
+
+   bool within(const double valueTolerance, const double derivativeTolerance) const {
+      return value <= valueTolerance && derivative <= derivativeTolerance;
+   }
+};
+
+/*! Compare the averages of all cells of an n^3 grid with cell size dx and lower corner start.*/
+template<typename F> static bool check(const string& name, const F& field, const int n, const double dx, const double start[3]) {
+   const FieldFunction fieldFunction(field);
+   const double cellSize[3] = {dx, dx, dx};
+   Difference closedForm, gauss, cross;
+   int closedFormCells = 0, gaussCells = 0, rombergCells = 0;
+   for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+         for (int k = 0; k < n; k++) {
+            const double corner[3] = {start[0] + i*dx, start[1] + j*dx, start[2] + k*dx};
+            double romberg[fsgrids::bgbfield::N_BGB];
+            double exact[fsgrids::bgbfield::N_BGB];
+            double quadrature[fsgrids::bgbfield::N_BGB];
+            rombergCellAverages(fieldFunction, corner, cellSize, romberg);
+            const bool hasClosedForm = field.cellAverages(corner, cellSize, exact);
+            const bool isSmooth = field.smoothDistance(corner, cellSize) >= GAUSS_MIN_DISTANCE;
+            if (hasClosedForm) {
+               closedForm.add(exact, romberg);
+               closedFormCells++;
+            }
+            if (isSmooth) {
+               gaussCellAverages(field, corner, cellSize, quadrature);
+               gauss.add(quadrature, romberg);
+               gaussCells++;
+            }
+            if (hasClosedForm && isSmooth) {
+               cross.add(quadrature, exact);
+            }
+            if (!hasClosedForm && !isSmooth) {
+               rombergCells++;
+            }
+         }
+      }
+   }
+   const bool ok = closedForm.within(VALUE_TOLERANCE, DERIVATIVE_TOLERANCE)
+                   && gauss.within(VALUE_TOLERANCE, DERIVATIVE_TOLERANCE)
+                   && cross.within(CROSS_TOLERANCE, CROSS_TOLERANCE);
+   cout << (ok ? "PASS " : "FAIL ") << name << endl
+        << "   closed form, " << closedFormCells << " cells: " << closedForm.value << " averages, "
+        << closedForm.derivative << " derivatives" << endl
+        << "   Gauss-Legendre, " << gaussCells << " cells: " << gauss.value << " averages, "
+        << gauss.derivative << " derivatives" << endl
+        << "   closed form against Gauss-Legendre: " << max(cross.value, cross.derivative) << endl
+        << "   Romberg only: " << rombergCells << " cells" << endl;
+   return ok;
+}
+
+int main() {
+   bool ok = true;
+
+   Dipole dipole;
+   dipole.initialize(8e15, 0, 0, 0, 0.2);
+   const double around[3] = {-6.2*R_E, -5.9*R_E, -6.1*R_E};
+   const double far[3] = {10*R_E, -16*R_E, -16*R_E};
+   ok = check("dipole", dipole, 24, 0.5*R_E, around) && ok;
+   ok = check("dipole, coarse far grid", dipole, 12, 2*R_E, far) && ok;
+
+   LineDipole lineDipole;
+   lineDipole.initialize(126.2e6, 0, 0, 0);
+   const double lineStart[3] = {-5*R_E, -5*R_E, -5*R_E};
+   ok = check("line dipole", lineDipole, 16, 0.5*R_E, lineStart) && ok;
+
+   VectorDipole vectorDipole;
+   vectorDipole.initialize(8e15, 0, 0, 0, 0.1, 0.2, 3*R_E, 6*R_E, 1e-9, 2e-9, -3e-9);
+   ok = check("vector dipole", vectorDipole, 16, 0.5*R_E, lineStart) && ok;
+
+   ConstantField constant;
+   constant.initialize(1e-9, 2e-9, 3e-9);
+   const double origin[3] = {0, 0, 0};
+   ok = check("constant field", constant, 8, 0.5*R_E, origin) && ok;
+
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
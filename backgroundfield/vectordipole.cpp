@@ -26,7 +26,11 @@ Background magnetic field class of Vlasiator.
 
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <limits>
 #include "vectordipole.hpp"
+#include "dipole.hpp"
+#include "integratefunction.hpp"
 #include "../common.h"
 
 // tilt_angle_phi is from the z-axis in radians
@@ -353,8 +357,78 @@ double VectorDipole::operator()( double x, double y, double z, coordinate compon
    return 0; // dummy, but prevents gcc from yelling
 }
 
+/*! Batched version of operator(), used by the Gauss-Legendre cell averages.
+ * Batches entirely in the full dipole region use the vectorized dipole
+ * evaluation, the transition region is evaluated point by point.*/
+void VectorDipole::evaluate(const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) const {
+   if(this->initialized==false) {
+      for (int i = 0; i < n; i++) {
+         result[i] = 0.0;
+      }
+      return;
+   }
+   bool fullDipole = true;
+   for (int i = 0; i < n; i++) {
+      fullDipole = fullDipole && (x[i]-center[0] <= xlimit[0]);
+   }
+   if (fullDipole) {
+      dipoleEvaluate(q, center, n, x, y, z, component, derivative, dcomponent, result);
+      return;
+   }
+   for (int i = 0; i < n; i++) {
+      result[i] = (*this)(x[i], y[i], z[i], component, derivative, dcomponent);
+   }
+}
 
+/*! Distance from the cell to the dipole in units of the largest cell edge, or
+ * zero if the cell straddles one of the x limits where the scaling starts
+ * or ends and the field is not smooth.*/
+double VectorDipole::smoothDistance(const double start[3], const double dx[3]) const {
+   if(this->initialized==false) {
+      return std::numeric_limits<double>::max();
+   }
+   const double xlo = start[0]-center[0];
+   const double xhi = xlo+dx[0];
+   if ((xlo < xlimit[0] && xhi > xlimit[0]) || (xlo < xlimit[1] && xhi > xlimit[1])) {
+      return 0.0;
+   }
+   return cellDistance(center, start, dx) / std::max(dx[0], std::max(dx[1], dx[2]));
+}
 
+/*! Closed-form cell averages in the full dipole region (see
+ * dipoleCellAverages()) and beyond the zero x limit, where the field is the
+ * constant IMF.*/
+bool VectorDipole::cellAverages(const double start[3], const double dx[3], double averages[]) const {
+   if(this->initialized==false) {
+      for (int i = 0; i < fsgrids::bgbfield::N_BGB; i++) {
+         averages[i] = 0.0;
+      }
+      return true;
+   }
+   const double xlo = start[0]-center[0];
+   const double xhi = xlo+dx[0];
+   if (xhi <= xlimit[0]) {
+      return dipoleCellAverages(q, center, start, dx, averages);
+   }
+   if (xlo >= xlimit[1]) {
+      for (int i = 0; i < fsgrids::bgbfield::N_BGB; i++) {
+         averages[i] = 0.0;
+      }
+      for (int c = 0; c < 3; c++) {
+         averages[fsgrids::bgbfield::BGBX+c] = IMF[c];
+         averages[fsgrids::bgbfield::BGBXVOL+c] = IMF[c];
+      }
+      return true;
+   }
+   return false;
+}
 
-
-
+/*! Hash of the field parameters, used as part of the background field cache key.*/
+uint64_t VectorDipole::parameterHash() const {
+   uint64_t hash = hashBytes(HASH_SEED, "VectorDipole", 12);
+   hash = hashBytes(hash, &initialized, sizeof(initialized));
+   hash = hashBytes(hash, q, sizeof(q));
+   hash = hashBytes(hash, center, sizeof(center));
+   hash = hashBytes(hash, xlimit, sizeof(xlimit));
+   return hashBytes(hash, IMF, sizeof(IMF));
+}
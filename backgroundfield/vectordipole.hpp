@@ -42,6 +42,10 @@ public:
    VectorDipole(){};
    void initialize(const double moment,const double center_x, const double center_y, const double center_z, const double tilt_angle_phi, const double tilt_angle_theta, const double xlimit_f, const double xlimit_z, const double IMF_Bx, const double IMF_By, const double IMF_Bz);
    double operator()(double x, double y, double z, coordinate component, unsigned int derivative=0, coordinate dcomponent=X) const;
+   void evaluate(const int n, const double* x, const double* y, const double* z, coordinate component, unsigned int derivative, coordinate dcomponent, double* result) const;
+   double smoothDistance(const double start[3], const double dx[3]) const;
+   bool cellAverages(const double start[3], const double dx[3], double averages[]) const;
+   uint64_t parameterHash() const;
 };
 
 #endif
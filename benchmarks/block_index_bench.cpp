@@ -0,0 +1,171 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute and University of Helsinki
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*! \file block_index_bench.cpp
+ * Microbenchmark of velocity block global to local ID lookups.
+ *
+ * Fills the velocity grids of a number of spatial cells, gridLength^3 blocks each,
+ * with spherical clouds of blocks at slightly different positions. The blocks are
+ * added in random order like the block adjustment does, into both the
+ * OpenBucketHashtable used by VelocityMesh by default and the two-level
+ * VelocityBlockIndex selected with -DVELOCITY_BLOCK_INDEX. Then times three
+ * lookup patterns on each:
+ * - random: existing blocks of random cells in random order
+ * - pencils: each block of the first cell in all cells in turn, and its six
+ *   face neighbours, as translation does along a pencil of cells. A mix of hits
+ *   and misses.
+ * - misses: random blocks anywhere in the grid, mostly not existing
+ * With many cells the tables do not fit into the caches, as in a simulation.
+ *
+ * Usage: block_index_bench [gridLength] [cloudRadius] [cells] [repetitions]
+ * Built by "make block_index_bench".
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../definitions.h"
+#include "../open_bucket_hashtable.h"
+#include "../velocity_block_index.h"
+
+using namespace std;
+
+namespace bench {
+
+   struct Pattern {
+      string name;
+      vector<pair<uint32_t, vmesh::GlobalID>> keys; // cell and block
+   };
+
+   /** Time the lookups of a pattern, best of the repetitions.
+    * @return Lookups per second, the sum of the found local IDs is stored in checksum.*/
+   template <typename Map>
+   double timeLookups(const vector<Map>& maps, const Pattern& pattern, const int repetitions, uint64_t& checksum) {
+      double best = 0.0;
+      for (int r=0; r<repetitions; ++r) {
+         uint64_t sum = 0;
+         const auto start = chrono::steady_clock::now();
+         for (const auto& key : pattern.keys) {
+            const Map& map = maps[key.first];
+            auto it = map.find(key.second);
+            if (it != map.end()) {
+               sum += it->second + 1;
+            }
+         }
+         const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         best = max(best, pattern.keys.size() / seconds);
+         checksum = sum;
+      }
+      return best;
+   }
+}
+
+int main(int argn, char* args[]) {
+   const uint32_t gridLength = argn > 1 ? atoi(args[1]) : 100;
+   const double radius = argn > 2 ? atof(args[2]) : 20.0;
+   const uint32_t nCells = argn > 3 ? atoi(args[3]) : 64;
+   const int repetitions = argn > 4 ? atoi(args[4]) : 5;
+   const uint32_t length[3] = {gridLength, gridLength, gridLength};
+   const size_t nLookups = 1 << 24;
+   mt19937_64 random(12345);
+
+   // Spherical clouds of blocks, off the grid centre and shifted from cell to cell
+   vector<vector<vmesh::GlobalID>> blocks(nCells);
+   vector<OpenBucketHashtable<vmesh::GlobalID,vmesh::LocalID>> hashtables(nCells);
+   vector<VelocityBlockIndex<vmesh::GlobalID,vmesh::LocalID>> indices(nCells);
+   size_t nBlocks = 0;
+   for (uint32_t c=0; c<nCells; ++c) {
+      const double shift = 0.1 * radius * c / nCells;
+      const double centre[3] = {0.45 * gridLength + shift, 0.5 * gridLength, 0.55 * gridLength - shift};
+      for (uint32_t k=0; k<gridLength; ++k) {
+         for (uint32_t j=0; j<gridLength; ++j) {
+            for (uint32_t i=0; i<gridLength; ++i) {
+               const double dx = i + 0.5 - centre[0], dy = j + 0.5 - centre[1], dz = k + 0.5 - centre[2];
+               if (dx*dx + dy*dy + dz*dz <= radius*radius) {
+                  blocks[c].push_back((k * gridLength + j) * gridLength + i);
+               }
+            }
+         }
+      }
+      shuffle(blocks[c].begin(), blocks[c].end(), random);
+      indices[c].setGridLength(length);
+      for (size_t b=0; b<blocks[c].size(); ++b) {
+         hashtables[c].insert(make_pair(blocks[c][b], (vmesh::LocalID)b));
+         indices[c].insert(make_pair(blocks[c][b], (vmesh::LocalID)b));
+      }
+      nBlocks += blocks[c].size();
+   }
+   size_t hashtableBytes = 0, indexBytes = 0;
+   for (uint32_t c=0; c<nCells; ++c) {
+      hashtableBytes += hashtables[c].bucket_count() * (sizeof(vmesh::GlobalID) + sizeof(vmesh::LocalID));
+      indexBytes += indices[c].bucket_count() * (sizeof(vmesh::GlobalID) + sizeof(vmesh::LocalID));
+   }
+
+   vector<bench::Pattern> patterns(3);
+   patterns[0].name = "random";
+   uniform_int_distribution<uint32_t> anyCell(0, nCells - 1);
+   for (size_t n=0; n<nLookups; ++n) {
+      const uint32_t c = anyCell(random);
+      patterns[0].keys.push_back(make_pair(c, blocks[c][uniform_int_distribution<size_t>(0, blocks[c].size() - 1)(random)]));
+   }
+   patterns[1].name = "pencils";
+   const int64_t offsets[7] = {0, -1, 1, -(int64_t)gridLength, gridLength,
+                               -(int64_t)gridLength * gridLength, (int64_t)gridLength * gridLength};
+   while (patterns[1].keys.size() < nLookups) {
+      for (size_t b=0; b<blocks[0].size() && patterns[1].keys.size() < nLookups; ++b) {
+         for (int o=0; o<7; ++o) {
+            for (uint32_t c=0; c<nCells; ++c) {
+               patterns[1].keys.push_back(make_pair(c, (vmesh::GlobalID)(blocks[0][b] + offsets[o])));
+            }
+         }
+      }
+   }
+   patterns[2].name = "misses";
+   uniform_int_distribution<vmesh::GlobalID> anyGID(0, gridLength * gridLength * gridLength - 1);
+   for (size_t n=0; n<nLookups; ++n) {
+      patterns[2].keys.push_back(make_pair(anyCell(random), anyGID(random)));
+   }
+
+   cout << "(BENCH) " << nCells << " cells, " << gridLength << "^3 block grid, " << nBlocks / nCells << " blocks per cell, "
+        << nLookups << " lookups per pattern, best of " << repetitions << endl;
+   cout << "(BENCH) memory: hashtables " << hashtableBytes << " bytes, two-level indices " << indexBytes << " bytes" << endl;
+   cout << setw(12) << "pattern" << setw(18) << "hashtable (M/s)" << setw(18) << "two-level (M/s)" << setw(10) << "speedup" << endl;
+   bool ok = true;
+   for (const bench::Pattern& pattern : patterns) {
+      uint64_t hashSum, indexSum;
+      const double hashRate = bench::timeLookups(hashtables, pattern, repetitions, hashSum);
+      const double indexRate = bench::timeLookups(indices, pattern, repetitions, indexSum);
+      cout << setw(12) << pattern.name << setw(18) << hashRate * 1e-6 << setw(18) << indexRate * 1e-6
+           << setw(10) << indexRate / hashRate << endl;
+      if (hashSum != indexSum) {
+         cerr << "(BENCH) ERROR: lookups of pattern " << pattern.name << " differ" << endl;
+         ok = false;
+      }
+   }
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute and University of Helsinki
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*! \file derivatives_bench.cpp
+ * Comparison of the structure-of-arrays derivative kernels with the per-cell ones.
+ *
+ * Fills B, the moments and the volume averaged B of a periodic fsgrid box with
+ * smooth fields plus noise, with flat patches so that the limiter also sees
+ * zero slopes, and with cells in system boundary layers 1 and 2 so that the
+ * centered differences and the per-cell fallback of the SoA path are used too.
+ * calculateDerivativesSimple and calculateBVOLDerivativesSimple are then run
+ * with fieldsolver.soaKernels off and on, for the first and the second order
+ * Hall term. The derivatives have to be bitwise identical, the program returns
+ * nonzero otherwise. Each path is also timed, best of the repetitions, which
+ * gives the throughput of the SoA kernels against the per-cell path.
+ *
+ * Usage: derivatives_bench [cellsPerDimension] [repetitions]
+ * Built by "make derivatives_bench", runs on any number of MPI processes.
+ */
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <mpi.h>
+#include <fsgrid.hpp>
+
+#include "../definitions.h"
+#include "../common.h"
+#include "../parameters.h"
+#include "../sysboundary/sysboundary.h"
+#include "../fieldsolver/derivatives.hpp"
+#include "phiprof.hpp"
+
+using namespace std;
+
+namespace bench {
+
+   typedef FsGrid< array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> BGrid;
+   typedef FsGrid< array<Real, fsgrids::moments::N_MOMENTS>, FS_STENCIL_WIDTH> MomentsGrid;
+   typedef FsGrid< array<Real, fsgrids::dperb::N_DPERB>, FS_STENCIL_WIDTH> DPerBGrid;
+   typedef FsGrid< array<Real, fsgrids::dmoments::N_DMOMENTS>, FS_STENCIL_WIDTH> DMomentsGrid;
+   typedef FsGrid< array<Real, fsgrids::volfields::N_VOL>, FS_STENCIL_WIDTH> VolGrid;
+   typedef FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> TechnicalGrid;
+
+   // Written to the outputs before every run, so that components left unset by one path show up
+   const Real SENTINEL = -1234.5;
+
+   /** Smooth field of global cell (x,y,z) with noise, constant inside the flat patches.*/
+   Real fieldValue(const array<int32_t,3>& g, const int component, mt19937_64& rng, const Real offset) {
+      uniform_real_distribution<Real> noise(-0.05, 0.05);
+      if (g[0] % 8 < 2 && g[1] % 8 < 2) {
+         return offset + 0.5;
+      }
+      return offset + sin(0.3*g[0] + component) * cos(0.2*g[1] - 0.5*component) + 0.5*sin(0.25*g[2]) + noise(rng);
+   }
+
+   template<typename Grid> void fill(Grid& grid, const int first, const int last, const Real offset, const uint64_t seed) {
+      const array<int32_t,3>& n = grid.getLocalSize();
+      for (int k=0; k<n[2]; k++) {
+         for (int j=0; j<n[1]; j++) {
+            for (int i=0; i<n[0]; i++) {
+               const array<int32_t,3> g = grid.getGlobalIndices(i,j,k);
+               mt19937_64 rng(seed + ((uint64_t)g[2] << 40) + ((uint64_t)g[1] << 20) + g[0]);
+               for (int c=first; c<last; c++) {
+                  grid.get(i,j,k)->at(c) = fieldValue(g, c, rng, offset);
+               }
+            }
+         }
+      }
+   }
+
+   template<typename Grid> void setAll(Grid& grid, const Real value) {
+      const array<int32_t,3>& n = grid.getLocalSize();
+      for (int k=0; k<n[2]; k++) {
+         for (int j=0; j<n[1]; j++) {
+            for (int i=0; i<n[0]; i++) {
+               grid.get(i,j,k)->fill(value);
+            }
+         }
+      }
+   }
+
+   /** Local values of all components of the local cells of a grid.*/
+   template<typename Grid> vector<Real> snapshot(Grid& grid) {
+      const array<int32_t,3>& n = grid.getLocalSize();
+      vector<Real> values;
+      for (int k=0; k<n[2]; k++) {
+         for (int j=0; j<n[1]; j++) {
+            for (int i=0; i<n[0]; i++) {
+               values.insert(values.end(), grid.get(i,j,k)->begin(), grid.get(i,j,k)->end());
+            }
+         }
+      }
+      return values;
+   }
+
+   /** Number of values that differ bitwise.*/
+   uint64_t countDifferences(const vector<Real>& a, const vector<Real>& b) {
+      uint64_t differences = 0;
+      for (size_t v=0; v<a.size(); v++) {
+         if (memcmp(&a[v], &b[v], sizeof(Real)) != 0) {
+            differences++;
+         }
+      }
+      return differences;
+   }
+
+   struct Grids {
+      BGrid& perB;
+      BGrid& perBDt2;
+      MomentsGrid& moments;
+      MomentsGrid& momentsDt2;
+      DPerBGrid& dPerB;
+      DMomentsGrid& dMoments;
+      VolGrid& vol;
+      TechnicalGrid& technical;
+      SysBoundary& sysBoundaries;
+   };
+
+   void runFaceDerivatives(Grids& g) {
+      calculateDerivativesSimple(g.perB, g.perBDt2, g.moments, g.momentsDt2, g.dPerB, g.dMoments,
+                                 g.technical, g.sysBoundaries, RK_ORDER1, true);
+   }
+
+   void runVolumeDerivatives(Grids& g) {
+      calculateBVOLDerivativesSimple(g.vol, g.technical, g.sysBoundaries);
+   }
+
+   /** Best wall time of a run over the repetitions, the slowest process counts.*/
+   double bestTime(void (*run)(Grids&), Grids& g, const int repetitions) {
+      double best = 0.0;
+      for (int r=0; r<repetitions; r++) {
+         MPI_Barrier(MPI_COMM_WORLD);
+         const double start = MPI_Wtime();
+         run(g);
+         double seconds = MPI_Wtime() - start;
+         MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+         if (r == 0 || seconds < best) {
+            best = seconds;
+         }
+      }
+      return best;
+   }
+
+   /** Compare and time one kernel with the SoA path off and on.
+    * @return True if the outputs of the two paths are identical on all processes.*/
+   bool compare(const char* name, void (*run)(Grids&), Grids& g, const int repetitions, const uint64_t globalCells) {
+      int myRank;
+      MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+      vector<Real> reference[3];
+      vector<Real> soa[3];
+      for (int pass=0; pass<2; pass++) {
+         Parameters::fieldSolverSoAKernels = (pass == 1);
+         setAll(g.dPerB, SENTINEL);
+         setAll(g.dMoments, SENTINEL);
+         // The volume derivatives are stored next to the volume averages, reset only those
+         const array<int32_t,3>& n = g.vol.getLocalSize();
+         for (int k=0; k<n[2]; k++) {
+            for (int j=0; j<n[1]; j++) {
+               for (int i=0; i<n[0]; i++) {
+                  for (int c=fsgrids::volfields::dPERBXVOLdx; c<=fsgrids::volfields::dPERBZVOLdz; c++) {
+                     g.vol.get(i,j,k)->at(c) = SENTINEL;
+                  }
+               }
+            }
+         }
+         run(g);
+         vector<Real>* out = (pass == 0) ? reference : soa;
+         out[0] = snapshot(g.dPerB);
+         out[1] = snapshot(g.dMoments);
+         out[2] = snapshot(g.vol);
+      }
+      uint64_t differences = 0;
+      for (int q=0; q<3; q++) {
+         differences += countDifferences(reference[q], soa[q]);
+      }
+      MPI_Allreduce(MPI_IN_PLACE, &differences, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+      Parameters::fieldSolverSoAKernels = false;
+      const double perCell = bestTime(run, g, repetitions);
+      Parameters::fieldSolverSoAKernels = true;
+      const double soaTime = bestTime(run, g, repetitions);
+
+      if (myRank == MASTER_RANK) {
+         cout << (differences == 0 ? "PASS " : "FAIL ") << name << ", ohmHallTerm " << Parameters::ohmHallTerm
+              << ": " << differences << " differing values, per-cell " << globalCells / perCell * 1e-6
+              << " Mcells/s, SoA " << globalCells / soaTime * 1e-6 << " Mcells/s, speedup "
+              << perCell / soaTime << endl;
+      }
+      return differences == 0;
+   }
+
+} // namespace bench
+
+int main(int argn, char* args[]) {
+   typedef Parameters P;
+   int provided;
+   MPI_Init_thread(&argn, &args, MPI_THREAD_FUNNELED, &provided);
+   phiprof::initialize();
+
+   const int cellsPerDimension = (argn > 1) ? atoi(args[1]) : 64;
+   const int repetitions = (argn > 2) ? atoi(args[2]) : 10;
+
+   // Electron pressure gradient term as in a typical magnetosphere run
+   P::electronTemperature = 0.5e6;
+   P::electronDensity = 1e6;
+   P::electronPTindex = 5.0/3.0;
+
+   bool ok = true;
+   {
+      const array<int32_t,3> dimensions = {cellsPerDimension, cellsPerDimension, cellsPerDimension};
+      const array<bool,3> periodicity = {true, true, true};
+      FsGridCouplingInformation coupling;
+      bench::BGrid perB(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      bench::BGrid perBDt2(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      bench::MomentsGrid moments(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      bench::MomentsGrid momentsDt2(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      bench::DPerBGrid dPerB(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      bench::DMomentsGrid dMoments(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      bench::VolGrid vol(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      bench::TechnicalGrid technical(dimensions, MPI_COMM_WORLD, periodicity, coupling);
+      SysBoundary sysBoundaries;
+
+      bench::fill(perB, fsgrids::bfield::PERBX, fsgrids::bfield::N_BFIELD, 0.0, 1);
+      bench::fill(vol, fsgrids::volfields::PERBXVOL, fsgrids::volfields::PERBZVOL+1, 0.0, 2);
+      // Densities and pressures have to stay positive
+      bench::fill(moments, fsgrids::moments::RHOM, fsgrids::moments::N_MOMENTS, 3.0, 3);
+
+      // No system boundaries, but layers 1 and 2 around planes of the box as next to a boundary
+      const array<int32_t,3>& n = technical.getLocalSize();
+      for (int k=0; k<n[2]; k++) {
+         for (int j=0; j<n[1]; j++) {
+            for (int i=0; i<n[0]; i++) {
+               const array<int32_t,3> g = technical.getGlobalIndices(i,j,k);
+               fsgrids::technical* tech = technical.get(i,j,k);
+               tech->sysBoundaryFlag = sysboundarytype::NOT_SYSBOUNDARY;
+               tech->sysBoundaryLayer = (g[0] % 16 == 5) ? 1 : ((g[0] % 16 == 4 || g[0] % 16 == 6) ? 2 : 0);
+            }
+         }
+      }
+
+      bench::Grids grids = {perB, perBDt2, moments, momentsDt2, dPerB, dMoments, vol, technical, sysBoundaries};
+      const uint64_t globalCells = (uint64_t)cellsPerDimension * cellsPerDimension * cellsPerDimension;
+      for (uint hall : {0u, 2u}) {
+         P::ohmHallTerm = hall;
+         ok = bench::compare("face derivatives", bench::runFaceDerivatives, grids, repetitions, globalCells) && ok;
+      }
+      ok = bench::compare("volume derivatives", bench::runVolumeDerivatives, grids, repetitions, globalCells) && ok;
+   }
+
+   MPI_Finalize();
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
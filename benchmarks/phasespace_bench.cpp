@@ -0,0 +1,558 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute and University of Helsinki
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*! \file phasespace_bench.cpp
+ * Synthetic phase-space benchmark of the Vlasov solver stages.
+ *
+ * A periodic single-process DCCRG grid is filled with a synthetic distribution
+ * (Maxwellian, shell or beam) whose velocity blocks are chosen with the sparsity
+ * threshold of the population, at the WID/VECL/precision the code was compiled
+ * with. Acceleration (cpu_accelerate_cell), translation (trans_map_1d_amr) and
+ * the velocity moments (calculateMoments_V) are then timed in isolation for each
+ * requested thread count. The distribution is restored before every repetition
+ * so that all runs propagate the same phase-space content.
+ *
+ * Each measurement is appended as one JSON object per line to bench.output, so
+ * results of different commits can be collected into the same file. Built and
+ * run by "make bench", which uses benchmarks/phasespace_bench.cfg.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+#ifdef _OPENMP
+   #include <omp.h>
+#endif
+
+#include "../definitions.h"
+#include "../common.h"
+#include "../logger.h"
+#include "../object_wrapper.h"
+#include "../parameters.h"
+#include "../readparameters.h"
+#include "../grid.h"
+#include "../globals.h"
+#include "../velocity_mesh_parameters.h"
+#include "../vlasovsolver/arch_moments.h"
+#include "../vlasovsolver/cpu_acc_semilag.hpp"
+#include "../vlasovsolver/cpu_trans_map_amr.hpp"
+#include "../vlasovsolver/cpu_trans_pencils.hpp"
+
+using namespace std;
+
+namespace bench {
+
+   /** Options of the benchmark, read from the bench.* parameters.*/
+   struct Options {
+      vector<string> distributions;
+      vector<string> stages;
+      vector<int> threads;
+      uint repetitions;
+      uint warmup;
+      Real density;
+      Real temperature;
+      Real V[3];
+      Real B[3];
+      Real shellRadius;
+      Real beamSpeed;
+      Real beamFraction;
+      Real densityContrast;
+      Real translationCFL;
+      string output;
+      string commit;
+   };
+
+   /** Velocity blocks of a synthetic distribution, shared by all spatial cells.
+    * Cells differ only by a density factor, so that translation always finds
+    * its target blocks.*/
+   struct PhaseSpace {
+      string name;
+      vector<vmesh::GlobalID> blocks;
+      vector<Realf> data;            /**< WID3 values per block at unit density factor.*/
+      vector<Real> densityFactor;    /**< Per local cell, in the order of getLocalCells().*/
+   };
+
+   /** Timings of one stage at one thread count.*/
+   struct Result {
+      string distribution;
+      string stage;
+      int threads;
+      uint64_t blocks;               /**< Velocity blocks processed per invocation.*/
+      uint64_t bytes;                /**< Nominal distribution function traffic per invocation.*/
+      vector<double> seconds;
+   };
+
+   void addParameters() {
+      typedef Readparameters RP;
+      RP::addComposing("bench.distribution", "Synthetic distribution to benchmark: maxwellian, shell or beam. Repeat for several, default is all three.");
+      RP::addComposing("bench.stage", "Solver stage to benchmark: acceleration, translation or moments. Repeat for several, default is all three.");
+      RP::addComposing("bench.threads", "OpenMP thread count to run each stage with. Repeat for several, default is 1 and the maximum thread count.");
+      RP::add("bench.repetitions", "Number of timed repetitions of each stage.", 5);
+      RP::add("bench.warmup", "Number of untimed repetitions before the timed ones.", 1);
+      RP::add("bench.density", "Number density of the distribution (m^-3).", 1.0e6);
+      RP::add("bench.temperature", "Temperature of the Maxwellian components (K).", 5.0e5);
+      RP::add("bench.Vx", "Bulk velocity x-component (m/s).", -2.0e5);
+      RP::add("bench.Vy", "Bulk velocity y-component (m/s).", 0.0);
+      RP::add("bench.Vz", "Bulk velocity z-component (m/s).", 0.0);
+      RP::add("bench.Bx", "Magnetic field x-component used by the acceleration (T).", 3.0e-9);
+      RP::add("bench.By", "Magnetic field y-component used by the acceleration (T).", 2.0e-9);
+      RP::add("bench.Bz", "Magnetic field z-component used by the acceleration (T).", -4.0e-9);
+      RP::add("bench.shellRadius", "Radius of the shell distribution around the bulk velocity (m/s).", 6.0e5);
+      RP::add("bench.beamSpeed", "Speed of the beam relative to the core, along the magnetic field (m/s).", 8.0e5);
+      RP::add("bench.beamFraction", "Fraction of the density in the beam of the beam distribution.", 0.1);
+      RP::add("bench.densityContrast", "Relative amplitude of the spatial density variation, in [0,1).", 0.5);
+      RP::add("bench.translationCFL", "Translation time step as a fraction of the spatial CFL limit of the velocity mesh.", 0.5);
+      RP::add("bench.output", "File to which one JSON record per measurement is appended.", string("phasespace_bench.jsonl"));
+      RP::add("bench.commit", "Revision label stored with the results.", string(""));
+   }
+
+   void getParameters(Options& opts) {
+      typedef Readparameters RP;
+      RP::get("bench.distribution", opts.distributions);
+      RP::get("bench.stage", opts.stages);
+      RP::get("bench.threads", opts.threads);
+      RP::get("bench.repetitions", opts.repetitions);
+      RP::get("bench.warmup", opts.warmup);
+      RP::get("bench.density", opts.density);
+      RP::get("bench.temperature", opts.temperature);
+      RP::get("bench.Vx", opts.V[0]);
+      RP::get("bench.Vy", opts.V[1]);
+      RP::get("bench.Vz", opts.V[2]);
+      RP::get("bench.Bx", opts.B[0]);
+      RP::get("bench.By", opts.B[1]);
+      RP::get("bench.Bz", opts.B[2]);
+      RP::get("bench.shellRadius", opts.shellRadius);
+      RP::get("bench.beamSpeed", opts.beamSpeed);
+      RP::get("bench.beamFraction", opts.beamFraction);
+      RP::get("bench.densityContrast", opts.densityContrast);
+      RP::get("bench.translationCFL", opts.translationCFL);
+      RP::get("bench.output", opts.output);
+      RP::get("bench.commit", opts.commit);
+
+      if (opts.distributions.size() == 0) opts.distributions = {"maxwellian", "shell", "beam"};
+      if (opts.stages.size() == 0) opts.stages = {"acceleration", "translation", "moments"};
+      if (opts.threads.size() == 0) {
+         opts.threads.push_back(1);
+         #ifdef _OPENMP
+         if (omp_get_max_threads() > 1) opts.threads.push_back(omp_get_max_threads());
+         #endif
+      }
+      if (opts.repetitions == 0) opts.repetitions = 1;
+   }
+
+   /** Value of the synthetic distribution at velocity v, at unit density factor.
+    * The shell is normalised in the thin-shell limit, which is close enough for
+    * choosing the blocks.*/
+   Real phaseSpaceDensity(const string& kind, const Options& opts, const Real mass, const Real v[3]) {
+      const Real vth2 = physicalconstants::K_B * opts.temperature / mass;
+      const Real maxwellNorm = 1.0 / pow(2.0 * M_PI * vth2, 1.5);
+      Real dv[3];
+      for (int i=0; i<3; ++i) dv[i] = v[i] - opts.V[i];
+      const Real dv2 = dv[0]*dv[0] + dv[1]*dv[1] + dv[2]*dv[2];
+
+      if (kind == "maxwellian") {
+         return opts.density * maxwellNorm * exp(-0.5 * dv2 / vth2);
+      }
+      if (kind == "shell") {
+         const Real r = sqrt(dv2) - opts.shellRadius;
+         const Real norm = 1.0 / (4.0 * M_PI * opts.shellRadius * opts.shellRadius * sqrt(2.0 * M_PI * vth2));
+         return opts.density * norm * exp(-0.5 * r * r / vth2);
+      }
+      if (kind == "beam") {
+         const Real Bnorm = sqrt(opts.B[0]*opts.B[0] + opts.B[1]*opts.B[1] + opts.B[2]*opts.B[2]) + 1e-30;
+         Real db2 = 0.0;
+         for (int i=0; i<3; ++i) {
+            const Real d = dv[i] - opts.beamSpeed * opts.B[i] / Bnorm;
+            db2 += d * d;
+         }
+         return opts.density * maxwellNorm * ((1.0 - opts.beamFraction) * exp(-0.5 * dv2 / vth2)
+                                              + opts.beamFraction * exp(-0.5 * db2 / vth2));
+      }
+      cerr << "(BENCH) ERROR: unknown distribution '" << kind << "'" << endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+      return 0.0;
+   }
+
+   /** Sample the distribution on the cell centres of every velocity block of the
+    * base mesh and keep the blocks in which it reaches the sparsity threshold in
+    * the densest spatial cell.*/
+   void buildPhaseSpace(PhaseSpace& ps, const Options& opts, const uint popID) {
+      const species::Species& species = getObjectWrapper().particleSpecies[popID];
+      const vector<CellID>& cells = getLocalCells();
+      SpatialCell* cell = mpiGrid[cells[0]];
+      const vmesh::LocalID* gridLength = cell->get_velocity_grid_length(popID);
+      const Real* cellSize = cell->get_velocity_grid_cell_size(popID);
+      const Real threshold = species.sparseMinValue / (1.0 + fabs(opts.densityContrast));
+
+      // Collected per vz-plane, so that the block order does not depend on the thread count
+      vector<vector<vmesh::GlobalID>> planeBlocks(gridLength[2]);
+      vector<vector<Realf>> planeData(gridLength[2]);
+      #pragma omp parallel for schedule(dynamic,1)
+      for (vmesh::LocalID kv=0; kv<gridLength[2]; ++kv) {
+         Realf block[WID3];
+         for (vmesh::LocalID jv=0; jv<gridLength[1]; ++jv) {
+            for (vmesh::LocalID iv=0; iv<gridLength[0]; ++iv) {
+               vmesh::GlobalID indices[3] = {iv, jv, kv};
+               const vmesh::GlobalID blockGID = cell->get_velocity_block(popID, indices, 0);
+               Real blockCoords[3];
+               cell->get_velocity_block_coordinates(popID, blockGID, blockCoords);
+               Realf maxValue = 0.0;
+               for (uint k=0; k<WID; ++k) for (uint j=0; j<WID; ++j) for (uint i=0; i<WID; ++i) {
+                  const Real v[3] = {blockCoords[0] + (i + 0.5) * cellSize[0],
+                                     blockCoords[1] + (j + 0.5) * cellSize[1],
+                                     blockCoords[2] + (k + 0.5) * cellSize[2]};
+                  block[cellIndex(i,j,k)] = phaseSpaceDensity(ps.name, opts, species.mass, v);
+                  maxValue = max(maxValue, block[cellIndex(i,j,k)]);
+               }
+               if (maxValue >= threshold) {
+                  planeBlocks[kv].push_back(blockGID);
+                  planeData[kv].insert(planeData[kv].end(), block, block + WID3);
+               }
+            }
+         }
+      }
+      ps.blocks.clear();
+      ps.data.clear();
+      for (vmesh::LocalID kv=0; kv<gridLength[2]; ++kv) {
+         ps.blocks.insert(ps.blocks.end(), planeBlocks[kv].begin(), planeBlocks[kv].end());
+         ps.data.insert(ps.data.end(), planeData[kv].begin(), planeData[kv].end());
+      }
+
+      // Smooth spatial density variation over the periodic box
+      ps.densityFactor.resize(cells.size());
+      for (size_t c=0; c<cells.size(); ++c) {
+         const Real* p = mpiGrid[cells[c]]->parameters.data();
+         const Real x = (p[CellParams::XCRD] + 0.5 * p[CellParams::DX] - P::xmin) / (P::xmax - P::xmin);
+         const Real y = (p[CellParams::YCRD] + 0.5 * p[CellParams::DY] - P::ymin) / (P::ymax - P::ymin);
+         const Real z = (p[CellParams::ZCRD] + 0.5 * p[CellParams::DZ] - P::zmin) / (P::zmax - P::zmin);
+         ps.densityFactor[c] = 1.0 + opts.densityContrast * sin(2.0 * M_PI * x) * cos(2.0 * M_PI * y) * cos(2.0 * M_PI * z);
+      }
+   }
+
+   /** Restore the synthetic distribution into all local cells.*/
+   void fillCells(const PhaseSpace& ps, const uint popID) {
+      const vector<CellID>& cells = getLocalCells();
+      #pragma omp parallel for schedule(dynamic,1)
+      for (size_t c=0; c<cells.size(); ++c) {
+         SpatialCell* cell = mpiGrid[cells[c]];
+         cell->clear(popID);
+         cell->add_velocity_blocks(ps.blocks, popID);
+         Realf* data = cell->get_data(popID);
+         const Realf factor = ps.densityFactor[c];
+         for (size_t i=0; i<ps.data.size(); ++i) {
+            data[i] = factor * ps.data[i];
+         }
+      }
+   }
+
+   uint64_t countBlocks(const vector<CellID>& cells, const uint popID) {
+      uint64_t blocks = 0;
+      for (const CellID cellID : cells) {
+         blocks += mpiGrid[cellID]->get_number_of_velocity_blocks(popID);
+      }
+      return blocks;
+   }
+
+   /** Set up the state an invocation of the stage starts from, outside of the
+    * timed region.*/
+   void prepareStage(const string& stage, const PhaseSpace& ps, const uint popID) {
+      const vector<CellID>& cells = getLocalCells();
+      fillCells(ps, popID);
+      if (stage == "acceleration") {
+         // The acceleration transform needs the _V moments and the time step limit
+         calculateMoments_V(mpiGrid, cells, false);
+         #pragma omp parallel for
+         for (size_t c=0; c<cells.size(); ++c) {
+            prepareAccelerateCell(mpiGrid[cells[c]], popID);
+         }
+      }
+   }
+
+   /** Run one invocation of the stage and return its duration.
+    * @param dt Time step of the stage.
+    * @param repetition Index of the repetition, rotates the acceleration sweep order.
+    * @param result Gets the number of processed blocks and the nominal traffic.*/
+   double runStage(const string& stage, const Real dt, const uint repetition, const uint popID, Result& result) {
+      const vector<CellID>& cells = getLocalCells();
+      const uint64_t blockBytes = WID3 * sizeof(Realf);
+      double seconds = 0.0;
+
+      if (stage == "acceleration") {
+         const uint map_order = repetition % 3;
+         result.blocks = countBlocks(cells, popID);
+         const double t0 = MPI_Wtime();
+         #pragma omp parallel for schedule(dynamic,1)
+         for (size_t c=0; c<cells.size(); ++c) {
+            cpu_accelerate_cell(mpiGrid[cells[c]], popID, map_order, dt);
+         }
+         seconds = MPI_Wtime() - t0;
+         // One read and one write of every block per dimension
+         result.bytes = 3 * 2 * result.blocks * blockBytes;
+      } else if (stage == "translation") {
+         vector<CellID> propagatedCells;
+         for (const CellID cellID : cells) {
+            if (do_translate_cell(mpiGrid[cellID])) propagatedCells.push_back(cellID);
+         }
+         const uint64_t blocks = countBlocks(propagatedCells, popID);
+         const uint cellsPerDim[3] = {P::xcells_ini, P::ycells_ini, P::zcells_ini};
+         vector<uint> nPencils;
+         uint dimensions = 0;
+         const double t0 = MPI_Wtime();
+         for (int dimension=2; dimension>=0; --dimension) {
+            if (cellsPerDim[dimension] == 1) continue;
+            const vector<CellID> remoteTargetCells = mpiGrid.get_remote_cells_on_process_boundary(
+               dimension == 0 ? VLASOV_SOLVER_TARGET_X_NEIGHBORHOOD_ID :
+               dimension == 1 ? VLASOV_SOLVER_TARGET_Y_NEIGHBORHOOD_ID :
+                                VLASOV_SOLVER_TARGET_Z_NEIGHBORHOOD_ID);
+            trans_map_1d_amr(mpiGrid, propagatedCells, remoteTargetCells, nPencils, dimension, dt, popID);
+            ++dimensions;
+         }
+         seconds = MPI_Wtime() - t0;
+         result.blocks = dimensions * blocks;
+         result.bytes = 2 * result.blocks * blockBytes;
+      } else if (stage == "moments") {
+         result.blocks = countBlocks(cells, popID);
+         const double t0 = MPI_Wtime();
+         calculateMoments_V(mpiGrid, cells, true);
+         seconds = MPI_Wtime() - t0;
+         // First and second moments each read the blocks once
+         result.bytes = 2 * result.blocks * blockBytes;
+      } else {
+         cerr << "(BENCH) ERROR: unknown stage '" << stage << "'" << endl;
+         MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      return seconds;
+   }
+
+   /** Time step of the stage. Acceleration uses the largest step that needs no
+    * subcycling in any cell, translation a fraction of the spatial CFL limit of
+    * the fastest velocity cell of the mesh.*/
+   Real stageTimeStep(const string& stage, const Options& opts, const PhaseSpace& ps, const uint popID) {
+      const vector<CellID>& cells = getLocalCells();
+      if (stage == "acceleration") {
+         prepareStage(stage, ps, popID);
+         Real dt = numeric_limits<Real>::max();
+         for (const CellID cellID : cells) {
+            dt = min(dt, mpiGrid[cellID]->get_max_v_dt(popID));
+         }
+         return dt;
+      }
+      if (stage == "translation") {
+         const vmesh::MeshParameters& vMesh = vmesh::getMeshWrapper()->velocityMeshes->at(getObjectWrapper().particleSpecies[popID].velocityMesh);
+         const Real dx[3] = {P::dx_ini, P::dy_ini, P::dz_ini};
+         Real dt = numeric_limits<Real>::max();
+         for (int d=0; d<3; ++d) {
+            const Real vmax = max(fabs(vMesh.meshMinLimits[d]), fabs(vMesh.meshMaxLimits[d]));
+            if (vmax > 0.0) dt = min(dt, dx[d] / vmax);
+         }
+         return opts.translationCFL * dt;
+      }
+      return 0.0;
+   }
+
+   double minimum(const vector<double>& v) {
+      return *min_element(v.begin(), v.end());
+   }
+
+   double median(vector<double> v) {
+      sort(v.begin(), v.end());
+      const size_t n = v.size();
+      return (n % 2 == 1) ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+   }
+
+   /** Write one measurement as a JSON object on its own line. Speedup and
+    * efficiency are relative to the smallest thread count of the same stage.*/
+   void writeRecord(ofstream& out, const Options& opts, const string& timestamp, const Result& r, const Result& reference) {
+      const double tMin = minimum(r.seconds);
+      const double speedup = minimum(reference.seconds) / tMin;
+      const double efficiency = speedup * reference.threads / r.threads;
+      out << setprecision(9)
+          << "{\"commit\":\"" << opts.commit << "\""
+          << ",\"timestamp\":\"" << timestamp << "\""
+          << ",\"WID\":" << WID
+          << ",\"VECL\":" << VECL
+          << ",\"realf_bytes\":" << sizeof(Realf)
+          << ",\"real_bytes\":" << sizeof(Real)
+          << ",\"distribution\":\"" << r.distribution << "\""
+          << ",\"stage\":\"" << r.stage << "\""
+          << ",\"threads\":" << r.threads
+          << ",\"cells\":" << getLocalCells().size()
+          << ",\"blocks\":" << r.blocks
+          << ",\"repetitions\":" << r.seconds.size()
+          << ",\"seconds_min\":" << tMin
+          << ",\"seconds_median\":" << median(r.seconds)
+          << ",\"blocks_per_second\":" << r.blocks / tMin
+          << ",\"bytes_per_second\":" << r.bytes / tMin
+          << ",\"speedup\":" << speedup
+          << ",\"efficiency\":" << efficiency
+          << "}" << endl;
+   }
+}
+
+int main(int argn, char* args[]) {
+   typedef Parameters P;
+   int myRank, nProcs;
+   int required = MPI_THREAD_FUNNELED;
+   int provided;
+   MPI_Init_thread(&argn, &args, required, &provided);
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+   MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+   if (nProcs != 1) {
+      if (myRank == MASTER_RANK) cerr << "(BENCH) ERROR: the benchmark runs on a single MPI process." << endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+   }
+   phiprof::initialize();
+
+   // Parameters, populations and velocity meshes as in vlasiator.cpp
+   vmesh::allocMeshWrapper();
+   Readparameters readparameters(argn, args);
+   P::addParameters();
+   getObjectWrapper().addParameters();
+   bench::addParameters();
+   readparameters.parse(false);
+   P::getParameters();
+   getObjectWrapper().addPopulationParameters();
+   readparameters.parse(false, false);
+   readparameters.helpMessage();
+   getObjectWrapper().getPopulationParameters();
+   vmesh::getMeshWrapper()->initVelocityMeshes(getObjectWrapper().particleSpecies.size());
+
+   bench::Options opts;
+   bench::getParameters(opts);
+
+   if (logFile.open(MPI_COMM_WORLD, MASTER_RANK, "phasespace_bench_log.txt") == false) {
+      cerr << "(BENCH) ERROR: Logger failed to open logfile!" << endl;
+      exit(1);
+   }
+
+   float zoltanVersion;
+   if (Zoltan_Initialize(argn, args, &zoltanVersion) != ZOLTAN_OK) {
+      cerr << "(BENCH) ERROR: Zoltan initialization failed." << endl;
+      exit(1);
+   }
+
+   // Periodic box without spatial refinement, so that every cell is translated
+   const std::array<uint64_t, 3> grid_length = {{P::xcells_ini, P::ycells_ini, P::zcells_ini}};
+   dccrg::Cartesian_Geometry::Parameters geom_params;
+   geom_params.start[0] = P::xmin;
+   geom_params.start[1] = P::ymin;
+   geom_params.start[2] = P::zmin;
+   geom_params.level_0_cell_length[0] = P::dx_ini;
+   geom_params.level_0_cell_length[1] = P::dy_ini;
+   geom_params.level_0_cell_length[2] = P::dz_ini;
+   mpiGrid.set_initial_length(grid_length)
+      .set_load_balancing_method(&P::loadBalanceAlgorithm[0])
+      .set_neighborhood_length(VLASOV_STENCIL_WIDTH)
+      .set_maximum_refinement_level(0)
+      .set_periodic(true, true, true)
+      .initialize(MPI_COMM_WORLD)
+      .set_geometry(geom_params);
+   P::amrMaxSpatialRefLevel = 0;
+   initializeStencils(mpiGrid);
+   recalculateLocalCellsCache();
+   initSpatialCellCoordinates(mpiGrid);
+   setFaceNeighborRanks(mpiGrid);
+
+   const vector<CellID>& cells = getLocalCells();
+   for (const CellID cellID : cells) {
+      SpatialCell* cell = mpiGrid[cellID];
+      cell->sysBoundaryFlag = sysboundarytype::NOT_SYSBOUNDARY;
+      cell->sysBoundaryLayer = 0;
+      cell->parameters[CellParams::BGBXVOL] = opts.B[0];
+      cell->parameters[CellParams::BGBYVOL] = opts.B[1];
+      cell->parameters[CellParams::BGBZVOL] = opts.B[2];
+   }
+   for (uint dimension=0; dimension<3; ++dimension) {
+      prepareSeedIdsAndPencils(mpiGrid, dimension);
+   }
+
+   char timestamp[32];
+   const time_t now = time(NULL);
+   strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+   ofstream out(opts.output.c_str(), ofstream::app);
+   if (!out.good()) {
+      cerr << "(BENCH) ERROR: cannot open '" << opts.output << "' for writing." << endl;
+      exit(1);
+   }
+
+   cout << "(BENCH) WID " << WID << " VECL " << VECL << " Realf " << sizeof(Realf) << " bytes, "
+        << cells.size() << " spatial cells" << endl;
+   cout << setw(12) << "distribution" << setw(14) << "stage" << setw(8) << "threads" << setw(12) << "blocks"
+        << setw(14) << "t_min (s)" << setw(14) << "blocks/s" << setw(14) << "GB/s" << setw(10) << "speedup" << endl;
+
+   // All populations share the setup, the first one is benchmarked
+   const uint popID = 0;
+   SpatialCell::setCommunicatedSpecies(popID);
+   for (const string& distribution : opts.distributions) {
+      bench::PhaseSpace ps;
+      ps.name = distribution;
+      bench::buildPhaseSpace(ps, opts, popID);
+
+      for (const string& stage : opts.stages) {
+         const Real dt = bench::stageTimeStep(stage, opts, ps, popID);
+         vector<bench::Result> results;
+         for (const int threads : opts.threads) {
+            #ifdef _OPENMP
+            omp_set_num_threads(threads);
+            #endif
+            bench::Result result;
+            result.distribution = distribution;
+            result.stage = stage;
+            result.threads = threads;
+            for (uint r=0; r<opts.warmup + opts.repetitions; ++r) {
+               bench::prepareStage(stage, ps, popID);
+               const double seconds = bench::runStage(stage, dt, r, popID, result);
+               if (r >= opts.warmup) result.seconds.push_back(seconds);
+            }
+            results.push_back(result);
+         }
+
+         size_t reference = 0;
+         for (size_t i=1; i<results.size(); ++i) {
+            if (results[i].threads < results[reference].threads) reference = i;
+         }
+         for (const bench::Result& result : results) {
+            bench::writeRecord(out, opts, timestamp, result, results[reference]);
+            const double tMin = bench::minimum(result.seconds);
+            cout << setw(12) << distribution << setw(14) << stage << setw(8) << result.threads
+                 << setw(12) << result.blocks << setw(14) << tMin << setw(14) << result.blocks / tMin
+                 << setw(14) << result.bytes / tMin * 1e-9
+                 << setw(10) << bench::minimum(results[reference].seconds) / tMin << endl;
+         }
+      }
+   }
+   out.close();
+   cout << "(BENCH) Results appended to " << opts.output << endl;
+
+   MPI_Finalize();
+   return 0;
+}
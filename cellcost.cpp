@@ -0,0 +1,262 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <mpi.h>
+#include "cellcost.h"
+#include "parameters.h"
+#include "logger.h"
+#include "object_wrapper.h"
+
+extern Logger logFile;
+
+using namespace std;
+using namespace spatial_cell;
+
+namespace cellcost {
+
+   // Whether the current step is sampled
+   static bool sampleActive = false;
+   // Smoothed cost per velocity block on this rank, used for cells that have no measured cost yet
+   static Real costPerBlock = 0.0;
+
+   // Imbalance monitor, all of these have the same value on every rank
+   // Wall time of the last rebalance, negative until one has been measured
+   static double rebalanceCost = -1.0;
+   // Smoothed wall time lost per step to load imbalance
+   static double lostPerStep = 0.0;
+   // Latest max/mean load over ranks
+   static double loadImbalance = 1.0;
+   static uint stepsSinceRebalance = 0;
+
+   static Real countBlocks(SpatialCell* cell, const int popID) {
+      if (popID >= 0) {
+         return cell->get_number_of_velocity_blocks(popID);
+      }
+      Real blocks = 0;
+      for (uint p=0; p<getObjectWrapper().particleSpecies.size(); ++p) {
+         blocks += cell->get_number_of_velocity_blocks(p);
+      }
+      return blocks;
+   }
+
+   bool useMeasuredWeights() {
+      return P::loadBalanceWeightPolicy == "measured";
+   }
+
+   bool sampling() {
+      return sampleActive;
+   }
+
+   void beginStep(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, const vector<CellID>& cells) {
+      sampleActive = useMeasuredWeights() && P::loadBalanceCostSampleInterval > 0
+         && P::tstep % P::loadBalanceCostSampleInterval == 0;
+      if (!sampleActive) {
+         return;
+      }
+      #pragma omp parallel for
+      for (size_t c=0; c<cells.size(); ++c) {
+         mpiGrid[cells[c]]->parameters[CellParams::LBCOSTSAMPLE] = 0.0;
+      }
+   }
+
+   void distributeTime(
+      dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const vector<CellID>& cells,
+      const double seconds,
+      const int popID
+   ) {
+      if (!sampleActive || cells.size() == 0) {
+         return;
+      }
+      // Every cell gets a share of one block even if it has none, empty cells still cost something
+      Real totalBlocks = 0;
+      #pragma omp parallel for reduction(+:totalBlocks)
+      for (size_t c=0; c<cells.size(); ++c) {
+         totalBlocks += countBlocks(mpiGrid[cells[c]], popID) + 1;
+      }
+      const Real perBlock = seconds / totalBlocks;
+      #pragma omp parallel for
+      for (size_t c=0; c<cells.size(); ++c) {
+         SpatialCell* cell = mpiGrid[cells[c]];
+         addCellTime(cell, perBlock * (countBlocks(cell, popID) + 1));
+      }
+   }
+
+   void distributeBoundaryTime(
+      dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const vector<CellID>& cells,
+      const double seconds
+   ) {
+      if (!sampleActive) {
+         return;
+      }
+      vector<CellID> boundaryCells;
+      for (size_t c=0; c<cells.size(); ++c) {
+         const uint flag = mpiGrid[cells[c]]->sysBoundaryFlag;
+         if (flag != sysboundarytype::NOT_SYSBOUNDARY && flag != sysboundarytype::DO_NOT_COMPUTE) {
+            boundaryCells.push_back(cells[c]);
+         }
+      }
+      distributeTime(mpiGrid, boundaryCells, seconds);
+   }
+
+   void endStep(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, const vector<CellID>& cells) {
+      if (!sampleActive) {
+         return;
+      }
+      sampleActive = false;
+
+      const Real alpha = P::loadBalanceCostSmoothing;
+      Real totalCost = 0;
+      Real totalBlocks = 0;
+      #pragma omp parallel for reduction(+:totalCost,totalBlocks)
+      for (size_t c=0; c<cells.size(); ++c) {
+         SpatialCell* cell = mpiGrid[cells[c]];
+         Real& cost = cell->parameters[CellParams::LBMEASUREDCOST];
+         const Real sample = cell->parameters[CellParams::LBCOSTSAMPLE];
+         // First sample of a cell is taken as is
+         cost = (cost > 0.0) ? alpha * sample + (1.0 - alpha) * cost : sample;
+         totalCost += cost;
+         totalBlocks += countBlocks(cell, -1) + 1;
+      }
+      if (totalBlocks > 0) {
+         costPerBlock = totalCost / totalBlocks;
+      }
+   }
+
+   Real getWeight(SpatialCell* cell) {
+      const Real cost = cell->parameters[CellParams::LBMEASUREDCOST];
+      if (cost > 0.0) {
+         return cost;
+      }
+      // Not measured yet (e.g. a new cell from refinement), estimate from its blocks
+      if (costPerBlock > 0.0) {
+         return costPerBlock * (countBlocks(cell, -1) + 1);
+      }
+      return cell->parameters[CellParams::LBWEIGHTCOUNTER];
+   }
+
+   void logImbalance(
+      dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const vector<CellID>& cells,
+      const string& label
+   ) {
+      double localCost = 0.0;
+      for (size_t c=0; c<cells.size(); ++c) {
+         localCost += getWeight(mpiGrid[cells[c]]);
+      }
+      int nRanks;
+      MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+      double maxCost, sumCost;
+      MPI_Allreduce(&localCost, &maxCost, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(&localCost, &sumCost, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+      const double meanCost = sumCost / nRanks;
+      logFile << "(LB): " << label << " measured cost max/mean over ranks = "
+              << (meanCost > 0.0 ? maxCost / meanCost : 1.0)
+              << " (max " << maxCost << " s, mean " << meanCost << " s per sampled step)" << endl << writeVerbose;
+   }
+
+   static bool imbalanceTrigger() {
+      return P::loadBalanceTrigger == "imbalance";
+   }
+
+   bool rebalanceScheduled(const uint tstep) {
+      if (!imbalanceTrigger() || rebalanceCost < 0.0) {
+         return tstep % P::rebalanceInterval == 0;
+      }
+      // Adaptive refinement is done together with a rebalance, keep it on its schedule
+      return P::adaptRefinement && tstep % (P::rebalanceInterval * P::refineMultiplier) == 0;
+   }
+
+   void recordStep(
+      dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const vector<CellID>& cells,
+      const double vlasovSeconds
+   ) {
+      if (!imbalanceTrigger()) {
+         return;
+      }
+      double localLoad = 0.0;
+      if (useMeasuredWeights()) {
+         for (size_t c=0; c<cells.size(); ++c) {
+            localLoad += getWeight(mpiGrid[cells[c]]);
+         }
+      } else {
+         for (size_t c=0; c<cells.size(); ++c) {
+            localLoad += countBlocks(mpiGrid[cells[c]], -1);
+         }
+      }
+      const double local[2] = {vlasovSeconds, localLoad};
+      double maximum[2];
+      double sumLoad;
+      int nRanks;
+      MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+      MPI_Allreduce(local, maximum, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(&localLoad, &sumLoad, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+      // The slowest rank sets the step time, with perfect balance all ranks would carry the mean load
+      const double meanLoad = sumLoad / nRanks;
+      loadImbalance = (meanLoad > 0.0) ? maximum[1] / meanLoad : 1.0;
+      const double lost = (maximum[1] > 0.0) ? maximum[0] * (1.0 - meanLoad / maximum[1]) : 0.0;
+      const double alpha = P::loadBalanceCostSmoothing;
+      lostPerStep = (stepsSinceRebalance == 0) ? lost : alpha * lost + (1.0 - alpha) * lostPerStep;
+      ++stepsSinceRebalance;
+   }
+
+   bool rebalanceDue() {
+      // A partition co-located with the fsgrid does not depend on the load, rebalancing cannot help
+      if (!imbalanceTrigger() || rebalanceCost < 0.0 || P::loadBalanceCoLocateFsGrid) {
+         return false;
+      }
+      const double predictedGain = lostPerStep * P::loadBalanceHorizon;
+      if (P::loadBalanceMaxInterval > 0 && stepsSinceRebalance >= P::loadBalanceMaxInterval) {
+         logFile << "(LB): Rebalancing at tstep = " << P::tstep << ", " << stepsSinceRebalance
+                 << " steps since the last rebalance reached loadBalance.maxInterval (load max/mean "
+                 << loadImbalance << ")" << endl << writeVerbose;
+         return true;
+      }
+      if (stepsSinceRebalance < P::loadBalanceMinInterval) {
+         return false;
+      }
+      if (predictedGain > rebalanceCost) {
+         logFile << "(LB): Rebalancing at tstep = " << P::tstep << ", load max/mean " << loadImbalance
+                 << ", predicted gain over " << P::loadBalanceHorizon << " steps " << predictedGain
+                 << " s exceeds last rebalance cost " << rebalanceCost << " s" << endl << writeVerbose;
+         return true;
+      }
+      if (stepsSinceRebalance % P::rebalanceInterval == 0) {
+         logFile << "(LB): Not rebalancing at tstep = " << P::tstep << ", load max/mean " << loadImbalance
+                 << ", predicted gain over " << P::loadBalanceHorizon << " steps " << predictedGain
+                 << " s, last rebalance cost " << rebalanceCost << " s" << endl << writeVerbose;
+      }
+      return false;
+   }
+
+   void recordRebalance(const double seconds) {
+      MPI_Allreduce(&seconds, &rebalanceCost, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      stepsSinceRebalance = 0;
+      lostPerStep = 0.0;
+      if (imbalanceTrigger()) {
+         logFile << "(LB): Rebalance took " << rebalanceCost << " s" << endl << writeVerbose;
+      }
+   }
+}
@@ -0,0 +1,115 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef CELLCOST_H
+#define CELLCOST_H
+
+#include <string>
+#include <vector>
+#include <dccrg.hpp>
+#include <dccrg_cartesian_geometry.hpp>
+#include "definitions.h"
+#include "spatial_cell.hpp"
+
+/* Measured per-cell cost model for load balancing.
+ *
+ * On every loadBalance.costSampleInterval:th step (when
+ * loadBalance.weightPolicy is "measured") the Vlasov solvers report the time
+ * they spend: acceleration per cell and subcycle, translation per population
+ * and the Vlasov system boundary conditions per call. Times that are only
+ * known per call are distributed to the cells involved in proportion to their
+ * velocity block counts. At the end of the step the sample is folded into
+ * CellParams::LBMEASUREDCOST with exponential smoothing, and balanceLoad uses
+ * that as the cell weight instead of the block count in LBWEIGHTCOUNTER.
+ *
+ * The same module also decides when to rebalance when loadBalance.trigger is
+ * "imbalance". Every step the Vlasov solver wall time and the load (block
+ * count, or measured cost) of each rank are reduced over ranks. The time lost
+ * per step is estimated as walltime * (1 - mean load / max load), and a
+ * rebalance is requested once that loss summed over loadBalance.horizon steps
+ * exceeds the measured wall time of the previous rebalance. */
+namespace cellcost {
+
+   /*! True if balanceLoad should use the measured cost as cell weights.*/
+   bool useMeasuredWeights();
+
+   /*! True if the current step is being sampled, the solvers report their time only then.*/
+   bool sampling();
+
+   /*! Start a step, decides whether it is sampled and clears the per-cell samples if it is.*/
+   void beginStep(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, const std::vector<CellID>& cells);
+
+   /*! Add measured time spent on one cell. Not thread safe for the same cell.*/
+   inline void addCellTime(spatial_cell::SpatialCell* cell, const double seconds) {
+      cell->parameters[CellParams::LBCOSTSAMPLE] += seconds;
+   }
+
+   /*! Distribute time measured for a whole solver call to the given cells in
+    * proportion to their velocity block count of population popID, or of all
+    * populations if popID is negative.*/
+   void distributeTime(
+      dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const std::vector<CellID>& cells,
+      const double seconds,
+      const int popID = -1
+   );
+
+   /*! Distribute time measured for the Vlasov system boundary conditions to the local boundary cells.*/
+   void distributeBoundaryTime(
+      dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const std::vector<CellID>& cells,
+      const double seconds
+   );
+
+   /*! Finish a sampled step, smooths the sample into CellParams::LBMEASUREDCOST.*/
+   void endStep(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, const std::vector<CellID>& cells);
+
+   /*! Load balance weight of a cell under the measured policy.*/
+   Real getWeight(spatial_cell::SpatialCell* cell);
+
+   /*! Write the max/mean ratio of the summed measured cost over ranks to the log file. Collective.*/
+   void logImbalance(
+      dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const std::vector<CellID>& cells,
+      const std::string& label
+   );
+
+   /*! True if a rebalance is scheduled at step tstep regardless of the measured imbalance.
+    * That is every rebalanceInterval:th step for the interval trigger, and before the first
+    * rebalance cost is known or on adaptive refinement steps for the imbalance trigger.*/
+   bool rebalanceScheduled(const uint tstep);
+
+   /*! Record the load imbalance of the step just taken. Collective.
+    * \param vlasovSeconds Wall time of this rank in the Vlasov solvers during the step*/
+   void recordStep(
+      dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const std::vector<CellID>& cells,
+      const double vlasovSeconds
+   );
+
+   /*! True if the predicted gain of rebalancing exceeds its cost. Same result on all ranks.*/
+   bool rebalanceDue();
+
+   /*! Record the wall time of a completed rebalance and restart the imbalance estimate. Collective.*/
+   void recordRebalance(const double seconds);
+}
+
+#endif
@@ -184,6 +184,10 @@ namespace CellParams {
                            * this is the max allowed timestep over all particle species.*/
       MAXFDT,             /*!< maximum timestep allowed in ordinary space by fieldsolver for this cell**/
       LBWEIGHTCOUNTER,    /*!< Counter for storing compute time weights needed by the load balancing**/
+      LBMEASUREDCOST,     /*!< Smoothed measured compute time of this cell per sampled step, see cellcost.h */
+      LBCOSTSAMPLE,       /*!< Compute time measured for this cell during the current sampled step */
+      LBTRANSFERBYTES,    /*!< Velocity block bytes of this cell when it is migrated by the load balance */
+      LBTRANSFERSOURCE,   /*!< Rank sending this cell when it is migrated by the load balance */
       ISCELLSAVINGF,      /*!< Value telling whether a cell is saving its distribution function when partial f data is written out. */
       FSGRID_RANK, /*!< Rank of this cell in the FsGrid cartesian communicator */
       FSGRID_BOUNDARYTYPE, /*!< Boundary type of this cell, as stored in the fsGrid */
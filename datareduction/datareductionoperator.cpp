@@ -598,46 +598,37 @@ namespace DRO {
       const Realf *block_data = cell->get_data(popID);
       const Real *parameters = cell->get_block_parameters(popID);
       const Real HALF = 0.5;
-      # pragma omp parallel
-      {
-         Real sum[3] = {0.0, 0.0, 0.0};
-         Real averageVX = this->averageVX, averageVY = this->averageVY, averageVZ = this->averageVZ;
-
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA(const uint i, const uint j, const uint k, const uint n, Real *lsum ){
-
-                                             const Real VX
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
-                                                + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
-                                             const Real VY
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
-                                                + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
-                                             const Real VZ
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
-                                                + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-                                             const Real DV3
-                                                = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-
-                                             lsum[0] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VX - averageVX) * (VX - averageVX) * DV3;
-                                             lsum[1] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VY - averageVY) * (VY - averageVY) * DV3;
-                                             lsum[2] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VZ - averageVZ) * (VZ - averageVZ) * DV3;
-                                          }, sum);
-
-         sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
-         // Accumulate contributions coming from this velocity block to the
-         // spatial cell velocity moments. If multithreading / OpenMP is used,
-         // these updates need to be atomic:
-         # pragma omp critical
-         {
-            PTensor[0] += sum[0];
-            PTensor[1] += sum[1];
-            PTensor[2] += sum[2];
-         }
-      }
+      Real sum[3] = {0.0, 0.0, 0.0};
+      Real averageVX = this->averageVX, averageVY = this->averageVY, averageVZ = this->averageVZ;
+
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA(const uint i, const uint j, const uint k, const uint n, Real *lsum ){
+
+                                          const Real VX
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
+                                             + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
+                                          const Real VY
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
+                                             + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
+                                          const Real VZ
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
+                                             + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+                                          const Real DV3
+                                             = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+
+                                          lsum[0] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VX - averageVX) * (VX - averageVX) * DV3;
+                                          lsum[1] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VY - averageVY) * (VY - averageVY) * DV3;
+                                          lsum[2] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VZ - averageVZ) * (VZ - averageVZ) * DV3;
+                                       }, sum);
+
+      sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
+      PTensor[0] += sum[0];
+      PTensor[1] += sum[1];
+      PTensor[2] += sum[2];
       const char* ptr = reinterpret_cast<const char*>(&PTensor);
       for (uint i = 0; i < 3*sizeof(Real); ++i) buffer[i] = ptr[i];
       return true;
@@ -669,47 +660,38 @@ namespace DRO {
       const Realf *block_data = cell->get_data(popID);
       const Real *parameters = cell->get_block_parameters(popID);
       const Real HALF = 0.5;
-      # pragma omp parallel
-      {
-         Real sum[3] = {0.0, 0.0, 0.0};
-         Real averageVX = this->averageVX, averageVY = this->averageVY, averageVZ = this->averageVZ;
-
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA(const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
-
-                                             const Real VX
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
-                                                + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
-                                             const Real VY
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
-                                                + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
-                                             const Real VZ
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
-                                                + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-                                             const Real DV3
-                                                = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-
-                                             lsum[0] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VX - averageVX) * (VY - averageVY) * DV3;
-                                             lsum[1] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VZ - averageVZ) * (VX - averageVX) * DV3;
-                                             lsum[2] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VY - averageVY) * (VZ - averageVZ) * DV3;
-                                          }, sum);
-
-         sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
-
-         // Accumulate contributions coming from this velocity block to the
-         // spatial cell velocity moments. If multithreading / OpenMP is used,
-         // these updates need to be atomic:
-# pragma omp critical
-         {
-            PTensor[0] += sum[2];
-            PTensor[1] += sum[1];
-            PTensor[2] += sum[0];
-         }
-      }
+      Real sum[3] = {0.0, 0.0, 0.0};
+      Real averageVX = this->averageVX, averageVY = this->averageVY, averageVZ = this->averageVZ;
+
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA(const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
+
+                                          const Real VX
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
+                                             + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
+                                          const Real VY
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
+                                             + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
+                                          const Real VZ
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
+                                             + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+                                          const Real DV3
+                                             = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+
+                                          lsum[0] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VX - averageVX) * (VY - averageVY) * DV3;
+                                          lsum[1] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VZ - averageVZ) * (VX - averageVX) * DV3;
+                                          lsum[2] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * (VY - averageVY) * (VZ - averageVZ) * DV3;
+                                       }, sum);
+
+      sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
+
+      PTensor[0] += sum[2];
+      PTensor[1] += sum[1];
+      PTensor[2] += sum[0];
       const char* ptr = reinterpret_cast<const char*>(&PTensor);
       for (uint i = 0; i < 3*sizeof(Real); ++i) buffer[i] = ptr[i];
       return true;
@@ -742,20 +724,10 @@ namespace DRO {
       maxF = std::numeric_limits<Real>::min();
       const Realf* block_data = cell->get_data(popID);
 
-#pragma omp parallel
-      {
-         Real threadMax = std::numeric_limits<Real>::min();
-
-         arch::parallel_reduce<arch::max>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lthreadMax)-> void {
-                                             lthreadMax[0] = max((Real)(block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]), lthreadMax[0]);
-                                          }, threadMax);
-
-                  #pragma omp critical
-         {
-            maxF = max(threadMax, maxF);
-         }
-      }
+      arch::parallel_reduce<arch::max>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lmax)-> void {
+                                          lmax[0] = max((Real)(block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]), lmax[0]);
+                                       }, maxF);
 
       *buffer = maxF;
       return true;
@@ -793,20 +765,10 @@ namespace DRO {
       minF =  std::numeric_limits<Real>::max();
       const Realf* block_data = cell->get_data(popID);
 
-#pragma omp parallel
-      {
-         Real threadMin = std::numeric_limits<Real>::max();
-
-         arch::parallel_reduce<arch::min>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lthreadMin) -> void{
-                                             lthreadMin[0] = min((Real)(block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]), lthreadMin[0]);
-                                          }, threadMin);
-
-#pragma omp critical
-         {
-            minF = min(threadMin, minF);
-         }
-      }
+      arch::parallel_reduce<arch::min>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lmin) -> void{
+                                          lmin[0] = min((Real)(block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]), lmin[0]);
+                                       }, minF);
 
       *buffer = minF;
       return true;
@@ -839,47 +801,37 @@ namespace DRO {
       const Real* parameters = cell->get_block_parameters(popID);
       const Realf* block_data = cell->get_data(popID);
 
-# pragma omp parallel
-      {
-         Real thread_n_sum = 0.0;
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
-
-                                             const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
-                                             const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] *  block_parameters[BlockParams::DVZ];
-
-                                             // Go through every velocity cell (i, j, k are indices)
-                                             ARCH_INNER_BODY(i, j, k, n, lsum) {
-                                                // Get the vx, vy, vz coordinates of the velocity cell
-                                                const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
-                                                const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
-                                                const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
-                                                // Compare the distance of the velocity cell from the center of the maxwellian distribution to the radius of the maxwellian distribution
-                                                if (((calculateNonthermal == true) &&
-                                                     (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                        + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                        + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                      > thermalRadius*thermalRadius))
-                                                     ||
-                                                     ((calculateNonthermal == false) &&
-                                                      (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                         + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                         + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                       <= thermalRadius*thermalRadius) )) {
-                                                   //The velocity cell is a part of the nonthermal/thermal population:
-                                                   lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * DV3;
-                                                }
-                                             };
-                                          }, thread_n_sum);
-         // Accumulate contributions coming from this velocity block
-         // If multithreading / OpenMP is used,
-         // these updates need to be atomic:
-         // todo: use omp reduction
-         # pragma omp critical
-         {
-            rho += thread_n_sum;
-         }
-      }
+      Real thread_n_sum = 0.0;
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
+
+                                          const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
+                                          const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] *  block_parameters[BlockParams::DVZ];
+
+                                          // Go through every velocity cell (i, j, k are indices)
+                                          ARCH_INNER_BODY(i, j, k, n, lsum) {
+                                             // Get the vx, vy, vz coordinates of the velocity cell
+                                             const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
+                                             const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
+                                             const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
+                                             // Compare the distance of the velocity cell from the center of the maxwellian distribution to the radius of the maxwellian distribution
+                                             if (((calculateNonthermal == true) &&
+                                                  (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                     + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                     + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                   > thermalRadius*thermalRadius))
+                                                  ||
+                                                  ((calculateNonthermal == false) &&
+                                                   (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                      + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                      + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                    <= thermalRadius*thermalRadius) )) {
+                                                //The velocity cell is a part of the nonthermal/thermal population:
+                                                lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * DV3;
+                                             }
+                                          };
+                                       }, thread_n_sum);
+      rho += thread_n_sum;
       return;
    }
 
@@ -897,56 +849,47 @@ namespace DRO {
       const Real* parameters = cell->get_block_parameters(popID);
       const Realf* block_data = cell->get_data(popID);
 
-# pragma omp parallel
-      {
 
-         Real sum[4] = {0};
-
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
-
-                                             const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
-                                             // Get the volume of a velocity cell
-                                             const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] * block_parameters[BlockParams::DVZ];
-
-                                             // Go through a block's every velocity cell
-                                             ARCH_INNER_BODY(i, j, k, n, lsum) {
-                                                // Get the coordinates of the velocity cell (e.g. VX = block_vx_min_coordinates + (velocity_cell_indice_x+0.5)*length_of_velocity_cell_in_x_direction
-                                                const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
-                                                const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
-                                                const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
-                                                // Calculate the distance of the velocity cell from the center of the maxwellian distribution and compare it to the approximate radius of the maxwellian distribution
-                                                if (((calculateNonthermal == true) &&
-                                                     (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                        + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                        + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                      > thermalRadius*thermalRadius))
-                                                   ||
-                                                    ((calculateNonthermal == false) &&
-                                                     (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                        + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                        + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                      <= thermalRadius*thermalRadius) )) {
-                                                   // Add the value of the coordinates and multiply by the AVGS value of the velocity cell and the volume of the velocity cell
-                                                   lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*VX*DV3;
-                                                   lsum[1] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*VY*DV3;
-                                                   lsum[2] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*VZ*DV3;
-                                                   lsum[3] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*DV3;
-                                                }
-                                             };
-                                          }, sum);
-
-         // Accumulate contributions coming from this velocity block.
-         // If multithreading / OpenMP is used,
-         // these updates need to be atomic:
-# pragma omp critical
-         {
-            V[0] += sum[0];
-            V[1] += sum[1];
-            V[2] += sum[2];
-            n_sum += sum[3];
-         }
-      }
+      Real sum[4] = {0};
+
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
+
+                                          const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
+                                          // Get the volume of a velocity cell
+                                          const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] * block_parameters[BlockParams::DVZ];
+
+                                          // Go through a block's every velocity cell
+                                          ARCH_INNER_BODY(i, j, k, n, lsum) {
+                                             // Get the coordinates of the velocity cell (e.g. VX = block_vx_min_coordinates + (velocity_cell_indice_x+0.5)*length_of_velocity_cell_in_x_direction
+                                             const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
+                                             const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
+                                             const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
+                                             // Calculate the distance of the velocity cell from the center of the maxwellian distribution and compare it to the approximate radius of the maxwellian distribution
+                                             if (((calculateNonthermal == true) &&
+                                                  (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                     + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                     + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                   > thermalRadius*thermalRadius))
+                                                ||
+                                                 ((calculateNonthermal == false) &&
+                                                  (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                     + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                     + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                   <= thermalRadius*thermalRadius) )) {
+                                                // Add the value of the coordinates and multiply by the AVGS value of the velocity cell and the volume of the velocity cell
+                                                lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*VX*DV3;
+                                                lsum[1] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*VY*DV3;
+                                                lsum[2] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*VZ*DV3;
+                                                lsum[3] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)]*DV3;
+                                             }
+                                          };
+                                       }, sum);
+
+      V[0] += sum[0];
+      V[1] += sum[1];
+      V[2] += sum[2];
+      n_sum += sum[3];
 
 
       // Finally, divide n_sum*V by V.
@@ -970,55 +913,46 @@ namespace DRO {
       const Real* parameters = cell->get_block_parameters(popID);
       const Realf* block_data = cell->get_data(popID);
 
-# pragma omp parallel
-      {
-         Real sum[3] = {0};
-
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
-
-                                             const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
-                                             // Get the volume of a velocity cell
-                                             const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] * block_parameters[BlockParams::DVZ];
-
-                                             ARCH_INNER_BODY(i, j, k, n, lsum) {
-                                                // Get the coordinates of the velocity cell (e.g. VX = block_vx_min_coordinates + (velocity_cell_indice_x+0.5)*length_of_velocity_cell_in_x_direction
-                                                const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
-                                                const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
-                                                const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
-                                                // Calculate the distance of the velocity cell from the center of the maxwellian distribution and compare it to the approximate radius of the maxwellian distribution
-                                                if (((calculateNonthermal == true) &&
-                                                     (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                        + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                        + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                      > thermalRadius*thermalRadius))
-                                                    ||
-                                                    ((calculateNonthermal == false) &&
-                                                     (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                        + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                        + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                      <= thermalRadius*thermalRadius ))) {
-                                                   lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VX - averageVX) * (VX - averageVX) * DV3;
-                                                   lsum[1] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VY - averageVY) * (VY - averageVY) * DV3;
-                                                   lsum[2] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VZ - averageVZ) * (VZ - averageVZ) * DV3;
-                                                }
-                                             };
-                                          }, sum);
-
-         sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
-
-         // Accumulate contributions coming from this velocity block to the
-         // spatial cell velocity moments. If multithreading / OpenMP is used,
-         // these updates need to be atomic:
-# pragma omp critical
-         {
-            PTensor[0] += sum[0];
-            PTensor[1] += sum[1];
-            PTensor[2] += sum[2];
-         }
-      }
+      Real sum[3] = {0};
+
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
+
+                                          const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
+                                          // Get the volume of a velocity cell
+                                          const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] * block_parameters[BlockParams::DVZ];
+
+                                          ARCH_INNER_BODY(i, j, k, n, lsum) {
+                                             // Get the coordinates of the velocity cell (e.g. VX = block_vx_min_coordinates + (velocity_cell_indice_x+0.5)*length_of_velocity_cell_in_x_direction
+                                             const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
+                                             const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
+                                             const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
+                                             // Calculate the distance of the velocity cell from the center of the maxwellian distribution and compare it to the approximate radius of the maxwellian distribution
+                                             if (((calculateNonthermal == true) &&
+                                                  (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                     + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                     + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                   > thermalRadius*thermalRadius))
+                                                 ||
+                                                 ((calculateNonthermal == false) &&
+                                                  (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                     + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                     + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                   <= thermalRadius*thermalRadius ))) {
+                                                lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VX - averageVX) * (VX - averageVX) * DV3;
+                                                lsum[1] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VY - averageVY) * (VY - averageVY) * DV3;
+                                                lsum[2] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VZ - averageVZ) * (VZ - averageVZ) * DV3;
+                                             }
+                                          };
+                                       }, sum);
+
+      sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
+
+      PTensor[0] += sum[0];
+      PTensor[1] += sum[1];
+      PTensor[2] += sum[2];
       return;
    }
 
@@ -1036,55 +970,46 @@ namespace DRO {
       const Real* parameters = cell->get_block_parameters(popID);
       const Realf* block_data = cell->get_data(popID);
 
-# pragma omp parallel
-      {
-         Real sum[3] = {0};
-
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
-
-                                             const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
-                                             // Get the volume of a velocity cell
-                                             const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] * block_parameters[BlockParams::DVZ];
-
-                                             ARCH_INNER_BODY(i, j, k, n, lsum) {
-                                                // Get the coordinates of the velocity cell (e.g. VX = block_vx_min_coordinates + (velocity_cell_indice_x+0.5)*length_of_velocity_cell_in_x_direction
-                                                const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
-                                                const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
-                                                const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
-                                                // Calculate the distance of the velocity cell from the center of the maxwellian distribution and compare it to the approximate radius of the maxwellian distribution
-                                                if (((calculateNonthermal == true) &&
-                                                     (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                        + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                        + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                      > thermalRadius*thermalRadius))
-                                                    ||
-                                                    ((calculateNonthermal == false) &&
-                                                     (( (thermalV[0] - VX) * (thermalV[0] - VX)
-                                                        + (thermalV[1] - VY) * (thermalV[1] - VY)
-                                                        + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
-                                                      <= thermalRadius*thermalRadius ))) {
-                                                   lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VX - averageVX) * (VY - averageVY) * DV3;
-                                                   lsum[1] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VZ - averageVZ) * (VX - averageVX) * DV3;
-                                                   lsum[2] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VY - averageVY) * (VZ - averageVZ) * DV3;
-                                                }
-                                             };
-                                          }, sum);
-
-         sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
-         sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
-
-         // Accumulate contributions coming from this velocity block to the
-         // spatial cell velocity moments. If multithreading / OpenMP is used,
-         // these updates need to be atomic:
-# pragma omp critical
-         {
-            PTensor[0] += sum[2];
-            PTensor[1] += sum[1];
-            PTensor[2] += sum[0];
-         }
-      }
+      Real sum[3] = {0};
+
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
+
+                                          const Real* block_parameters = &parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS];
+                                          // Get the volume of a velocity cell
+                                          const Real DV3 = block_parameters[BlockParams::DVX] * block_parameters[BlockParams::DVY] * block_parameters[BlockParams::DVZ];
+
+                                          ARCH_INNER_BODY(i, j, k, n, lsum) {
+                                             // Get the coordinates of the velocity cell (e.g. VX = block_vx_min_coordinates + (velocity_cell_indice_x+0.5)*length_of_velocity_cell_in_x_direction
+                                             const Real VX = block_parameters[BlockParams::VXCRD] + (i + HALF) * block_parameters[BlockParams::DVX];
+                                             const Real VY = block_parameters[BlockParams::VYCRD] + (j + HALF) * block_parameters[BlockParams::DVY];
+                                             const Real VZ = block_parameters[BlockParams::VZCRD] + (k + HALF) * block_parameters[BlockParams::DVZ];
+                                             // Calculate the distance of the velocity cell from the center of the maxwellian distribution and compare it to the approximate radius of the maxwellian distribution
+                                             if (((calculateNonthermal == true) &&
+                                                  (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                     + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                     + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                   > thermalRadius*thermalRadius))
+                                                 ||
+                                                 ((calculateNonthermal == false) &&
+                                                  (( (thermalV[0] - VX) * (thermalV[0] - VX)
+                                                     + (thermalV[1] - VY) * (thermalV[1] - VY)
+                                                     + (thermalV[2] - VZ) * (thermalV[2] - VZ) )
+                                                   <= thermalRadius*thermalRadius ))) {
+                                                lsum[0] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VX - averageVX) * (VY - averageVY) * DV3;
+                                                lsum[1] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VZ - averageVZ) * (VX - averageVX) * DV3;
+                                                lsum[2] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * (VY - averageVY) * (VZ - averageVZ) * DV3;
+                                             }
+                                          };
+                                       }, sum);
+
+      sum[0] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[1] *= getObjectWrapper().particleSpecies[popID].mass;
+      sum[2] *= getObjectWrapper().particleSpecies[popID].mass;
+
+      PTensor[0] += sum[2];
+      PTensor[1] += sum[1];
+      PTensor[2] += sum[0];
       return;
    }
 
@@ -1485,54 +1410,46 @@ namespace DRO {
       const Real* parameters  = cell->get_block_parameters(popID);
       const Realf* block_data = cell->get_data(popID);
 
-# pragma omp parallel
-      {
-         std::vector<Real> sum(2 * nChannels,0.0);
+      std::vector<Real> sum(2 * nChannels,0.0);
 
-         const Real mass = getObjectWrapper().particleSpecies[popID].mass;
+      const Real mass = getObjectWrapper().particleSpecies[popID].mass;
 
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum )-> void {
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum )-> void {
 
-                                             const Real VX
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
-                                                + (i + 0.5)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
-                                             const Real VY
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
-                                                + (j + 0.5)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
-                                             const Real VZ
-                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
-                                                + (k + 0.5)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-
-                                             const Real DV3
-                                                = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-
-                                             const Real normV = sqrt(VX*VX + VY*VY + VZ*VZ);
-                                             const Real VdotB_norm = (B[0]*VX + B[1]*VY + B[2]*VZ)/normV;
-                                             Real countAndGate = floor(VdotB_norm/cosAngle);  // gate function: 0 outside loss cone, 1 inside
-                                             countAndGate = max(0.,countAndGate);
-                                             const Real energy = 0.5 * mass * normV*normV; // in SI
-
-                                             // Find the correct energy bin number to update
-                                             int binNumber = round((log(energy) - log(emin)) / log(emax/emin) * (nChannels-1));
-                                             binNumber = max(binNumber,0); // anything < emin goes to the lowest channel
-                                             binNumber = min(binNumber,nChannels-1); // anything > emax goes to the highest channel
-
-                                             lsum[binNumber] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * countAndGate * normV*normV * DV3;
-                                             lsum[nChannels + binNumber] += countAndGate * DV3;
-                                          }, sum);
-
-         // Accumulate contributions coming from this velocity block
-         // If multithreading / OpenMP is used, these updates need to be atomic:
-# pragma omp critical
-         {
-            for (int i=0; i<nChannels; i++) {
-               dataDiffFlux[i] += sum[i];
-               sumWeights[i] += sum[nChannels + i];
-            }
-         }
+                                          const Real VX
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
+                                             + (i + 0.5)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
+                                          const Real VY
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
+                                             + (j + 0.5)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
+                                          const Real VZ
+                                             =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
+                                             + (k + 0.5)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+
+                                          const Real DV3
+                                             = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+
+                                          const Real normV = sqrt(VX*VX + VY*VY + VZ*VZ);
+                                          const Real VdotB_norm = (B[0]*VX + B[1]*VY + B[2]*VZ)/normV;
+                                          Real countAndGate = floor(VdotB_norm/cosAngle);  // gate function: 0 outside loss cone, 1 inside
+                                          countAndGate = max(0.,countAndGate);
+                                          const Real energy = 0.5 * mass * normV*normV; // in SI
+
+                                          // Find the correct energy bin number to update
+                                          int binNumber = round((log(energy) - log(emin)) / log(emax/emin) * (nChannels-1));
+                                          binNumber = max(binNumber,0); // anything < emin goes to the lowest channel
+                                          binNumber = min(binNumber,nChannels-1); // anything > emax goes to the highest channel
+
+                                          lsum[binNumber] += block_data[n * SIZE_VELBLOCK + cellIndex(i,j,k)] * countAndGate * normV*normV * DV3;
+                                          lsum[nChannels + binNumber] += countAndGate * DV3;
+                                       }, sum);
+
+      for (int i=0; i<nChannels; i++) {
+         dataDiffFlux[i] += sum[i];
+         sumWeights[i] += sum[nChannels + i];
       }
 
       // Averaging within each bin and conversion to unit of part. cm-2 s-1 sr-1 ev-1
@@ -1743,48 +1660,39 @@ namespace DRO {
          EDensity[i] = 0.0;
       }
 
-# pragma omp parallel
-      {
-         Real sum[3] = {0.0, 0.0, 0.0};
-
-         const Real mass = getObjectWrapper().particleSpecies[popID].mass;
-
-         arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
-
-                                             const Real DV3 = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
-                                                * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-
-                                             ARCH_INNER_BODY(i, j, k, n, lsum) {
-                                                const Real VX
-                                                   =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
-                                                   + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
-                                                const Real VY
-                                                   =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
-                                                   + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
-                                                const Real VZ
-                                                   =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
-                                                   + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-
-                                                const Real ENERGY = (VX*VX + VY*VY + VZ*VZ) * HALF * mass;
-                                                lsum[0] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * ENERGY * DV3;
-                                                if (ENERGY > E1limit) lsum[1] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * ENERGY * DV3;
-                                                if (ENERGY > E2limit) lsum[2] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * ENERGY * DV3;
-                                             };
-                                          }, sum);
+      Real sum[3] = {0.0, 0.0, 0.0};
 
-         // Accumulate contributions coming from this velocity block to the
-         // spatial cell velocity moments. If multithreading / OpenMP is used,
-         // these updates need to be atomic:
-# pragma omp critical
-         {
-            EDensity[0] += sum[0];
-            EDensity[1] += sum[1];
-            EDensity[2] += sum[2];
-         }
+      const Real mass = getObjectWrapper().particleSpecies[popID].mass;
+
+      arch::parallel_reduce<arch::sum>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                       ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lsum ) {
+
+                                          const Real DV3 = parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY]
+                                             * parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+
+                                          ARCH_INNER_BODY(i, j, k, n, lsum) {
+                                             const Real VX
+                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
+                                                + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
+                                             const Real VY
+                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
+                                                + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
+                                             const Real VZ
+                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
+                                                + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+
+                                             const Real ENERGY = (VX*VX + VY*VY + VZ*VZ) * HALF * mass;
+                                             lsum[0] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * ENERGY * DV3;
+                                             if (ENERGY > E1limit) lsum[1] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * ENERGY * DV3;
+                                             if (ENERGY > E2limit) lsum[2] += block_data[n * SIZE_VELBLOCK+cellIndex(i,j,k)] * ENERGY * DV3;
+                                          };
+                                       }, sum);
+
+      EDensity[0] += sum[0];
+      EDensity[1] += sum[1];
+      EDensity[2] += sum[2];
 
-      }
 
       // Output energy density in units eV/cm^3 instead of Joules per m^3
       EDensity[0] *= (1.0e-6)/physicalconstants::CHARGE;
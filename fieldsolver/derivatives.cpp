@@ -25,6 +25,7 @@
 #include "fs_common.h"
 #include "derivatives.hpp"
 #include "fs_limiters.h"
+#include "fs_soa.h"
 
 /*! \brief Low-level spatial derivatives calculation.
  *
@@ -287,6 +288,264 @@ void calculateDerivatives(
 }
 
 
+/*! One first derivative computed by the SoA kernels: the gathered slot it is
+ * taken of and the component of dPerB or dMoments it is stored to.*/
+struct SoADerivative {
+   int slot;
+   int target;
+};
+
+// Slots of the structure-of-arrays copies used in calculateDerivativesSoA
+namespace soaslots {
+   enum perb {PERBX, PERBY, PERBZ, N_PERB};
+   enum moments {RHOM, RHOQ, P_11, P_22, P_33, VX, VY, VZ, PE, N_MOMENTS};
+}
+
+static const SoADerivative soaMomentDerivatives[3][8] = {
+   {{soaslots::RHOM, fsgrids::dmoments::drhomdx}, {soaslots::RHOQ, fsgrids::dmoments::drhoqdx},
+    {soaslots::P_11, fsgrids::dmoments::dp11dx}, {soaslots::P_22, fsgrids::dmoments::dp22dx}, {soaslots::P_33, fsgrids::dmoments::dp33dx},
+    {soaslots::VX, fsgrids::dmoments::dVxdx}, {soaslots::VY, fsgrids::dmoments::dVydx}, {soaslots::VZ, fsgrids::dmoments::dVzdx}},
+   {{soaslots::RHOM, fsgrids::dmoments::drhomdy}, {soaslots::RHOQ, fsgrids::dmoments::drhoqdy},
+    {soaslots::P_11, fsgrids::dmoments::dp11dy}, {soaslots::P_22, fsgrids::dmoments::dp22dy}, {soaslots::P_33, fsgrids::dmoments::dp33dy},
+    {soaslots::VX, fsgrids::dmoments::dVxdy}, {soaslots::VY, fsgrids::dmoments::dVydy}, {soaslots::VZ, fsgrids::dmoments::dVzdy}},
+   {{soaslots::RHOM, fsgrids::dmoments::drhomdz}, {soaslots::RHOQ, fsgrids::dmoments::drhoqdz},
+    {soaslots::P_11, fsgrids::dmoments::dp11dz}, {soaslots::P_22, fsgrids::dmoments::dp22dz}, {soaslots::P_33, fsgrids::dmoments::dp33dz},
+    {soaslots::VX, fsgrids::dmoments::dVxdz}, {soaslots::VY, fsgrids::dmoments::dVydz}, {soaslots::VZ, fsgrids::dmoments::dVzdz}}
+};
+static const int soaPeDerivatives[3] = {fsgrids::dmoments::dPedx, fsgrids::dmoments::dPedy, fsgrids::dmoments::dPedz};
+static const SoADerivative soaPerBDerivatives[3][2] = {
+   {{soaslots::PERBY, fsgrids::dperb::dPERBydx}, {soaslots::PERBZ, fsgrids::dperb::dPERBzdx}},
+   {{soaslots::PERBX, fsgrids::dperb::dPERBxdy}, {soaslots::PERBZ, fsgrids::dperb::dPERBzdy}},
+   {{soaslots::PERBX, fsgrids::dperb::dPERBxdz}, {soaslots::PERBY, fsgrids::dperb::dPERBydz}}
+};
+static const SoADerivative soaPerBSecondDerivatives[3][2] = {
+   {{soaslots::PERBY, fsgrids::dperb::dPERBydxx}, {soaslots::PERBZ, fsgrids::dperb::dPERBzdxx}},
+   {{soaslots::PERBX, fsgrids::dperb::dPERBxdyy}, {soaslots::PERBZ, fsgrids::dperb::dPERBzdyy}},
+   {{soaslots::PERBX, fsgrids::dperb::dPERBxdzz}, {soaslots::PERBY, fsgrids::dperb::dPERBydzz}}
+};
+
+/*! Store a row of values into component c of an fsgrid row, for the cells selected by mask only.
+ * The store is written as a select so that the loop vectorizes.*/
+template<size_t N> static inline void storeRowSelected(
+   std::array<Real, N> * __restrict__ out,
+   const int c,
+   const Real * __restrict__ values,
+   const char * __restrict__ mask,
+   const int n
+) {
+   #pragma omp simd
+   for (int i=0; i<n; i++) {
+      const Real old = out[i][c];
+      out[i][c] = mask[i] ? values[i] : old;
+   }
+}
+
+/*! \brief Derivative calculation on structure-of-arrays copies of B and the moments.
+ *
+ * Gives the same result as calling calculateDerivatives on every cell, but the
+ * bulk cells (NOT_SYSBOUNDARY, not in layer 1) are processed a row along x at a
+ * time from the contiguous copies made by FsGridSoA, so that the loops over i
+ * vectorize. The remaining system boundary cells go through calculateDerivatives.
+ *
+ * \param perBGrid fsGrid holding the perturbed B quantities, ghost cells up to date
+ * \param momentsGrid fsGrid holding the moment quantities, ghost cells up to date
+ * \param dPerBGrid fsGrid holding the derivatives of perturbed B
+ * \param dMomentsGrid fsGrid holding the derviatives of moments
+ * \param technicalGrid fsGrid holding technical information (such as boundary types)
+ * \param sysBoundaries System boundary conditions existing
+ * \param RKCase Element in the enum defining the Runge-Kutta method steps
+ *
+ * \sa calculateDerivatives calculateDerivativesSimple
+ */
+static void calculateDerivativesSoA(
+   FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & perBGrid,
+   FsGrid< std::array<Real, fsgrids::moments::N_MOMENTS>, FS_STENCIL_WIDTH> & momentsGrid,
+   FsGrid< std::array<Real, fsgrids::dperb::N_DPERB>, FS_STENCIL_WIDTH> & dPerBGrid,
+   FsGrid< std::array<Real, fsgrids::dmoments::N_DMOMENTS>, FS_STENCIL_WIDTH> & dMomentsGrid,
+   FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+   SysBoundary& sysBoundaries,
+   cint& RKCase
+) {
+   // Kept between calls, only called from the master thread
+   static FsGridSoA<fsgrids::bfield::N_BFIELD> perBSoA;
+   static FsGridSoA<fsgrids::moments::N_MOMENTS> momentsSoA;
+
+   const int* gridDims = &technicalGrid.getLocalSize()[0];
+   const int nx = gridDims[0];
+
+   phiprof::start("Gather SoA");
+   perBSoA.gather(perBGrid, {fsgrids::bfield::PERBX, fsgrids::bfield::PERBY, fsgrids::bfield::PERBZ});
+   momentsSoA.gather(momentsGrid,
+                     {fsgrids::moments::RHOM, fsgrids::moments::RHOQ, fsgrids::moments::P_11, fsgrids::moments::P_22,
+                      fsgrids::moments::P_33, fsgrids::moments::VX, fsgrids::moments::VY, fsgrids::moments::VZ},
+                     1);
+
+   // pres_e = const * np.power(rho_e, index), evaluated once per cell instead of once per use
+   {
+      const Real * rhoq = momentsSoA.slotData(soaslots::RHOQ);
+      Real * pe = momentsSoA.slotData(soaslots::PE);
+      const size_t n = momentsSoA.getSlotSize();
+      #pragma omp parallel for
+      for (size_t c=0; c<n; c++) {
+         pe[c] = pow(rhoq[c]/physicalconstants::CHARGE,Parameters::electronPTindex);
+      }
+   }
+   phiprof::stop("Gather SoA");
+
+   // Constants for electron pressure derivatives
+   // Upstream pressure
+   const Real Peupstream = Parameters::electronTemperature * Parameters::electronDensity * physicalconstants::K_B;
+   const Real Peconst = Peupstream * pow(Parameters::electronDensity, -Parameters::electronPTindex);
+   const bool secondDerivatives = Parameters::ohmHallTerm >= 2;
+
+   #pragma omp parallel
+   {
+      std::vector<Real> value(nx);
+      std::vector<Real> centered(nx);
+      std::vector<char> bulk(nx);
+
+      #pragma omp for collapse(2)
+      for (int k=0; k<gridDims[2]; k++) {
+         for (int j=0; j<gridDims[1]; j++) {
+            const fsgrids::technical * tech = technicalGrid.get(0,j,k);
+            std::array<Real, fsgrids::dperb::N_DPERB> * dPerB = dPerBGrid.get(0,j,k);
+            std::array<Real, fsgrids::dmoments::N_DMOMENTS> * dMoments = dMomentsGrid.get(0,j,k);
+
+            bool anyBulk = false;
+            for (int i=0; i<nx; i++) {
+               bulk[i] = tech[i].sysBoundaryFlag == sysboundarytype::NOT_SYSBOUNDARY && tech[i].sysBoundaryLayer != 1;
+               centered[i] = tech[i].sysBoundaryLayer == 2 ? 1.0 : 0.0;
+               anyBulk = anyBulk || bulk[i];
+            }
+
+            #ifdef DEBUG_SOLVERS
+            // Same density checks as calculateDerivatives: the cell itself and its x neighbours
+            {
+               const Real * rhom = momentsSoA.row(soaslots::RHOM, j, k);
+               for (int i=0; i<nx; i++) {
+                  if (!bulk[i]) {
+                     continue;
+                  }
+                  for (int di=-1; di<=1; di++) {
+                     if (rhom[i+di] <= 0) {
+                        std::cerr << __FILE__ << ":" << __LINE__
+                           << (rhom[i+di] < 0 ? " Negative" : " Zero") << " density in spatial cell at (" << i+di << " " << j << " " << k << ")"
+                           << std::endl;
+                        abort();
+                     }
+                  }
+               }
+            }
+            #endif
+
+            if (anyBulk) {
+               for (int dir=0; dir<3; dir++) {
+                  // Neighbour rows in direction dir, x neighbours are the same row shifted by one
+                  const int dj = (dir == 1) ? 1 : 0;
+                  const int dk = (dir == 2) ? 1 : 0;
+                  const int di = (dir == 0) ? 1 : 0;
+
+                  for (int q=0; q<8; q++) {
+                     const int slot = soaMomentDerivatives[dir][q].slot;
+                     const Real * __restrict__ left = momentsSoA.row(slot, j-dj, k-dk) - di;
+                     const Real * __restrict__ cent = momentsSoA.row(slot, j, k);
+                     const Real * __restrict__ rght = momentsSoA.row(slot, j+dj, k+dk) + di;
+                     #pragma omp simd
+                     for (int i=0; i<nx; i++) {
+                        const Real limited = limiter(left[i], cent[i], rght[i]);
+                        value[i] = centered[i] != 0.0 ? (rght[i]-left[i])/2 : limited;
+                     }
+                     storeRowSelected(dMoments, soaMomentDerivatives[dir][q].target, value.data(), bulk.data(), nx);
+                  }
+
+                  {
+                     const Real * __restrict__ left = momentsSoA.row(soaslots::PE, j-dj, k-dk) - di;
+                     const Real * __restrict__ cent = momentsSoA.row(soaslots::PE, j, k);
+                     const Real * __restrict__ rght = momentsSoA.row(soaslots::PE, j+dj, k+dk) + di;
+                     #pragma omp simd
+                     for (int i=0; i<nx; i++) {
+                        value[i] = Peconst * limiter(left[i], cent[i], rght[i]);
+                     }
+                     storeRowSelected(dMoments, soaPeDerivatives[dir], value.data(), bulk.data(), nx);
+                  }
+
+                  for (int q=0; q<2; q++) {
+                     const int slot = soaPerBDerivatives[dir][q].slot;
+                     const Real * __restrict__ left = perBSoA.row(slot, j-dj, k-dk) - di;
+                     const Real * __restrict__ cent = perBSoA.row(slot, j, k);
+                     const Real * __restrict__ rght = perBSoA.row(slot, j+dj, k+dk) + di;
+                     #pragma omp simd
+                     for (int i=0; i<nx; i++) {
+                        const Real limited = limiter(left[i], cent[i], rght[i]);
+                        value[i] = centered[i] != 0.0 ? (rght[i]-left[i])/2 : limited;
+                     }
+                     storeRowSelected(dPerB, soaPerBDerivatives[dir][q].target, value.data(), bulk.data(), nx);
+
+                     if (secondDerivatives) {
+                        #pragma omp simd
+                        for (int i=0; i<nx; i++) {
+                           value[i] = left[i] + rght[i] - 2.0*cent[i];
+                        }
+                     } else {
+                        std::fill(value.begin(), value.end(), 0.0);
+                     }
+                     storeRowSelected(dPerB, soaPerBSecondDerivatives[dir][q].target, value.data(), bulk.data(), nx);
+                  }
+               }
+
+               if (secondDerivatives) {
+                  // Calculate xy mixed derivatives:
+                  {
+                     const Real * __restrict__ bot = perBSoA.row(soaslots::PERBZ, j-1, k);
+                     const Real * __restrict__ top = perBSoA.row(soaslots::PERBZ, j+1, k);
+                     #pragma omp simd
+                     for (int i=0; i<nx; i++) {
+                        value[i] = FOURTH * (bot[i-1] + top[i+1] - bot[i+1] - top[i-1]);
+                     }
+                     storeRowSelected(dPerB, fsgrids::dperb::dPERBzdxy, value.data(), bulk.data(), nx);
+                  }
+                  // Calculate xz mixed derivatives:
+                  {
+                     const Real * __restrict__ bot = perBSoA.row(soaslots::PERBY, j, k-1);
+                     const Real * __restrict__ top = perBSoA.row(soaslots::PERBY, j, k+1);
+                     #pragma omp simd
+                     for (int i=0; i<nx; i++) {
+                        value[i] = FOURTH * (bot[i-1] + top[i+1] - bot[i+1] - top[i-1]);
+                     }
+                     storeRowSelected(dPerB, fsgrids::dperb::dPERBydxz, value.data(), bulk.data(), nx);
+                  }
+                  // Calculate yz mixed derivatives:
+                  {
+                     const Real * __restrict__ botLeft = perBSoA.row(soaslots::PERBX, j-1, k-1);
+                     const Real * __restrict__ botRght = perBSoA.row(soaslots::PERBX, j+1, k-1);
+                     const Real * __restrict__ topLeft = perBSoA.row(soaslots::PERBX, j-1, k+1);
+                     const Real * __restrict__ topRght = perBSoA.row(soaslots::PERBX, j+1, k+1);
+                     #pragma omp simd
+                     for (int i=0; i<nx; i++) {
+                        value[i] = FOURTH * (botLeft[i] + topRght[i] - botRght[i] - topLeft[i]);
+                     }
+                     storeRowSelected(dPerB, fsgrids::dperb::dPERBxdyz, value.data(), bulk.data(), nx);
+                  }
+               } else {
+                  std::fill(value.begin(), value.end(), 0.0);
+                  storeRowSelected(dPerB, fsgrids::dperb::dPERBzdxy, value.data(), bulk.data(), nx);
+                  storeRowSelected(dPerB, fsgrids::dperb::dPERBydxz, value.data(), bulk.data(), nx);
+                  storeRowSelected(dPerB, fsgrids::dperb::dPERBxdyz, value.data(), bulk.data(), nx);
+               }
+            }
+
+            // System boundary cells and layer 1 keep the per-cell treatment
+            for (int i=0; i<nx; i++) {
+               if (bulk[i] || tech[i].sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
+                  continue;
+               }
+               calculateDerivatives(i,j,k, perBGrid, momentsGrid, dPerBGrid, dMomentsGrid, technicalGrid, sysBoundaries, RKCase);
+            }
+         }
+      }
+   }
+}
+
 /*! \brief High-level derivative calculation wrapper function.
  * 
 
@@ -364,6 +623,20 @@ void calculateDerivativesSimple(
    
    phiprof::stop(timer);
 
+   if (Parameters::fieldSolverSoAKernels) {
+      timer=phiprof::initializeTimer("Compute cells (SoA)");
+      phiprof::start(timer);
+      if (RKCase == RK_ORDER1 || RKCase == RK_ORDER2_STEP2) {
+         calculateDerivativesSoA(perBGrid, momentsGrid, dPerBGrid, dMomentsGrid, technicalGrid, sysBoundaries, RKCase);
+      } else {
+         calculateDerivativesSoA(perBDt2Grid, momentsDt2Grid, dPerBGrid, dMomentsGrid, technicalGrid, sysBoundaries, RKCase);
+      }
+      phiprof::stop(timer,N_cells,"Spatial Cells");
+
+      phiprof::stop("Calculate face derivatives",N_cells,"Spatial Cells");
+      return;
+   }
+
    timer=phiprof::initializeTimer("Compute cells");
    phiprof::start(timer);
 
@@ -475,6 +748,85 @@ void calculateBVOLDerivatives(
    }
 }
 
+static const SoADerivative soaBVOLDerivatives[3][3] = {
+   {{soaslots::PERBX, fsgrids::volfields::dPERBXVOLdx}, {soaslots::PERBY, fsgrids::volfields::dPERBYVOLdx}, {soaslots::PERBZ, fsgrids::volfields::dPERBZVOLdx}},
+   {{soaslots::PERBX, fsgrids::volfields::dPERBXVOLdy}, {soaslots::PERBY, fsgrids::volfields::dPERBYVOLdy}, {soaslots::PERBZ, fsgrids::volfields::dPERBZVOLdy}},
+   {{soaslots::PERBX, fsgrids::volfields::dPERBXVOLdz}, {soaslots::PERBY, fsgrids::volfields::dPERBYVOLdz}, {soaslots::PERBZ, fsgrids::volfields::dPERBZVOLdz}}
+};
+
+/*! \brief BVOL derivative calculation on a structure-of-arrays copy of PERB[XYZ]VOL.
+ *
+ * Same result as calling calculateBVOLDerivatives on every cell, with the bulk
+ * cells processed a row along x at a time as in calculateDerivativesSoA.
+ *
+ * \param volGrid fsGrid holding the volume averaged fields, ghost cells up to date
+ * \param technicalGrid fsGrid holding technical information (such as boundary types)
+ * \param sysBoundaries System boundary conditions existing
+ *
+ * \sa calculateBVOLDerivatives calculateBVOLDerivativesSimple
+ */
+static void calculateBVOLDerivativesSoA(
+   FsGrid< std::array<Real, fsgrids::volfields::N_VOL>, FS_STENCIL_WIDTH> & volGrid,
+   FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+   SysBoundary& sysBoundaries
+) {
+   // Kept between calls, only called from the master thread
+   static FsGridSoA<fsgrids::volfields::N_VOL> volSoA;
+
+   const int* gridDims = &technicalGrid.getLocalSize()[0];
+   const int nx = gridDims[0];
+
+   phiprof::start("Gather SoA");
+   volSoA.gather(volGrid, {fsgrids::volfields::PERBXVOL, fsgrids::volfields::PERBYVOL, fsgrids::volfields::PERBZVOL});
+   phiprof::stop("Gather SoA");
+
+   #pragma omp parallel
+   {
+      std::vector<Real> value(nx);
+      std::vector<Real> centered(nx);
+      std::vector<char> bulk(nx);
+
+      #pragma omp for collapse(2)
+      for (int k=0; k<gridDims[2]; k++) {
+         for (int j=0; j<gridDims[1]; j++) {
+            const fsgrids::technical * tech = technicalGrid.get(0,j,k);
+            std::array<Real, fsgrids::volfields::N_VOL> * vol = volGrid.get(0,j,k);
+
+            for (int i=0; i<nx; i++) {
+               bulk[i] = tech[i].sysBoundaryFlag == sysboundarytype::NOT_SYSBOUNDARY && tech[i].sysBoundaryLayer != 1;
+               centered[i] = tech[i].sysBoundaryLayer == 2 ? 1.0 : 0.0;
+            }
+
+            for (int dir=0; dir<3; dir++) {
+               const int dj = (dir == 1) ? 1 : 0;
+               const int dk = (dir == 2) ? 1 : 0;
+               const int di = (dir == 0) ? 1 : 0;
+               for (int q=0; q<3; q++) {
+                  const int slot = soaBVOLDerivatives[dir][q].slot;
+                  const Real * __restrict__ left = volSoA.row(slot, j-dj, k-dk) - di;
+                  const Real * __restrict__ cent = volSoA.row(slot, j, k);
+                  const Real * __restrict__ rght = volSoA.row(slot, j+dj, k+dk) + di;
+                  #pragma omp simd
+                  for (int i=0; i<nx; i++) {
+                     const Real limited = limiter(left[i], cent[i], rght[i]);
+                     value[i] = centered[i] != 0.0 ? (rght[i]-left[i])/2 : limited;
+                  }
+                  storeRowSelected(vol, soaBVOLDerivatives[dir][q].target, value.data(), bulk.data(), nx);
+               }
+            }
+
+            // System boundary cells and layer 1 keep the per-cell treatment
+            for (int i=0; i<nx; i++) {
+               if (bulk[i] || tech[i].sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
+                  continue;
+               }
+               calculateBVOLDerivatives(volGrid,technicalGrid,i,j,k,sysBoundaries);
+            }
+         }
+      }
+   }
+}
+
 /*! \brief High-level derivative calculation wrapper function.
  * 
  * BVOL has been calculated locally by calculateVolumeAveragedFields but not communicated.
@@ -505,6 +857,16 @@ void calculateBVOLDerivativesSimple(
    phiprof::stop(timer,N_cells,"Spatial Cells");
    
    
+   if (Parameters::fieldSolverSoAKernels) {
+      timer=phiprof::initializeTimer("Compute cells (SoA)");
+      phiprof::start(timer);
+      calculateBVOLDerivativesSoA(volGrid, technicalGrid, sysBoundaries);
+      phiprof::stop(timer,N_cells,"Spatial Cells");
+
+      phiprof::stop("Calculate volume derivatives",N_cells,"Spatial Cells");
+      return;
+   }
+
    // Calculate derivatives
    timer=phiprof::initializeTimer("Compute cells");
    phiprof::start(timer);
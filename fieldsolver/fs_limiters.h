@@ -75,14 +75,16 @@ template<typename T> inline T superbee(const T& left,const T& cent,const T& righ
 template<typename T> inline T vanLeer(const T& left,const T& cent,const T& right) {
    const T EPSILON = std::numeric_limits<T>::min();
    const T ZERO    = 0.0;
+   const T ONE     = 1.0;
    const T TWO     = 2.0;
 
+   // Written as selects so that it vectorizes in the SoA derivative kernels: the division
+   // is always done on a safe value and the result of a flat profile is replaced afterwards.
    const T numerator = std::max((right-cent)*(cent-left),ZERO);
    const T denumerator = right-left ;
-   if(fabs(denumerator) < EPSILON)
-      return ZERO;
-   else
-     return TWO * numerator / denumerator;
+   const bool flat = fabs(denumerator) < EPSILON;
+   const T ratio = TWO * numerator / (flat ? ONE : denumerator);
+   return flat ? ZERO : ratio;
    
    //return TWO*std::max((right-cent)*(cent-left),ZERO)/(right-left+EPSILON);
 
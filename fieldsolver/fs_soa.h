@@ -0,0 +1,107 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef FS_SOA_H
+#define FS_SOA_H
+
+#include <array>
+#include <vector>
+#include <fsgrid.hpp>
+
+#include "../definitions.h"
+#include "../common.h"
+
+/*! \brief Structure-of-arrays copy of selected components of an fsgrid.
+ *
+ * FsGrid keeps the N components of a cell together, so a loop along x over one
+ * component strides through memory by N values and loads the whole cell to use a
+ * few of them. gather() copies the wanted components of the local cells and of
+ * one layer of ghost cells into a contiguous array per component, rows along x
+ * padded by one cell at each end. row(slot,j,k)[i] is then the value of the
+ * slot:th gathered component at (i,j,k), for i=-1..nx and j,k in -1..ny/nz,
+ * which is what the SIMD field solver kernels read.
+ *
+ * Extra slots after the gathered components are left for quantities derived
+ * from them by the caller.
+ *
+ * This is a staging copy, not a storage backend: the fsgrid itself stays the
+ * only storage of the field, as all other solvers, the ghost updates and the
+ * I/O work on it, and every gather() copies the components again. Only the
+ * allocation is kept between calls. The derivative kernels in derivatives.cpp
+ * are its only users, the electric field and wave speed kernels work on the
+ * fsgrids directly.
+ */
+template<int N> class FsGridSoA {
+public:
+   /*! Copy the listed components of grid, see the class description.
+    * \param grid The fsgrid to copy from, its ghost cells have to be up to date
+    * \param components Component indices in grid, in slot order
+    * \param extraSlots Number of additional slots to allocate after the gathered ones
+    */
+   void gather(
+      FsGrid< std::array<Real, N>, FS_STENCIL_WIDTH> & grid,
+      const std::vector<int>& components,
+      const int extraSlots = 0
+   ) {
+      const std::array<int32_t, 3>& localSize = grid.getLocalSize();
+      for (int d = 0; d < 3; d++) {
+         paddedSize[d] = localSize[d] + 2;
+      }
+      slotSize = (size_t)paddedSize[0] * paddedSize[1] * paddedSize[2];
+      nSlots = components.size() + extraSlots;
+      data.resize(nSlots * slotSize);
+
+      #pragma omp parallel for collapse(2)
+      for (int k = -1; k < localSize[2] + 1; k++) {
+         for (int j = -1; j < localSize[1] + 1; j++) {
+            // Cells along x are contiguous in fsgrid storage, ghost cells included
+            const std::array<Real, N> * src = grid.get(-1, j, k);
+            for (size_t slot = 0; slot < components.size(); slot++) {
+               Real * dst = row(slot, j, k) - 1;
+               const int c = components[slot];
+               for (int i = 0; i < paddedSize[0]; i++) {
+                  dst[i] = src[i][c];
+               }
+            }
+         }
+      }
+   }
+
+   /*! Pointer to cell i=0 of row (j,k) of a slot, valid for i=-1..nx.*/
+   Real * row(const int slot, const int j, const int k) {
+      return &data[slot * slotSize + ((size_t)(k + 1) * paddedSize[1] + (j + 1)) * paddedSize[0] + 1];
+   }
+
+   /*! Number of values in one slot, including the padding.*/
+   size_t getSlotSize() const { return slotSize; }
+   /*! Pointer to the start of a slot, for loops over all of its values.*/
+   Real * slotData(const int slot) { return &data[slot * slotSize]; }
+
+private:
+   std::array<int, 3> paddedSize;
+   size_t slotSize;
+   size_t nSlots;
+   std::vector<Real> data;
+};
+
+#endif
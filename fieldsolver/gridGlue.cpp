@@ -5,12 +5,73 @@
 #include "../definitions.h"
 #include "../common.h"
 #include "gridGlue.hpp"
+#include "../logger.h"
+
+extern Logger logFile;
+
+// Tasks owning the fsgrid cells along each axis, relative to the task of cell (0,0,0).
+// The fsgrid task layout is row-major, so the owner of a cell is the sum of its three axis entries.
+static std::array<std::vector<int>, 3> fsgridAxisTasks;
+static int fsgridOriginTask = 0;
+
+// Coupling data sent since the last report, to other ranks and to this rank itself
+static uint64_t couplingBytesRemote = 0;
+static uint64_t couplingBytesLocal = 0;
+static uint64_t couplingSteps = 0;
+
+static void countCouplingBytes(const int targetRank, const uint64_t bytes) {
+   int myRank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+   if (targetRank == myRank) {
+      couplingBytesLocal += bytes;
+   } else {
+      couplingBytesRemote += bytes;
+   }
+}
 
+void recordFsGridDecomposition(FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid) {
+   const std::array<int,3> fsgridDims = {
+      (int)(P::xcells_ini * pow(2, P::amrMaxSpatialRefLevel)),
+      (int)(P::ycells_ini * pow(2, P::amrMaxSpatialRefLevel)),
+      (int)(P::zcells_ini * pow(2, P::amrMaxSpatialRefLevel))
+   };
+   const int64_t strides[3] = {1, fsgridDims[0], (int64_t)fsgridDims[0] * fsgridDims[1]};
+   fsgridOriginTask = technicalGrid.getTaskForGlobalID(0).first;
+   for (int dim=0; dim<3; ++dim) {
+      fsgridAxisTasks[dim].resize(fsgridDims[dim]);
+      for (int i=0; i<fsgridDims[dim]; ++i) {
+         fsgridAxisTasks[dim][i] = technicalGrid.getTaskForGlobalID(i * strides[dim]).first - fsgridOriginTask;
+      }
+   }
+}
 
+int getFsGridOwner(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, const CellID dccrgID) {
+   // Use the fsgrid cell at the centre of the dccrg cell, coarse cells may span several tasks
+   const uint64_t halfLength = pow(2, mpiGrid.get_maximum_refinement_level() - mpiGrid.get_refinement_level(dccrgID)) / 2;
+   const auto indices = mpiGrid.mapping.get_indices(dccrgID);
+   return fsgridOriginTask
+      + fsgridAxisTasks[0][indices[0] + halfLength]
+      + fsgridAxisTasks[1][indices[1] + halfLength]
+      + fsgridAxisTasks[2][indices[2] + halfLength];
+}
 
-
-
-
+void logFsGridCouplingTraffic() {
+   const double local[2] = {(double)couplingBytesRemote, (double)couplingBytesLocal};
+   double sum[2];
+   MPI_Allreduce(local, sum, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+   // Every rank takes part in each coupling step, so the step count is the same everywhere and is not reduced
+   const double steps = couplingSteps;
+   couplingBytesRemote = 0;
+   couplingBytesLocal = 0;
+   couplingSteps = 0;
+   if (steps == 0) {
+      return;
+   }
+   const double total = sum[0] + sum[1];
+   logFile << "(LB): fsgrid coupling traffic " << sum[0] / steps / (1024.0 * 1024.0)
+           << " MB per step between ranks, " << (total > 0.0 ? 100.0 * sum[0] / total : 0.0)
+           << "% of all coupling data, over " << steps << " steps" << std::endl << writeVerbose;
+}
 
 /*
 Calculate the number of cells on the maximum refinement level overlapping the list of dccrg cells in cells.
@@ -273,6 +334,7 @@ void feedMomentsIntoFsGrid(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
       }
     }
     int count = sendBuffer.size(); //note, compared to receive this includes all elements to be sent
+    countCouplingBytes(targetProc, sendBuffer.size() * sizeof(Real));
     MPI_Isend(sendBuffer.data(), sendBuffer.size() * sizeof(Real),
 	      MPI_BYTE, targetProc, 1, MPI_COMM_WORLD,&(sendRequests[ii]));
     ii++;
@@ -432,9 +494,11 @@ void getFieldsFromFsGrid(
   for(auto const &sends: onFsgridMapRemoteProcess){
     int remoteRank = sends.first;
     int count = sends.second.size();
+    countCouplingBytes(remoteRank, count * sizeof(Average));
     MPI_Isend(sendData[remoteRank].data(), count * sizeof(Average),
 	     MPI_BYTE, remoteRank, 1, MPI_COMM_WORLD,&(sendRequests[ii++]));
   }
+  couplingSteps++;
   
   MPI_Waitall(receiveRequests.size(), receiveRequests.data(), MPI_STATUSES_IGNORE);
 
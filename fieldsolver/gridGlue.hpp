@@ -35,6 +35,21 @@ enum FieldsToCommunicate {
 std::vector<CellID> mapDccrgIdToFsGridGlobalID(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
 					       CellID dccrgID);
 
+/*! Record which rank owns each part of the fsgrid, for getFsGridOwner.
+ * \param technicalGrid Any fsgrid, they all share the same decomposition
+ */
+void recordFsGridDecomposition(FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid);
+
+/*! Rank owning the fsgrid cells at the centre of a dccrg cell.
+ * recordFsGridDecomposition has to be called first.
+ */
+int getFsGridOwner(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, const CellID dccrgID);
+
+/*! Write the dccrg <=> fsgrid coupling data volume per step since the previous call to the log file,
+ * split into data sent between ranks and data staying on a rank. Collective.
+ */
+void logFsGridCouplingTraffic();
+
 /*! Take input moments from DCCRG grid and put them into the Fieldsolver grid
  * \param mpiGrid The DCCRG grid carrying rho, rhoV and P
  * \param cells List of local cells
@@ -1520,7 +1520,9 @@ void calculateEdgeElectricFieldZ(
 
 /*! \brief Electric field propagation function.
  * 
- * Calls the general or the system boundary electric field propagation functions.
+ * Calls the general electric field propagation functions for the components
+ * solved in this cell. The other components are set by the system boundary
+ * conditions in calculateUpwindedElectricFieldSimple.
  * 
  * \param perBGrid fsGrid holding the perturbed B quantities
  * \param EGrid fsGrid holding the electric field
@@ -1532,7 +1534,6 @@ void calculateEdgeElectricFieldZ(
  * \param BgBGrid fsGrid holding the background B quantities
  * \param technicalGrid fsGrid holding technical information (such as boundary types)
  * \param i,j,k fsGrid cell coordinates for the current cell
- * \param sysBoundaries System boundary conditions existing
  * \param RKCase Element in the enum defining the Runge-Kutta method steps
  * 
  * \sa calculateUpwindedElectricFieldSimple calculateEdgeElectricFieldX calculateEdgeElectricFieldY calculateEdgeElectricFieldZ
@@ -1551,7 +1552,6 @@ void calculateElectricField(
    cint i,
    cint j,
    cint k,
-   SysBoundary& sysBoundaries,
    cint& RKCase
 ) {
    cuint cellSysBoundaryFlag = technicalGrid.get(i,j,k)->sysBoundaryFlag;
@@ -1576,8 +1576,6 @@ void calculateElectricField(
          k,
          RKCase
       );
-   } else {
-      sysBoundaries.getSysBoundary(cellSysBoundaryFlag)->fieldSolverBoundaryCondElectricField(EGrid, i, j, k, 0);
    }
    
    if ((bitfield & compute::EY) == compute::EY) {
@@ -1596,8 +1594,6 @@ void calculateElectricField(
          k,
          RKCase
       );
-   } else {
-      sysBoundaries.getSysBoundary(cellSysBoundaryFlag)->fieldSolverBoundaryCondElectricField(EGrid, i, j, k, 1);
    }
    
    if ((bitfield & compute::EZ) == compute::EZ) {
@@ -1616,8 +1612,6 @@ void calculateElectricField(
          k,
          RKCase
       );
-   } else {
-      sysBoundaries.getSysBoundary(cellSysBoundaryFlag)->fieldSolverBoundaryCondElectricField(EGrid, i, j, k, 2);
    }
 }
 
@@ -1703,7 +1697,6 @@ void calculateUpwindedElectricFieldSimple(
                   i,
                   j,
                   k,
-                  sysBoundaries,
                   RKCase
                );
             } else { // RKCase == RK_ORDER2_STEP1
@@ -1720,7 +1713,6 @@ void calculateUpwindedElectricFieldSimple(
                   i,
                   j,
                   k,
-                  sysBoundaries,
                   RKCase
                );
             }
@@ -1728,6 +1720,22 @@ void calculateUpwindedElectricFieldSimple(
       }
    }
    phiprof::stop(timer,N_cells,"Spatial Cells");
+
+   // Set the components not solved above from the system boundary conditions
+   timer=phiprof::initializeTimer("Compute system boundary cells");
+   phiprof::start(timer);
+   const std::vector<SysBoundaryCellBatch>& boundaryBatches = sysBoundaries.getFieldSolverBoundaryCells().electricField;
+   #pragma omp parallel for schedule(dynamic,1)
+   for (size_t b=0; b<boundaryBatches.size(); b++) {
+      const SysBoundaryCellBatch& batch = boundaryBatches[b];
+      batch.sbc->fieldSolverBoundaryCondElectricFieldBatch(
+         (RKCase == RK_ORDER1 || RKCase == RK_ORDER2_STEP2) ? EGrid : EDt2Grid,
+         batch.cells.data(),
+         batch.cells.size(),
+         batch.component
+      );
+   }
+   phiprof::stop(timer);
    
    timer=phiprof::initializeTimer("MPI","MPI");
    phiprof::start(timer);
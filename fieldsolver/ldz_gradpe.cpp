@@ -114,7 +114,7 @@ void calculateEdgeGradPeTermZComponents(
 }
 
 /** Calculate the electron pressure gradient term on all given cells.
- * @param sysBoundaries System boundary condition functions.
+ * Cells where the system boundary sets the term are skipped here, see calculateGradPeTermSimple.
  */
 void calculateGradPeTerm(
    FsGrid< std::array<Real, fsgrids::egradpe::N_EGRADPE>, FS_STENCIL_WIDTH> & EGradPeGrid,
@@ -123,8 +123,7 @@ void calculateGradPeTerm(
    FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
    cint i,
    cint j,
-   cint k,
-   SysBoundary& sysBoundaries
+   cint k
 ) {
    #ifdef DEBUG_FSOLVER
    if (technicalGrid.get(i,j,k) == NULL) {
@@ -139,15 +138,11 @@ void calculateGradPeTerm(
    
    cuint cellSysBoundaryLayer = technicalGrid.get(i,j,k)->sysBoundaryLayer;
    
-   if ((cellSysBoundaryFlag != sysboundarytype::NOT_SYSBOUNDARY) && (cellSysBoundaryLayer != 1)) {
-      sysBoundaries.getSysBoundary(cellSysBoundaryFlag)->fieldSolverBoundaryCondGradPeElectricField(EGradPeGrid,i,j,k,0);
-      sysBoundaries.getSysBoundary(cellSysBoundaryFlag)->fieldSolverBoundaryCondGradPeElectricField(EGradPeGrid,i,j,k,1);
-      sysBoundaries.getSysBoundary(cellSysBoundaryFlag)->fieldSolverBoundaryCondGradPeElectricField(EGradPeGrid,i,j,k,2);
-   } else {
-      calculateEdgeGradPeTermXComponents(EGradPeGrid,momentsGrid,dMomentsGrid,i,j,k);
-      calculateEdgeGradPeTermYComponents(EGradPeGrid,momentsGrid,dMomentsGrid,i,j,k);
-      calculateEdgeGradPeTermZComponents(EGradPeGrid,momentsGrid,dMomentsGrid,i,j,k);
-   }
+   if ((cellSysBoundaryFlag != sysboundarytype::NOT_SYSBOUNDARY) && (cellSysBoundaryLayer != 1)) return;
+   
+   calculateEdgeGradPeTermXComponents(EGradPeGrid,momentsGrid,dMomentsGrid,i,j,k);
+   calculateEdgeGradPeTermYComponents(EGradPeGrid,momentsGrid,dMomentsGrid,i,j,k);
+   calculateEdgeGradPeTermZComponents(EGradPeGrid,momentsGrid,dMomentsGrid,i,j,k);
 }
 
 void calculateGradPeTermSimple(
@@ -178,14 +173,24 @@ void calculateGradPeTermSimple(
       for (int j=0; j<gridDims[1]; j++) {
          for (int i=0; i<gridDims[0]; i++) {
             if (RKCase == RK_ORDER1 || RKCase == RK_ORDER2_STEP2) {
-               calculateGradPeTerm(EGradPeGrid, momentsGrid, dMomentsGrid, technicalGrid, i, j, k, sysBoundaries);
+               calculateGradPeTerm(EGradPeGrid, momentsGrid, dMomentsGrid, technicalGrid, i, j, k);
             } else {
-               calculateGradPeTerm(EGradPeGrid, momentsDt2Grid, dMomentsGrid, technicalGrid, i, j, k, sysBoundaries);
+               calculateGradPeTerm(EGradPeGrid, momentsDt2Grid, dMomentsGrid, technicalGrid, i, j, k);
             }
          }
       }
    }
    phiprof::stop(timer,N_cells,"Spatial Cells");
+
+   timer=phiprof::initializeTimer("Compute system boundary cells");
+   phiprof::start(timer);
+   const std::vector<SysBoundaryCellBatch>& boundaryBatches = sysBoundaries.getFieldSolverBoundaryCells().ohmTerms;
+   #pragma omp parallel for schedule(dynamic,1)
+   for (size_t b=0; b<boundaryBatches.size(); b++) {
+      const SysBoundaryCellBatch& batch = boundaryBatches[b];
+      batch.sbc->fieldSolverBoundaryCondGradPeElectricFieldBatch(EGradPeGrid, batch.cells.data(), batch.cells.size(), batch.component);
+   }
+   phiprof::stop(timer);
    
    phiprof::stop("Calculate GradPe term",N_cells,"Spatial Cells");
 }
@@ -155,70 +155,114 @@ void propagateMagneticField(
    }
 }
 
-/*! \brief Low-level magnetic field propagation function.
+/*! \brief Low-level magnetic field propagation function for a row of cells.
  * 
- * Propagates the magnetic field according to the system boundary conditions.
+ * Propagates the face-averaged magnetic field components of the cells i=0..nx-1
+ * of row (j,k) like propagateMagneticField, each component only where the
+ * SOLVE bits of the cell say so. The updates are written as selects rather than
+ * branches, and cells along x are contiguous in fsgrid storage (including the
+ * ghost cell at i=nx), so the loop over the row vectorizes.
  * 
  * \param perBGrid fsGrid holding the perturbed B quantities at runge-kutta t=0
  * \param perBDt2Grid fsGrid holding the perturbed B quantities at runge-kutta t=0.5
  * \param EGrid fsGrid holding the Electric field quantities at runge-kutta t=0
  * \param EDt2Grid fsGrid holding the Electric field quantities at runge-kutta t=0.5
  * \param technicalGrid fsGrid holding technical information (such as boundary types)
- * \param i,j,k fsGrid cell coordinates for the current cell
- * \param sysBoundaries System boundary conditions existing
+ * \param j,k fsGrid cell coordinates of the row
+ * \param nx Number of local cells in the row
  * \param dt Length of the time step
  * \param RKCase Element in the enum defining the Runge-Kutta method steps
  * 
- * \sa propagateMagneticFieldSimple propagateMagneticField
+ * \sa propagateMagneticField propagateMagneticFieldSimple
  */
-void propagateSysBoundaryMagneticField(
+static void propagateMagneticFieldRow(
    FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & perBGrid,
    FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & perBDt2Grid,
    FsGrid< std::array<Real, fsgrids::efield::N_EFIELD>, FS_STENCIL_WIDTH> & EGrid,
    FsGrid< std::array<Real, fsgrids::efield::N_EFIELD>, FS_STENCIL_WIDTH> & EDt2Grid,
    FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
-   cint i,
    cint j,
    cint k,
-   SysBoundary& sysBoundaries,
+   cint nx,
    creal& dt,
-   cint& RKCase,
-   cuint component
+   cint& RKCase
 ) {
-   if (RKCase == RK_ORDER1 || RKCase == RK_ORDER2_STEP2) {
-      perBGrid.get(i,j,k)->at(fsgrids::bfield::PERBX + component) = sysBoundaries.getSysBoundary(technicalGrid.get(i,j,k)->sysBoundaryFlag)->fieldSolverBoundaryCondMagneticField(perBGrid, technicalGrid, i, j, k, dt, component);
-   } else {
-      perBDt2Grid.get(i,j,k)->at(fsgrids::bfield::PERBX + component) = sysBoundaries.getSysBoundary(technicalGrid.get(i,j,k)->sysBoundaryFlag)->fieldSolverBoundaryCondMagneticField(perBDt2Grid, technicalGrid, i, j, k, dt, component);
+   if (RKCase != RK_ORDER1 && RKCase != RK_ORDER2_STEP1 && RKCase != RK_ORDER2_STEP2) {
+      std::cerr << __FILE__ << ":" << __LINE__ << ":" << "Invalid RK case." << std::endl;
+      abort();
+   }
+   
+   // RK_ORDER2_STEP1 writes the half step from the t=0 fields, the other cases update perB in place.
+   FsGrid< std::array<Real, fsgrids::efield::N_EFIELD>, FS_STENCIL_WIDTH> & eGrid = (RKCase == RK_ORDER2_STEP2) ? EDt2Grid : EGrid;
+   const std::array<Real, fsgrids::efield::N_EFIELD> * E0 = eGrid.get(0,j,k);
+   const std::array<Real, fsgrids::efield::N_EFIELD> * Ej = eGrid.get(0,j+1,k);
+   const std::array<Real, fsgrids::efield::N_EFIELD> * Ek = eGrid.get(0,j,k+1);
+   const std::array<Real, fsgrids::bfield::N_BFIELD> * B0 = perBGrid.get(0,j,k);
+   std::array<Real, fsgrids::bfield::N_BFIELD> * B1 = (RKCase == RK_ORDER2_STEP1) ? perBDt2Grid.get(0,j,k) : perBGrid.get(0,j,k);
+   const fsgrids::technical * technical = technicalGrid.get(0,j,k);
+   
+   // Same operation order as propagateMagneticField so that the results are bit-identical:
+   // RK_ORDER1 adds dt/dz*a + dt/dy*b, the second order steps add scale*(1.0/dz*a + 1.0/dy*b).
+   // Multiplying by scale=1.0 in the first order case is exact.
+   creal scale = (RKCase == RK_ORDER1) ? 1.0 : ((RKCase == RK_ORDER2_STEP1) ? 0.5*dt : dt);
+   creal factor = (RKCase == RK_ORDER1) ? dt : 1.0;
+   creal cx = factor/perBGrid.DX;
+   creal cy = factor/perBGrid.DY;
+   creal cz = factor/perBGrid.DZ;
+   
+   // All loads are done unconditionally and only the final store selects, otherwise
+   // the compiler turns them into masked loads and gives up on the loop.
+   #pragma omp simd
+   for (int i=0; i<nx; i++) {
+      creal dBx = scale*(cz*(Ek[i][fsgrids::efield::EY] - E0[i][fsgrids::efield::EY]) + cy*(E0[i][fsgrids::efield::EZ] - Ej[i][fsgrids::efield::EZ]));
+      creal dBy = scale*(cx*(E0[i+1][fsgrids::efield::EZ] - E0[i][fsgrids::efield::EZ]) + cz*(E0[i][fsgrids::efield::EX] - Ek[i][fsgrids::efield::EX]));
+      creal dBz = scale*(cy*(Ej[i][fsgrids::efield::EX] - E0[i][fsgrids::efield::EX]) + cx*(E0[i][fsgrids::efield::EY] - E0[i+1][fsgrids::efield::EY]));
+      creal newBx = B0[i][fsgrids::bfield::PERBX] + dBx;
+      creal newBy = B0[i][fsgrids::bfield::PERBY] + dBy;
+      creal newBz = B0[i][fsgrids::bfield::PERBZ] + dBz;
+      creal oldBx = B1[i][fsgrids::bfield::PERBX];
+      creal oldBy = B1[i][fsgrids::bfield::PERBY];
+      creal oldBz = B1[i][fsgrids::bfield::PERBZ];
+      cuint bitfield = technical[i].SOLVE;
+      B1[i][fsgrids::bfield::PERBX] = (bitfield & compute::BX) ? newBx : oldBx;
+      B1[i][fsgrids::bfield::PERBY] = (bitfield & compute::BY) ? newBy : oldBy;
+      B1[i][fsgrids::bfield::PERBZ] = (bitfield & compute::BZ) ? newBz : oldBz;
    }
 }
 
-/*! \brief Low-level magnetic field projection function.
- *
- * Projects the magnetic field according to the system boundary conditions.
- *
+/*! \brief Applies one system boundary condition pass of the magnetic field propagation.
+ * 
+ * Hands the batches of boundary cells out to the threads, each batch is processed
+ * by its system boundary condition in a single call.
+ * 
  * \param perBGrid fsGrid holding the perturbed B quantities at runge-kutta t=0
  * \param perBDt2Grid fsGrid holding the perturbed B quantities at runge-kutta t=0.5
  * \param technicalGrid fsGrid holding technical information (such as boundary types)
- * \param i,j,k fsGrid cell coordinates for the current cell
- * \param sysBoundaries System boundary conditions existing
+ * \param batches Cell batches of the pass, from SysBoundary::getFieldSolverBoundaryCells
+ * \param dt Length of the time step
  * \param RKCase Element in the enum defining the Runge-Kutta method steps
- *
- * \sa propagateMagneticFieldSimple propagateMagneticField
+ * \param projection If true, apply the projection of B instead of the boundary condition
+ * 
+ * \sa propagateMagneticFieldSimple
  */
-void SysBoundaryMagneticFieldProjection(
+static void propagateSysBoundaryMagneticField(
    FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & perBGrid,
    FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & perBDt2Grid,
    FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
-   cint i,
-   cint j,
-   cint k,
-   SysBoundary& sysBoundaries,
-   cint& RKCase
+   const std::vector<SysBoundaryCellBatch>& batches,
+   creal& dt,
+   cint& RKCase,
+   const bool projection
 ) {
-   if (RKCase == RK_ORDER1 || RKCase == RK_ORDER2_STEP2) {
-      sysBoundaries.getSysBoundary(technicalGrid.get(i,j,k)->sysBoundaryFlag)->fieldSolverBoundaryCondMagneticFieldProjection(perBGrid, technicalGrid, i, j, k);
-   } else {
-      sysBoundaries.getSysBoundary(technicalGrid.get(i,j,k)->sysBoundaryFlag)->fieldSolverBoundaryCondMagneticFieldProjection(perBDt2Grid, technicalGrid, i, j, k);
+   FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & bGrid = (RKCase == RK_ORDER1 || RKCase == RK_ORDER2_STEP2) ? perBGrid : perBDt2Grid;
+   #pragma omp parallel for schedule(dynamic,1)
+   for (size_t b=0; b<batches.size(); b++) {
+      const SysBoundaryCellBatch& batch = batches[b];
+      if (projection) {
+         batch.sbc->fieldSolverBoundaryCondMagneticFieldProjectionBatch(bGrid, technicalGrid, batch.cells.data(), batch.cells.size());
+      } else {
+         batch.sbc->fieldSolverBoundaryCondMagneticFieldBatch(bGrid, technicalGrid, batch.cells.data(), batch.cells.size(), dt, batch.component);
+      }
    }
 }
 
@@ -235,7 +279,7 @@ void SysBoundaryMagneticFieldProjection(
  * \param dt Length of the time step
  * \param RKCase Element in the enum defining the Runge-Kutta method steps
  * 
- * \sa propagateMagneticField propagateSysBoundaryMagneticField
+ * \sa propagateMagneticFieldRow propagateSysBoundaryMagneticField
  */
 void propagateMagneticFieldSimple(
    FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & perBGrid,
@@ -251,19 +295,17 @@ void propagateMagneticFieldSimple(
    //const std::array<int, 3> gridDims = technicalGrid.getLocalSize();
    const int* gridDims = &technicalGrid.getLocalSize()[0];
    const size_t N_cells = gridDims[0]*gridDims[1]*gridDims[2];
+   const FieldSolverBoundaryCells& boundaryCells = sysBoundaries.getFieldSolverBoundaryCells();
    
    phiprof::start("Propagate magnetic field");
    
    timer=phiprof::initializeTimer("Compute cells");
    phiprof::start(timer);
    
-   #pragma omp parallel for collapse(3) schedule(dynamic,1)
+   #pragma omp parallel for collapse(2)
    for (int k=0; k<gridDims[2]; k++) {
       for (int j=0; j<gridDims[1]; j++) {
-         for (int i=0; i<gridDims[0]; i++) {
-            cuint bitfield = technicalGrid.get(i,j,k)->SOLVE;
-            propagateMagneticField(perBGrid, perBDt2Grid, EGrid, EDt2Grid, i, j, k, dt, RKCase, ((bitfield & compute::BX) == compute::BX), ((bitfield & compute::BY) == compute::BY), ((bitfield & compute::BZ) == compute::BZ));
-         }
+         propagateMagneticFieldRow(perBGrid, perBDt2Grid, EGrid, EDt2Grid, technicalGrid, j, k, gridDims[0], dt, RKCase);
       }
    }
    
@@ -289,26 +331,7 @@ void propagateMagneticFieldSimple(
    timer=phiprof::initializeTimer("Compute system boundary cells");
    phiprof::start(timer);
    // L1 pass
-   #pragma omp parallel for collapse(3)
-   for (int k=0; k<gridDims[2]; k++) {
-      for (int j=0; j<gridDims[1]; j++) {
-         for (int i=0; i<gridDims[0]; i++) {
-            cuint bitfield = technicalGrid.get(i,j,k)->SOLVE;
-            // L1 pass
-            if (technicalGrid.get(i,j,k)->sysBoundaryLayer == 1) {
-               if ((bitfield & compute::BX) != compute::BX) {
-                  propagateSysBoundaryMagneticField(perBGrid, perBDt2Grid, EGrid, EDt2Grid, technicalGrid, i, j, k, sysBoundaries, dt, RKCase, 0);
-               }
-               if ((bitfield & compute::BY) != compute::BY) {
-                  propagateSysBoundaryMagneticField(perBGrid, perBDt2Grid, EGrid, EDt2Grid, technicalGrid, i, j, k, sysBoundaries, dt, RKCase, 1);
-               }
-               if ((bitfield & compute::BZ) != compute::BZ) {
-                  propagateSysBoundaryMagneticField(perBGrid, perBDt2Grid, EGrid, EDt2Grid, technicalGrid, i, j, k, sysBoundaries, dt, RKCase, 2);
-               }
-            }
-         }
-      }
-   }
+   propagateSysBoundaryMagneticField(perBGrid, perBDt2Grid, technicalGrid, boundaryCells.magneticFieldL1, dt, RKCase, false);
    phiprof::stop(timer);
    
    timer=phiprof::initializeTimer("MPI","MPI");
@@ -325,38 +348,13 @@ void propagateMagneticFieldSimple(
    timer=phiprof::initializeTimer("Compute system boundary cells");
    phiprof::start(timer);
    // L2 pass
-   #pragma omp parallel for collapse(3)
-   for (int k=0; k<gridDims[2]; k++) {
-      for (int j=0; j<gridDims[1]; j++) {
-         for (int i=0; i<gridDims[0]; i++) {
-            if(technicalGrid.get(i,j,k)->sysBoundaryFlag != sysboundarytype::NOT_SYSBOUNDARY &&
-               technicalGrid.get(i,j,k)->sysBoundaryLayer == 2
-            ) {
-               for (uint component = 0; component < 3; component++) {
-                  propagateSysBoundaryMagneticField(perBGrid, perBDt2Grid, EGrid, EDt2Grid, technicalGrid, i, j, k, sysBoundaries, dt, RKCase, component);
-               }
-            }
-         }
-      }
-   }
+   propagateSysBoundaryMagneticField(perBGrid, perBDt2Grid, technicalGrid, boundaryCells.magneticFieldL2, dt, RKCase, false);
    phiprof::stop(timer,N_cells,"Spatial Cells");
 
    // Projection of magnetic field to normal of boundary, if necessary
    timer=phiprof::initializeTimer("Compute system boundary cells");
    phiprof::start(timer);
-   #pragma omp parallel for collapse(3)
-   for (int k=0; k<gridDims[2]; k++) {
-      for (int j=0; j<gridDims[1]; j++) {
-         for (int i=0; i<gridDims[0]; i++) {
-            if (technicalGrid.get(i,j,k)->sysBoundaryFlag != sysboundarytype::NOT_SYSBOUNDARY &&
-                ((technicalGrid.get(i,j,k)->sysBoundaryLayer == 2) ||
-                 (technicalGrid.get(i,j,k)->sysBoundaryLayer == 1))
-               ) {
-               SysBoundaryMagneticFieldProjection(perBGrid, perBDt2Grid, technicalGrid, i, j, k, sysBoundaries, RKCase);
-            }
-         }
-      }
-   }
+   propagateSysBoundaryMagneticField(perBGrid, perBDt2Grid, technicalGrid, boundaryCells.magneticFieldProjection, dt, RKCase, true);
    phiprof::stop(timer,N_cells,"Spatial Cells");
    
    phiprof::stop("Propagate magnetic field",N_cells,"Spatial Cells");
@@ -0,0 +1,60 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <vector>
+
+#include "globals.h"
+#include "common.h"
+#include "logger.h"
+#include "object_wrapper.h"
+#include "parameters.h"
+
+using namespace std;
+
+Logger logFile, diagnostic;
+dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry> mpiGrid;
+
+int globalflags::bailingOut = 0;
+bool globalflags::writeRestart = 0;
+bool globalflags::balanceLoad = 0;
+bool globalflags::ionosphereJustSolved = false;
+
+ObjectWrapper objectWrapper;
+
+ObjectWrapper& getObjectWrapper() {
+   return objectWrapper;
+}
+
+/** Get local cell IDs. This function creates a cached copy of the
+ * cell ID lists to significantly improve performance. The cell ID
+ * cache is recalculated every time the mesh partitioning changes.
+ * @return Local cell IDs.*/
+const std::vector<CellID>& getLocalCells() {
+   return Parameters::localCells;
+}
+
+void recalculateLocalCellsCache() {
+     {
+        vector<CellID> dummy;
+        dummy.swap(Parameters::localCells);
+     }
+   Parameters::localCells = mpiGrid.get_cells();
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef GLOBALS_H
+#define GLOBALS_H
+
+#include <dccrg.hpp>
+#include <dccrg_cartesian_geometry.hpp>
+#include "spatial_cell.hpp"
+#include "logger.h"
+
+/* Process-wide state shared by the simulator and the benchmarks.
+ *
+ * globals.cpp defines the log files, the global flags, the object wrapper and
+ * the spatial grid behind getLocalCells(), which the solvers expect to exist.
+ * vlasiator.cpp and benchmarks/phasespace_bench.cpp both link it instead of
+ * defining their own copies. Only the executables' main files should include
+ * this header, the solvers get the grid as an argument.
+ */
+
+/*! Log file and diagnostic output of the master rank.*/
+extern Logger logFile, diagnostic;
+
+/*! The spatial grid of this process.*/
+extern dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry> mpiGrid;
+
+#endif
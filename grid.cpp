@@ -27,10 +27,16 @@
 #include <vector>
 #include <sstream>
 #include <ctime>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <map>
+#include <set>
 #ifdef _OPENMP
   #include <omp.h>
 #endif
 #include "grid.h"
+#include "cellcost.h"
 #include "vlasovmover.h"
 #include "definitions.h"
 #include "mpiconversion.h"
@@ -68,8 +74,6 @@ int globalflags::AMRstencilWidth = VLASOV_STENCIL_WIDTH;
 extern Logger logFile, diagnostic;
 
 void initVelocityGridGeometry(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
-void initSpatialCellCoordinates(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
-void initializeStencils(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
 
 void writeVelMesh(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid) {
    const vector<CellID>& cells = getLocalCells();
@@ -478,6 +482,163 @@ void setFaceNeighborRanks( dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    }
 }
 
+/*! Bytes of velocity block data of all populations in a cell, as allocated when it is received.*/
+static double migratedBlockBytes(SpatialCell* cell) {
+   const double bytesPerBlock = WID3 * sizeof(Realf) + BlockParams::N_VELOCITY_BLOCK_PARAMS * sizeof(Real) + sizeof(vmesh::GlobalID);
+   double blocks = 0;
+   for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
+      blocks += cell->get_number_of_velocity_blocks(popID);
+   }
+   return blocks * bytesPerBlock;
+}
+
+/*! Peak of the extra block data held by a rank during a migration done in the given parts.
+ * Received parts accumulate, sent cells are freed after each part.*/
+static double migrationPeakBytes(const vector<double>& incomingPerPart, const vector<double>& outgoingPerPart) {
+   double held = 0.0;
+   double peak = 0.0;
+   for (size_t part=0; part<incomingPerPart.size(); ++part) {
+      peak = max(peak, held + incomingPerPart[part]);
+      held += incomingPerPart[part] - outgoingPerPart[part];
+   }
+   return peak;
+}
+
+/*! Number of load balance transfer parts used when no loadBalance.transferMemoryBudget is given.*/
+static const uint64_t DEFAULT_MIGRATION_PARTS = 5;
+
+/*! Splits the cells migrated by a load balance into transfer parts.
+ *
+ * By default the cells are migrated in DEFAULT_MIGRATION_PARTS parts, which
+ * amounts to a budget of the largest block data received by a rank divided by
+ * that number. If loadBalance.transferMemoryBudget is set, the number of parts
+ * is the smallest with which no rank receives more than the budget of velocity
+ * block data in one part. The block data of a cell is its measured block count
+ * times the size of a received block. Each
+ * receiving rank fills the parts largest cells first, always into the part
+ * with the fewest bytes so far, and tells the sending ranks the part of each
+ * cell. The sizes and senders of the incoming cells are exchanged before that
+ * with a cell parameter transfer. Collective, call between
+ * initialize_balance_load and the data transfers.
+ * \param mpiGrid Spatial grid
+ * \param incoming Cells added to this rank by the load balance
+ * \param outgoing Cells removed from this rank by the load balance
+ * \param incomingParts Transfer part of each incoming cell
+ * \param outgoingParts Transfer part of each outgoing cell
+ * \return Number of transfer parts
+ */
+static uint64_t planMigrationParts(
+   dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+   const vector<CellID>& incoming,
+   const vector<CellID>& outgoing,
+   vector<uint64_t>& incomingParts,
+   vector<uint64_t>& outgoingParts
+) {
+   int myRank, nRanks;
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+   MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+   const double MiB = 1024.0 * 1024.0;
+
+   // Tell the receiving ranks how big the cells are and where they come from
+   for (size_t i=0; i<outgoing.size(); ++i) {
+      SpatialCell* cell = mpiGrid[outgoing[i]];
+      cell->set_mpi_transfer_enabled(true);
+      cell->parameters[CellParams::LBTRANSFERBYTES] = migratedBlockBytes(cell);
+      cell->parameters[CellParams::LBTRANSFERSOURCE] = myRank;
+   }
+   for (size_t i=0; i<incoming.size(); ++i) {
+      mpiGrid[incoming[i]]->set_mpi_transfer_enabled(true);
+   }
+   SpatialCell::set_mpi_transfer_type(Transfer::CELL_PARAMETERS);
+   mpiGrid.continue_balance_load();
+
+   double incomingBytes = 0.0;
+   for (size_t i=0; i<incoming.size(); ++i) {
+      incomingBytes += mpiGrid[incoming[i]]->parameters[CellParams::LBTRANSFERBYTES];
+   }
+   const double local[2] = {incomingBytes, (double)incoming.size()};
+   double maximum[2];
+   MPI_Allreduce(local, maximum, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+   uint64_t nParts = DEFAULT_MIGRATION_PARTS;
+   if (P::loadBalanceTransferBudget > 0.0) {
+      nParts = (uint64_t)ceil(maximum[0] / (P::loadBalanceTransferBudget * MiB));
+      nParts = max((uint64_t)1, min(nParts, (uint64_t)maximum[1]));
+   }
+
+   // Largest cells first into the part with the fewest bytes so far
+   vector<size_t> order(incoming.size());
+   iota(order.begin(), order.end(), 0);
+   sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+      const Real bytesA = mpiGrid[incoming[a]]->parameters[CellParams::LBTRANSFERBYTES];
+      const Real bytesB = mpiGrid[incoming[b]]->parameters[CellParams::LBTRANSFERBYTES];
+      return bytesA > bytesB || (bytesA == bytesB && incoming[a] < incoming[b]);
+   });
+   vector<double> incomingPerPart(nParts, 0.0);
+   incomingParts.assign(incoming.size(), 0);
+   for (size_t i : order) {
+      const uint64_t part = min_element(incomingPerPart.begin(), incomingPerPart.end()) - incomingPerPart.begin();
+      incomingParts[i] = part;
+      incomingPerPart[part] += mpiGrid[incoming[i]]->parameters[CellParams::LBTRANSFERBYTES];
+   }
+
+   // Send the (cell, part) pairs back to the ranks the cells come from
+   vector<int> sendCounts(nRanks, 0);
+   for (size_t i=0; i<incoming.size(); ++i) {
+      sendCounts[(int)mpiGrid[incoming[i]]->parameters[CellParams::LBTRANSFERSOURCE]] += 2;
+   }
+   vector<int> sendDispls(nRanks, 0);
+   for (int rank=1; rank<nRanks; ++rank) {
+      sendDispls[rank] = sendDispls[rank-1] + sendCounts[rank-1];
+   }
+   vector<uint64_t> sendBuffer(2 * incoming.size());
+   vector<int> offsets = sendDispls;
+   for (size_t i=0; i<incoming.size(); ++i) {
+      const int source = (int)mpiGrid[incoming[i]]->parameters[CellParams::LBTRANSFERSOURCE];
+      sendBuffer[offsets[source]++] = incoming[i];
+      sendBuffer[offsets[source]++] = incomingParts[i];
+   }
+   vector<int> recvCounts(nRanks, 0);
+   MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+   vector<int> recvDispls(nRanks, 0);
+   for (int rank=1; rank<nRanks; ++rank) {
+      recvDispls[rank] = recvDispls[rank-1] + recvCounts[rank-1];
+   }
+   vector<uint64_t> recvBuffer(recvDispls[nRanks-1] + recvCounts[nRanks-1]);
+   MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendDispls.data(), MPI_UINT64_T,
+                 recvBuffer.data(), recvCounts.data(), recvDispls.data(), MPI_UINT64_T, MPI_COMM_WORLD);
+   unordered_map<CellID, uint64_t> partOfCell;
+   for (size_t i=0; i<recvBuffer.size(); i+=2) {
+      partOfCell[recvBuffer[i]] = recvBuffer[i+1];
+   }
+   vector<double> outgoingPerPart(nParts, 0.0);
+   outgoingParts.assign(outgoing.size(), 0);
+   for (size_t i=0; i<outgoing.size(); ++i) {
+      outgoingParts[i] = partOfCell.at(outgoing[i]);
+      outgoingPerPart[outgoingParts[i]] += mpiGrid[outgoing[i]]->parameters[CellParams::LBTRANSFERBYTES];
+   }
+
+   // Compare the peak against a single transfer and against the earlier parts by cell ID
+   vector<double> incomingModulo(DEFAULT_MIGRATION_PARTS, 0.0);
+   vector<double> outgoingModulo(DEFAULT_MIGRATION_PARTS, 0.0);
+   for (size_t i=0; i<incoming.size(); ++i) {
+      incomingModulo[incoming[i] % DEFAULT_MIGRATION_PARTS] += mpiGrid[incoming[i]]->parameters[CellParams::LBTRANSFERBYTES];
+   }
+   for (size_t i=0; i<outgoing.size(); ++i) {
+      outgoingModulo[outgoing[i] % DEFAULT_MIGRATION_PARTS] += mpiGrid[outgoing[i]]->parameters[CellParams::LBTRANSFERBYTES];
+   }
+   const double peaks[3] = {
+      migrationPeakBytes(incomingPerPart, outgoingPerPart),
+      incomingBytes,
+      migrationPeakBytes(incomingModulo, outgoingModulo)
+   };
+   double maxPeaks[3];
+   MPI_Allreduce(peaks, maxPeaks, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+   logFile << "(LB): Migrating cells in " << nParts << " parts, peak received block data per rank "
+           << maxPeaks[0] / MiB << " MB (" << maxPeaks[1] / MiB << " MB in one part, "
+           << maxPeaks[2] / MiB << " MB in " << DEFAULT_MIGRATION_PARTS << " parts by cell ID)" << endl << writeVerbose;
+   return nParts;
+}
+
 void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, SysBoundary& sysBoundaries){
    // Invalidate cached cell lists
    Parameters::meshRepartitioned = true;
@@ -491,12 +652,21 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
    deallocateRemoteCellBlocks(mpiGrid);
 
    phiprof::stop("deallocate boundary data");
+   logFsGridCouplingTraffic();
    //set weights based on each cells LB weight counter
    const vector<CellID>& cells = getLocalCells();
+   const bool measuredWeights = cellcost::useMeasuredWeights();
+   if (measuredWeights) {
+      cellcost::logImbalance(mpiGrid, cells, "before balance");
+   }
    for (size_t i=0; i<cells.size(); ++i){
-      //Set weight. If acceleration is enabled then we use the weight
-      //counter which is updated in acceleration, otherwise we just
-      //use the number of blocks.
+      //Set weight. With the measured policy the smoothed solver time of the
+      //cell is used, otherwise the weight counter which is updated in
+      //translation, i.e. the number of blocks.
+      if (measuredWeights) {
+         mpiGrid.set_cell_weight(cells[i], cellcost::getWeight(mpiGrid[cells[i]]));
+         continue;
+      }
 //      if (P::propagateVlasovAcceleration)
       mpiGrid.set_cell_weight(cells[i], mpiGrid[cells[i]]->parameters[CellParams::LBWEIGHTCOUNTER]);
 //      else
@@ -504,8 +674,14 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
       //reset counter
       //mpiGrid[cells[i]]->parameters[CellParams::LBWEIGHTCOUNTER] = 0.0;
    }
+   // With co-location every cell goes to the rank owning the same region of the fsgrid, Zoltan is not used
+   if (P::loadBalanceCoLocateFsGrid) {
+      for (size_t i=0; i<cells.size(); ++i) {
+         mpiGrid.pin(cells[i], getFsGridOwner(mpiGrid, cells[i]));
+      }
+   }
    phiprof::start("dccrg.initialize_balance_load");
-   mpiGrid.initialize_balance_load(true);
+   mpiGrid.initialize_balance_load(!P::loadBalanceCoLocateFsGrid);
    phiprof::stop("dccrg.initialize_balance_load");
 
    const std::unordered_set<CellID>& incoming_cells = mpiGrid.get_cells_added_by_balance_load();
@@ -515,14 +691,19 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
    std::vector<CellID> outgoing_cells_list (outgoing_cells.begin(),outgoing_cells.end());
 
    /*transfer cells in parts to preserve memory*/
+   phiprof::start("Plan data transfers");
+   std::vector<uint64_t> incoming_parts;
+   std::vector<uint64_t> outgoing_parts;
+   const uint64_t num_part_transfers = planMigrationParts(mpiGrid, incoming_cells_list, outgoing_cells_list, incoming_parts, outgoing_parts);
+   phiprof::stop("Plan data transfers");
+
    phiprof::start("Data transfers");
-   const uint64_t num_part_transfers=5;
    for (uint64_t transfer_part=0; transfer_part<num_part_transfers; transfer_part++) {
       //Set transfers on/off for the incoming cells in this transfer set and prepare for receive
       for (unsigned int i=0;i<incoming_cells_list.size();i++){
          CellID cell_id=incoming_cells_list[i];
          SpatialCell* cell = mpiGrid[cell_id];
-         if (cell_id%num_part_transfers!=transfer_part) {
+         if (incoming_parts[i]!=transfer_part) {
             cell->set_mpi_transfer_enabled(false);
          } else {
             cell->set_mpi_transfer_enabled(true);
@@ -533,7 +714,7 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
       for (unsigned int i=0; i<outgoing_cells_list.size(); i++) {
          CellID cell_id=outgoing_cells_list[i];
          SpatialCell* cell = mpiGrid[cell_id];
-         if (cell_id%num_part_transfers!=transfer_part) {
+         if (outgoing_parts[i]!=transfer_part) {
             cell->set_mpi_transfer_enabled(false);
          } else {
             cell->set_mpi_transfer_enabled(true);
@@ -554,7 +735,7 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
          for (unsigned int i=0; i<incoming_cells_list.size(); i++) {
             CellID cell_id=incoming_cells_list[i];
             SpatialCell* cell = mpiGrid[cell_id];
-            if (cell_id % num_part_transfers == transfer_part) {
+            if (incoming_parts[i] == transfer_part) {
                receives++;
                phiprof::start("Preparing receives");
                // reserve space for velocity block data in arriving remote cells
@@ -583,7 +764,7 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
             // Free memory of this cell as it has already been transferred,
             // it will not be used anymore. NOTE: Only clears memory allocated
             // to the active population.
-            if (cell_id % num_part_transfers == transfer_part) cell->clear(p);
+            if (outgoing_parts[i] == transfer_part) cell->clear(p);
          }
       } // for-loop over populations
    } // for-loop over transfer parts
@@ -593,9 +774,15 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
    phiprof::start("dccrg.finish_balance_load");
    mpiGrid.finish_balance_load();
    phiprof::stop("dccrg.finish_balance_load");
+   if (P::loadBalanceCoLocateFsGrid) {
+      mpiGrid.unpin_all_cells();
+   }
 
    //Make sure transfers are enabled for all cells
    recalculateLocalCellsCache();
+   if (measuredWeights) {
+      cellcost::logImbalance(mpiGrid, cells, "after balance");
+   }
    #pragma omp parallel for
    for (uint i=0; i<cells.size(); ++i) {
       mpiGrid[cells[i]]->set_mpi_transfer_enabled(true);
@@ -813,6 +1000,213 @@ bool adjustVelocityBlocks(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& m
    return true;
 }
 
+/*! Processes owning cells in the nearest neighbourhood of local cells, or having local cells
+ * in the nearest neighbourhood of theirs. The relation is symmetric, also at refinement interfaces.
+ * \param mpiGrid Spatial grid
+ */
+vector<int> getNearestNeighborProcesses(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid) {
+   std::set<int> processes;
+   for (const CellID cellID : mpiGrid.get_remote_cells_on_process_boundary(NEAREST_NEIGHBORHOOD_ID)) {
+      processes.insert(mpiGrid.get_process(cellID));
+   }
+   for (const CellID cellID : mpiGrid.get_local_cells_on_process_boundary(NEAREST_NEIGHBORHOOD_ID)) {
+      for (const auto& nbrPair : *mpiGrid.get_neighbors_to(cellID, NEAREST_NEIGHBORHOOD_ID)) {
+         if (nbrPair.first != INVALID_CELLID && !mpiGrid.is_local(nbrPair.first)) {
+            processes.insert(mpiGrid.get_process(nbrPair.first));
+         }
+      }
+   }
+   return vector<int>(processes.begin(), processes.end());
+}
+
+bool adjustVelocityBlocksLocally(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+                                 const vector<CellID>& cellsToAdjust,
+                                 const vector<int>& exchangeProcesses,
+                                 const uint popID) {
+   if (cellsToAdjust.size() == 0 && exchangeProcesses.size() == 0) {
+      return true;
+   }
+   phiprof::initializeTimer("re-adjust blocks locally","Block adjustment");
+   phiprof::start("re-adjust blocks locally");
+   SpatialCell::setCommunicatedSpecies(popID);
+   const int contentListTag = 0x5AC1;
+
+   // Local boundary cells in the nearest neighbourhood of cells of each of the given processes
+   phiprof::start("Collect neighbourhood");
+   const std::set<int> processes(exchangeProcesses.begin(), exchangeProcesses.end());
+   std::map<int, vector<CellID>> sendCells;
+   for (const int process : processes) {
+      sendCells[process];
+   }
+   if (processes.size() > 0) {
+      for (const CellID cellID : mpiGrid.get_local_cells_on_process_boundary(NEAREST_NEIGHBORHOOD_ID)) {
+         std::set<int> targets;
+         for (const auto* neighbors : {mpiGrid.get_neighbors_of(cellID, NEAREST_NEIGHBORHOOD_ID),
+                                       mpiGrid.get_neighbors_to(cellID, NEAREST_NEIGHBORHOOD_ID)}) {
+            for (const auto& nbrPair : *neighbors) {
+               if (nbrPair.first == INVALID_CELLID || mpiGrid.is_local(nbrPair.first)) continue;
+               const int process = mpiGrid.get_process(nbrPair.first);
+               if (processes.count(process) > 0) targets.insert(process);
+            }
+         }
+         for (const int process : targets) sendCells[process].push_back(cellID);
+      }
+   }
+
+   // Content lists are needed for the adjusted cells, their local neighbours and the sent cells
+   vector<CellID> contentCells(cellsToAdjust.begin(), cellsToAdjust.end());
+   for (const CellID cellID : cellsToAdjust) {
+      for (const auto& nbrPair : *mpiGrid.get_neighbors_of(cellID, NEAREST_NEIGHBORHOOD_ID)) {
+         if (nbrPair.first != INVALID_CELLID && mpiGrid.is_local(nbrPair.first)) {
+            contentCells.push_back(nbrPair.first);
+         }
+      }
+   }
+   for (const auto& list : sendCells) {
+      contentCells.insert(contentCells.end(), list.second.begin(), list.second.end());
+   }
+   std::sort(contentCells.begin(), contentCells.end());
+   contentCells.erase(std::unique(contentCells.begin(), contentCells.end()), contentCells.end());
+   phiprof::stop("Collect neighbourhood");
+
+   phiprof::start("Compute with_content_list");
+   #pragma omp parallel for schedule(dynamic,1)
+   for (size_t i=0; i<contentCells.size(); ++i) {
+      SpatialCell* cell = mpiGrid[contentCells[i]];
+#ifdef USE_GPU
+      cell->gpu_attachToStream();
+#endif
+      cell->updateSparseMinValue(popID);
+      cell->update_velocity_block_content_lists(popID);
+#ifdef USE_GPU
+      cell->gpu_detachFromStream();
+#endif
+   }
+   phiprof::stop("Compute with_content_list");
+
+   // One message per process: cell count, (cell ID, list size) pairs, then the lists themselves
+   phiprof::initializeTimer("Transfer with_content_list locally","MPI");
+   phiprof::start("Transfer with_content_list locally");
+   std::map<int, vector<uint64_t>> sendBuffers;
+   vector<MPI_Request> sendRequests;
+   sendRequests.reserve(processes.size());
+   for (const auto& list : sendCells) {
+      vector<uint64_t>& buffer = sendBuffers[list.first];
+      buffer.push_back(list.second.size());
+      for (const CellID cellID : list.second) {
+         buffer.push_back(cellID);
+         buffer.push_back(mpiGrid[cellID]->velocity_block_with_content_list->size());
+      }
+      for (const CellID cellID : list.second) {
+         const SpatialCell* cell = mpiGrid[cellID];
+         buffer.insert(buffer.end(), cell->velocity_block_with_content_list->begin(), cell->velocity_block_with_content_list->end());
+      }
+      sendRequests.push_back(MPI_REQUEST_NULL);
+      MPI_Isend(buffer.data(), buffer.size(), MPI_UINT64_T,
+                list.first, contentListTag, MPI_COMM_WORLD, &(sendRequests.back()));
+   }
+   vector<CellID> receivedCells;
+   for (const int process : processes) {
+      MPI_Status status;
+      int count;
+      MPI_Probe(process, contentListTag, MPI_COMM_WORLD, &status);
+      MPI_Get_count(&status, MPI_UINT64_T, &count);
+      vector<uint64_t> buffer(count);
+      MPI_Recv(buffer.data(), count, MPI_UINT64_T, process, contentListTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+      const size_t nCells = buffer[0];
+      size_t offset = 1 + 2*nCells;
+      for (size_t c=0; c<nCells; ++c) {
+         const CellID cellID = buffer[1 + 2*c];
+         const size_t listSize = buffer[2 + 2*c];
+         SpatialCell* cell = mpiGrid[cellID];
+         if (cell != NULL) {
+            cell->velocity_block_with_content_list_size = listSize;
+            cell->velocity_block_with_content_list->resize(listSize);
+            for (size_t b=0; b<listSize; ++b) {
+               (*cell->velocity_block_with_content_list)[b] = buffer[offset + b];
+            }
+            receivedCells.push_back(cellID);
+         }
+         offset += listSize;
+      }
+   }
+   MPI_Waitall(sendRequests.size(), sendRequests.data(), MPI_STATUSES_IGNORE);
+   phiprof::stop("Transfer with_content_list locally");
+
+#ifdef USE_GPU
+   #pragma omp parallel
+   {
+      #pragma omp for
+      for (size_t i=0; i<cellsToAdjust.size(); ++i) {
+         mpiGrid[cellsToAdjust[i]]->gpu_uploadContentLists();
+      }
+      #pragma omp for schedule(dynamic,1)
+      for (size_t i=0; i<receivedCells.size(); ++i) {
+         mpiGrid[receivedCells[i]]->gpu_uploadContentLists();
+      }
+   }
+#endif
+
+   phiprof::start("Adjusting blocks");
+   #pragma omp parallel for schedule(dynamic,1)
+   for (size_t i=0; i<cellsToAdjust.size(); ++i) {
+      const CellID cell_id = cellsToAdjust[i];
+      SpatialCell* cell = mpiGrid[cell_id];
+      const auto* neighbors = mpiGrid.get_neighbors_of(cell_id, NEAREST_NEIGHBORHOOD_ID);
+      vector<SpatialCell*> neighbor_ptrs;
+      neighbor_ptrs.reserve(neighbors->size());
+      for (const auto& nbrPair : *neighbors) {
+         if (nbrPair.first == 0 || nbrPair.first == cell_id) {
+            continue;
+         }
+         neighbor_ptrs.push_back(mpiGrid[nbrPair.first]);
+      }
+#ifdef USE_GPU
+      cell->gpu_attachToStream();
+#endif
+      Real density_pre_adjust=0.0;
+      Real density_post_adjust=0.0;
+      if (getObjectWrapper().particleSpecies[popID].sparse_conserve_mass) {
+         for (size_t j=0; j<cell->get_number_of_velocity_blocks(popID)*WID3; ++j) {
+            density_pre_adjust += cell->get_data(popID)[j];
+         }
+      }
+      cell->adjust_velocity_blocks(neighbor_ptrs,popID);
+      if (getObjectWrapper().particleSpecies[popID].sparse_conserve_mass) {
+         for (size_t j=0; j<cell->get_number_of_velocity_blocks(popID)*WID3; ++j) {
+            density_post_adjust += cell->get_data(popID)[j];
+         }
+         if (density_post_adjust != 0.0) {
+            for (size_t j=0; j<cell->get_number_of_velocity_blocks(popID)*WID3; ++j) {
+               cell->get_data(popID)[j] *= density_pre_adjust/density_post_adjust;
+            }
+         }
+      }
+#ifdef USE_GPU
+      cell->gpu_detachFromStream();
+#endif
+   }
+   phiprof::stop("Adjusting blocks");
+
+#ifdef USE_GPU
+   #pragma omp parallel
+   {
+      #pragma omp for
+      for (size_t i=0; i<cellsToAdjust.size(); ++i) {
+         mpiGrid[cellsToAdjust[i]]->gpu_clearContentLists();
+      }
+      #pragma omp for
+      for (size_t i=0; i<receivedCells.size(); ++i) {
+         mpiGrid[receivedCells[i]]->gpu_clearContentLists();
+      }
+   }
+#endif
+
+   phiprof::stop("re-adjust blocks locally");
+   return true;
+}
+
 /*! Shrink to fit velocity space data to save memory.
  * \param mpiGrid Spatial grid
  */
@@ -912,19 +1306,42 @@ void updateRemoteVelocityBlockLists(
    const uint popID,
    const uint neighborhood/*=DIST_FUNC_NEIGHBORHOOD_ID default*/
 )
+{
+   startRemoteVelocityBlockListUpdate(mpiGrid, popID, neighborhood);
+   finishRemoteVelocityBlockListUpdate(mpiGrid, popID, neighborhood);
+}
+
+void startRemoteVelocityBlockListUpdate(
+   dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+   const uint popID,
+   const uint neighborhood/*=DIST_FUNC_NEIGHBORHOOD_ID default*/
+)
 {
    SpatialCell::setCommunicatedSpecies(popID);
 
    // update velocity block lists For small velocity spaces it is
    // faster to do it in one operation, and not by first sending size,
-   // then list. For large we do it in two steps
+   // then list. For large we do it in two steps. The sizes are
+   // exchanged here, the lists are left in flight.
    phiprof::initializeTimer("Velocity block list update","MPI");
    phiprof::start("Velocity block list update");
    SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_LIST_STAGE1);
    mpiGrid.update_copies_of_remote_neighbors(neighborhood);
    SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_LIST_STAGE2);
-   mpiGrid.update_copies_of_remote_neighbors(neighborhood);
+   mpiGrid.start_remote_neighbor_copy_updates(neighborhood);
    phiprof::stop("Velocity block list update");
+}
+
+void finishRemoteVelocityBlockListUpdate(
+   dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+   const uint popID,
+   const uint neighborhood/*=DIST_FUNC_NEIGHBORHOOD_ID default*/
+)
+{
+   phiprof::initializeTimer("Velocity block list wait","MPI","Wait");
+   phiprof::start("Velocity block list wait");
+   mpiGrid.wait_remote_neighbor_copy_updates(neighborhood);
+   phiprof::stop("Velocity block list wait");
 
    // Prepare spatial cells for receiving velocity block data
    phiprof::start("Preparing receives");
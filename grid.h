@@ -49,6 +49,16 @@ void initializeGrids(
    Project& project
 );
 
+/*!
+  \brief Set the coordinates, lengths and refinement levels of all local spatial cells from the DCCRG geometry
+*/
+void initSpatialCellCoordinates(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
+
+/*!
+  \brief Register the reduced DCCRG neighborhoods used by the field and Vlasov solvers
+*/
+void initializeStencils(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
+
 /*!
   \brief Balance load
 
@@ -70,6 +80,24 @@ void updateRemoteVelocityBlockLists(
    const uint neighborhood=DIST_FUNC_NEIGHBORHOOD_ID
 );
 
+/*! Split version of updateRemoteVelocityBlockLists. The start exchanges the list sizes and
+leaves the lists themselves in flight, the finish waits for them and prepares the remote cells
+to receive velocity block data. Population popID of the remote cells in the neighborhood must
+not be touched in between, and no other transfer may be started in the same neighborhood.
+
+\param mpiGrid   The DCCRG grid with spatial cells
+*/
+void startRemoteVelocityBlockListUpdate(
+   dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+   const uint popID,
+   const uint neighborhood=DIST_FUNC_NEIGHBORHOOD_ID
+);
+void finishRemoteVelocityBlockListUpdate(
+   dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+   const uint popID,
+   const uint neighborhood=DIST_FUNC_NEIGHBORHOOD_ID
+);
+
 /*! Deallocates all blocks in remote cells in order to save
  *  memory. 
  * \param mpiGrid Spatial grid
@@ -95,6 +123,28 @@ bool adjustVelocityBlocks(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& m
                           bool doPrepareToReceiveBlocks,
                             const uint popID);
 
+/*! Processes owning cells in the nearest neighbourhood of local cells, or owning cells whose
+ * nearest neighbourhood contains local cells. Sorted, and symmetric between processes.
+ * \param mpiGrid Spatial grid
+ */
+std::vector<int> getNearestNeighborProcesses(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
+
+/*! Neighbourhood-local variant of adjustVelocityBlocks for use between acceleration subcycles.
+
+ Content lists are only computed for cellsToAdjust, their local nearest neighbours and the
+ boundary cells neighbouring exchangeProcesses, and are only exchanged point-to-point with
+ exchangeProcesses. Remote cells are not prepared to receive blocks, so the final adjust of a
+ time step still has to be done with adjustVelocityBlocks.
+
+ \param mpiGrid  Parallel grid with spatial cells
+ \param cellsToAdjust  List of local cells whose blocks are added or removed.
+ \param exchangeProcesses  Processes to exchange content lists with. Has to be symmetric, that is process A lists B iff B lists A.
+*/
+bool adjustVelocityBlocksLocally(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+                                 const std::vector<CellID>& cellsToAdjust,
+                                 const std::vector<int>& exchangeProcesses,
+                                 const uint popID);
+
 /*! Estimates memory consumption and writes it into logfile. Collective operation on MPI_COMM_WORLD
  * \param mpiGrid Spatial grid
  */
@@ -27,6 +27,7 @@
 #include <limits>
 #include "logger.h"
 #include "memoryallocation.h"
+#include "velocity_block_pool.h"
 #include "common.h"
 #include "parameters.h"
 #ifdef PAPI_MEM
@@ -180,6 +181,34 @@ void report_process_memory_consumption(double extra_bytes){
    
 #endif
 
+#ifdef VELOCITY_BLOCK_POOL
+   /*Report velocity block pool statistics. Utilization is the fraction of the
+     pooled buffers actually requested by the block containers (the rest is
+     size class rounding), cached is the free memory held for reuse and the
+     reuse ratio the fraction of allocations served without going to the heap.*/
+   {
+      const block_pool::Statistics stats = block_pool::getStatistics();
+      double pool[5] = {};
+      double sum_pool[5];
+      double min_pool[5];
+      double max_pool[5];
+      pool[0] = stats.bytesInUse;
+      pool[1] = stats.bytesCached;
+      pool[2] = stats.bytesHighWaterMark;
+      pool[3] = stats.bytesInUse > 0 ? (double)stats.bytesRequested / stats.bytesInUse : 1.0;
+      pool[4] = stats.allocations > 0 ? (double)stats.poolHits / stats.allocations : 0.0;
+      MPI_Reduce(pool, sum_pool, 5, MPI_DOUBLE, MPI_SUM, MASTER_RANK, MPI_COMM_WORLD);
+      MPI_Reduce(pool, min_pool, 5, MPI_DOUBLE, MPI_MIN, MASTER_RANK, MPI_COMM_WORLD);
+      MPI_Reduce(pool, max_pool, 5, MPI_DOUBLE, MPI_MAX, MASTER_RANK, MPI_COMM_WORLD);
+      if(rank == MASTER_RANK) {
+         logFile << "(MEM) Block pool in use per process (GiB) avg: " << sum_pool[0]/nProcs/GiB << " min: " << min_pool[0]/GiB << " max: " << max_pool[0]/GiB << endl;
+         logFile << "(MEM) Block pool cached per process (GiB) avg: " << sum_pool[1]/nProcs/GiB << " min: " << min_pool[1]/GiB << " max: " << max_pool[1]/GiB << endl;
+         logFile << "(MEM) Block pool high water mark per process (GiB) avg: " << sum_pool[2]/nProcs/GiB << " min: " << min_pool[2]/GiB << " max: " << max_pool[2]/GiB << endl;
+         logFile << "(MEM) Block pool utilization (avg, min, max): " << sum_pool[3]/nProcs << " " << min_pool[3] << " " << max_pool[3] << endl;
+         logFile << "(MEM) Block pool reuse ratio (avg, min, max): " << sum_pool[4]/nProcs << " " << min_pool[4] << " " << max_pool[4] << endl;
+      }
+   }
+#endif
 
    /*
    // Report /proc/meminfo memory consumption.      
@@ -132,6 +132,17 @@ bool ObjectWrapper::getPopulationParameters() {
       RP::get(pop + "_sparse.dynamicMinValue1", species.sparseDynamicMinValue1);
       RP::get(pop + "_sparse.dynamicMinValue2", species.sparseDynamicMinValue2);
 
+      // The fused moments are taken before the block adjustment, which rescales the
+      // distribution function when conserving mass, so they would be off by that factor.
+      if (species.sparse_conserve_mass && P::vlasovFusedMoments) {
+         int myRank;
+         MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+         if(myRank==MASTER_RANK) {
+            std::cerr<<" Warning: "<<pop<<"_sparse.conserve_mass is set, disabling vlasovsolver.fusedMoments."<<std::endl;
+         }
+         P::vlasovFusedMoments = false;
+      }
+
 
       // Particle velocity space properties
       RP::get(pop + "_vspace.vx_min",vMesh.meshLimits[0]);
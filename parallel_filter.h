@@ -0,0 +1,97 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PARALLEL_FILTER_H
+#define PARALLEL_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#ifdef _OPENMP
+   #include <omp.h>
+#endif
+
+/** Order-preserving parallel compaction. Appends value(i) to output for each
+ * i in [0, n) for which keep(i) is true, in ascending order of i. Each thread
+ * tests a contiguous chunk of the index range, the per-chunk counts are turned
+ * into output offsets with a prefix sum, and each thread then writes its own
+ * range of the output. Unlike lists built with push_back in an omp critical
+ * section, the result does not depend on the number of threads or on scheduling.
+ * keep is called exactly once for each index and value once for each kept index,
+ * both concurrently from several threads. Inside a parallel region this runs on
+ * the calling thread.
+ * @param n Number of indices to test.
+ * @param keep Predicate taking an index.
+ * @param value Element to store for a kept index.
+ * @param output Compacted elements, previous contents are replaced.*/
+template<typename T, typename Predicate, typename Generator>
+void parallelCompact(const size_t n, Predicate keep, Generator value, std::vector<T>& output) {
+   std::vector<size_t> offsets;
+   #pragma omp parallel
+   {
+      size_t nThreads = 1;
+      size_t thread = 0;
+#ifdef _OPENMP
+      nThreads = omp_get_num_threads();
+      thread = omp_get_thread_num();
+#endif
+      #pragma omp single
+      offsets.assign(nThreads + 1, 0);
+
+      const size_t begin = n * thread / nThreads;
+      const size_t end = n * (thread + 1) / nThreads;
+      std::vector<uint8_t> kept(end - begin);
+      size_t count = 0;
+      for (size_t i = begin; i < end; ++i) {
+         kept[i - begin] = keep(i) ? 1 : 0;
+         count += kept[i - begin];
+      }
+      offsets[thread + 1] = count;
+
+      #pragma omp barrier
+      #pragma omp single
+      {
+         for (size_t t = 0; t < nThreads; ++t) {
+            offsets[t + 1] += offsets[t];
+         }
+         output.resize(offsets[nThreads]);
+      }
+
+      size_t o = offsets[thread];
+      for (size_t i = begin; i < end; ++i) {
+         if (kept[i - begin]) {
+            output[o++] = value(i);
+         }
+      }
+   }
+}
+
+/** Order-preserving parallel filter, see parallelCompact.
+ * @param input Elements to filter, must not be the same vector as output.
+ * @param keep Predicate taking the index of an element in input.
+ * @param output Elements of input for which keep is true, previous contents are replaced.*/
+template<typename T, typename Predicate>
+void parallelFilter(const std::vector<T>& input, Predicate keep, std::vector<T>& output) {
+   parallelCompact(input.size(), keep, [&input](const size_t i) { return input[i]; }, output);
+}
+
+#endif
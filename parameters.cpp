@@ -107,6 +107,12 @@ uint64_t P::vlsvBufferSize = 0;
 int P::restartStripeFactor = 0;
 int P::systemStripeFactor = 0;
 string P::restartWritePath = string("");
+string P::bgbCachePath = string("");
+uint P::metricsInterval = 0;
+string P::metricsFile = string("");
+uint P::traceBufferSize = 0;
+uint P::traceInterval = 0;
+string P::traceFilePrefix = string("");
 
 uint P::transmit = 0;
 
@@ -122,6 +128,8 @@ uint P::maxFieldSolverSubcycles = 0.0;
 int P::maxSlAccelerationSubcycles = 0.0;
 Real P::resistivity = NAN;
 bool P::fieldSolverDiffusiveEterms = true;
+bool P::fieldSolverSoAKernels = false;
+bool P::fastBackgroundAverages = false;
 uint P::ohmHallTerm = 0;
 uint P::ohmGradPeTerm = 0;
 Real P::electronTemperature = 0.0;
@@ -135,6 +143,15 @@ int P::writeRestartAsFloat = false;
 string P::loadBalanceAlgorithm = string("");
 std::map<std::string, std::string> P::loadBalanceOptions;
 uint P::rebalanceInterval = numeric_limits<uint>::max();
+string P::loadBalanceWeightPolicy = string("blocks");
+uint P::loadBalanceCostSampleInterval = 5;
+Real P::loadBalanceCostSmoothing = 0.3;
+string P::loadBalanceTrigger = string("interval");
+uint P::loadBalanceHorizon = 100;
+uint P::loadBalanceMinInterval = 10;
+uint P::loadBalanceMaxInterval = 0;
+Real P::loadBalanceTransferBudget = 0.0;
+bool P::loadBalanceCoLocateFsGrid = false;
 
 vector<string> P::outputVariableList;
 vector<string> P::diagnosticVariableList;
@@ -142,6 +159,8 @@ vector<string> P::diagnosticVariableList;
 string P::projectName = string("");
 
 bool P::vlasovAccelerateMaxwellianBoundaries = false;
+bool P::vlasovPipelineAcceleration = false;
+bool P::vlasovFusedMoments = false;
 Real P::maxSlAccelerationRotation = 10.0;
 Real P::hallMinimumRhom = physicalconstants::MASS_PROTON;
 Real P::hallMinimumRhoq = physicalconstants::CHARGE;
@@ -149,6 +168,7 @@ Real P::hallMinimumRhoq = physicalconstants::CHARGE;
 bool P::bailout_write_restart = false;
 Real P::bailout_min_dt = NAN;
 Real P::bailout_max_memory = 1073741824.;
+Real P::blockPoolMaxCached = 1.0;
 uint P::bailout_velocity_space_wall_margin = 0;
 
 uint P::vamrMaxVelocityRefLevel = 0;
@@ -245,6 +265,24 @@ bool P::addParameters() {
            "Path to the location where restart files should be written. Defaults to the local directory, also if the "
            "specified destination is not writeable.",
            string("./"));
+   RP::add("io.bgb_cache_path",
+           "Directory where the computed background magnetic field is cached between runs, keyed by the field "
+           "parameters and the grid geometry. Empty (default) disables the cache.",
+           string(""));
+   RP::add("io.metrics_interval",
+           "Write solver performance metrics of every arg:th time step as one JSON line to io.metrics_file. "
+           "0 (default) disables the metrics.",
+           0);
+   RP::add("io.metrics_file", "File the performance metrics are appended to.", string("metrics.jsonl"));
+   RP::add("io.trace_buffer_size",
+           "Number of solver phase events each rank keeps for the timeline trace. The oldest events are overwritten "
+           "when the buffer is full. 0 (default) disables tracing.",
+           0);
+   RP::add("io.trace_interval",
+           "Write the timeline trace of every arg:th time step, and a summary of the ranks that made the others wait "
+           "at barriers, to io.trace_file_prefix_<tstep>.json.",
+           100);
+   RP::add("io.trace_file_prefix", "Prefix of the timeline trace files, in Chrome trace event format.", string("trace"));
 
    RP::add("propagate_field", "Propagate magnetic field during the simulation", true);
    RP::add("propagate_vlasov_acceleration",
@@ -295,6 +333,14 @@ bool P::addParameters() {
    RP::add("fieldsolver.maxSubcycles", "Maximum allowed field solver subcycles", 1);
    RP::add("fieldsolver.resistivity", "Resistivity for the eta*J term in Ohm's law.", 0.0);
    RP::add("fieldsolver.diffusiveEterms", "Enable diffusive terms in the computation of E", true);
+   RP::add("fieldsolver.soaKernels",
+           "Compute the field derivatives with the structure-of-arrays SIMD kernels instead of the per-cell functions",
+           false);
+   RP::add("fieldsolver.fastBackgroundAverages",
+           "Average the analytic background fields in closed form or with Gauss-Legendre quadrature where this is "
+           "accurate, and with Romberg integration only near singularities. Checked against Romberg by "
+           "backgroundfield/tests/averages_test.",
+           false);
    RP::add(
        "fieldsolver.ohmHallTerm",
        "Enable/choose spatial order of the Hall term in Ohm's law. 0: off, 1: 1st spatial order, 2: 2nd spatial order",
@@ -331,11 +377,38 @@ bool P::addParameters() {
    RP::add("vlasovsolver.accelerateMaxwellianBoundaries",
            "Propagate maxwellian boundary cell contents in velocity space. Default false.",
            false);
+   RP::add("vlasovsolver.pipelineAcceleration",
+           "Overlap the velocity block list exchange of one particle population with the acceleration of the next one. "
+           "Results are identical to the sequential order. Default false.",
+           false);
+   RP::add("vlasovsolver.fusedMoments",
+           "Accumulate the _V velocity moments in the last mapping sweep of the acceleration instead of a separate pass "
+           "over the distribution function. Moments then include the sub-threshold content of blocks removed by the "
+           "following block adjustment. Not used with <population>_sparse.conserve_mass. Default false.",
+           false);
 
    // Load balancing parameters
    RP::add("loadBalance.algorithm", "Load balancing algorithm to be used", string("RCB"));
    RP::add("loadBalance.tolerance", "Load imbalance tolerance", string("1.05"));
    RP::add("loadBalance.rebalanceInterval", "Load rebalance interval (steps)", 10);
+   RP::add("loadBalance.weightPolicy",
+           "Cell weights for load balancing: 'blocks' (velocity block count) or 'measured' (sampled solver time per cell)",
+           string("blocks"));
+   RP::add("loadBalance.costSampleInterval", "Interval (steps) at which cell costs are measured for the 'measured' weight policy", 5);
+   RP::add("loadBalance.costSmoothing", "Weight of a new cost sample in the exponential smoothing of measured cell costs (0..1]", 0.3);
+   RP::add("loadBalance.trigger",
+           "When to rebalance: 'interval' (every rebalanceInterval steps) or 'imbalance' (when the time predicted to be lost to imbalance over loadBalance.horizon steps exceeds the cost of the last rebalance)",
+           string("interval"));
+   RP::add("loadBalance.horizon", "Number of steps over which the gain of a rebalance is predicted for the 'imbalance' trigger", 100);
+   RP::add("loadBalance.minInterval", "Minimum number of steps between rebalances for the 'imbalance' trigger", 10);
+   RP::add("loadBalance.maxInterval", "Maximum number of steps between rebalances for the 'imbalance' trigger, 0 for no limit", 0);
+   RP::add("loadBalance.transferMemoryBudget",
+           "Velocity block data (MB) a rank may receive in one part of the load balance cell migration, sets the number of parts. "
+           "0 migrates in 5 parts of equal block data.",
+           0.0);
+   RP::add("loadBalance.coLocateFsGrid",
+           "Partition dccrg into the boxes of the fsgrid decomposition instead of balancing the Vlasov load, so that dccrg <=> fsgrid coupling stays on each rank",
+           false);
 
    RP::addComposing("loadBalance.optionKey", "Zoltan option key. Has to be matched by loadBalance.optionValue.");
    RP::addComposing("loadBalance.optionValue", "Zoltan option value. Has to be matched by loadBalance.optionKey.");
@@ -418,6 +491,9 @@ bool P::addParameters() {
            1073741824.);
    RP::add("bailout.velocity_space_wall_block_margin", "Distance from the velocity space limits in blocks, if the distribution function reaches that distance from the wall we bail out to avoid hitting the wall.", 1);
 
+   // velocity block memory pool
+   RP::add("memory.block_pool_max_cached", "Maximum amount of freed velocity block memory (in GiB) kept per process for reuse by other cells. Only used if compiled with VELOCITY_BLOCK_POOL.", 1.0);
+
    // Velocity Refinement parameters
    RP::add("VAMR.vel_refinement_criterion", "Name of the velocity refinement criterion", string(""));
    RP::add("VAMR.max_velocity_level", "Maximum velocity mesh refinement level", (uint)0);
@@ -486,6 +562,12 @@ void Parameters::getParameters() {
    RP::get("io.write_system_stripe_factor", P::systemStripeFactor);
    RP::get("io.restart_write_path", P::restartWritePath);
    RP::get("io.write_as_float", P::writeAsFloat);
+   RP::get("io.bgb_cache_path", P::bgbCachePath);
+   RP::get("io.metrics_interval", P::metricsInterval);
+   RP::get("io.metrics_file", P::metricsFile);
+   RP::get("io.trace_buffer_size", P::traceBufferSize);
+   RP::get("io.trace_interval", P::traceInterval);
+   RP::get("io.trace_file_prefix", P::traceFilePrefix);
 
    // Checks for validity of io and restart parameters
    int myRank;
@@ -498,6 +580,13 @@ void Parameters::getParameters() {
       }
       P::restartWritePath = prefix;
    }
+   if (P::bgbCachePath.size() > 0 && access(P::bgbCachePath.c_str(), W_OK) != 0) {
+      if (myRank == MASTER_RANK) {
+         cerr << "ERROR background field cache path " << P::bgbCachePath << " not writeable, disabling the cache."
+              << endl;
+      }
+      P::bgbCachePath = string("");
+   }
    size_t maxSize = 0;
    maxSize = max(maxSize, P::systemWriteTimeInterval.size());
    maxSize = max(maxSize, P::systemWriteName.size());
@@ -778,6 +867,8 @@ void Parameters::getParameters() {
    RP::get("fieldsolver.maxSubcycles", P::maxFieldSolverSubcycles);
    RP::get("fieldsolver.resistivity", P::resistivity);
    RP::get("fieldsolver.diffusiveEterms", P::fieldSolverDiffusiveEterms);
+   RP::get("fieldsolver.soaKernels", P::fieldSolverSoAKernels);
+   RP::get("fieldsolver.fastBackgroundAverages", P::fastBackgroundAverages);
    RP::get("fieldsolver.ohmHallTerm", P::ohmHallTerm);
    RP::get("fieldsolver.ohmGradPeTerm", P::ohmGradPeTerm);
    RP::get("fieldsolver.electronTemperature", P::electronTemperature);
@@ -791,12 +882,35 @@ void Parameters::getParameters() {
    RP::get("vlasovsolver.maxCFL", P::vlasovSolverMaxCFL);
    RP::get("vlasovsolver.minCFL", P::vlasovSolverMinCFL);
    RP::get("vlasovsolver.accelerateMaxwellianBoundaries",  P::vlasovAccelerateMaxwellianBoundaries);
+   RP::get("vlasovsolver.pipelineAcceleration", P::vlasovPipelineAcceleration);
+   RP::get("vlasovsolver.fusedMoments", P::vlasovFusedMoments);
 
    // Get load balance parameters
    RP::get("loadBalance.algorithm", P::loadBalanceAlgorithm);
    loadBalanceOptions["IMBALANCE_TOL"] = "";
    RP::get("loadBalance.tolerance", loadBalanceOptions["IMBALANCE_TOL"]);
    RP::get("loadBalance.rebalanceInterval", P::rebalanceInterval);
+   RP::get("loadBalance.weightPolicy", P::loadBalanceWeightPolicy);
+   if (P::loadBalanceWeightPolicy != "blocks" && P::loadBalanceWeightPolicy != "measured") {
+      cerr << "ERROR loadBalance.weightPolicy has to be 'blocks' or 'measured'." << endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+   }
+   RP::get("loadBalance.costSampleInterval", P::loadBalanceCostSampleInterval);
+   RP::get("loadBalance.costSmoothing", P::loadBalanceCostSmoothing);
+   RP::get("loadBalance.trigger", P::loadBalanceTrigger);
+   if (P::loadBalanceTrigger != "interval" && P::loadBalanceTrigger != "imbalance") {
+      cerr << "ERROR loadBalance.trigger has to be 'interval' or 'imbalance'." << endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+   }
+   RP::get("loadBalance.horizon", P::loadBalanceHorizon);
+   RP::get("loadBalance.minInterval", P::loadBalanceMinInterval);
+   RP::get("loadBalance.maxInterval", P::loadBalanceMaxInterval);
+   RP::get("loadBalance.transferMemoryBudget", P::loadBalanceTransferBudget);
+   RP::get("loadBalance.coLocateFsGrid", P::loadBalanceCoLocateFsGrid);
+   if (P::loadBalanceTransferBudget < 0.0) {
+      cerr << "ERROR loadBalance.transferMemoryBudget cannot be negative." << endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+   }
 
    std::vector<std::string> loadBalanceKeys;
    std::vector<std::string> loadBalanceValues;
@@ -836,6 +950,8 @@ void Parameters::getParameters() {
       abort();
    }
 
+   RP::get("memory.block_pool_max_cached", P::blockPoolMaxCached);
+
    for (size_t s = 0; s < P::systemWriteName.size(); ++s) {
       P::systemWrites.push_back(0);
    }
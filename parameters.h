@@ -113,6 +113,13 @@ struct Parameters {
    static int systemStripeFactor;             /*!< stripe_factor for bulk and initial grid writing*/
    static std::string restartWritePath; /*!< Path to the location where restart files should be written. Defaults to the
                                            local directory, also if the specified destination is not writeable. */
+   static std::string bgbCachePath; /*!< Directory for cached background field files, empty to always recompute the
+                                        background field. */
+   static uint metricsInterval;    /*!< Interval (steps) of writing performance metrics, 0 to disable. */
+   static std::string metricsFile; /*!< File the performance metrics are appended to as JSON lines. */
+   static uint traceBufferSize;    /*!< Number of timeline trace events kept per rank, 0 to disable tracing. */
+   static uint traceInterval;      /*!< Interval (steps) of writing the timeline trace. */
+   static std::string traceFilePrefix; /*!< Prefix of the timeline trace files. */
 
    static uint transmit;
    /*!< Indicates the data that needs to be transmitted to remote nodes.
@@ -142,10 +149,15 @@ struct Parameters {
                                    isothermal, 1.667 is adiabatic electrons */
 
    static bool fieldSolverDiffusiveEterms; /*!< Enable resistive terms in the computation of E*/
+   static bool fieldSolverSoAKernels; /*!< Use the structure-of-arrays SIMD kernels for the field solver derivatives*/
+   static bool fastBackgroundAverages; /*!< Average the analytic background fields in closed form or with Gauss-Legendre
+                                          quadrature where possible, instead of Romberg integration everywhere*/
 
    static Real maxSlAccelerationRotation; /*!< Maximum rotation in acceleration for semilagrangian solver*/
    static int maxSlAccelerationSubcycles; /*!< Maximum number of subcycles in acceleration*/
    static bool vlasovAccelerateMaxwellianBoundaries; /*!< Accelerate also Maxwellian boundary cells*/
+   static bool vlasovPipelineAcceleration; /*!< Overlap the block list exchange of a population with the acceleration of the next one*/
+   static bool vlasovFusedMoments; /*!< Compute the _V moments in the last acceleration sweep*/
 
    static Real hallMinimumRhom; /*!< Minimum mass density value used in the field solver.*/
    static Real hallMinimumRhoq; /*!< Minimum charge density value used for the Hall and electron pressure gradient terms
@@ -154,6 +166,15 @@ struct Parameters {
    static std::string loadBalanceAlgorithm; /*!< Algorithm to be used for load balance.*/
    static std::map<std::string, std::string> loadBalanceOptions;  // Other Load balancing options
    static uint rebalanceInterval;           /*!< Load rebalance interval (steps). */
+   static std::string loadBalanceWeightPolicy; /*!< Cell weights for load balance, "blocks" or "measured". */
+   static uint loadBalanceCostSampleInterval;  /*!< Interval (steps) of measuring the cell costs for the measured policy. */
+   static Real loadBalanceCostSmoothing;       /*!< Weight of a new cost sample in the exponential smoothing. */
+   static std::string loadBalanceTrigger;      /*!< When to rebalance, "interval" or "imbalance". */
+   static uint loadBalanceHorizon;             /*!< Steps over which the gain of a rebalance is predicted. */
+   static uint loadBalanceMinInterval;         /*!< Minimum steps between imbalance-triggered rebalances. */
+   static uint loadBalanceMaxInterval;         /*!< Maximum steps between imbalance-triggered rebalances, 0 for no limit. */
+   static Real loadBalanceTransferBudget;      /*!< Velocity block data (MB) a rank may receive per load balance transfer part, 0 for the default parts. */
+   static bool loadBalanceCoLocateFsGrid;      /*!< If true, dccrg cells are placed on the rank owning the same region of the fsgrid. */
    static bool prepareForRebalance; /**< If true, propagators should measure their time consumption in preparation
                                      * for mesh repartitioning.*/
 
@@ -177,6 +198,8 @@ struct Parameters {
    static Real bailout_max_memory;    /*!< Maximum amount of memory used per node (in GiB) over which bailout occurs. */
    static uint bailout_velocity_space_wall_margin; /*!< Safety margin in number of blocks off the v-space wall beyond which bailout occurs. */
 
+   static Real blockPoolMaxCached; /*!< Maximum amount of free velocity block memory (in GiB) kept per process for reuse. */
+
    static uint vamrMaxVelocityRefLevel; /**< Maximum velocity mesh refinement level, defaults to 0.*/
    static Realf vamrCoarsenLimit; /**< If the value of refinement criterion is below this value, block can be coarsened.
                                   * The value must be smaller than vamrRefineLimit.*/
@@ -136,6 +136,89 @@ struct Field
       return operator()(v);
    }
 
+   // Offset of a cell in data, with cell coordinates already mapped by the boundaries
+   size_t cellOffset(int x, int y, int z) const {
+      if(dimension[2]->cells == 1) {
+         return 4*((size_t)y*dimension[0]->cells+x);
+      } else {
+         return 4*((size_t)z*dimension[0]->cells*dimension[1]->cells + (size_t)y*dimension[0]->cells + x);
+      }
+   }
+
+   // Batched version of the round-brace indexing: interpolates the field at the
+   // four positions given in structure-of-arrays form (one vector lane per position),
+   // with the same arithmetic as operator() for each lane. The boundary mapping of
+   // the cell coordinates and the loads are done per lane, the interpolation on
+   // full vectors.
+   virtual void gather(const Vec4d x[3], Vec4d out[3]) {
+      const int lanes = 4;
+      // Cell indices and fractional positions inside the cell
+      int index[3][lanes];
+      Vec4d fract[3];
+      for(int d=0; d<3; d++) {
+         const Vec4d v = (x[d] - dimension[d]->min) / dx[d];
+         const Vec4d t = truncate(v);
+         fract[d] = v - t;
+         double tl[lanes];
+         t.store(tl);
+         for(int l=0; l<lanes; l++) {
+            index[d][l] = (int)tl[l];
+         }
+      }
+
+      // Neighbouring cells along each dimension, mapped by the boundaries
+      int lo[3][lanes], hi[3][lanes];
+      for(int d=0; d<3; d++) {
+         for(int l=0; l<lanes; l++) {
+            lo[d][l] = dimension[d]->cellCoordinate(index[d][l]);
+            hi[d][l] = dimension[d]->cellCoordinate(index[d][l]+1);
+         }
+      }
+
+      // Gather the corner values component-wise: corner bit 0 is x+1, bit 1 y+1, bit 2 z+1
+      // (in the polar plane the second direction is z instead of y)
+      const bool equatorial = dimension[2]->cells <= 1;
+      const bool polar = !equatorial && dimension[1]->cells <= 1;
+      const int corners = (equatorial || polar) ? 4 : 8;
+      Vec4d interp[8][3];
+      for(int corner=0; corner<corners; corner++) {
+         double values[3][lanes];
+         for(int l=0; l<lanes; l++) {
+            const int cx = (corner & 1) ? hi[0][l] : lo[0][l];
+            int cy = (corner & 2) ? hi[1][l] : lo[1][l];
+            int cz = (corner & 4) ? hi[2][l] : lo[2][l];
+            if(polar) {
+               cy = lo[1][l];
+               cz = (corner & 2) ? hi[2][l] : lo[2][l];
+            }
+            const double* cell = &data[cellOffset(cx,cy,cz)];
+            for(int c=0; c<3; c++) {
+               values[c][l] = cell[c];
+            }
+         }
+         for(int c=0; c<3; c++) {
+            interp[corner][c].load(values[c]);
+         }
+      }
+
+      if(equatorial || polar) {
+         const Vec4d& f = polar ? fract[2] : fract[1];
+         for(int c=0; c<3; c++) {
+            out[c] = fract[0]*(f*interp[3][c]+(1.-f)*interp[1][c])
+               + (1.-fract[0])*(f*interp[2][c]+(1.-f)*interp[0][c]);
+         }
+      } else {
+         for(int c=0; c<3; c++) {
+            out[c] = fract[2] * (
+                  fract[0]*(fract[1]*interp[3][c]+(1.-fract[1])*interp[1][c])
+                  + (1.-fract[0])*(fract[1]*interp[2][c]+(1.-fract[1])*interp[0][c]))
+               + (1.-fract[2]) * (
+                     fract[0]*(fract[1]*interp[7][c]+(1.-fract[1])*interp[5][c])
+                     + (1.-fract[0])*(fract[1]*interp[6][c]+(1.-fract[1])*interp[4][c]));
+         }
+      }
+   }
+
 };
 
 // Linear Temporal interpolation between two input fields
@@ -157,4 +240,15 @@ struct Interpolated_Field : Field{
       double fract = (t - a.time)/(b.time-a.time);
       return fract*bval + (1.-fract)*aval;
    }
+
+   virtual void gather(const Vec4d x[3], Vec4d out[3]) {
+      Vec4d aval[3], bval[3];
+      a.gather(x,aval);
+      b.gather(x,bval);
+
+      double fract = (t - a.time)/(b.time-a.time);
+      for(int c=0; c<3; c++) {
+         out[c] = fract*bval[c] + (1.-fract)*aval[c];
+      }
+   }
 };
@@ -97,6 +97,10 @@ int main(int argc, char** argv) {
    Scenario* scenario = createScenario(ParticleParameters::mode);
    ParticleContainer particles = scenario->initialParticles(E[0],B[0],V);
 
+   // Background reader for the following input file
+   FieldPrefetcher<vlsvinterface::Reader> prefetcher;
+   FieldPrefetcher<vlsvinterface::Reader>* prefetch = ParticleParameters::prefetch_fields ? &prefetcher : nullptr;
+
    std::cerr << "Pushing " << particles.size() << " particles for " << maxsteps << " steps..." << std::endl;
    std::cerr << "[                                                                        ]\x0d[";
 
@@ -107,10 +111,10 @@ int main(int argc, char** argv) {
       /* Load newer fields, if neccessary */
       if(step >= 0) {
          newfile = readNextTimestep(filename_pattern, ParticleParameters::start_time + step*dt, 1,E[0], E[1],
-               B[0], B[1], V, scenario->needV, input_file_counter);
+               B[0], B[1], V, scenario->needV, input_file_counter, prefetch);
       } else {
          newfile = readNextTimestep(filename_pattern, ParticleParameters::start_time + step*dt, -1,E[1], E[0],
-               B[1], B[0], V, scenario->needV, input_file_counter);
+               B[1], B[0], V, scenario->needV, input_file_counter, prefetch);
       }
 
       Interpolated_Field cur_E(E[0],E[1],ParticleParameters::start_time + step*dt);
@@ -123,52 +127,13 @@ int main(int argc, char** argv) {
 
       scenario->beforePush(particles,cur_E,cur_B,V);
 
-#pragma omp parallel for
-      for(unsigned int i=0; i< particles.size(); i++) {
-
-         if(isnan(vector_length(particles[i].x))) {
-            // Skip disabled particles.
-            continue;
-         }
-
-         /* Get E- and B-Field at their position */
-         Vec3d Eval,Bval;
-
-         Eval = cur_E(particles[i].x);
-         Bval = cur_B(particles[i].x);
-
-         if(dt < 0) {
-           // If propagating backwards in time, flip B-field pseudovector
-           Bval *= -1;
-         }
-
-         /* Push them around */
-         particles[i].push(Bval,Eval,dt);
-
-      }
+      /* Push them around */
+      pushParticles(particles, cur_E, cur_B, dt);
 
       // Remove all particles that have left the simulation box after this step
-      // (unfortunately, this can not be done in parallel, so it better be fast!)
-      for(auto i = particles.begin(); i != particles.end(); ) {
-
-         // Boundaries are allowed to mangle the particles here.
-         // If they return false, particles are deleted.
-         bool do_erase = false;
-         if(!ParticleParameters::boundary_behaviour_x->handleParticle(*i)) {
-            do_erase = true;
-         }
-         if(!ParticleParameters::boundary_behaviour_y->handleParticle(*i)) {
-            do_erase = true;
-         }
-         if(!ParticleParameters::boundary_behaviour_z->handleParticle(*i)) {
-            do_erase = true;
-         }
-         if(do_erase) {
-            particles.erase(i);
-         } else {
-            i++;
-         }
-      }
+      // (parallel, order-preserving compaction)
+      applyBoundaries(particles, ParticleParameters::boundary_behaviour_x,
+            ParticleParameters::boundary_behaviour_y, ParticleParameters::boundary_behaviour_z);
 
       scenario->afterPush(step, step*dt, particles, cur_E, cur_B, V);
 
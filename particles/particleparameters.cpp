@@ -37,6 +37,7 @@ Real P::init_z = 0;
 
 Real P::dt = 0;
 Real P::input_dt = 1;
+bool P::prefetch_fields = true;
 Real P::start_time = 0;
 Real P::end_time = 0;
 uint64_t P::num_particles = 0;
@@ -88,6 +89,7 @@ bool ParticleParameters::addParameters() {
 
    Readparameters::add("particles.dt", "Particle pusher timestep",0);
    Readparameters::add("particles.input_dt", "Time spacing (seconds) of input files",1.);
+   Readparameters::add("particles.prefetch_fields", "Read the next input file in a background thread while pushing particles", true);
    Readparameters::add("particles.start_time", "Simulation time (seconds) for particle start.",0);
    Readparameters::add("particles.end_time", "Simulation time (seconds) at which particle simulation stops.",0);
    Readparameters::add("particles.num_particles", "Number of particles to simulate.",10000);
@@ -164,6 +166,7 @@ bool ParticleParameters::getParameters() {
 
    Readparameters::get("particles.dt",P::dt);
    Readparameters::get("particles.input_dt", P::input_dt);
+   Readparameters::get("particles.prefetch_fields", P::prefetch_fields);
    Readparameters::get("particles.start_time",P::start_time);
    Readparameters::get("particles.end_time",P::end_time);
    Readparameters::get("particles.num_particles",P::num_particles);
@@ -43,6 +43,7 @@ struct ParticleParameters {
    static Real start_time; /*!< Simulation time at which the particles are injected */
    static Real end_time;  /*!< Simulation time at which the particle-simulation should be stopped */
    static Real input_dt; /*!< Time interval between input files */
+   static bool prefetch_fields; /*!< Read the next input file in the background while pushing */
 
    static uint64_t num_particles; /*!< Number of particles to generate */
    static std::string V_field_name; /*!< Name of the Velocity data set to read */
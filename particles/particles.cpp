@@ -20,7 +20,12 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <vector>
+#ifdef _OPENMP
+   #include <omp.h>
+#endif
 #include "particles.h"
+#include "field.h"
+#include "boundaries.h"
 #include "physconst.h"
 #include "relativistic_math.h"
 #include "vectorclass.h"
@@ -42,6 +47,179 @@ void Particle::push(Vec3d& B, Vec3d& E, double dt) {
    x += dt * v;
 }
 
+/* Batched version of Particle::push: the same Boris step as above, with each
+ * vector lane holding one particle of the batch (structure-of-arrays). */
+static void borisPushBatch(Vec4d x[3], Vec4d v[3], const Vec4d E[3], const Vec4d B[3],
+      const Vec4d& m, const Vec4d& q, double dt) {
+
+   Vec4d uminus[3], h[3], uprime[3];
+   for(int c=0; c<3; c++) {
+      uminus[c] = v[c] + (q * E[c] * dt)/(2. * m);
+   }
+   const Vec4d usqr = uminus[0]*uminus[0] + uminus[1]*uminus[1] + uminus[2]*uminus[2];
+   const Vec4d g = sqrt(1. + (usqr / (PhysicalConstantsSI::c * PhysicalConstantsSI::c)));
+   for(int c=0; c<3; c++) {
+      h[c] = (q * B[c] * dt)/(2. * m * g);
+   }
+   uprime[0] = uminus[0] + (uminus[1]*h[2] - uminus[2]*h[1]);
+   uprime[1] = uminus[1] + (uminus[2]*h[0] - uminus[0]*h[2]);
+   uprime[2] = uminus[2] + (uminus[0]*h[1] - uminus[1]*h[0]);
+   const Vec4d hsqr = h[0]*h[0] + h[1]*h[1] + h[2]*h[2];
+   for(int c=0; c<3; c++) {
+      h[c] = (2.* h[c])/(1. + hsqr);
+   }
+   v[0] = uminus[0] + (uprime[1]*h[2] - uprime[2]*h[1]);
+   v[1] = uminus[1] + (uprime[2]*h[0] - uprime[0]*h[2]);
+   v[2] = uminus[2] + (uprime[0]*h[1] - uprime[1]*h[0]);
+   for(int c=0; c<3; c++) {
+      v[c] += (q * E[c] * dt)/(2. * m);
+      x[c] += dt * v[c];
+   }
+}
+
+void pushParticles(ParticleContainer& particles, Field& E, Field& B, double dt) {
+
+   const size_t numBatches = (particles.size() + PARTICLE_BATCH - 1) / PARTICLE_BATCH;
+
+#pragma omp parallel for schedule(static)
+   for(size_t batch=0; batch < numBatches; batch++) {
+
+      // Transpose the batch into SoA form
+      double x[3][PARTICLE_BATCH], v[3][PARTICLE_BATCH];
+      double m[PARTICLE_BATCH], q[PARTICLE_BATCH];
+      bool active[PARTICLE_BATCH];
+      int firstActive = -1;
+      for(int lane=0; lane < PARTICLE_BATCH; lane++) {
+         const size_t i = batch*PARTICLE_BATCH + lane;
+         active[lane] = i < particles.size() && !isnan(vector_length(particles[i].x));
+         if(!active[lane]) {
+            continue;
+         }
+         if(firstActive < 0) {
+            firstActive = lane;
+         }
+         const Particle& p = particles[i];
+         for(int c=0; c<3; c++) {
+            x[c][lane] = p.x[c];
+            v[c][lane] = p.v[c];
+         }
+         m[lane] = p.m;
+         q[lane] = p.q;
+      }
+      if(firstActive < 0) {
+         continue;
+      }
+      for(int lane=0; lane < PARTICLE_BATCH; lane++) {
+         if(!active[lane]) {
+            // Padding lane: a copy of an active particle, so that the field is
+            // evaluated inside the grid. Results are discarded.
+            for(int c=0; c<3; c++) {
+               x[c][lane] = x[c][firstActive];
+               v[c][lane] = v[c][firstActive];
+            }
+            m[lane] = m[firstActive];
+            q[lane] = q[firstActive];
+         }
+      }
+
+      Vec4d vx[3], vv[3], ve[3], vb[3], vm, vq;
+      for(int c=0; c<3; c++) {
+         vx[c].load(x[c]);
+         vv[c].load(v[c]);
+      }
+      vm.load(m);
+      vq.load(q);
+
+      // E and B at the particle positions, interpolated for the whole batch
+      E.gather(vx,ve);
+      B.gather(vx,vb);
+      if(dt < 0) {
+         // If propagating backwards in time, flip B-field pseudovector
+         for(int c=0; c<3; c++) {
+            vb[c] = -vb[c];
+         }
+      }
+
+      borisPushBatch(vx,vv,ve,vb,vm,vq,dt);
+
+      // Scatter results back into the particles
+      for(int c=0; c<3; c++) {
+         vx[c].store(x[c]);
+         vv[c].store(v[c]);
+      }
+      for(int lane=0; lane < PARTICLE_BATCH; lane++) {
+         if(!active[lane]) {
+            continue;
+         }
+         Particle& p = particles[batch*PARTICLE_BATCH + lane];
+         p.x = Vec3d(x[0][lane],x[1][lane],x[2][lane]);
+         p.v = Vec3d(v[0][lane],v[1][lane],v[2][lane]);
+      }
+   }
+}
+
+size_t applyBoundaries(ParticleContainer& particles, Boundary* bx, Boundary* by, Boundary* bz) {
+
+   const size_t n = particles.size();
+   std::vector<char> keep(n);
+#ifdef _OPENMP
+   const int maxThreads = omp_get_max_threads();
+#else
+   const int maxThreads = 1;
+#endif
+   // Number of kept particles per thread, turned into output offsets by a prefix sum
+   std::vector<size_t> offsets(maxThreads+1, 0);
+   ParticleContainer compacted;
+
+#pragma omp parallel
+   {
+#ifdef _OPENMP
+      const int thread = omp_get_thread_num();
+      const int numThreads = omp_get_num_threads();
+#else
+      const int thread = 0;
+      const int numThreads = 1;
+#endif
+      const size_t begin = n * thread / numThreads;
+      const size_t end = n * (thread+1) / numThreads;
+
+      // Boundaries are allowed to mangle the particles here.
+      // If any of them returns false, the particle is deleted.
+      size_t kept = 0;
+      for(size_t i=begin; i<end; i++) {
+         bool ok = bx->handleParticle(particles[i]);
+         ok = by->handleParticle(particles[i]) && ok;
+         ok = bz->handleParticle(particles[i]) && ok;
+         keep[i] = ok;
+         kept += ok;
+      }
+      offsets[thread+1] = kept;
+
+#pragma omp barrier
+#pragma omp single
+      {
+         for(int t=0; t<numThreads; t++) {
+            offsets[t+1] += offsets[t];
+         }
+         compacted.resize(offsets[numThreads]);
+      }
+
+      // Each thread copies its kept particles to its own contiguous output range
+      size_t out = offsets[thread];
+      for(size_t i=begin; i<end; i++) {
+         if(keep[i]) {
+            compacted[out++] = particles[i];
+         }
+      }
+   }
+
+   const size_t removed = n - compacted.size();
+   if(removed > 0) {
+      particles.swap(compacted);
+   }
+   return removed;
+}
+
 void writeParticles(ParticleContainer& p,const char* filename) {
 
    vlsv::Writer vlsvWriter;
@@ -27,12 +27,13 @@
 #include "../memoryallocation.h"
 
 struct Particle {
-      Vec3d x;
-      Vec3d v;
-      Real m;
-      Real q;
-      char padding[128-sizeof(Vec3d)*2-sizeof(Real)*2];
+      Vec3d x = Vec3d(0.0, 0.0, 0.0);
+      Vec3d v = Vec3d(0.0, 0.0, 0.0);
+      Real m = 0.0;
+      Real q = 0.0;
+      char padding[128-sizeof(Vec3d)*2-sizeof(Real)*2] = {};
 
+      Particle() = default;
       Particle(Real mass, Real charge, const Vec3d& _x, const Vec3d& _v) :
          x(_x),v(_v),m(mass),q(charge) {}
 
@@ -43,5 +44,21 @@ struct Particle {
 
 typedef std::vector<Particle, aligned_allocator<Particle, 32>> ParticleContainer;
 
+struct Field;
+struct Boundary;
+
+/* Push all particles of the container by dt, with E and B interpolated at the
+ * particle positions. Particles are processed in batches of PARTICLE_BATCH,
+ * transposed into structure-of-arrays form so that the field gather
+ * (Field::gather) and the Boris push run on full vector lanes. Disabled
+ * particles (NaN position) are left untouched. */
+const int PARTICLE_BATCH = 4;
+void pushParticles(ParticleContainer& particles, Field& E, Field& B, double dt);
+
+/* Apply the boundary behaviour of all three dimensions to every particle and
+ * remove the particles a boundary rejects. The relative order of the remaining
+ * particles is preserved. Returns the number of removed particles. */
+size_t applyBoundaries(ParticleContainer& particles, Boundary* bx, Boundary* by, Boundary* bz);
+
 void writeParticles(ParticleContainer& p, const char* filename);
 
@@ -30,12 +30,35 @@
 #include <string>
 #include <set>
 #include <cstring>
+#include <fstream>
+#include <thread>
+#include <exception>
+#include <stdexcept>
 
 #define DEBUG
 
 extern std::string B_field_name;
 extern std::string E_field_name;
 extern std::string V_field_name;
+
+/* Thrown instead of exiting when reading an input file fails on the
+ * prefetch thread of FieldPrefetcher, see fieldReadError(). */
+struct FieldReadError : public std::runtime_error {
+   FieldReadError() : std::runtime_error("Reading a field input file failed") {}
+};
+
+/* True on the prefetch thread of FieldPrefetcher */
+inline thread_local bool fieldReadInBackground = false;
+
+/* Give up reading an input file, after the reason has been printed.
+ * Exits on the main thread. On the prefetch thread exiting would bypass the
+ * main thread, so the error is thrown and handed over by FieldPrefetcher. */
+[[noreturn]] inline void fieldReadError() {
+   if(fieldReadInBackground) {
+      throw FieldReadError();
+   }
+   exit(1);
+}
 extern bool do_divide_by_rho;
 
 /* Read the cellIDs into an array */
@@ -75,7 +98,7 @@ static void detect_field_names(Reader& r) {
       B_field_name = "vg_b_background_vol";
    } else {
       std::cerr << "No B-fields found! Strange file format?" << std::endl;
-      exit(1);
+      fieldReadError();
    }
    
    if (find(variableNames.begin(), variableNames.end(), std::string("fg_e"))!=variableNames.end()) {
@@ -96,7 +119,7 @@ static void detect_field_names(Reader& r) {
       E_field_name = "vg_e_vol";
    } else {
       std::cerr << "No E-fields found! Strange file format?" << std::endl;
-      exit(1);
+      fieldReadError();
    }
 
    std::cerr << B_field_name << std::endl;
@@ -116,12 +139,12 @@ std::vector<double> readFieldData(Reader& r, std::string& name, unsigned int num
    if( r.getArrayInfo("VARIABLE",attribs, arraySize,vectorSize,dataType,byteSize) == false ) {
       std::cerr << "getArrayInfo returned false when trying to read VARIABLE \""
          << name << "\"." << std::endl;
-      exit(1);
+      fieldReadError();
    }
 
    if(dataType != vlsv::datatype::type::FLOAT || byteSize != 8 || vectorSize != numcomponents) {
       std::cerr << "Datatype of VARIABLE \"" << name << "\" entries is not double." << std::endl;
-      exit(1);
+      fieldReadError();
    }
 
    /* Allocate memory for the data */
@@ -129,7 +152,7 @@ std::vector<double> readFieldData(Reader& r, std::string& name, unsigned int num
 
    if( r.readArray("VARIABLE",attribs,0,arraySize,(char*) buffer.data()) == false) {
       std::cerr << "readArray faied when trying to read VARIABLE \"" << name << "\"." << std::endl;
-      exit(1);
+      fieldReadError();
    }
 
    return buffer;
@@ -151,18 +174,18 @@ std::vector<double> readFsGridData(Reader& r, std::string& name, unsigned int nu
    if (r.getArrayInfo("VARIABLE",attribs,arraySize,vectorSize,dataType,byteSize) == false) {
       std::cerr << "getArrayInfo returned false when trying to read VARIABLE \""
          << name << "\"." << std::endl;
-      exit(1);
+      fieldReadError();
    }
 
    if(dataType != vlsv::datatype::type::FLOAT || byteSize != 8 || vectorSize != numcomponents) {
       std::cerr << "Datatype of VARIABLE \"" << name << "\" entries is not double." << std::endl;
-      exit(1);
+      fieldReadError();
    }
 
    int numWritingRanks=0;
    if(r.readParameter("numWritingRanks",numWritingRanks) == false) {
       std::cerr << "FSGrid writing rank number not found";
-      exit(1);
+      fieldReadError();
    }
 
    // Are we restarting from the same number of tasks, or a different number?
@@ -179,7 +202,7 @@ std::vector<double> readFsGridData(Reader& r, std::string& name, unsigned int nu
 
    if(r.readArray("VARIABLE",attribs,0,arraySize,(char*) readBuffer.data()) == false) {
       std::cerr << "readArray faied when trying to read VARIABLE \"" << name << "\"." << std::endl;
-      exit(1);
+      fieldReadError();
    }
 
 
@@ -249,132 +272,241 @@ std::vector<double> readFsGridData(Reader& r, std::string& name, unsigned int nu
    return buffer;
 }
 
-/* Read the next logical input file. Depending on sign of dt,
- * this may be a numerically larger or smaller file.
- * Return value: true if a new file was read, otherwise false.
- * TODO: might need some DRY
+/* Read one input file into the given fields. The fields need to be
+ * set up already (dimensions and data size), as done by readfields().
  */
 template <class Reader>
-bool readNextTimestep(const std::string& filename_pattern, double t, int step, Field& E0, Field& E1,
-      Field& B0, Field& B1, Field& V, bool doV, int& input_file_counter) {
+void readTimestepFile(const char* filename, Field& E, Field& B, Field& V, bool doV) {
 
-   char filename_buffer[256];
-   bool retval = false;
+   Reader r;
+   r.open(filename);
+   double t;
+   if(!r.readParameter("time",t)) {
+      if(!r.readParameter("t",t)) {
+         std::cerr << "Time parameter in file " << filename << " is neither 't' nor 'time'. Bad file format?"
+            << std::endl;
+         fieldReadError();
+      }
+   }
 
-   while(t < E0.time || t>= E1.time) {
-      input_file_counter += step;
+   E.time = t;
+   B.time = t;
 
-      E0=E1;
-      B0=B1;
-      snprintf(filename_buffer,256,filename_pattern.c_str(),input_file_counter);
-
-      /* Open next file */
-      Reader r;
-      r.open(filename_buffer);
-      double t;
-      if(!r.readParameter("time",t)) {
-         if(!r.readParameter("t",t)) {
-            std::cerr << "Time parameter in file " << filename_buffer << " is neither 't' nor 'time'. Bad file format?"
-               << std::endl;
-            exit(1);
+   uint64_t cells[3];
+   r.readParameter("xcells_ini",cells[0]);
+   r.readParameter("ycells_ini",cells[1]);
+   r.readParameter("zcells_ini",cells[2]);
+
+   /* Read CellIDs and Field data */
+   std::vector<uint64_t> cellIds = readCellIds(r);
+   std::string name(B_field_name);
+   std::vector<double> Bbuffer;
+   std::vector<double> Ebuffer;
+   if (B_field_name == "fg_b" || B_field_name == "fg_b_background") {
+      Bbuffer = readFsGridData(r,name,3u);
+      if (B_field_name == "fg_b_background") {
+         name = "fg_b_perturbed";
+         std::vector<double> perturbedBbuffer = readFsGridData(r,name,3u);
+         for (int i = 0; i < Bbuffer.size(); ++i) {
+            Bbuffer[i] += perturbedBbuffer[i];
+         }
+      }
+      name = E_field_name;
+      Ebuffer = readFsGridData(r,name,3u);
+      for (int i = 0; i < cellIds.size(); ++i) {
+         cellIds[i] = i+1;
+      }
+   } else {
+      Bbuffer = readFieldData(r,name,3u);
+      if (B_field_name == "vg_b_background_vol") {
+         name = "vg_b_perturbed_vol";
+         std::vector<double> perturbedBbuffer = readFieldData(r,name,3u);
+         for (int i = 0; i < Bbuffer.size(); ++i) {
+            Bbuffer[i] += perturbedBbuffer[i];
          }
       }
+      name = E_field_name;
+      Ebuffer = readFieldData(r,name,3u);
+   }
+   std::vector<double> Vbuffer;
+   if(doV) {
+     name = ParticleParameters::V_field_name;
+     std::vector<double> rho_v_buffer = readFieldData(r,name,3u);
+     if(ParticleParameters::divide_rhov_by_rho) {
+       name = ParticleParameters::rho_field_name;
+       std::vector<double> rho_buffer = readFieldData(r,name,1u);
+       for(unsigned int i=0; i<rho_buffer.size(); i++) {
+         Vbuffer.push_back(rho_v_buffer[3*i] / rho_buffer[i]);
+         Vbuffer.push_back(rho_v_buffer[3*i+1] / rho_buffer[i]);
+         Vbuffer.push_back(rho_v_buffer[3*i+2] / rho_buffer[i]);
+       }
+     }
+   }
 
-      E1.time = t;
-      B1.time = t;
-
-      uint64_t cells[3];
-      r.readParameter("xcells_ini",cells[0]);
-      r.readParameter("ycells_ini",cells[1]);
-      r.readParameter("zcells_ini",cells[2]);
-
-      /* Read CellIDs and Field data */
-      std::vector<uint64_t> cellIds = readCellIds(r);
-      std::string name(B_field_name);
-      std::vector<double> Bbuffer;
-      std::vector<double> Ebuffer;
-      if (B_field_name == "fg_b" || B_field_name == "fg_b_background") {
-         Bbuffer = readFsGridData(r,name,3u);
-         if (B_field_name == "fg_b_background") {
-            name = "fg_b_perturbed";
-            std::vector<double> perturbedBbuffer = readFsGridData(r,name,3u);
-            for (int i = 0; i < Bbuffer.size(); ++i) {
-               Bbuffer[i] += perturbedBbuffer[i];
-            }
+   /* Assign them, without sanity checking */
+   /* TODO: Is this actually a good idea? */
+   for(uint i=0; i< cellIds.size(); i++) {
+      uint64_t c = cellIds[i];
+      int64_t x = c % cells[0];
+      int64_t y = (c /cells[0]) % cells[1];
+      int64_t z = c /(cells[0]*cells[1]);
+
+      double* Etgt = E.getCellRef(x,y,z);
+      double* Btgt = B.getCellRef(x,y,z);
+      Etgt[0] = Ebuffer[3*i];
+      Etgt[1] = Ebuffer[3*i+1];
+      Etgt[2] = Ebuffer[3*i+2];
+      Btgt[0] = Bbuffer[3*i];
+      Btgt[1] = Bbuffer[3*i+1];
+      Btgt[2] = Bbuffer[3*i+2];
+
+      if(doV) {
+        double* Vtgt = V.getCellRef(x,y,z);
+        Vtgt[0] = Vbuffer[3*i];
+        Vtgt[1] = Vbuffer[3*i+1];
+        Vtgt[2] = Vbuffer[3*i+2];
+      }
+   }
+
+   r.close();
+}
+
+/* Background reader for the input file following the current one.
+ * While the pusher works with snapshot n, the worker thread loads snapshot
+ * n+1 (or n-1 when tracing backwards) into spare fields, which
+ * readNextTimestep() then swaps in instead of stalling on the file read.
+ */
+template <class Reader>
+class FieldPrefetcher {
+   public:
+      FieldPrefetcher() : pendingCounter(-1), pendingDoV(false), error(nullptr) {}
+      ~FieldPrefetcher() {
+         wait();
+      }
+
+      /* Start loading input file number counter, using E, B and V as templates for the spare fields. */
+      void start(const std::string& filename_pattern, int counter, const Field& E, const Field& B, const Field& V, bool doV) {
+         wait();
+         char filename_buffer[256];
+         snprintf(filename_buffer,256,filename_pattern.c_str(),counter);
+         std::ifstream test(filename_buffer);
+         if(!test.good()) {
+            // Past the last input file, nothing to prefetch
+            pendingCounter = -1;
+            return;
          }
-         name = E_field_name;
-         Ebuffer = readFsGridData(r,name,3u);
-         for (int i = 0; i < cellIds.size(); ++i) {
-            cellIds[i] = i+1;
+         prepare(spareE,E);
+         prepare(spareB,B);
+         if(doV) {
+            prepare(spareV,V);
          }
-      } else {
-         Bbuffer = readFieldData(r,name,3u);
-         if (B_field_name == "vg_b_background_vol") {
-            name = "vg_b_perturbed_vol";
-            std::vector<double> perturbedBbuffer = readFieldData(r,name,3u);
-            for (int i = 0; i < Bbuffer.size(); ++i) {
-               Bbuffer[i] += perturbedBbuffer[i];
+         pendingCounter = counter;
+         pendingDoV = doV;
+         pendingFilename = filename_buffer;
+         error = nullptr;
+         worker = std::thread([this,doV]() {
+            fieldReadInBackground = true;
+            try {
+               readTimestepFile<Reader>(pendingFilename.c_str(),spareE,spareB,spareV,doV);
+            } catch(...) {
+               error = std::current_exception();
             }
-         }
-         name = E_field_name;
-         Ebuffer = readFieldData(r,name,3u);
+         });
       }
-      std::vector<double> Vbuffer;
-      if(doV) {
-        name = ParticleParameters::V_field_name;
-        std::vector<double> rho_v_buffer = readFieldData(r,name,3u);
-        if(ParticleParameters::divide_rhov_by_rho) {
-          name = ParticleParameters::rho_field_name;
-          std::vector<double> rho_buffer = readFieldData(r,name,1u);
-          for(unsigned int i=0; i<rho_buffer.size(); i++) {
-            Vbuffer.push_back(rho_v_buffer[3*i] / rho_buffer[i]);
-            Vbuffer.push_back(rho_v_buffer[3*i+1] / rho_buffer[i]);
-            Vbuffer.push_back(rho_v_buffer[3*i+2] / rho_buffer[i]);
-          }
-        }
+
+      /* If input file number counter has been prefetched, swap it into E, B and V and return true.
+       * Otherwise return false, and the caller has to read the file itself. */
+      bool fetch(int counter, Field& E, Field& B, Field& V, bool doV) {
+         wait();
+         if(pendingCounter != counter || (doV && !pendingDoV)) {
+            pendingCounter = -1;
+            return false;
+         }
+         if(error != nullptr) {
+            // The reason has been printed by the prefetch thread
+            std::cerr << "Reading input file " << pendingFilename << " in the background failed." << std::endl;
+            exit(1);
+         }
+         E.data.swap(spareE.data);
+         E.time = spareE.time;
+         B.data.swap(spareB.data);
+         B.time = spareB.time;
+         if(doV) {
+            V.data.swap(spareV.data);
+         }
+         pendingCounter = -1;
+         return true;
       }
 
-      /* Assign them, without sanity checking */
-      /* TODO: Is this actually a good idea? */
-      for(uint i=0; i< cellIds.size(); i++) {
-         uint64_t c = cellIds[i];
-         int64_t x = c % cells[0];
-         int64_t y = (c /cells[0]) % cells[1];
-         int64_t z = c /(cells[0]*cells[1]);
-
-         double* Etgt = E1.getCellRef(x,y,z);
-         double* Btgt = B1.getCellRef(x,y,z);
-         Etgt[0] = Ebuffer[3*i];
-         Etgt[1] = Ebuffer[3*i+1];
-         Etgt[2] = Ebuffer[3*i+2];
-         Btgt[0] = Bbuffer[3*i];
-         Btgt[1] = Bbuffer[3*i+1];
-         Btgt[2] = Bbuffer[3*i+2];
+   private:
+      void wait() {
+         if(worker.joinable()) {
+            worker.join();
+         }
+      }
 
-         if(doV) {
-           double* Vtgt = V.getCellRef(x,y,z);
-           Vtgt[0] = Vbuffer[3*i];
-           Vtgt[1] = Vbuffer[3*i+1];
-           Vtgt[2] = Vbuffer[3*i+2];
+      /* Set up a spare field like the template without copying its data. After the
+       * first swap the spare already holds a buffer of the right size, the data of
+       * an earlier snapshot, which the read overwrites. */
+      static void prepare(Field& spare, const Field& templ) {
+         spare.time = templ.time;
+         for(int i=0; i<3; i++) {
+            spare.dx[i] = templ.dx[i];
+            spare.dimension[i] = templ.dimension[i];
+         }
+         if(spare.data.size() != templ.data.size()) {
+            spare.data.resize(templ.data.size());
          }
       }
 
-      r.close();
+      std::thread worker;
+      int pendingCounter;
+      bool pendingDoV;
+      std::string pendingFilename;
+      std::exception_ptr error;
+      Field spareE, spareB, spareV;
+};
+
+/* Read the next logical input file. Depending on sign of dt,
+ * this may be a numerically larger or smaller file.
+ * If a prefetcher is given, the file is taken from it when available,
+ * and loading of the file after it is started in the background.
+ * Return value: true if a new file was read, otherwise false.
+ */
+template <class Reader>
+bool readNextTimestep(const std::string& filename_pattern, double t, int step, Field& E0, Field& E1,
+      Field& B0, Field& B1, Field& V, bool doV, int& input_file_counter,
+      FieldPrefetcher<Reader>* prefetcher = nullptr) {
+
+   char filename_buffer[256];
+   bool retval = false;
+
+   while(t < E0.time || t>= E1.time) {
+      input_file_counter += step;
+
+      E0=E1;
+      B0=B1;
+      if(prefetcher == nullptr || !prefetcher->fetch(input_file_counter,E1,B1,V,doV)) {
+         snprintf(filename_buffer,256,filename_pattern.c_str(),input_file_counter);
+         readTimestepFile<Reader>(filename_buffer,E1,B1,V,doV);
+      }
       retval = true;
    }
 
+   if(retval && prefetcher != nullptr) {
+      prefetcher->start(filename_pattern,input_file_counter+step,E1,B1,V,doV);
+   }
+
    return retval;
 }
 
 /* Non-template version, autodetecting the reader type */
 static bool readNextTimestep(const std::string& filename_pattern, double t, int step, Field& E0, Field& E1,
-      Field& B0, Field& B1, Field& V, bool doV, int& input_file_counter) {
-
-   char filename_buffer[256];
-   snprintf(filename_buffer,256,filename_pattern.c_str(),input_file_counter);
+      Field& B0, Field& B1, Field& V, bool doV, int& input_file_counter,
+      FieldPrefetcher<vlsvinterface::Reader>* prefetcher = nullptr) {
 
    return readNextTimestep<vlsvinterface::Reader>(filename_pattern, t,
-         step,E0,E1,B0,B1,V,doV,input_file_counter);
+         step,E0,E1,B0,B1,V,doV,input_file_counter,prefetcher);
 }
 
 /* Read E- and B-Fields as well as velocity field from a vlsv file */
@@ -467,23 +599,23 @@ void readfields(const char* filename, Field& E, Field& B, Field& V, bool doV=tru
    if(3*cellIds.size() != Bbuffer.size()) {
       std::cerr << "3 * cellIDs.size (" << cellIds.size() << ") != Bbuffer.size (" << Bbuffer.size() << ")!"
          << std::endl;
-      exit(1);
+      fieldReadError();
    }
    if(3*cellIds.size() != Ebuffer.size()) {
       std::cerr << "3 * cellIDs.size (" << cellIds.size() << ") != Ebuffer.size (" << Ebuffer.size() << ")!"
          << std::endl;
-      exit(1);
+      fieldReadError();
    }
    if(doV) {
      if(3*cellIds.size() != rho_v_buffer.size()) {
         std::cerr << "3 * cellIDs.size (" << cellIds.size() << ") != rho_v_buffer.size (" << Ebuffer.size() << ")!"
            << std::endl;
-        exit(1);
+        fieldReadError();
      }
      if(ParticleParameters::divide_rhov_by_rho && cellIds.size() != rho_buffer.size()) {
         std::cerr << "cellIDs.size (" << cellIds.size() << ") != rho_buffer.size (" << Ebuffer.size() << ")!"
            << std::endl;
-        exit(1);
+        fieldReadError();
      }
    }
 
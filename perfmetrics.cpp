@@ -0,0 +1,185 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <mpi.h>
+#include <sys/resource.h>
+#include "perfmetrics.h"
+#include "parameters.h"
+#include "logger.h"
+#include "object_wrapper.h"
+
+extern Logger logFile;
+
+using namespace std;
+using namespace spatial_cell;
+
+namespace perfmetrics {
+
+   static const char* stageNames[N_STAGES] = {"translation", "acceleration", "vlasovBoundaries", "fields"};
+
+   // Whether the current step is sampled
+   static bool sampleActive = false;
+   static double stepStart = 0.0;
+   static double stageTime[N_STAGES];
+   static uint64_t sentBytes[N_NEIGHBORHOOD_COUNTERS];
+   // Only open on the master rank, and only once metrics have been written
+   static ofstream metricsFile;
+   static bool openFailed = false;
+
+   // Process memory high-water mark in bytes
+   static double getHighWaterMark() {
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) != 0) {
+         return 0.0;
+      }
+      return usage.ru_maxrss * 1024.0; // kilobytes on Linux
+   }
+
+   // Write min, max and mean over ranks as a JSON object
+   static void writeStatistics(ostream& out, const double minimum, const double maximum, const double sum, const int nRanks) {
+      out << "{\"min\":" << minimum << ",\"max\":" << maximum << ",\"mean\":" << sum / nRanks << "}";
+   }
+
+   bool sampling() {
+      return sampleActive;
+   }
+
+   void beginStep() {
+      sampleActive = P::metricsInterval > 0 && P::tstep % P::metricsInterval == 0;
+      stepStart = MPI_Wtime();
+      for (int s=0; s<N_STAGES; ++s) {
+         stageTime[s] = 0.0;
+      }
+      for (int n=0; n<N_NEIGHBORHOOD_COUNTERS; ++n) {
+         sentBytes[n] = 0;
+      }
+   }
+
+   void addStageTime(const Stage stage, const double seconds) {
+      stageTime[stage] += seconds;
+   }
+
+   void addSentBytes(const int neighborhood, const uint64_t bytes) {
+      const int counter = min(max(neighborhood, 0), N_NEIGHBORHOOD_COUNTERS - 1);
+      #pragma omp atomic
+      sentBytes[counter] += bytes;
+   }
+
+   void endStep(
+      dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const vector<CellID>& cells,
+      const uint64_t propagatedBlocks
+   ) {
+      if (!sampleActive) {
+         return;
+      }
+      int myRank, nRanks;
+      MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+      MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+      const size_t nPops = getObjectWrapper().particleSpecies.size();
+
+      // Timings and memory are reduced as min/max/sum
+      const int nTimes = 1 + N_STAGES + 1;
+      double local[nTimes];
+      local[0] = MPI_Wtime() - stepStart;
+      for (int s=0; s<N_STAGES; ++s) {
+         local[1 + s] = stageTime[s];
+      }
+      local[nTimes - 1] = getHighWaterMark();
+      double minimum[nTimes], maximum[nTimes], sum[nTimes];
+      MPI_Reduce(local, minimum, nTimes, MPI_DOUBLE, MPI_MIN, MASTER_RANK, MPI_COMM_WORLD);
+      MPI_Reduce(local, maximum, nTimes, MPI_DOUBLE, MPI_MAX, MASTER_RANK, MPI_COMM_WORLD);
+      MPI_Reduce(local, sum, nTimes, MPI_DOUBLE, MPI_SUM, MASTER_RANK, MPI_COMM_WORLD);
+
+      // The rank that took longest on the step
+      struct { double time; int rank; } slowest, localStep = {local[0], myRank};
+      MPI_Reduce(&localStep, &slowest, 1, MPI_DOUBLE_INT, MPI_MAXLOC, MASTER_RANK, MPI_COMM_WORLD);
+
+      // Counters are summed: propagated blocks, blocks per population, bytes per neighbourhood
+      vector<uint64_t> counts(1 + nPops + N_NEIGHBORHOOD_COUNTERS, 0);
+      counts[0] = propagatedBlocks;
+      for (size_t c=0; c<cells.size(); ++c) {
+         for (size_t popID=0; popID<nPops; ++popID) {
+            counts[1 + popID] += mpiGrid[cells[c]]->get_number_of_velocity_blocks(popID);
+         }
+      }
+      for (int n=0; n<N_NEIGHBORHOOD_COUNTERS; ++n) {
+         counts[1 + nPops + n] = sentBytes[n];
+      }
+      vector<uint64_t> totals(counts.size(), 0);
+      MPI_Reduce(counts.data(), totals.data(), counts.size(), MPI_UINT64_T, MPI_SUM, MASTER_RANK, MPI_COMM_WORLD);
+
+      if (myRank != MASTER_RANK) {
+         return;
+      }
+      // The other ranks keep sampling even if the file cannot be written, the reductions are collective
+      if (!metricsFile.is_open()) {
+         if (openFailed) {
+            return;
+         }
+         metricsFile.open(P::metricsFile, ios::out | ios::app);
+         if (!metricsFile.good()) {
+            logFile << "(METRICS) ERROR could not open " << P::metricsFile << ", no metrics are written" << endl << writeVerbose;
+            openFailed = true;
+            return;
+         }
+      }
+
+      stringstream line;
+      line.precision(9);
+      line << "{\"tstep\":" << P::tstep << ",\"t\":" << P::t << ",\"dt\":" << P::dt << ",\"ranks\":" << nRanks;
+      line << ",\"propagatedBlocks\":" << totals[0];
+      line << ",\"blocks\":{";
+      for (size_t popID=0; popID<nPops; ++popID) {
+         line << (popID > 0 ? "," : "") << "\"" << getObjectWrapper().particleSpecies[popID].name << "\":" << totals[1 + popID];
+      }
+      line << "},\"walltime\":";
+      writeStatistics(line, minimum[0], maximum[0], sum[0], nRanks);
+      line << ",\"slowestRank\":" << slowest.rank;
+      line << ",\"stages\":{";
+      for (int s=0; s<N_STAGES; ++s) {
+         line << (s > 0 ? "," : "") << "\"" << stageNames[s] << "\":{\"time\":";
+         writeStatistics(line, minimum[1 + s], maximum[1 + s], sum[1 + s], nRanks);
+         if ((s == TRANSLATION || s == ACCELERATION) && maximum[1 + s] > 0.0) {
+            line << ",\"blocksPerSecond\":" << totals[0] / maximum[1 + s];
+         }
+         line << "}";
+      }
+      line << "},\"sentBytes\":{";
+      bool first = true;
+      for (int n=0; n<N_NEIGHBORHOOD_COUNTERS; ++n) {
+         if (totals[1 + nPops + n] == 0) {
+            continue;
+         }
+         line << (first ? "" : ",") << "\"" << n << "\":" << totals[1 + nPops + n];
+         first = false;
+      }
+      line << "},\"memoryHighWaterMark\":";
+      writeStatistics(line, minimum[nTimes - 1], maximum[nTimes - 1], sum[nTimes - 1], nRanks);
+      line << "}\n";
+
+      metricsFile << line.str() << flush;
+   }
+}
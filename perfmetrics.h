@@ -0,0 +1,83 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef PERFMETRICS_H
+#define PERFMETRICS_H
+
+#include <cstdint>
+#include <vector>
+#include <dccrg.hpp>
+#include <dccrg_cartesian_geometry.hpp>
+#include "definitions.h"
+#include "spatial_cell.hpp"
+
+/* Per-step solver performance metrics.
+ *
+ * On every io.metrics_interval:th step the master rank appends one JSON object
+ * as a line to io.metrics_file. Each line holds:
+ * - the step number, simulation time and dt
+ * - the velocity blocks propagated and the blocks per population, summed over ranks
+ * - the wall time of the step and of each solver stage, as min/max/mean over
+ *   ranks, and the rank that took longest on the step
+ * - the blocks/s of the Vlasov stages, ie. the propagated blocks over the
+ *   slowest rank's stage time
+ * - the bytes sent by dccrg remote neighbour updates, per neighbourhood id
+ * - the min/max/mean process memory high-water mark
+ *
+ * Between sampled steps the cost is a few counter updates. The reductions over
+ * ranks and the write are done on sampled steps only. */
+namespace perfmetrics {
+
+   /*! Solver stages that are timed separately.*/
+   enum Stage {
+      TRANSLATION,
+      ACCELERATION,
+      VLASOV_BOUNDARIES,
+      FIELDS,
+      N_STAGES
+   };
+
+   /*! Number of neighbourhood ids with their own communication counter, larger ids share the last one.*/
+   const int N_NEIGHBORHOOD_COUNTERS = 32;
+
+   /*! True if metrics are written for the current step.*/
+   bool sampling();
+
+   /*! Start a step, decides whether it is sampled and clears the counters.*/
+   void beginStep();
+
+   /*! Add wall time spent in a solver stage during this step.*/
+   void addStageTime(const Stage stage, const double seconds);
+
+   /*! Add bytes sent to another rank in a remote neighbour update of the given neighbourhood.
+    * Called from SpatialCell::get_mpi_datatype.*/
+   void addSentBytes(const int neighborhood, const uint64_t bytes);
+
+   /*! Finish a step, on sampled steps reduces the metrics over ranks and writes them. Collective.
+    * \param propagatedBlocks Velocity blocks of all populations propagated on this rank during the step*/
+   void endStep(
+      dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const std::vector<CellID>& cells,
+      const uint64_t propagatedBlocks
+   );
+}
+
+#endif
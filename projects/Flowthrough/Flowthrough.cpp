@@ -239,6 +239,20 @@ namespace projects {
       return centerPoints;
    }
 
+   /*! Only the uniform Maxwellian density model gives its moments, the others use the TriAxisSearch. */
+   bool Flowthrough::getInitialMoments(spatial_cell::SpatialCell* cell,const uint popID,std::vector<InitialMoments>& moments) const {
+      if (densityModel != Maxwellian) {
+         return false;
+      }
+      const FlowthroughSpeciesParameters& sP = speciesParams[popID];
+      InitialMoments m;
+      m.rho = emptyBox ? 0.0 : sP.rho;
+      m.V0 = {{sP.V0[0], sP.V0[1], sP.V0[2]}};
+      m.T = sP.T;
+      moments.push_back(m);
+      return true;
+   }
+
    bool Flowthrough::canRefine(const std::array<double,3> xyz, const int refLevel) const {
       const int bw = (2 + 1*refLevel) * VLASOV_STENCIL_WIDTH; // Seems to be the limit
 
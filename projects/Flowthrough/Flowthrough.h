@@ -74,6 +74,7 @@ namespace projects {
                                                       creal z,
                                                       const uint popID
                                                      ) const;
+      virtual bool getInitialMoments(spatial_cell::SpatialCell* cell, const uint popID, std::vector<InitialMoments>& moments) const;
       bool adaptRefinement( dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid ) const;
       bool canRefine(const std::array<double,3> xyz, const int refLevel) const;
 
@@ -458,16 +458,11 @@ namespace projects {
    }
    
    
-   Real Magnetosphere::getDistribValue(
-           creal& x,creal& y,creal& z,
-           creal& vx,creal& vy,creal& vz,
-           creal& dvx,creal& dvy,creal& dvz,
-           const uint popID) const
-   {
+   /*! Density and temperature of population popID at (x,y,z), tapered towards the ionospheric values near the inner boundary.*/
+   void Magnetosphere::getTaperedRhoT(creal& x,creal& y,creal& z,const uint popID,Real& initRho,Real& initT) const {
       const MagnetosphereSpeciesParameters& sP = this->speciesParams[popID];
-      Real initRho = sP.rho;
-      Real initT = sP.T;
-      std::array<Real, 3> initV0 = this->getV0(x, y, z, popID)[0];
+      initRho = sP.rho;
+      initT = sP.T;
       
       Real radius;
       
@@ -502,6 +497,17 @@ namespace projects {
             initT = sP.ionosphereT;
          }
       }
+   }
+
+   Real Magnetosphere::getDistribValue(
+           creal& x,creal& y,creal& z,
+           creal& vx,creal& vy,creal& vz,
+           creal& dvx,creal& dvy,creal& dvz,
+           const uint popID) const
+   {
+      Real initRho, initT;
+      getTaperedRhoT(x, y, z, popID, initRho, initT);
+      std::array<Real, 3> initV0 = this->getV0(x, y, z, popID)[0];
 
       Real mass = getObjectWrapper().particleSpecies[popID].mass;
 
@@ -509,6 +515,53 @@ namespace projects {
       exp(- mass * ((vx-initV0[0])*(vx-initV0[0]) + (vy-initV0[1])*(vy-initV0[1]) + (vz-initV0[2])*(vz-initV0[2])) / (2.0 * physicalconstants::K_B * initT));
    }
 
+   /*! Without sub-cell sampling the spatial part of the distribution is the
+    * same for the whole block, so it is evaluated once and the Maxwellian
+    * computed over the velocity cells in one vectorizable loop. */
+   void Magnetosphere::calcPhaseSpaceDensityBatch(
+           creal& x,creal& y,creal& z,creal& dx,creal& dy,creal& dz,
+           const Real* vx,const Real* vy,const Real* vz,
+           creal& dvx,creal& dvy,creal& dvz,
+           const uint popID,const uint n,Real* result) const
+   {
+      const MagnetosphereSpeciesParameters& sP = this->speciesParams[popID];
+      if((sP.nSpaceSamples > 1) && (sP.nVelocitySamples > 1)) {
+         Project::calcPhaseSpaceDensityBatch(x,y,z,dx,dy,dz,vx,vy,vz,dvx,dvy,dvz,popID,n,result);
+         return;
+      }
+
+      creal xc = x+0.5*dx;
+      creal yc = y+0.5*dy;
+      creal zc = z+0.5*dz;
+      Real initRho, initT;
+      getTaperedRhoT(xc, yc, zc, popID, initRho, initT);
+      const std::array<Real, 3> initV0 = this->getV0(xc, yc, zc, popID)[0];
+
+      const Real mass = getObjectWrapper().particleSpecies[popID].mass;
+      const Real norm = initRho * pow(mass / (2.0 * M_PI * physicalconstants::K_B * initT), 1.5);
+      const Real denom = 2.0 * physicalconstants::K_B * initT;
+
+      #pragma omp simd
+      for (uint c=0; c<n; ++c) {
+         const Real vxc = vx[c]+0.5*dvx;
+         const Real vyc = vy[c]+0.5*dvy;
+         const Real vzc = vz[c]+0.5*dvz;
+         result[c] = norm *
+            exp(- mass * ((vxc-initV0[0])*(vxc-initV0[0]) + (vyc-initV0[1])*(vyc-initV0[1]) + (vzc-initV0[2])*(vzc-initV0[2])) / denom);
+      }
+   }
+
+   bool Magnetosphere::getInitialMoments(spatial_cell::SpatialCell* cell,const uint popID,std::vector<InitialMoments>& moments) const {
+      creal xc = cell->parameters[CellParams::XCRD] + 0.5*cell->parameters[CellParams::DX];
+      creal yc = cell->parameters[CellParams::YCRD] + 0.5*cell->parameters[CellParams::DY];
+      creal zc = cell->parameters[CellParams::ZCRD] + 0.5*cell->parameters[CellParams::DZ];
+      InitialMoments m;
+      getTaperedRhoT(xc, yc, zc, popID, m.rho, m.T);
+      m.V0 = this->getV0(xc, yc, zc, popID)[0];
+      moments.push_back(m);
+      return true;
+   }
+
    vector<std::array<Real, 3> > Magnetosphere::getV0(
       creal x,
       creal y,
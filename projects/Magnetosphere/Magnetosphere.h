@@ -62,8 +62,17 @@ namespace projects {
                                          creal& dvx, creal& dvy, creal& dvz,
                                          const uint popID
                                         ) const;
+      virtual void calcPhaseSpaceDensityBatch(
+                                              creal& x, creal& y, creal& z,
+                                              creal& dx, creal& dy, creal& dz,
+                                              const Real* vx, const Real* vy, const Real* vz,
+                                              creal& dvx, creal& dvy, creal& dvz,
+                                              const uint popID, const uint n, Real* result
+                                             ) const;
       
     protected:
+      void getTaperedRhoT(creal& x, creal& y, creal& z, const uint popID, Real& rho, Real& T) const;
+      virtual bool getInitialMoments(spatial_cell::SpatialCell* cell, const uint popID, std::vector<InitialMoments>& moments) const;
       Real getDistribValue(
                            creal& x,creal& y, creal& z,
                            creal& vx, creal& vy, creal& vz,
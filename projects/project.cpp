@@ -22,6 +22,8 @@
 
 #include "project.h"
 #include <cstdlib>
+#include <algorithm>
+#include <cmath>
 #include "../common.h"
 #include "../parameters.h"
 #include "../readparameters.h"
@@ -163,6 +165,11 @@ namespace projects {
    }
 
    std::vector<vmesh::GlobalID> Project::findBlocksToInitialize(spatial_cell::SpatialCell* cell,const uint popID) const {
+      vector<InitialMoments> moments;
+      if (getInitialMoments(cell,popID,moments) == true) {
+         return findBlocksInSupport(cell,popID,moments);
+      }
+
       vector<vmesh::GlobalID> blocksToInitialize;
       const uint8_t refLevel = 0;
 
@@ -184,6 +191,77 @@ namespace projects {
       return blocksToInitialize;
    }
    
+   bool Project::getInitialMoments(spatial_cell::SpatialCell* cell,const uint popID,std::vector<InitialMoments>& moments) const {
+      return false;
+   }
+
+   /** Create the blocks of the refLevel 0 velocity mesh whose centres are within
+    * the support of the given Maxwellians. A Maxwellian with density n and
+    * thermal speed vth = sqrt(kT/m) falls below the limit f_lim at the radius
+    * vth*sqrt(2*ln(f_max/f_lim)) from its bulk velocity, f_max being its peak value.
+    * As in TriAxisSearch the limit is a tenth of the sparsity threshold and the
+    * radius is extended by two blocks, which leaves room for sub-cell sampling and
+    * for the limit being reached between block centres.
+    * @param cell Spatial cell.
+    * @param popID ID of the particle species.
+    * @param moments Maxwellian components of the population.
+    * @return Global IDs of the created blocks.*/
+   std::vector<vmesh::GlobalID> Project::findBlocksInSupport(
+      spatial_cell::SpatialCell* cell,
+      const uint popID,
+      const std::vector<InitialMoments>& moments
+   ) const {
+      const uint8_t refLevel = 0;
+      const vmesh::LocalID* gridLength = cell->get_velocity_grid_length(popID,refLevel);
+      const Real* blockSize = cell->get_velocity_grid_block_size(popID,refLevel);
+      const Real* meshMin = cell->get_velocity_grid_min_limits(popID);
+      const Real mass = getObjectWrapper().particleSpecies[popID].mass;
+      const Real limit = 0.1 * cell->getVelocityBlockMinValue(popID);
+
+      vector<vmesh::GlobalID> blocksToInitialize;
+      for (const InitialMoments& m : moments) {
+         if (m.rho <= 0.0 || m.T <= 0.0) continue;
+         const Real vth2 = physicalconstants::K_B * m.T / mass;
+         const Real peak = m.rho * pow(1.0 / (2.0 * M_PI * vth2), 1.5);
+         if (peak <= limit) continue;
+         const Real radius = sqrt(2.0 * vth2 * log(peak / limit));
+
+         // Index range of the blocks within the bounding box of the support
+         Real support[3];
+         int64_t lower[3], upper[3];
+         for (int d=0; d<3; ++d) {
+            support[d] = radius + 2*blockSize[d];
+            lower[d] = max<int64_t>(0, (int64_t)floor((m.V0[d] - support[d] - meshMin[d]) / blockSize[d]));
+            upper[d] = min<int64_t>((int64_t)gridLength[d]-1, (int64_t)floor((m.V0[d] + support[d] - meshMin[d]) / blockSize[d]));
+         }
+
+         for (int64_t kv=lower[2]; kv<=upper[2]; ++kv) {
+            for (int64_t jv=lower[1]; jv<=upper[1]; ++jv) {
+               for (int64_t iv=lower[0]; iv<=upper[0]; ++iv) {
+                  const Real dvx = (meshMin[0] + (iv+0.5)*blockSize[0] - m.V0[0]) / support[0];
+                  const Real dvy = (meshMin[1] + (jv+0.5)*blockSize[1] - m.V0[1]) / support[1];
+                  const Real dvz = (meshMin[2] + (kv+0.5)*blockSize[2] - m.V0[2]) / support[2];
+                  if (dvx*dvx + dvy*dvy + dvz*dvz >= 1.0) continue;
+
+                  vmesh::GlobalID blockIndices[3];
+                  blockIndices[0] = iv;
+                  blockIndices[1] = jv;
+                  blockIndices[2] = kv;
+                  blocksToInitialize.push_back(cell->get_velocity_block(popID,blockIndices,refLevel));
+               }
+            }
+         }
+      }
+
+      // Components may overlap
+      sort(blocksToInitialize.begin(),blocksToInitialize.end());
+      blocksToInitialize.erase(unique(blocksToInitialize.begin(),blocksToInitialize.end()),blocksToInitialize.end());
+      for (const vmesh::GlobalID blockGID : blocksToInitialize) {
+         cell->add_velocity_block(blockGID,popID);
+      }
+      return blocksToInitialize;
+   }
+
    /** Write simulated particle populations to logfile.*/
    void Project::printPopulations() {
       logFile << "(PROJECT): Loaded particle populations are:" << endl;
@@ -245,29 +323,53 @@ namespace projects {
       creal dvxCell = parameters[blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
       creal dvyCell = parameters[blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
       creal dvzCell = parameters[blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-      // Calculate volume average of distribution function for each phase-space cell in the block.
-      Real maxValue = 0.0;
+      // Velocity coordinates of the phase-space cells in the block
+      Real vxCell[WID3];
+      Real vyCell[WID3];
+      Real vzCell[WID3];
+      uint index[WID3];
+      uint n = 0;
       for (uint kc=0; kc<WID_VZ; ++kc) {
          for (uint jc=0; jc<WID_VY; ++jc) {
             for (uint ic=0; ic<WID_VX; ++ic) {
-               creal vxCell = vxBlock + ic*dvxCell;
-               creal vyCell = vyBlock + jc*dvyCell;
-               creal vzCell = vzBlock + kc*dvzCell;
-               creal average =
-                  calcPhaseSpaceDensity(
-                     x, y, z, dx, dy, dz,
-                     vxCell,vyCell,vzCell,
-                     dvxCell,dvyCell,dvzCell,popID);
-               if (average != 0.0) {
-                  data[blockLID*SIZE_VELBLOCK+cellIndex(ic,jc,kc)] = average;
-                  maxValue = max(maxValue,average);
-               }
+               vxCell[n] = vxBlock + ic*dvxCell;
+               vyCell[n] = vyBlock + jc*dvyCell;
+               vzCell[n] = vzBlock + kc*dvzCell;
+               index[n] = cellIndex(ic,jc,kc);
+               ++n;
             }
          }
       }
+
+      // Calculate volume average of distribution function for each phase-space cell in the block.
+      Real average[WID3];
+      calcPhaseSpaceDensityBatch(
+         x, y, z, dx, dy, dz,
+         vxCell,vyCell,vzCell,
+         dvxCell,dvyCell,dvzCell,popID,n,average);
+
+      Real maxValue = 0.0;
+      for (uint c=0; c<n; ++c) {
+         if (average[c] != 0.0) {
+            data[blockLID*SIZE_VELBLOCK+index[c]] = average[c];
+            maxValue = max(maxValue,average[c]);
+         }
+      }
       return maxValue;
    }
    
+   void Project::calcPhaseSpaceDensityBatch(
+      creal& x, creal& y, creal& z,
+      creal& dx, creal& dy, creal& dz,
+      const Real* vx, const Real* vy, const Real* vz,
+      creal& dvx, creal& dvy, creal& dvz,
+      const uint popID, const uint n, Real* result
+   ) const {
+      for (uint c=0; c<n; ++c) {
+         result[c] = calcPhaseSpaceDensity(x, y, z, dx, dy, dz, vx[c], vy[c], vz[c], dvx, dvy, dvz, popID);
+      }
+   }
+
    void Project::setVelocitySpace(const uint popID,SpatialCell* cell) const {
       vmesh::VelocityMesh* vmesh = cell->get_velocity_mesh(popID);
 
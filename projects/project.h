@@ -31,6 +31,16 @@
 #include "fsgrid.hpp"
 
 namespace projects {
+   /*! Bulk parameters of one Maxwellian component of a population, used to
+    * bound the part of velocity space that is initialized.
+    * \sa Project::getInitialMoments
+    */
+   struct InitialMoments {
+      Real rho;               /*!< Number density */
+      std::array<Real, 3> V0; /*!< Bulk velocity */
+      Real T;                 /*!< Temperature */
+   };
+
    class Project {
     public:
       Project();
@@ -110,6 +120,25 @@ namespace projects {
        * NOTE: This function is called inside parallel region so it must be declared as const.
        */
       virtual std::vector<vmesh::GlobalID> findBlocksToInitialize(spatial_cell::SpatialCell* cell,const uint popID) const;
+
+      /*! \brief Moments of the initial distribution of a population in a cell.
+       * 
+       * Projects whose initial distributions are (sums of) Maxwellians can return their
+       * density, bulk velocity and temperature here. findBlocksToInitialize then only
+       * creates the blocks where the Maxwellians reach a tenth of the sparsity threshold,
+       * instead of the whole velocity mesh. The base class version returns false.
+       * NOTE: This function is called inside parallel region so it must be declared as const.
+       * \param moments One entry per Maxwellian component is appended to this vector.
+       * \return True if moments were given.
+       * 
+       * \sa findBlocksInSupport
+       */
+      virtual bool getInitialMoments(spatial_cell::SpatialCell* cell,const uint popID,std::vector<InitialMoments>& moments) const;
+
+      /*! \brief Create and return the blocks within the support of the given Maxwellians.
+       * \sa getInitialMoments
+       */
+      std::vector<vmesh::GlobalID> findBlocksInSupport(spatial_cell::SpatialCell* cell,const uint popID,const std::vector<InitialMoments>& moments) const;
       
       /*! \brief Sets the distribution function in a cell.
        * 
@@ -157,6 +186,22 @@ namespace projects {
                                          creal& vx, creal& vy, creal& vz,
                                          creal& dvx, creal& dvy, creal& dvz,
                                          const uint popID) const = 0;
+
+      /** Batched version of calcPhaseSpaceDensity, used by setVelocityBlock for all velocity cells of a block.
+       * The base class version calls calcPhaseSpaceDensity for each cell. Projects can override it with a
+       * version that evaluates the spatial part once and loops over the velocity cells in a vectorizable loop.
+       * NOTE: This function is called inside parallel region so it must be declared as const.
+       * @param vx,vy,vz Arrays of n starting values of the velocity coordinates of the cells.
+       * @param n Number of velocity cells.
+       * @param result Array of n values, set to the volume averages of the distribution function.
+       * Other parameters as in calcPhaseSpaceDensity.
+       */
+      virtual void calcPhaseSpaceDensityBatch(
+                                              creal& x, creal& y, creal& z,
+                                              creal& dx, creal& dy, creal& dz,
+                                              const Real* vx, const Real* vy, const Real* vz,
+                                              creal& dvx, creal& dvy, creal& dvz,
+                                              const uint popID, const uint n, Real* result) const;
       
       void printPopulations();
       
@@ -32,6 +32,12 @@ namespace projects {
     * WARNING This assumes that the velocity space is isotropic (same resolution in vx, vy, vz).
     */
    std::vector<vmesh::GlobalID> TriAxisSearch::findBlocksToInitialize(SpatialCell* cell,const uint popID) const {
+      // Projects that know the moments of their distributions skip the search
+      vector<InitialMoments> moments;
+      if (getInitialMoments(cell,popID,moments) == true) {
+         return findBlocksInSupport(cell,popID,moments);
+      }
+
       set<vmesh::GlobalID> blocksToInitialize;
       bool search;
       unsigned int counter;
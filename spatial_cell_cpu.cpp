@@ -25,6 +25,7 @@
 #include "spatial_cell_cpu.hpp"
 #include "velocity_blocks.h"
 #include "object_wrapper.h"
+#include "perfmetrics.h"
 
 #ifndef NDEBUG
    #define DEBUG_SPATIAL_CELL
@@ -579,6 +580,21 @@ namespace spatial_cell {
       }
    }
 
+   /** Check if any phase-space density value of a velocity block is at or above the
+    * sparsity threshold. All WID3 values are compared without an early exit, so
+    * the loop is vectorized into compares and an OR of the masks.
+    * @param block_data Data of the velocity block.
+    * @param velocity_block_min_value Sparsity threshold of the population.
+    * @return True if the block has content.*/
+   static inline bool block_data_has_content(const Realf* __restrict__ block_data,const Real velocity_block_min_value) {
+      int has_content = 0;
+      #pragma omp simd reduction(|:has_content)
+      for (unsigned int i=0; i<WID3; ++i) {
+         has_content |= block_data[i] >= velocity_block_min_value;
+      }
+      return has_content != 0;
+   }
+
    /*!
     Returns true if given velocity block has enough of a distribution function.
     Returns false if the value of the distribution function is too low in every
@@ -598,17 +614,7 @@ namespace spatial_cell {
       const vmesh::LocalID blockLID = get_velocity_block_local_id(blockGID,popID);
       if (blockLID == invalid_local_id()) return false;
 
-      bool has_content = false;
-      const Real velocity_block_min_value = getVelocityBlockMinValue(popID);
-      const Realf* block_data = populations[popID].blockContainer->getData(blockLID);
-      for (unsigned int i=0; i<WID3; ++i) {
-         if (block_data[i] >= velocity_block_min_value) {
-            has_content = true;
-            break;
-         }
-      }
-
-      return has_content;
+      return block_data_has_content(populations[popID].blockContainer->getData(blockLID),getVelocityBlockMinValue(popID));
    }
 
    /** Get maximum translation timestep for the given species.
@@ -836,6 +842,14 @@ namespace spatial_cell {
       int count;
       MPI_Datatype datatype;
 
+      if (!receiving && perfmetrics::sampling()) {
+         uint64_t bytes = 0;
+         for (const int length : block_lengths) {
+            bytes += length;
+         }
+         perfmetrics::addSentBytes(neighborhood, bytes);
+      }
+
       if (displacements.size() > 0) {
          count = 1;
          MPI_Type_create_hindexed(
@@ -1453,10 +1467,15 @@ namespace spatial_cell {
    /**  Purges extra capacity from block vectors. It sets size to
     * num_blocks * block_allocation_factor (if capacity greater than this),
     * and also forces capacity to this new smaller value.
+    * Without the velocity block pool this is disabled, as reallocating every
+    * cell after load balance fragments the heap. With the pool the released
+    * buffers are reused by other cells.
     * @return True on success.*/
    bool SpatialCell::shrink_to_fit() {
       bool success = true;
+      #ifndef VELOCITY_BLOCK_POOL
       return success;
+      #endif
 
       for (size_t p=0; p<populations.size(); ++p) {
          const uint64_t amount
@@ -1482,17 +1501,29 @@ namespace spatial_cell {
       }
       #endif
 
-      velocity_block_with_content_list->clear();
-      velocity_block_with_no_content_list->clear();
-
-      for (vmesh::LocalID block_index=0; block_index<populations[popID].vmesh->size(); ++block_index) {
+      // Blocks are scanned in local ID order straight from the block container, so
+      // no global to local ID lookups are needed. Each block ID is written to the end
+      // of both lists and only the counter of the list it belongs to is advanced.
+      const vmesh::LocalID nBlocks = populations[popID].vmesh->size();
+      const Real velocity_block_min_value = getVelocityBlockMinValue(popID);
+      const Realf* data = populations[popID].blockContainer->getData();
+      velocity_block_with_content_list->resize(nBlocks);
+      velocity_block_with_no_content_list->resize(nBlocks);
+      vmesh::GlobalID* with_content = velocity_block_with_content_list->data();
+      vmesh::GlobalID* with_no_content = velocity_block_with_no_content_list->data();
+      vmesh::LocalID n_with_content = 0;
+      vmesh::LocalID n_with_no_content = 0;
+
+      for (vmesh::LocalID block_index=0; block_index<nBlocks; ++block_index) {
          const vmesh::GlobalID globalID = populations[popID].vmesh->getGlobalID(block_index);
-         if (compute_block_has_content(globalID,popID)){
-            velocity_block_with_content_list->push_back(globalID);
-         } else {
-            velocity_block_with_no_content_list->push_back(globalID);
-         }
-      }
+         const bool has_content = block_data_has_content(data + block_index*WID3,velocity_block_min_value);
+         with_content[n_with_content] = globalID;
+         with_no_content[n_with_no_content] = globalID;
+         n_with_content += has_content;
+         n_with_no_content += !has_content;
+      }
+      velocity_block_with_content_list->resize(n_with_content);
+      velocity_block_with_no_content_list->resize(n_with_no_content);
    }
 
    void SpatialCell::printMeshSizes() {
@@ -25,6 +25,7 @@
 #include "spatial_cell_gpu.hpp"
 #include "arch/gpu_base.hpp"
 #include "object_wrapper.h"
+#include "perfmetrics.h"
 #include "velocity_mesh_parameters.h"
 
 #ifndef NDEBUG
@@ -1630,6 +1631,14 @@ namespace spatial_cell {
       int count;
       MPI_Datatype datatype;
 
+      if (!receiving && perfmetrics::sampling()) {
+         uint64_t bytes = 0;
+         for (const int length : block_lengths) {
+            bytes += length;
+         }
+         perfmetrics::addSentBytes(neighborhood, bytes);
+      }
+
       if (displacements.size() > 0) {
          count = 1;
          MPI_Type_create_hindexed(
@@ -47,7 +47,7 @@
 #endif
 
 namespace SBC {
-   Conductingsphere::Conductingsphere(): SysBoundaryCondition() { }
+   Conductingsphere::Conductingsphere(): FieldSolverBoundaryBatch<Conductingsphere, SysBoundaryCondition>() { }
    
    Conductingsphere::~Conductingsphere() { }
    
@@ -54,7 +54,7 @@ namespace SBC {
     *
     * For 3D magnetospheric simulations, you might be interesting in trying the ionosphere boundary instead!
     */
-   class Conductingsphere: public SysBoundaryCondition {
+   class Conductingsphere: public FieldSolverBoundaryBatch<Conductingsphere, SysBoundaryCondition> {
    public:
       Conductingsphere();
       virtual ~Conductingsphere();
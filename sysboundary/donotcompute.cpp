@@ -33,7 +33,7 @@
 using namespace std;
 
 namespace SBC {
-   DoNotCompute::DoNotCompute(): SysBoundaryCondition() { }
+   DoNotCompute::DoNotCompute(): FieldSolverBoundaryBatch<DoNotCompute, SysBoundaryCondition>() { }
    DoNotCompute::~DoNotCompute() { }
    
    void DoNotCompute::addParameters() { }
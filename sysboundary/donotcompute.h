@@ -36,7 +36,7 @@ namespace SBC {
     * 
     * DoNotCompute is a class handling cells tagged as sysboundarytype::DO_NOT_COMPUTE by a system boundary condition (e.g. SysBoundaryCondition::Ionosphere).
     */
-   class DoNotCompute: public SysBoundaryCondition {
+   class DoNotCompute: public FieldSolverBoundaryBatch<DoNotCompute, SysBoundaryCondition> {
    public:
       DoNotCompute();
       virtual ~DoNotCompute();
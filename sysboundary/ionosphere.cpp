@@ -2184,7 +2184,7 @@ namespace SBC {
    
    // Actual ionosphere object implementation
 
-   Ionosphere::Ionosphere(): SysBoundaryCondition() { }
+   Ionosphere::Ionosphere(): FieldSolverBoundaryBatch<Ionosphere, SysBoundaryCondition>() { }
 
    Ionosphere::~Ionosphere() { }
 
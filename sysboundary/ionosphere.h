@@ -318,7 +318,7 @@ namespace SBC {
     * - Keep only the normal perturbed B component and null out the other perturbed components (perfect conductor behavior);
     * - Null out the electric fields.
     */
-   class Ionosphere: public SysBoundaryCondition {
+   class Ionosphere: public FieldSolverBoundaryBatch<Ionosphere, SysBoundaryCondition> {
    public:
       Ionosphere();
       virtual ~Ionosphere();
@@ -44,7 +44,7 @@
 using namespace std;
 
 namespace SBC {
-   Outflow::Outflow(): OuterBoundaryCondition() { }
+   Outflow::Outflow(): FieldSolverBoundaryBatch<Outflow, OuterBoundaryCondition>() { }
    Outflow::~Outflow() { }
    
    void Outflow::addParameters() {
@@ -51,7 +51,7 @@ namespace SBC {
     * - Copy the distribution and moments from the nearest NOT_SYSBOUNDARY cell;
     * - Copy the perturbed B components from the nearest NOT_SYSBOUNDARY cell. EXCEPTION: the face components adjacent to the simulation domain at the +x/+y/+z faces are propagated still.
     */
-   class Outflow: public OuterBoundaryCondition {
+   class Outflow: public FieldSolverBoundaryBatch<Outflow, OuterBoundaryCondition> {
    public:
       Outflow();
       virtual ~Outflow();
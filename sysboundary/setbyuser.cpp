@@ -44,7 +44,7 @@
 using namespace std;
 
 namespace SBC {
-   SetByUser::SetByUser(): OuterBoundaryCondition() { }
+   SetByUser::SetByUser(): FieldSolverBoundaryBatch<SetByUser, OuterBoundaryCondition>() { }
    SetByUser::~SetByUser() { }
    
    bool SetByUser::initSysBoundary(
@@ -57,7 +57,7 @@ namespace SBC {
     * The daughter classes have then to handle parameters and generate the template cells as
     * wished from the data returned.
     */
-   class SetByUser: public OuterBoundaryCondition {
+   class SetByUser: public FieldSolverBoundaryBatch<SetByUser, OuterBoundaryCondition> {
    public:
       SetByUser();
       virtual ~SetByUser();
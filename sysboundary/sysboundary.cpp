@@ -723,9 +723,104 @@ bool SysBoundary::classifyCells(dccrg::Dccrg<spatial_cell::SpatialCell, dccrg::C
 
    technicalGrid.updateGhostCells();
 
+   buildFieldSolverBoundaryCells(technicalGrid);
+
    return success;
 }
 
+/*!\brief Collect the local fsgrid cells needing a field solver system boundary condition.
+ *
+ * The cells are grouped per system boundary condition and component, in the order
+ * the field solver passes used to visit them, and cut into batches of
+ * FIELD_SOLVER_BOUNDARY_BATCH cells so the passes can hand them out to threads.
+ * Has to be rerun whenever the technical flags change, i.e. from classifyCells.
+ *
+ * \param technicalGrid fsGrid holding the classified technical flags
+ */
+void SysBoundary::buildFieldSolverBoundaryCells(FsGrid<fsgrids::technical, FS_STENCIL_WIDTH>& technicalGrid) {
+   const size_t FIELD_SOLVER_BOUNDARY_BATCH = 128;
+   const std::array<int32_t, 3>& localSize = technicalGrid.getLocalSize();
+   const uint solveE[3] = {compute::EX, compute::EY, compute::EZ};
+   const uint solveB[3] = {compute::BX, compute::BY, compute::BZ};
+
+   typedef vector< array<int, 3> > CellList;
+   map< uint, array<CellList, 3> > electricField, magneticFieldL1, magneticFieldL2, ohmTerms;
+   map< uint, CellList > projection;
+
+   for (int k = 0; k < localSize[2]; k++) {
+      for (int j = 0; j < localSize[1]; j++) {
+         for (int i = 0; i < localSize[0]; i++) {
+            const fsgrids::technical* technical = technicalGrid.get(i, j, k);
+            cuint flag = technical->sysBoundaryFlag;
+            cint layer = technical->sysBoundaryLayer;
+            // DO_NOT_COMPUTE cells are skipped by the field solver and
+            // NOT_SYSBOUNDARY cells have no condition to apply.
+            if (flag == sysboundarytype::DO_NOT_COMPUTE || flag == sysboundarytype::NOT_SYSBOUNDARY) {
+               continue;
+            }
+            const array<int, 3> cell = {{i, j, k}};
+            for (uint component = 0; component < 3; component++) {
+               if ((technical->SOLVE & solveE[component]) != solveE[component]) {
+                  electricField[flag][component].push_back(cell);
+               }
+               if (layer == 1 && (technical->SOLVE & solveB[component]) != solveB[component]) {
+                  magneticFieldL1[flag][component].push_back(cell);
+               }
+               if (layer == 2) {
+                  magneticFieldL2[flag][component].push_back(cell);
+               }
+               if (layer != 1) {
+                  ohmTerms[flag][component].push_back(cell);
+               }
+            }
+            if (layer == 1 || layer == 2) {
+               projection[flag].push_back(cell);
+            }
+         }
+      }
+   }
+
+   auto addBatches = [&](vector<SysBoundaryCellBatch>& batches, const uint flag, const uint component, const CellList& cells) {
+      SBC::SysBoundaryCondition* sbc = this->getSysBoundary(flag);
+      if (sbc == NULL) {
+         return;
+      }
+      for (size_t begin = 0; begin < cells.size(); begin += FIELD_SOLVER_BOUNDARY_BATCH) {
+         const size_t end = min(cells.size(), begin + FIELD_SOLVER_BOUNDARY_BATCH);
+         SysBoundaryCellBatch batch;
+         batch.sbc = sbc;
+         batch.component = component;
+         batch.cells.assign(cells.begin() + begin, cells.begin() + end);
+         batches.push_back(batch);
+      }
+   };
+
+   fieldSolverBoundaryCells = FieldSolverBoundaryCells();
+   for (auto& it : electricField) {
+      for (uint component = 0; component < 3; component++) {
+         addBatches(fieldSolverBoundaryCells.electricField, it.first, component, it.second[component]);
+      }
+   }
+   for (auto& it : magneticFieldL1) {
+      for (uint component = 0; component < 3; component++) {
+         addBatches(fieldSolverBoundaryCells.magneticFieldL1, it.first, component, it.second[component]);
+      }
+   }
+   for (auto& it : magneticFieldL2) {
+      for (uint component = 0; component < 3; component++) {
+         addBatches(fieldSolverBoundaryCells.magneticFieldL2, it.first, component, it.second[component]);
+      }
+   }
+   for (auto& it : ohmTerms) {
+      for (uint component = 0; component < 3; component++) {
+         addBatches(fieldSolverBoundaryCells.ohmTerms, it.first, component, it.second[component]);
+      }
+   }
+   for (auto& it : projection) {
+      addBatches(fieldSolverBoundaryCells.magneticFieldProjection, it.first, 0, it.second);
+   }
+}
+
 /*!\brief Apply the initial state to all system boundary cells.
  * Loops through all SysBoundaryConditions and calls the corresponding applyInitialState
  * function. This function must apply the initial state for all existing particle species.
@@ -769,10 +864,12 @@ bool SysBoundary::applyInitialState(dccrg::Dccrg<SpatialCell, dccrg::Cartesian_G
  * \param mpiGrid Grid
  * \param t Current time
  * \param calculate_V_moments if true, compute into _V, false into _R moments so that the interpolated ones can be done
+ * \param computeTime If not NULL, the time spent in the boundary condition and moment computations is added to it,
+ * the remote neighbour transfers and their waits are not included
  */
 void SysBoundary::applySysBoundaryVlasovConditions(
     dccrg::Dccrg<SpatialCell, dccrg::Cartesian_Geometry>& mpiGrid, creal& t,
-    const bool calculate_V_moments) {
+    const bool calculate_V_moments, double* computeTime) {
 
    if (sysBoundaries.size() == 0) {
       return; // no system boundaries
@@ -799,6 +896,7 @@ void SysBoundary::applySysBoundaryVlasovConditions(
 
       timer = phiprof::initializeTimer("Compute process inner cells");
       phiprof::start(timer);
+      double computeStart = MPI_Wtime();
 
       // Compute Vlasov boundary condition on system boundary/process inner cells
       vector<CellID> localCells;
@@ -814,6 +912,9 @@ void SysBoundary::applySysBoundaryVlasovConditions(
       } else {
          calculateMoments_R(mpiGrid, localCells, true);
       }
+      if (computeTime != NULL) {
+         *computeTime += MPI_Wtime() - computeStart;
+      }
       phiprof::stop(timer);
 
       timer = phiprof::initializeTimer("Wait for receives", "MPI", "Wait");
@@ -824,6 +925,7 @@ void SysBoundary::applySysBoundaryVlasovConditions(
       // Compute vlasov boundary on system boundary/process boundary cells
       timer = phiprof::initializeTimer("Compute process boundary cells");
       phiprof::start(timer);
+      computeStart = MPI_Wtime();
       vector<CellID> boundaryCells;
       getBoundaryCellList(mpiGrid, mpiGrid.get_local_cells_on_process_boundary(SYSBOUNDARIES_EXTENDED_NEIGHBORHOOD_ID),
                           boundaryCells);
@@ -837,6 +939,9 @@ void SysBoundary::applySysBoundaryVlasovConditions(
       } else {
          calculateMoments_R(mpiGrid, boundaryCells, true);
       }
+      if (computeTime != NULL) {
+         *computeTime += MPI_Wtime() - computeStart;
+      }
       phiprof::stop(timer);
 
       // WARNING Blocks are changed but lists not updated now, if you need to use/communicate them before the next
@@ -860,6 +965,11 @@ SBC::SysBoundaryCondition* SysBoundary::getSysBoundary(cuint sysBoundaryType) co
    }
 }
 
+/*! Get the batches of local fsgrid cells needing field solver system boundary conditions.
+ * \retval fieldSolverBoundaryCells Batches built in the last call to classifyCells.
+ */
+const FieldSolverBoundaryCells& SysBoundary::getFieldSolverBoundaryCells() const { return fieldSolverBoundaryCells; }
+
 /*! Get the number of SysBoundaryConditions stored in SysBoundary.
  * \retval size Number of SysBoundaryConditions stored in SysBoundary.
  */
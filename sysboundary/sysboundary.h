@@ -23,6 +23,7 @@
 #ifndef SYSBOUNDARY_H
 #define SYSBOUNDARY_H
 
+#include <array>
 #include <map>
 #include <list>
 #include <vector>
@@ -51,6 +52,33 @@
  * If needed, a user can write his or her own SBC::SysBoundaryConditions, which 
  * are loaded when the simulation initializes.
  */
+/*! A batch of local fsgrid cells to which one system boundary condition applies
+ * its field solver boundary condition for one component.
+ */
+struct SysBoundaryCellBatch {
+   SBC::SysBoundaryCondition* sbc;
+   uint component;
+   std::vector< std::array<int, 3> > cells;
+};
+
+/*! The fsgrid cells of the field solver passes that need a system boundary
+ * condition, grouped into batches per boundary condition and component. Built
+ * in SysBoundary::classifyCells, so the field solver does not need to look up
+ * the condition of every cell in every step.
+ */
+struct FieldSolverBoundaryCells {
+   /*! Cells where the electric field component is not solved. */
+   std::vector<SysBoundaryCellBatch> electricField;
+   /*! Layer 1 cells where the magnetic field component is not solved. */
+   std::vector<SysBoundaryCellBatch> magneticFieldL1;
+   /*! Layer 2 system boundary cells, all three components. */
+   std::vector<SysBoundaryCellBatch> magneticFieldL2;
+   /*! Layer 1 and 2 system boundary cells needing the projection of B, component is unused. */
+   std::vector<SysBoundaryCellBatch> magneticFieldProjection;
+   /*! System boundary cells beyond layer 1 where the Hall and electron pressure gradient terms are set by the boundary. */
+   std::vector<SysBoundaryCellBatch> ohmTerms;
+};
+
 class SysBoundary {
  public:
    SysBoundary();
@@ -78,16 +106,18 @@ class SysBoundary {
                           FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & perBGrid,
                           Project& project
                          );
-   void applySysBoundaryVlasovConditions(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, creal& t, const bool calculate_V_moments);
+   void applySysBoundaryVlasovConditions(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, creal& t, const bool calculate_V_moments, double* computeTime = NULL);
    unsigned int size() const;
    SBC::SysBoundaryCondition* getSysBoundary(cuint sysBoundaryType) const;
    bool isDynamic() const;
    bool isBoundaryPeriodic(uint direction) const;
    bool updateSysBoundariesAfterLoadBalance(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
+   const FieldSolverBoundaryCells& getFieldSolverBoundaryCells() const;
 
    private:
       /*! Private copy-constructor to prevent copying the class. */
       SysBoundary(const SysBoundary& bc);
+      void buildFieldSolverBoundaryCells(FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid);
    
       //std::set<SBC::SysBoundaryCondition*,SBC::Comparator> sysBoundaries;
 
@@ -102,6 +132,8 @@ class SysBoundary {
 
       /*! Array of bool telling whether the system is periodic in any direction. */
       bool isPeriodic[3];
+      /*! Field solver boundary cells of the local fsgrid domain, see buildFieldSolverBoundaryCells. */
+      FieldSolverBoundaryCells fieldSolverBoundaryCells;
 };
 
 bool precedenceSort(const SBC::SysBoundaryCondition* first, 
@@ -286,7 +286,73 @@ namespace SBC {
             cerr << __FILE__ << ":" << __LINE__ << ":" << " Invalid component" << endl;
       }
    }
-   
+
+   /*! Default batched magnetic field boundary condition, calls fieldSolverBoundaryCondMagneticField for each cell.
+    * Derived classes normally get a devirtualized version from FieldSolverBoundaryBatch.
+    */
+   void SysBoundaryCondition::fieldSolverBoundaryCondMagneticFieldBatch(
+      FsGrid< array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & bGrid,
+      FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+      const array<int, 3>* cells,
+      const size_t n,
+      creal& dt,
+      cuint& component
+   ) {
+      for (size_t c = 0; c < n; c++) {
+         const array<int, 3>& cell = cells[c];
+         bGrid.get(cell[0], cell[1], cell[2])->at(fsgrids::bfield::PERBX + component) =
+            fieldSolverBoundaryCondMagneticField(bGrid, technicalGrid, cell[0], cell[1], cell[2], dt, component);
+      }
+   }
+
+   /*! Default batched magnetic field projection, calls fieldSolverBoundaryCondMagneticFieldProjection for each cell.*/
+   void SysBoundaryCondition::fieldSolverBoundaryCondMagneticFieldProjectionBatch(
+      FsGrid< array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & bGrid,
+      FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+      const array<int, 3>* cells,
+      const size_t n
+   ) {
+      for (size_t c = 0; c < n; c++) {
+         fieldSolverBoundaryCondMagneticFieldProjection(bGrid, technicalGrid, cells[c][0], cells[c][1], cells[c][2]);
+      }
+   }
+
+   /*! Default batched electric field boundary condition, calls fieldSolverBoundaryCondElectricField for each cell.*/
+   void SysBoundaryCondition::fieldSolverBoundaryCondElectricFieldBatch(
+      FsGrid< array<Real, fsgrids::efield::N_EFIELD>, FS_STENCIL_WIDTH> & EGrid,
+      const array<int, 3>* cells,
+      const size_t n,
+      cuint component
+   ) {
+      for (size_t c = 0; c < n; c++) {
+         fieldSolverBoundaryCondElectricField(EGrid, cells[c][0], cells[c][1], cells[c][2], component);
+      }
+   }
+
+   /*! Default batched Hall field boundary condition, calls fieldSolverBoundaryCondHallElectricField for each cell.*/
+   void SysBoundaryCondition::fieldSolverBoundaryCondHallElectricFieldBatch(
+      FsGrid< array<Real, fsgrids::ehall::N_EHALL>, FS_STENCIL_WIDTH> & EHallGrid,
+      const array<int, 3>* cells,
+      const size_t n,
+      cuint component
+   ) {
+      for (size_t c = 0; c < n; c++) {
+         fieldSolverBoundaryCondHallElectricField(EHallGrid, cells[c][0], cells[c][1], cells[c][2], component);
+      }
+   }
+
+   /*! Default batched electron pressure gradient field boundary condition, calls fieldSolverBoundaryCondGradPeElectricField for each cell.*/
+   void SysBoundaryCondition::fieldSolverBoundaryCondGradPeElectricFieldBatch(
+      FsGrid< array<Real, fsgrids::egradpe::N_EGRADPE>, FS_STENCIL_WIDTH> & EGradPeGrid,
+      const array<int, 3>* cells,
+      const size_t n,
+      cuint component
+   ) {
+      for (size_t c = 0; c < n; c++) {
+         fieldSolverBoundaryCondGradPeElectricField(EGradPeGrid, cells[c][0], cells[c][1], cells[c][2], component);
+      }
+   }
+
    /*! Function used to copy the distribution and moments from (one of) the closest sysboundarytype::NOT_SYSBOUNDARY cell.
     * \param mpiGrid Grid
     * \param cellID The cell's ID.
@@ -127,6 +127,43 @@ namespace SBC {
             cint k,
             cuint& component
          )=0;
+
+         /* Batched versions of the field solver boundary conditions, applied to
+          * the n fsgrid cells in cells. The magnetic field version stores the
+          * returned values in bGrid. The defaults loop over the virtual per-cell
+          * functions, FieldSolverBoundaryBatch overrides them with direct calls. */
+         virtual void fieldSolverBoundaryCondMagneticFieldBatch(
+            FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & bGrid,
+            FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            creal& dt,
+            cuint& component
+         );
+         virtual void fieldSolverBoundaryCondMagneticFieldProjectionBatch(
+            FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & bGrid,
+            FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+            const std::array<int, 3>* cells,
+            const size_t n
+         );
+         virtual void fieldSolverBoundaryCondElectricFieldBatch(
+            FsGrid< std::array<Real, fsgrids::efield::N_EFIELD>, FS_STENCIL_WIDTH> & EGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            cuint component
+         );
+         virtual void fieldSolverBoundaryCondHallElectricFieldBatch(
+            FsGrid< std::array<Real, fsgrids::ehall::N_EHALL>, FS_STENCIL_WIDTH> & EHallGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            cuint component
+         );
+         virtual void fieldSolverBoundaryCondGradPeElectricFieldBatch(
+            FsGrid< std::array<Real, fsgrids::egradpe::N_EGRADPE>, FS_STENCIL_WIDTH> & EGradPeGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            cuint component
+         );
          static void setCellDerivativesToZero(
             FsGrid< std::array<Real, fsgrids::dperb::N_DPERB>, FS_STENCIL_WIDTH> & dPerBGrid,
             FsGrid< std::array<Real, fsgrids::dmoments::N_DMOMENTS>, FS_STENCIL_WIDTH> & dMomentsGrid,
@@ -312,7 +349,77 @@ namespace SBC {
          /*! Array of bool telling which faces are going to be processed by the system boundary condition.*/
          bool facesToProcess[6];
    };
-   
+
+   /*!\brief Implements the batched field solver functions of SysBoundaryCondition
+    * for Derived by calling its per-cell functions directly.
+    *
+    * The calls are qualified, so the loops over the boundary cells of one condition
+    * do not go through the vtable and the per-cell functions can be inlined into
+    * them. Used as class X: public FieldSolverBoundaryBatch<X, SysBoundaryCondition>.
+    */
+   template<typename Derived, typename Base> class FieldSolverBoundaryBatch: public Base {
+      public:
+         virtual void fieldSolverBoundaryCondMagneticFieldBatch(
+            FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & bGrid,
+            FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            creal& dt,
+            cuint& component
+         ) {
+            Derived* self = static_cast<Derived*>(this);
+            for (size_t c = 0; c < n; c++) {
+               const std::array<int, 3>& cell = cells[c];
+               bGrid.get(cell[0], cell[1], cell[2])->at(fsgrids::bfield::PERBX + component) =
+                  self->Derived::fieldSolverBoundaryCondMagneticField(bGrid, technicalGrid, cell[0], cell[1], cell[2], dt, component);
+            }
+         }
+         virtual void fieldSolverBoundaryCondMagneticFieldProjectionBatch(
+            FsGrid< std::array<Real, fsgrids::bfield::N_BFIELD>, FS_STENCIL_WIDTH> & bGrid,
+            FsGrid< fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid,
+            const std::array<int, 3>* cells,
+            const size_t n
+         ) {
+            Derived* self = static_cast<Derived*>(this);
+            for (size_t c = 0; c < n; c++) {
+               self->Derived::fieldSolverBoundaryCondMagneticFieldProjection(bGrid, technicalGrid, cells[c][0], cells[c][1], cells[c][2]);
+            }
+         }
+         virtual void fieldSolverBoundaryCondElectricFieldBatch(
+            FsGrid< std::array<Real, fsgrids::efield::N_EFIELD>, FS_STENCIL_WIDTH> & EGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            cuint component
+         ) {
+            Derived* self = static_cast<Derived*>(this);
+            for (size_t c = 0; c < n; c++) {
+               self->Derived::fieldSolverBoundaryCondElectricField(EGrid, cells[c][0], cells[c][1], cells[c][2], component);
+            }
+         }
+         virtual void fieldSolverBoundaryCondHallElectricFieldBatch(
+            FsGrid< std::array<Real, fsgrids::ehall::N_EHALL>, FS_STENCIL_WIDTH> & EHallGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            cuint component
+         ) {
+            Derived* self = static_cast<Derived*>(this);
+            for (size_t c = 0; c < n; c++) {
+               self->Derived::fieldSolverBoundaryCondHallElectricField(EHallGrid, cells[c][0], cells[c][1], cells[c][2], component);
+            }
+         }
+         virtual void fieldSolverBoundaryCondGradPeElectricFieldBatch(
+            FsGrid< std::array<Real, fsgrids::egradpe::N_EGRADPE>, FS_STENCIL_WIDTH> & EGradPeGrid,
+            const std::array<int, 3>* cells,
+            const size_t n,
+            cuint component
+         ) {
+            Derived* self = static_cast<Derived*>(this);
+            for (size_t c = 0; c < n; c++) {
+               self->Derived::fieldSolverBoundaryCondGradPeElectricField(EGradPeGrid, cells[c][0], cells[c][1], cells[c][2], component);
+            }
+         }
+   };
+
    // Moved outside the class since it's a helper function that doesn't require member access
    void averageCellData (
       const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
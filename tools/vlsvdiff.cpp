@@ -53,6 +53,11 @@
 #include <typeinfo>
 #include <algorithm>
 #include <cstring>
+#include <numeric>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "definitions.h"
 #include <vlsv_reader.h>
@@ -76,6 +81,58 @@ enum gridType{
    ionosphere
 };
 
+// Variable data is read in chunks of at most this many bytes
+static const uint64_t readChunkBytes = 64*1024*1024;
+
+/*! One component of a variable read from a VLSV file, as flat arrays sorted by cell ID.
+ * fileIndex is the position of each cell in the file, the difference output
+ * of SpatialGrid data is written in that order.
+ */
+struct CellData {
+   vector<uint64_t> ids;
+   vector<Real> values;
+   vector<uint64_t> fileIndex;
+
+   size_t size() const {
+      return ids.size();
+   }
+
+   void clear() {
+      ids.clear();
+      values.clear();
+      fileIndex.clear();
+   }
+
+   void push_back(const uint64_t id, const Real value) {
+      fileIndex.push_back(ids.size());
+      ids.push_back(id);
+      values.push_back(value);
+   }
+
+   /*! Sort by cell ID. Of repeated IDs the first one read is kept.*/
+   void sortById() {
+      if (is_sorted(ids.begin(), ids.end()) && adjacent_find(ids.begin(), ids.end()) == ids.end()) {
+         return;
+      }
+      vector<uint64_t> order(ids.size());
+      iota(order.begin(), order.end(), 0);
+      stable_sort(order.begin(), order.end(), [this](const uint64_t a, const uint64_t b) {
+         return ids[a] < ids[b];
+      });
+      CellData sorted;
+      sorted.ids.reserve(ids.size());
+      sorted.values.reserve(ids.size());
+      sorted.fileIndex.reserve(ids.size());
+      for (const uint64_t i : order) {
+         if (sorted.ids.size() > 0 && sorted.ids.back() == ids[i]) continue;
+         sorted.ids.push_back(ids[i]);
+         sorted.values.push_back(values[i]);
+         sorted.fileIndex.push_back(fileIndex[i]);
+      }
+      swap(*this, sorted);
+   }
+};
+
 
 static uint64_t convUInt(const char* ptr, const vlsv::datatype::type& dataType, const uint64_t& dataSize) {
    if (dataType != vlsv::datatype::type::UINT) {
@@ -166,7 +223,7 @@ bool copyArray(vlsv::Reader& input,vlsv::Writer& output,
 /* Small function that overrides how fsgrid diff files are written*/
 bool HandleFsGrid(const string& inputFileName,
                   vlsv::Writer& output,
-                  std::map<uint, Real> orderedData)
+                  const CellData& cellData)
 {
    
 
@@ -224,10 +281,7 @@ bool HandleFsGrid(const string& inputFileName,
 
 
    //Get the global IDs in a vector
-   std::vector<uint64_t> globalIds;
-   for (const auto iter : orderedData){
-      globalIds.push_back( iter.first   );
-   }
+   std::vector<uint64_t> globalIds = cellData.ids;
    
    //Write to file
    output.writeArray("MESH",patch,arraysize,1,&globalIds[0]);
@@ -282,7 +336,7 @@ bool HandleFsGrid(const string& inputFileName,
  * @param output VLSV reader for the file where the cloned mesh is written.
  * @param meshName Name of the mesh.
  * @return If true, the mesh was successfully cloned.*/
-bool cloneMesh(const string& inputFileName,vlsv::Writer& output,const string& meshName, std::map<uint, Real> orderedData) {
+bool cloneMesh(const string& inputFileName,vlsv::Writer& output,const string& meshName, const CellData& cellData) {
    bool success = true;
             
    vlsv::Reader input;
@@ -317,7 +371,7 @@ bool cloneMesh(const string& inputFileName,vlsv::Writer& output,const string& me
       inputAttribs.push_back(make_pair("name",meshName));
       if (copyArray(input,output,"MESH",inputAttribs) == false) success = false;
    }else{
-      HandleFsGrid(inputFileName,output,orderedData);
+      HandleFsGrid(inputFileName,output,cellData);
    }
 
    input.close();
@@ -404,18 +458,16 @@ bool cloneMesh(const string& inputFileName,vlsv::Writer& output,const string& me
  * \param meshName Address of the string containing the name of the mesh to be extracted
  * \param varToExtract Pointer to the char array containing the name of the variable to extract
  * \param compToExtract Unsigned int designating the component to extract (0 for scalars)
- * \param orderedData Pointer to the return argument map which will get the extracted dataset
+ * \param cellData Pointer to the return argument which will get the extracted dataset, sorted by cell ID
  */
 bool convertMesh(vlsvinterface::Reader& vlsvReader,
                  const string& meshName,
                  const char * varToExtract,
                  const uint compToExtract,
-                 map<uint, Real> * orderedData,
-                 unordered_map<size_t,size_t>& cellOrder,
-                 const bool& storeCellOrder) {
+                 CellData * cellData) {
 
    //Check for null pointer:
-   if( !varToExtract || !orderedData ) {
+   if( !varToExtract || !cellData ) {
       cerr << "ERROR, PASSED A NULL POINTER AT " << __FILE__ << " " << __LINE__ << endl;
       return false;
    }
@@ -440,14 +492,6 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
    switch(gridName) {
       case gridType::SpatialGrid:
          {
-            std::vector<char> variableBuffer(variableVectorSize * variableDataSize);
-            float *variablePtrFloat = reinterpret_cast<float *>(variableBuffer.data());
-            double *variablePtrDouble = reinterpret_cast<double *>(variableBuffer.data());
-            uint *variablePtrUint = reinterpret_cast<uint *>(variableBuffer.data());
-            int *variablePtrInt = reinterpret_cast<int *>(variableBuffer.data());
-
-            // Read the mesh array one node (of a spatial cell) at a time
-            // and create a map which contains each cell's CellID and variable to be extracted
             //Get local cell ids:
             vector<uint64_t> local_cells;
             if ( vlsvReader.getCellIds( local_cells, meshName) == false ) {
@@ -464,45 +508,49 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                abort();
             }
 
-            if (storeCellOrder == true) {
-               cellOrder.clear();
-            }
-
-            orderedData->clear();
-
-            for (uint64_t i=0; i<local_cells.size(); ++i) {
-               const short int amountToReadIn = 1;
-               const uint64_t & startingReadIndex = i;
-               if (vlsvReader.readArray("VARIABLE", variableAttributes, startingReadIndex, amountToReadIn, variableBuffer.data()) == false) {
+            cellData->clear();
+            cellData->ids.resize(local_cells.size());
+            cellData->values.resize(local_cells.size());
+            cellData->fileIndex.resize(local_cells.size());
+
+            // Read the variable array in chunks of whole cells and pick the
+            // component to extract from each cell in parallel
+            const uint64_t cellBytes = variableVectorSize * variableDataSize;
+            const uint64_t chunkCells = max((uint64_t)1, readChunkBytes / cellBytes);
+            std::vector<char> variableBuffer(min(chunkCells, (uint64_t)local_cells.size()) * cellBytes);
+            for (uint64_t start=0; start<local_cells.size(); start+=chunkCells) {
+               const uint64_t amountToReadIn = min(chunkCells, local_cells.size() - start);
+               if (vlsvReader.readArray("VARIABLE", variableAttributes, start, amountToReadIn, variableBuffer.data()) == false) {
                   cerr << "ERROR, failed to read variable '" << _varToExtract << "' at " << __FILE__ << " " << __LINE__ << endl;
-                  variableSuccess = false; 
+                  variableSuccess = false;
                   break;
                }
-               // Get the CellID
-               uint64_t & CellID = local_cells[i];
-
-               // Get the variable value
-               Real extract = NAN;
-
-               switch (variableDataType) {
-                  case datatype::type::FLOAT:
-                     if(variableDataSize == sizeof(float)) extract = (Real)(variablePtrFloat[compToExtract]);
-                     if(variableDataSize == sizeof(double)) extract = (Real)(variablePtrDouble[compToExtract]);
-                     break;
-                  case datatype::type::UINT:
-                     extract = (Real)(variablePtrUint[compToExtract]);
-                     break;
-                  case datatype::type::INT:
-                     extract = (Real)(variablePtrInt[compToExtract]);
-                     break;
-                  case datatype::type::UNKNOWN:
-                     cerr << "ERROR, BAD DATATYPE AT " << __FILE__ << " " << __LINE__ << endl;
-                     break;
+               #pragma omp parallel for
+               for (uint64_t c=0; c<amountToReadIn; ++c) {
+                  const char* cellPtr = variableBuffer.data() + c * cellBytes;
+                  // Get the variable value
+                  Real extract = NAN;
+
+                  switch (variableDataType) {
+                     case datatype::type::FLOAT:
+                        if(variableDataSize == sizeof(float)) extract = (Real)(reinterpret_cast<const float*>(cellPtr)[compToExtract]);
+                        if(variableDataSize == sizeof(double)) extract = (Real)(reinterpret_cast<const double*>(cellPtr)[compToExtract]);
+                        break;
+                     case datatype::type::UINT:
+                        extract = (Real)(reinterpret_cast<const uint*>(cellPtr)[compToExtract]);
+                        break;
+                     case datatype::type::INT:
+                        extract = (Real)(reinterpret_cast<const int*>(cellPtr)[compToExtract]);
+                        break;
+                     default:
+                        break;
+                  }
+                  cellData->ids[start + c] = local_cells[start + c];
+                  cellData->values[start + c] = extract;
+                  cellData->fileIndex[start + c] = start + c;
                }
-               // Put those into the map
-               orderedData->insert(pair<uint64_t, Real>(CellID, extract));
-               if (storeCellOrder == true) {
-                  cellOrder[CellID] = i;
+               if (variableDataType == datatype::type::UNKNOWN) {
+                  cerr << "ERROR, BAD DATATYPE AT " << __FILE__ << " " << __LINE__ << endl;
                }
             }
          }
@@ -547,7 +595,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
             std::array<int32_t,3> taskEnd;
             int readOffset=0;
             int index,my_x,my_y,my_z;
-            orderedData->clear();
+            cellData->clear();
 
             for (int task=0; task<numtasks; task++){
 
@@ -613,8 +661,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                               cerr << "ERROR, BAD DATATYPE AT " << __FILE__ << " " << __LINE__ << endl;
                               break;
                         }
-                        //Add to map
-                        orderedData->insert(pair<uint64_t, Real>(globalindex, data));
+                        cellData->push_back(globalindex, data);
                         counter+=variableVectorSize;
                      }
                   }
@@ -631,7 +678,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
             cerr << "ERROR invalid component, this variable has size " << variableVectorSize << endl;
             abort();
          }
-         orderedData->clear();
+         cellData->clear();
          
          switch(variableDataType) {
             case datatype::type::FLOAT: 
@@ -646,7 +693,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                      }
 
                      for(unsigned int i=0; i<variableArraySize; i++) {
-                        orderedData->insert(pair<uint64_t, Real>(i, buffer[i*variableVectorSize + compToExtract]));
+                        cellData->push_back(i, buffer[i*variableVectorSize + compToExtract]);
                      }
                   } else if(variableDataSize == sizeof(float)) {
                      std::vector<double> buffer(variableVectorSize * variableArraySize);
@@ -658,7 +705,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                      }
 
                      for(unsigned int i=0; i<variableArraySize; i++) {
-                        orderedData->insert(pair<uint64_t, Real>(i, buffer[i*variableVectorSize + compToExtract]));
+                        cellData->push_back(i, buffer[i*variableVectorSize + compToExtract]);
                      }
                   }
                }
@@ -674,6 +721,8 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
          abort();
    }
 
+   cellData->sortById();
+
    if (meshSuccess == false) {
       cerr << "ERROR reading array MESH" << endl;
    }
@@ -687,16 +736,14 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
  * \param fileName String containing the name of the file to be processed
  * \param varToExtract Pointer to the char array containing the name of the variable to extract
  * \param compToExtract Unsigned int designating the component to extract (0 for scalars)
- * \param orderedData Pointer to the return argument map which will get the extracted dataset
+ * \param cellData Pointer to the return argument which will get the extracted dataset
  * \sa convertMesh
  */
 template <class T>
 bool convertSILO(const string fileName,
                  const char * varToExtract,
                  const uint compToExtract,
-                 map<uint, Real> * orderedData,
-                 unordered_map<size_t,size_t>& cellOrder,
-                 const bool& storeCellOrder=false) {
+                 CellData * cellData) {
    bool success = true;
 
    // Open VLSV file for reading:
@@ -716,12 +763,12 @@ bool convertSILO(const string fileName,
    }
 
    // Clear old data
-   orderedData->clear();
+   cellData->clear();
 
    for (list<string>::const_iterator it=meshNames.begin(); it!=meshNames.end(); ++it) {
-      if (*it != attributes["--meshname"]) continue;
+      if (*it != attributes.at("--meshname")) continue;
 
-      if (convertMesh(vlsvReader, *it, varToExtract, compToExtract, orderedData, cellOrder, storeCellOrder) == false) {
+      if (convertMesh(vlsvReader, *it, varToExtract, compToExtract, cellData) == false) {
          return false;
       }      
    }
@@ -729,38 +776,70 @@ bool convertSILO(const string fileName,
    return success;
 }
 
+/*! Match the cells of the second dataset to the cells of the first one.
+ * \param cellData1 Reference file's data
+ * \param cellData2 Second file's data
+ * \return For each cell of the first dataset the index of the same cell in the second dataset, -1 if it is missing
+ */
+static vector<int64_t> alignCells(const CellData& cellData1, const CellData& cellData2) {
+   vector<int64_t> match(cellData1.size(), -1);
+   const vector<uint64_t>& ids1 = cellData1.ids;
+   const vector<uint64_t>& ids2 = cellData2.ids;
+
+   // Both ID lists are sorted, each thread merges its own contiguous range of the first list
+   #pragma omp parallel
+   {
+      #ifdef _OPENMP
+      const size_t nThreads = omp_get_num_threads();
+      const size_t thread = omp_get_thread_num();
+      #else
+      const size_t nThreads = 1;
+      const size_t thread = 0;
+      #endif
+      const size_t begin = ids1.size() * thread / nThreads;
+      const size_t end = ids1.size() * (thread + 1) / nThreads;
+      if (begin < end) {
+         size_t j = lower_bound(ids2.begin(), ids2.end(), ids1[begin]) - ids2.begin();
+         for (size_t i=begin; i<end; ++i) {
+            while (j < ids2.size() && ids2[j] < ids1[i]) ++j;
+            if (j < ids2.size() && ids2[j] == ids1[i]) match[i] = j;
+         }
+      }
+   }
+   return match;
+}
+
 /*! Shift the second file to the average of the first
- * \param orderedData1 Pointer to the reference file's data
- * \param orderedData2 Pointer to the data to be shifted
- * \param shiftedData2 Pointer to where the shifted data of the second file will be put
+ * \param cellData1 Reference file's data
+ * \param cellData2 Data to be shifted
+ * \param shiftedValues2 Return argument, the shifted values of the second file in the order of cellData2
  */
-bool shiftAverage(const map<uint, Real>* const orderedData1,
-                  const map<uint, Real>* const orderedData2,
-                  map<uint,Real>* shiftedData2
+bool shiftAverage(const CellData& cellData1,
+                  const CellData& cellData2,
+                  vector<Real>& shiftedValues2
                  ) {
-   map<uint, Real>::const_iterator it1, it2;
    Real avg1 = 0.0;
    Real avg2 = 0.0;
    
-   for(it1=orderedData1->begin(), it2=orderedData2->begin();
-       it1 != orderedData1->end(), it2 != orderedData2->end();
-       it1++, it2++)
-   {
-      avg1 += orderedData1->at(it1->first);
-      avg2 += orderedData2->at(it2->first);
-   }
-   avg1 /= orderedData1->size();
-   avg2 /= orderedData1->size();
+   // Summed sequentially in cell ID order so that the result does not depend on the thread count
+   const size_t n = min(cellData1.size(), cellData2.size());
+   for (size_t i=0; i<n; ++i) {
+      avg1 += cellData1.values[i];
+      avg2 += cellData2.values[i];
+   }
+   avg1 /= cellData1.size();
+   avg2 /= cellData1.size();
    
-   for(it2=orderedData2->begin(); it2 != orderedData2->end(); it2++)
-   {
-      shiftedData2->insert(pair<uint, Real>(it2->first, it2->second - avg2 + avg1));
+   shiftedValues2.resize(cellData2.size());
+   #pragma omp parallel for
+   for (size_t i=0; i<cellData2.size(); ++i) {
+      shiftedValues2[i] = cellData2.values[i] - avg2 + avg1;
    }
    
    return 0;
 }
 
-/*! Compute the absolute and relative \f$ p \f$-distance between two datasets X(x) provided in the maps orderedData1 and orderedData2. Note that the dataset passed in orderedData1 will be taken as the reference dataset both when shifting averages and when computing relative distances.
+/*! Compute the absolute and relative \f$ p \f$-distance between two datasets X(x) provided in cellData1 and cellData2. Note that the dataset passed in cellData1 will be taken as the reference dataset both when shifting averages and when computing relative distances.
  * 
  * For \f$ p \neq 0 \f$:
  * 
@@ -782,96 +861,98 @@ bool shiftAverage(const map<uint, Real>* const orderedData1,
  * 
  * \f$ \|X_1 - X_2\|_\infty = \max_i\left(|X_1(i) - X_2(i)|\right) / \|X_1\|_\infty \f$
  * 
- * \param orderedData1 Pointer to the first file's data map
- * \param orderedData2 Pointer to the second file's data map
+ * The per-cell terms are computed in parallel, the sums are accumulated in cell ID order.
+ * 
+ * \param cellData1 The first file's data
+ * \param cellData2 The second file's data
+ * \param match Index of each cell of cellData1 in cellData2, from alignCells
  * \param p Parameter of the distance formula
  * \param absolute Return argument pointer, absolute value
  * \param relative Return argument pointer, relative value
  * \param doShiftAverage Boolean argument to determine whether to shift the second file's data
- * \sa shiftAverage
+ * \param out Stream for warnings
+ * \sa shiftAverage alignCells
  */
-bool pDistance(const map<uint, Real>& orderedData1,
-               const map<uint, Real>& orderedData2,
+bool pDistance(const CellData& cellData1,
+               const CellData& cellData2,
+               const vector<int64_t>& match,
                creal p,
                Real * absolute,
                Real * relative,
                const bool doShiftAverage,
-               const unordered_map<size_t,size_t>& cellOrder,
                vlsv::Writer& outputFile,
                const std::string& meshName,
-               const std::string& varName
+               const std::string& varName,
+               ostream& out
               ) {
-   map<uint,Real> shiftedData2;
-   map<uint,Real>* data2 = const_cast< map<uint,Real>* >(&orderedData2);   
+   vector<Real> shiftedValues2;
+   const vector<Real>* values2 = &cellData2.values;
 
    if (doShiftAverage == true) {
-      shiftAverage(&orderedData1,&orderedData2,&shiftedData2);
-      data2 = &shiftedData2;
+      shiftAverage(cellData1,cellData2,shiftedValues2);
+      values2 = &shiftedValues2;
    }
 
    // Reset old values
    *absolute = 0.0;
    *relative = 0.0;
 
-   vector<Real> array(orderedData1.size());
-   for (size_t i=0; i<array.size(); ++i) array[i] = -1.0;
+   const size_t n = cellData1.size();
+   vector<Real> array(n, -1.0);
+   vector<Real> diffTerm(n, 0.0);
+   vector<Real> refTerm(n, 0.0);
+
+   #pragma omp parallel for
+   for (size_t i=0; i<n; ++i) {
+      if (match[i] < 0) continue;
+      const Real value1 = cellData1.values[i];
+      const Real value2 = (*values2)[match[i]];
+      if (p == 0 || p == 1) {
+         diffTerm[i] = abs(value1 - value2);
+         refTerm[i] = abs(value1);
+      } else {
+         diffTerm[i] = pow(abs(value1 - value2), p);
+         refTerm[i] = pow(abs(value1), p);
+      }
+   }
+
+   // Write the per-cell difference in file order (SpatialGrid) or at its global index
+   #pragma omp parallel for
+   for (size_t i=0; i<n; ++i) {
+      const size_t position = (gridName == gridType::SpatialGrid) ? cellData1.fileIndex[i] : cellData1.ids[i];
+      const Real value = (p == 0 || p == 1) ? diffTerm[i] : pow(diffTerm[i], 1.0/p);
+      if (gridName == gridType::SpatialGrid) {
+         array[position] = value;
+      } else {
+         array.at(position) = value;
+      }
+   }
 
    Real length = 0.0;
    if (p == 0) {
-      for (map<uint,Real>::const_iterator it1=orderedData1.begin(); it1!=orderedData1.end(); ++it1) {
-         map<uint,Real>::const_iterator it2 = data2->find(it1->first);
-         Real value = 0.0;
-         if (it2 != data2->end()) {
-            value = abs(it1->second - it2->second);
-            *absolute = max(*absolute, value);
-            length    = max(length, abs(it1->second));
-         
-            }
-         if (gridName==gridType::SpatialGrid){  
-            array[cellOrder.at(it1->first)] = value;
-         }else if (gridName==gridType::fsgrid || gridName==gridType::ionosphere) {   
-            array.at(it1->first)=value;
-         }  
-      }
-   } else if (p == 1) {
-      for (map<uint,Real>::const_iterator it1=orderedData1.begin(); it1!=orderedData1.end(); ++it1) {
-         map<uint,Real>::const_iterator it2 = data2->find(it1->first);
-         Real value = 0.0;
-         if (it2 != data2->end()) {
-            value = abs(it1->second - it2->second);
-            *absolute += value;
-            length    += abs(it1->second);
-         
-            }
-         if (gridName==gridType::SpatialGrid){  
-            array[cellOrder.at(it1->first)] = value;
-         }else if (gridName==gridType::fsgrid || gridName==gridType::ionosphere) {   
-            array[it1->first]=value;
-         }  
+      Real maxDiff = 0.0;
+      Real maxRef = 0.0;
+      #pragma omp parallel for reduction(max:maxDiff,maxRef)
+      for (size_t i=0; i<n; ++i) {
+         maxDiff = max(maxDiff, diffTerm[i]);
+         maxRef = max(maxRef, refTerm[i]);
       }
+      *absolute = maxDiff;
+      length = maxRef;
    } else {
-      for (map<uint,Real>::const_iterator it1=orderedData1.begin(); it1!=orderedData1.end(); ++it1) {
-         map<uint,Real>::const_iterator it2 = data2->find(it1->first);
-         Real value = 0.0;
-         if (it2 != data2->end()) {
-            value = pow(abs(it1->second - it2->second), p);
-            *absolute += value;
-            length    += pow(abs(it1->second), p);
-         
-            }
-         if (gridName==gridType::SpatialGrid){  
-            array[cellOrder.at(it1->first)] = pow(value,1.0/p);
-         }else if (gridName==gridType::fsgrid || gridName==gridType::ionosphere) {   
-            array[it1->first]=pow(value,1.0/p);
-         }  
+      for (size_t i=0; i<n; ++i) {
+         *absolute += diffTerm[i];
+         length += refTerm[i];
+      }
+      if (p != 1) {
+         *absolute = pow(*absolute, 1.0 / p);
+         length = pow(length, 1.0 / p);
       }
-      *absolute = pow(*absolute, 1.0 / p);
-      length = pow(length, 1.0 / p);
    }
 
    if (length != 0.0) *relative = *absolute / length;
    else {
-      cout << "WARNING (pDistance) : length of reference is 0.0, cannot divide to give relative distance." << endl;
+      out << "WARNING (pDistance) : length of reference is 0.0, cannot divide to give relative distance." << endl;
       *relative = -1;
    }
 
@@ -894,13 +975,14 @@ bool pDistance(const map<uint, Real>& orderedData1,
    return 0;
 }
 
-/*! In verbose mode print the distance, in non-verbose store them for later output when lastCall is true
+/*! In verbose mode print the distance, in non-verbose append them to the row of the file pair
  * \param p Parameter of the distance
  * \param absolute Absolute value pointer
  * \param relative Relative value pointer
  * \param shiftedAverage Boolean parameter telling whether the dataset is average-shifted
  * \param verboseOutput Boolean parameter telling whether the output is verbose or compact
- * \param lastCall Boolean parameter telling whether this is the last call to the function
+ * \param row Non-verbose output row of the file pair
+ * \param out Stream for verbose output
  * \sa shiftAverage pDistance
  */
 bool outputDistance(const Real p,
@@ -908,44 +990,34 @@ bool outputDistance(const Real p,
                     const Real * relative,
                     const bool shiftedAverage,
                     const bool verboseOutput,
-                    const bool lastCall
+                    vector<Real>& row,
+                    ostream& out
 )
 {
    if(verboseOutput == true) {
       if(shiftedAverage == false) {
-         cout << "The absolute " << p << "-distance between both datasets is " << *absolute  << endl;
-         cout << "The relative " << p << "-distance between both datasets is " << *relative  << endl;
+         out << "The absolute " << p << "-distance between both datasets is " << *absolute  << endl;
+         out << "The relative " << p << "-distance between both datasets is " << *relative  << endl;
       } else {
-         cout << "The average-shifted absolute " << p << "-distance between both datasets is " << *absolute  << endl;
-         cout << "The average-shifted relative " << p << "-distance between both datasets is " << *relative  << endl;
+         out << "The average-shifted absolute " << p << "-distance between both datasets is " << *absolute  << endl;
+         out << "The average-shifted relative " << p << "-distance between both datasets is " << *relative  << endl;
       }
    } else {
-      static vector<Real> fileOutputData;
-      static uint fileNumber = 0;
-      
-      if(lastCall == true) {
-         vector<Real>::const_iterator it;
-         for(it = fileOutputData.begin(); it != fileOutputData.end(); it++) {
-            cout << *it << "\t";
-         }
-         fileOutputData.clear();
-         return 0;
-      }
-      
-      fileOutputData.push_back(*absolute);
-      fileOutputData.push_back(*relative);
+      row.push_back(*absolute);
+      row.push_back(*relative);
    }
    return 0;
 }
 
 /*! Compute statistics on a single file
+ * \param cellData The file's data
  * \param size Return argument pointer, dataset size
  * \param mini Return argument pointer, dataset minimum
  * \param maxi Return argument pointer, dataset maximum
  * \param avg Return argument pointer, dataset average
  * \param stdev Return argument pointer, dataset standard deviation
  */
-bool singleStatistics(map<uint, Real> * orderedData,
+bool singleStatistics(const CellData& cellData,
                       Real * size,
                       Real * mini,
                       Real * maxi,
@@ -954,40 +1026,39 @@ bool singleStatistics(map<uint, Real> * orderedData,
 )
 {
    /*
-    * Returns basic statistics on the map passed to it.
+    * Returns basic statistics on the data passed to it.
     */
-   map<uint, Real>::const_iterator it;
-   
-   *size = orderedData->size();
+   *size = cellData.size();
    *mini = numeric_limits<Real>::max();
    *maxi = numeric_limits<Real>::min();
    *avg = 0.0;
    *stdev = 0.0;
    
-   for(it=orderedData->begin(); it != orderedData->end() ; it++)
+   for (const Real value : cellData.values)
    {
-      *mini = min(*mini, orderedData->at(it->first));
-      *maxi = max(*maxi, orderedData->at(it->first));
-      *avg += orderedData->at(it->first);
+      *mini = min(*mini, value);
+      *maxi = max(*maxi, value);
+      *avg += value;
    }
    *avg /= *size;
-   for(it=orderedData->begin(); it != orderedData->end() ; it++)
+   for (const Real value : cellData.values)
    {
-      *stdev += pow(orderedData->at(it->first) - *avg, 2.0);
+      *stdev += pow(value - *avg, 2.0);
    }
    *stdev = sqrt(*stdev);
    *stdev /= (*size - 1);
    return 0;
 }
 
-/*! In verbose mode print the statistics, in non-verbose store them for later output when lastCall is true
+/*! In verbose mode print the statistics, in non-verbose append them to the row of the file pair
  * \param size Pointer to dataset size
  * \param mini Pointer to dataset minimum
  * \param maxi Pointer to dataset maximum
  * \param avg Pointer to dataset average
  * \param stdev Pointer to dataset standard deviation
  * \param verboseOutput Boolean parameter telling whether the output is verbose or compact
- * \param lastCall Boolean parameter telling whether this is the last call to the function
+ * \param row Non-verbose output row of the file pair
+ * \param out Stream for verbose output
  * \sa singleStatistics
  */
 bool outputStats(const Real * size,
@@ -996,11 +1067,12 @@ bool outputStats(const Real * size,
                  const Real * avg,
                  const Real * stdev,
                  const bool verboseOutput,
-                 const bool lastCall
+                 vector<Real>& row,
+                 ostream& out
                  ) {
    if(verboseOutput == true)
    {
-      cout << "Statistics on file: size " << *size
+      out << "Statistics on file: size " << *size
       << " min = " << *mini
       << " max = " << *maxi
       << " average = " << *avg
@@ -1009,75 +1081,54 @@ bool outputStats(const Real * size,
    }
    else
    {
-      static uint fileNumber = 0;
-      static vector<Real> pairStats;
-      
-      if(lastCall == true)
-      {
-         vector<Real>::const_iterator it;
-         for(it = pairStats.begin(); it != pairStats.end(); it++)
-         {
-            cout << *it << "\t";
-         }
-         pairStats.clear();
-         return 0;
-      }
-      
-      if(fileNumber%2 == 0)
-      {
-         pairStats.push_back(fileNumber / 2 + 1);
-      }
-      pairStats.push_back(*size);
-      pairStats.push_back(*mini);
-      pairStats.push_back(*maxi);
-      pairStats.push_back(*avg);
-      pairStats.push_back(*stdev);
-      fileNumber++;
+      row.push_back(*size);
+      row.push_back(*mini);
+      row.push_back(*maxi);
+      row.push_back(*avg);
+      row.push_back(*stdev);
    }
    return 0;
 }
 
-/*! In folder-processing, non-verbose mode the data are stored during the processing and output at the end to have the data sorted properly
- * \sa outputStats outputDistance
+/*! Key to the columns of the non-verbose output, printed once before the rows of a folder comparison
+ * \sa printNonVerboseData
  */
-bool printNonVerboseData()
+void printNonVerboseHeader(ostream& out)
 {
-   static bool header = true;
-   if(header == true)
-   {
-      // Key to contents
-      cout << "#1   File number in folder\n" <<
-              "#2   File 1 size\n" <<
-              "#3   File 1 min\n" <<
-              "#4   File 1 max\n" <<
-              "#5   File 1 average\n" <<
-              "#6   File 1 standard deviation\n" <<
-              "#7   File 2 size\n" <<
-              "#8   File 2 min\n" <<
-              "#9   File 2 max\n" <<
-              "#10  File 2 average\n" <<
-              "#11  File 2 standard deviation\n" <<
-              "#12  absolute infinity-distance\n" <<
-              "#13  relative infinity-distance\n" <<
-              "#14  absolute average-shifted infinity-distance\n" <<
-              "#15  relative average-shifted infinity-distance\n" <<
-              "#16  absolute 1-distance\n" <<
-              "#17  relative 1-distance\n" <<
-              "#18  absolute average-shifted 1-distance\n" <<
-              "#19  relative average-shifted 1-distance\n" <<
-              "#20  absolute 2-distance\n" <<
-              "#21  relative 2-distance\n" <<
-              "#22  absolute average-shifted 2-distance\n" <<
-              "#23  relative average-shifted 2-distance\n" <<
-              endl;
-      header = false;
+   out << "#1   File number in folder\n" <<
+          "#2   File 1 size\n" <<
+          "#3   File 1 min\n" <<
+          "#4   File 1 max\n" <<
+          "#5   File 1 average\n" <<
+          "#6   File 1 standard deviation\n" <<
+          "#7   File 2 size\n" <<
+          "#8   File 2 min\n" <<
+          "#9   File 2 max\n" <<
+          "#10  File 2 average\n" <<
+          "#11  File 2 standard deviation\n" <<
+          "#12  absolute infinity-distance\n" <<
+          "#13  relative infinity-distance\n" <<
+          "#14  absolute average-shifted infinity-distance\n" <<
+          "#15  relative average-shifted infinity-distance\n" <<
+          "#16  absolute 1-distance\n" <<
+          "#17  relative 1-distance\n" <<
+          "#18  absolute average-shifted 1-distance\n" <<
+          "#19  relative average-shifted 1-distance\n" <<
+          "#20  absolute 2-distance\n" <<
+          "#21  relative 2-distance\n" <<
+          "#22  absolute average-shifted 2-distance\n" <<
+          "#23  relative average-shifted 2-distance\n" <<
+          endl;
+}
+
+/*! In folder-processing, non-verbose mode the data of a file pair are collected in a row and output at once
+ * \sa outputStats outputDistance printNonVerboseHeader
+ */
+bool printNonVerboseData(const vector<Real>& row, ostream& out)
+{
+   for (const Real value : row) {
+      out << value << "\t";
    }
-   
-   // Data
-   // last argument (lastCall) is true to get the output of the whole stored dataset
-   outputStats(NULL, NULL, NULL, NULL, NULL, false, true);
-   outputDistance(0, NULL, NULL, false, false, true);
-   
    return 0;
 }
 
@@ -1569,6 +1620,8 @@ bool compareAvgs( const string fileName1,
  * \param varToExtract Pointer to the char array containing the name of the variable to extract
  * \param compToExtract Unsigned int designating the component to extract (0 for scalars)
  * \param verboseOutput Boolean parameter telling whether the output will be verbose or compact
+ * \param out Stream the results are written to
+ * \param pairNumber Number of the file pair in a folder comparison, first column of the non-verbose output
  * \sa convertSILO singleStatistics outputStats pDistance outputDistance printNonVerboseData
  */
 bool process2Files(const string fileName1,
@@ -1576,11 +1629,14 @@ bool process2Files(const string fileName1,
                    const char * varToExtract,
                    const uint compToExtract,
                    const bool verboseOutput,
-                   const uint compToExtract2 = 0
+                   const uint compToExtract2 = 0,
+                   ostream& out = cout,
+                   const uint pairNumber = 1
                   ) {
-   map<uint, Real> orderedData1;
-   map<uint, Real> orderedData2;
+   CellData cellData1;
+   CellData cellData2;
    Real absolute, relative, mini, maxi, size, avg, stdev;
+   vector<Real> row;
 
    // If the user wants to check avgs, call the avgs check function and return it. Otherwise move on to compare variables:
    if( strcmp(varToExtract, "proton") == 0 && attributes.find("--no-distrib") == attributes.end()) {
@@ -1593,17 +1649,15 @@ bool process2Files(const string fileName1,
       // Compare files:
       if( compareAvgs<vlsvinterface::Reader, vlsvinterface::Reader>(fileName1, fileName2, verboseOutput, cellIds1, cellIds2) == false ) { return false; }
    } else {
-      unordered_map<size_t,size_t> cellOrder;
-   
       bool success = true;
-      success = convertSILO<vlsvinterface::Reader>(fileName1, varToExtract, compToExtract, &orderedData1, cellOrder, true);
+      success = convertSILO<vlsvinterface::Reader>(fileName1, varToExtract, compToExtract, &cellData1);
 
       if( success == false ) {
          cerr << "ERROR Data import error with " << fileName1 << endl;
          return 1;
       }
 
-      success = convertSILO<vlsvinterface::Reader>(fileName2, varToExtract, compToExtract, &orderedData2, cellOrder, false);
+      success = convertSILO<vlsvinterface::Reader>(fileName2, varToExtract, compToExtract, &cellData2);
 
       if( success == false ) {
          cerr << "ERROR Data import error with " << fileName2 << endl;
@@ -1611,11 +1665,13 @@ bool process2Files(const string fileName1,
       }   
 
       // Basic consistency check
-      if(orderedData1.size() != orderedData2.size()) {
+      if(cellData1.size() != cellData2.size()) {
          cerr << "ERROR Datasets have different size." << endl;
          return 1;
       }
 
+      const string meshName = attributes.at("--meshname");
+
       // Open VLSV file where the diffence in the chosen variable is written
       const string prefix = fileName1.substr(0,fileName1.find_last_of('.'));
       const string suffix = fileName1.substr(fileName1.find_last_of('.'),fileName1.size());
@@ -1635,48 +1691,96 @@ bool process2Files(const string fileName1,
             return false;
          }
 
-
-         map<string,string>::const_iterator it = attributes.find("--meshname");
-         if (cloneMesh(fileName1,outputFile,it->second,orderedData1) == false) {
+         // Clone mesh from input file to diff file
+         if (cloneMesh(fileName1,outputFile,meshName,cellData1) == false) {
             std::cerr<<"Failed"<<std::endl;
             return false;
          }
       }
 
-      singleStatistics(&orderedData1, &size, &mini, &maxi, &avg, &stdev); //CONTINUE
-      // Clone mesh from input file to diff file
-      outputStats(&size, &mini, &maxi, &avg, &stdev, verboseOutput, false);
+      if (verboseOutput == false) {
+         row.push_back(pairNumber);
+      }
+
+      singleStatistics(cellData1, &size, &mini, &maxi, &avg, &stdev);
+      outputStats(&size, &mini, &maxi, &avg, &stdev, verboseOutput, row, out);
 
-      singleStatistics(&orderedData2, &size, &mini, &maxi, &avg, &stdev);
-      outputStats(&size, &mini, &maxi, &avg, &stdev, verboseOutput, false);
+      singleStatistics(cellData2, &size, &mini, &maxi, &avg, &stdev);
+      outputStats(&size, &mini, &maxi, &avg, &stdev, verboseOutput, row, out);
 
-      pDistance(orderedData1, orderedData2, 0, &absolute, &relative, false, cellOrder,outputFile,attributes["--meshname"],"d0_"+varName);
-      outputDistance(0, &absolute, &relative, false, verboseOutput, false);
-      pDistance(orderedData1, orderedData2, 0, &absolute, &relative, true, cellOrder,outputFile,attributes["--meshname"],"d0_sft_"+varName);
-      outputDistance(0, &absolute, &relative, true, verboseOutput, false);
+      const vector<int64_t> match = alignCells(cellData1, cellData2);
 
-      pDistance(orderedData1, orderedData2, 1, &absolute, &relative, false, cellOrder,outputFile,attributes["--meshname"],"d1_"+varName);
-      outputDistance(1, &absolute, &relative, false, verboseOutput, false);
-      pDistance(orderedData1, orderedData2, 1, &absolute, &relative, true, cellOrder,outputFile,attributes["--meshname"],"d1_sft_"+varName);
-      outputDistance(1, &absolute, &relative, true, verboseOutput, false);
+      pDistance(cellData1, cellData2, match, 0, &absolute, &relative, false, outputFile, meshName, "d0_"+varName, out);
+      outputDistance(0, &absolute, &relative, false, verboseOutput, row, out);
+      pDistance(cellData1, cellData2, match, 0, &absolute, &relative, true, outputFile, meshName, "d0_sft_"+varName, out);
+      outputDistance(0, &absolute, &relative, true, verboseOutput, row, out);
 
-      pDistance(orderedData1, orderedData2, 2, &absolute, &relative, false, cellOrder,outputFile,attributes["--meshname"],"d2_"+varName);
-      outputDistance(2, &absolute, &relative, false, verboseOutput, false);
-      pDistance(orderedData1, orderedData2, 2, &absolute, &relative, true, cellOrder,outputFile,attributes["--meshname"],"d2_sft_"+varName);
-      outputDistance(2, &absolute, &relative, true, verboseOutput, false);
+      pDistance(cellData1, cellData2, match, 1, &absolute, &relative, false, outputFile, meshName, "d1_"+varName, out);
+      outputDistance(1, &absolute, &relative, false, verboseOutput, row, out);
+      pDistance(cellData1, cellData2, match, 1, &absolute, &relative, true, outputFile, meshName, "d1_sft_"+varName, out);
+      outputDistance(1, &absolute, &relative, true, verboseOutput, row, out);
+
+      pDistance(cellData1, cellData2, match, 2, &absolute, &relative, false, outputFile, meshName, "d2_"+varName, out);
+      outputDistance(2, &absolute, &relative, false, verboseOutput, row, out);
+      pDistance(cellData1, cellData2, match, 2, &absolute, &relative, true, outputFile, meshName, "d2_sft_"+varName, out);
+      outputDistance(2, &absolute, &relative, true, verboseOutput, row, out);
 
       outputFile.close();
    }
    
    if(verboseOutput == false)
    {
-      printNonVerboseData();
-      cout << endl;
+      printNonVerboseData(row, out);
+      out << endl;
    }
    
    return 0;
 }
 
+/*! Compare a list of file pairs in non-verbose mode, printing one row per pair in list order.
+ * The pairs are processed concurrently when that is safe: velocity distribution comparisons
+ * run serially, and writing difference files needs MPI_THREAD_MULTIPLE and distinct output files.
+ * \param filePairs The file pairs, the first file of each pair is the reference
+ * \param varToExtract Pointer to the char array containing the name of the variable to extract
+ * \param compToExtract Unsigned int designating the component to extract (0 for scalars)
+ * \param compToExtract2 Component to extract from the second file (velocity distribution comparison)
+ * \param mpiThreadLevel Thread support level provided by MPI_Init_thread
+ * \sa process2Files
+ */
+void processFilePairs(const vector<pair<string,string> >& filePairs,
+                      const char * varToExtract,
+                      const uint compToExtract,
+                      const uint compToExtract2,
+                      const int mpiThreadLevel) {
+   bool concurrent = true;
+   if (strcmp(varToExtract, "proton") == 0 && attributes.find("--no-distrib") == attributes.end()) {
+      concurrent = false;
+   }
+   if (attributes.find("--diff") != attributes.end()) {
+      set<string> referenceFiles;
+      for (const auto& filePair : filePairs) referenceFiles.insert(filePair.first);
+      if (mpiThreadLevel < MPI_THREAD_MULTIPLE || referenceFiles.size() != filePairs.size()) {
+         concurrent = false;
+      }
+   }
+
+   printNonVerboseHeader(cout);
+   if (concurrent == false) {
+      for (size_t i=0; i<filePairs.size(); ++i) {
+         process2Files(filePairs[i].first, filePairs[i].second, varToExtract, compToExtract, false, compToExtract2, cout, i+1);
+      }
+      return;
+   }
+
+   #pragma omp parallel for ordered schedule(dynamic)
+   for (size_t i=0; i<filePairs.size(); ++i) {
+      stringstream out;
+      process2Files(filePairs[i].first, filePairs[i].second, varToExtract, compToExtract, false, compToExtract2, out, i+1);
+      #pragma omp ordered
+      cout << out.str() << flush;
+   }
+}
+
 /*! Creates the list of grid*.vlsv files present in the folder passed
  * \param dir DIR type pointer to the directory entry to process
  * \param fileList Pointer to a set of strings, return argument for the produced file list
@@ -1776,7 +1880,8 @@ void printHelp(const map<string,string>& defAttribs,const map<string,string>& de
  * \sa process2Files processDirectory
  */
 int main(int argn,char* args[]) {
-   MPI_Init(&argn,&args);
+   int mpiThreadLevel;
+   MPI_Init_thread(&argn,&args,MPI_THREAD_MULTIPLE,&mpiThreadLevel);
 
    // Create default attributes
    map<string,string> defAttribs;
@@ -1912,13 +2017,14 @@ int main(int argn,char* args[]) {
       cout << "#INFO Reading in one file and one directory." << endl;
       set<string> fileList;
       set<string>::iterator it;
+      vector<pair<string,string> > filePairs;
 
       if(dir1 == NULL){
          //file in 1, directory in 2
          processDirectory(dir2, &fileList);
          for(it = fileList.begin(); it != fileList.end();++it){
-            // Process two files with non-verbose output (last argument false), give full path to the file processor
-            process2Files(fileName1,fileName2 + "/" + *it, varToExtract, compToExtract, false, compToExtract2);
+            // Give full path to the file processor
+            filePairs.push_back(make_pair(fileName1,fileName2 + "/" + *it));
          }
       }
 
@@ -1926,11 +2032,14 @@ int main(int argn,char* args[]) {
          //directory in 1, file in 2
          processDirectory(dir1, &fileList);
          for(it = fileList.begin(); it != fileList.end();++it){
-            // Process two files with non-verbose output (last argument false), give full path to the file processor
-            process2Files(fileName1+"/"+*it,fileName2, varToExtract, compToExtract, false, compToExtract2);
+            // Give full path to the file processor
+            filePairs.push_back(make_pair(fileName1+"/"+*it,fileName2));
          }
       }
 
+      // Process the file pairs with non-verbose output
+      processFilePairs(filePairs, varToExtract, compToExtract, compToExtract2, mpiThreadLevel);
+
       closedir(dir1);
       closedir(dir2);
       return 1;
@@ -1953,14 +2062,17 @@ int main(int argn,char* args[]) {
       }
       
       set<string>::iterator it1, it2;
+      vector<pair<string,string> > filePairs;
       for(it1 = fileList1.begin(), it2 = fileList2.begin();
           it1 != fileList2.end(), it2 != fileList2.end();
           it1++, it2++)
       {
-      // Process two files with non-verbose output (last argument false), give full path to the file processor
-      process2Files(fileName1 + "/" + *it1,
-                    fileName2 + "/" + *it2, varToExtract, compToExtract, false, compToExtract2);
+      // Give full path to the file processor
+      filePairs.push_back(make_pair(fileName1 + "/" + *it1, fileName2 + "/" + *it2));
       }
+
+      // Process the file pairs with non-verbose output
+      processFilePairs(filePairs, varToExtract, compToExtract, compToExtract2, mpiThreadLevel);
       
       closedir(dir1);
       closedir(dir2);
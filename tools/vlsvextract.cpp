@@ -22,6 +22,8 @@
 
 #include <iostream>
 
+#include <algorithm>
+#include <fstream>
 #include <limits>
 #include <stdint.h>
 #include <cmath>
@@ -29,7 +31,10 @@
 #include <sstream>
 #include <dirent.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <unordered_map>
 #include <unordered_set>
 
 #include <vlsv_reader.h>
@@ -447,50 +452,9 @@ void applyRotation(const Real* B,Real* transform) {
    }
 }
 
-void getBulkVelocity(Real* V_bulk,vlsvinterface::Reader& vlsvReader,const string& meshName,const string& popName,const uint64_t& cellID) {
-   //Declarations
-   vlsv::datatype::type cellIdDataType;
-   uint64_t cellIdArraySize, cellIdVectorSize, cellIdDataSize;
-   
+void getBulkVelocity(Real* V_bulk,vlsvinterface::Reader& vlsvReader,const string& meshName,const string& popName,const uint64_t& cellIndex) {
+   // cellIndex is the position of the cell in the CellID array of the mesh, see getCellIndices
    list<pair<string,string> > xmlAttributes;
-   xmlAttributes.push_back(make_pair("mesh",meshName));
-   xmlAttributes.push_back(make_pair("name","CellID"));
-   if (vlsvReader.getArrayInfo("VARIABLE", xmlAttributes, cellIdArraySize, cellIdVectorSize, cellIdDataType, cellIdDataSize) == false) {
-      cerr << "Error " << __FILE__ << " " << __LINE__ << endl;
-      exit(1);
-   }
-
-   // Declare buffers and allocate memory, this is done to read in the cell id location:
-   uint64_t* cellIdBuffer = NULL;
-
-   // Read the array into cellIdBuffer starting from 0 up until cellIdArraySize 
-   // which was received from getArrayInfo
-   if (vlsvReader.read("VARIABLE",xmlAttributes,0,cellIdArraySize,cellIdBuffer,true) == false) {
-      cerr << "Error: failed to read cell IDs in " << __FILE__ << ":" << __LINE__ << endl;
-      delete [] cellIdBuffer;
-      exit(1);
-   }
-
-   // Search for the given cellID location, the array in the vlsv file is not ordered depending 
-   // on the cell id so the array might look like this, 
-   // for instance: [CellId1, CellId7, CellId5, ...] and the variables are saved in the same
-   // order: [CellId1_B_FIELD, CellId7_B_FIELD, CellId5_B_FIELD, ...]
-   uint64_t cellIndex = numeric_limits<uint64_t>::max();
-   for (uint64_t cell=0; cell<cellIdArraySize; ++cell) {
-      // the CellID are not sorted in the array, so we'll have to search 
-      // the array -- the CellID is stored in cellId
-      if (cellID == cellIdBuffer[cell]) {
-         //Found the right cell ID, break
-         cellIndex = cell; break;
-      }
-   }
-   delete [] cellIdBuffer; cellIdBuffer = NULL;
-   
-   // Check if the cell id was found:
-   if (cellIndex == numeric_limits<uint64_t>::max()) {
-      cerr << "Spatial cell #" << cellID << " not found in " << __FILE__ << ":" << __LINE__ << endl;
-      exit(1);
-   }
    
    do {
       // Read combined vg_v
@@ -560,50 +524,9 @@ void getBulkVelocity(Real* V_bulk,vlsvinterface::Reader& vlsvReader,const string
 
 }
 
-void getB(Real* B,vlsvinterface::Reader& vlsvReader,const string& meshName,const uint64_t& cellID) {
-   //Declarations
-   vlsv::datatype::type cellIdDataType;
-   uint64_t cellIdArraySize, cellIdVectorSize, cellIdDataSize;
-
+void getB(Real* B,vlsvinterface::Reader& vlsvReader,const string& meshName,const uint64_t& cellIndex) {
+   // cellIndex is the position of the cell in the CellID array of the mesh, see getCellIndices
    list<pair<string,string> > xmlAttributes;
-   xmlAttributes.push_back(make_pair("mesh",meshName));
-   xmlAttributes.push_back(make_pair("name","CellID"));
-   if (vlsvReader.getArrayInfo("VARIABLE", xmlAttributes, cellIdArraySize, cellIdVectorSize, cellIdDataType, cellIdDataSize) == false) {
-      cerr << "Error " << __FILE__ << " " << __LINE__ << endl;
-      exit(1);
-   }
-
-   // Declare buffers and allocate memory, this is done to read in the cell id location:
-   uint64_t* cellIdBuffer = NULL;
-
-   // Read the array into cellIdBuffer starting from 0 up until cellIdArraySize 
-   // which was received from getArrayInfo
-   if (vlsvReader.read("VARIABLE",xmlAttributes,0,cellIdArraySize,cellIdBuffer,true) == false) {
-      cerr << "Error: failed to read cell IDs in " << __FILE__ << ":" << __LINE__ << endl;
-      delete [] cellIdBuffer;
-      exit(1);
-   }
-
-   // Search for the given cellID location, the array in the vlsv file is not ordered depending 
-   // on the cell id so the array might look like this, 
-   // for instance: [CellId1, CellId7, CellId5, ...] and the variables are saved in the same
-   // order: [CellId1_B_FIELD, CellId7_B_FIELD, CellId5_B_FIELD, ...]
-   uint64_t cellIndex = numeric_limits<uint64_t>::max();
-   for (uint64_t cell=0; cell<cellIdArraySize; ++cell) {
-      // the CellID are not sorted in the array, so we'll have to search 
-      // the array -- the CellID is stored in cellId
-      if (cellID == cellIdBuffer[cell]) {
-         //Found the right cell ID, break
-         cellIndex = cell; break;
-      }
-   }
-   delete [] cellIdBuffer; cellIdBuffer = NULL;
-
-   // Check if the cell id was found:
-   if (cellIndex == numeric_limits<uint64_t>::max()) {
-      cerr << "Spatial cell #" << cellID << " not found in " << __FILE__ << ":" << __LINE__ << endl;
-      exit(1);
-   }
 
    // These are needed to determine the buffer size:
    vlsv::datatype::type variableDataType;
@@ -724,76 +647,238 @@ void getB(Real* B,vlsvinterface::Reader& vlsvReader,const string& meshName,const
    }
 }
 
-bool convertVelocityBlocks2(
-                            vlsvinterface::Reader& vlsvReader,
-                            const string& fname,
-                            const string& meshName,
-                            CellStructure& cellStruct,
-                            const uint64_t& cellID,
-                            const bool rotate,
-                            const bool plasmaFrame,
-                            vlsv::Writer& out,
-                            const std::string& popName
-                           ) {
-   bool success = true;
-   
-   // Read velocity mesh metadata for this population
-   if (setVelocityMeshVariables(vlsvReader,cellStruct,popName) == false) {
-      //cerr << "ERROR, failed to read velocity mesh metadata for species '";
-      //cerr << popName << "'" << endl;
-      
-      cerr << "Trying older Vlasiator file format..." << endl;
-      if (setVelocityMeshVariables(vlsvReader,cellStruct) == false) {
-         cerr << "ERROR, failed to read velocity mesh metadata in " << __FILE__ << ":" << __LINE__ << endl;
-         success = false;
-         return success;
+// Blocks of the requested cells that are closer than this in the block arrays are read in one go
+static const uint64_t coalesceGapBlocks = 256;
+// Upper limit for the velocity block data held in memory during a batched extraction
+static const uint64_t batchMemoryBudget = 512*1024*1024;
+
+/** Read the positions of all spatial cells in the CellID array of the given mesh.
+ * @param vlsvReader VLSV reader that has input file open.
+ * @param meshName Name of the spatial mesh.
+ * @param cellIndices Map from cell ID to its position in the mesh's variable arrays.
+ * @return If true, the cell IDs were read successfully.*/
+bool getCellIndices(vlsvinterface::Reader& vlsvReader,const string& meshName,unordered_map<uint64_t,uint64_t>& cellIndices) {
+   vector<uint64_t> cellIds;
+   if (vlsvReader.getCellIds(cellIds,meshName) == false) return false;
+   cellIndices.clear();
+   cellIndices.reserve(cellIds.size());
+   for (uint64_t i=0; i<cellIds.size(); ++i) cellIndices.insert(make_pair(cellIds[i],i));
+   return true;
+}
+
+bool BlockIndex::Population::find(const uint64_t cellId,uint64_t& offset,uint32_t& blockCount) const {
+   vector<uint64_t>::const_iterator it = lower_bound(cellIds.begin(),cellIds.end(),cellId);
+   if (it == cellIds.end() || *it != cellId) return false;
+   const size_t i = it - cellIds.begin();
+   offset = offsets[i];
+   blockCount = blockCounts[i];
+   return true;
+}
+
+/** Build the velocity block index of all particle populations from the VLSV file.
+ * @param vlsvReader VLSV reader that has input file open.
+ * @param meshName Name of the spatial mesh.
+ * @param index Block index where the locations are written.
+ * @return If true, the index was built successfully.*/
+bool buildBlockIndex(vlsvinterface::Reader& vlsvReader,const string& meshName,BlockIndex& index) {
+   // Read names of all existing particle species, old-style files have a single unnamed one
+   set<string> popNames;
+   if (vlsvReader.getUniqueAttributeValues("BLOCKIDS","name",popNames) == false) {
+      cerr << "ERROR could not read population names in " << __FILE__ << ":" << __LINE__ << endl;
+      return false;
+   }
+   if (popNames.empty() == true) popNames.insert("");
+
+   index.populations.clear();
+   for (set<string>::const_iterator pop=popNames.begin(); pop!=popNames.end(); ++pop) {
+      vector<uint64_t> cellIds;
+      vector<uint64_t> blockCounts;
+      if (vlsvReader.readCellsWithBlocks(meshName,*pop,cellIds,blockCounts) == false) return false;
+
+      // The blocks are stored in file order of the cells, sort the cells by ID for lookups
+      vector<uint64_t> offsets(cellIds.size());
+      uint64_t blockOffset = 0;
+      for (size_t i=0; i<cellIds.size(); ++i) {
+         offsets[i] = blockOffset;
+         blockOffset += blockCounts[i];
+      }
+      vector<size_t> order(cellIds.size());
+      for (size_t i=0; i<order.size(); ++i) order[i] = i;
+      sort(order.begin(),order.end(),[&cellIds](const size_t a,const size_t b) {return cellIds[a] < cellIds[b];});
+
+      BlockIndex::Population& population = index.populations[*pop];
+      population.cellIds.resize(order.size());
+      population.offsets.resize(order.size());
+      population.blockCounts.resize(order.size());
+      for (size_t i=0; i<order.size(); ++i) {
+         population.cellIds[i] = cellIds[order[i]];
+         population.offsets[i] = offsets[order[i]];
+         population.blockCounts[i] = blockCounts[order[i]];
+      }
+   }
+   return true;
+}
+
+// Identifies a block index file and its layout version
+static const char blockIndexMagic[8] = {'V','L','S','V','B','I','X','1'};
+
+/** The block index file stores the size and modification time of the VLSV file it was 
+ * built from, a stale index is rebuilt.*/
+static bool getFileStamp(const string& fileName,uint64_t& size,int64_t& mtime) {
+   struct stat fileStat;
+   if (stat(fileName.c_str(),&fileStat) != 0) return false;
+   size = fileStat.st_size;
+   mtime = fileStat.st_mtime;
+   return true;
+}
+
+/** Read the velocity block index of the given VLSV file from its sidecar file.
+ * @param fileName Name of the VLSV file.
+ * @param index Block index where the locations are written.
+ * @return If true, an up-to-date index was read.*/
+bool readBlockIndex(const string& fileName,BlockIndex& index) {
+   uint64_t size;
+   int64_t mtime;
+   if (getFileStamp(fileName,size,mtime) == false) return false;
+
+   ifstream in((fileName + ".blockindex").c_str(),ios::binary);
+   if (in.good() == false) return false;
+
+   char magic[8];
+   uint64_t indexedSize;
+   int64_t indexedMtime;
+   uint64_t N_populations;
+   in.read(magic,sizeof(magic));
+   in.read(reinterpret_cast<char*>(&indexedSize),sizeof(indexedSize));
+   in.read(reinterpret_cast<char*>(&indexedMtime),sizeof(indexedMtime));
+   in.read(reinterpret_cast<char*>(&N_populations),sizeof(N_populations));
+   if (in.good() == false || equal(magic,magic+8,blockIndexMagic) == false) return false;
+   if (indexedSize != size || indexedMtime != mtime) return false;
+
+   index.populations.clear();
+   for (uint64_t p=0; p<N_populations; ++p) {
+      uint64_t nameLength,N_cells;
+      in.read(reinterpret_cast<char*>(&nameLength),sizeof(nameLength));
+      if (in.good() == false) return false;
+      string popName(nameLength,' ');
+      in.read(&(popName[0]),nameLength);
+      in.read(reinterpret_cast<char*>(&N_cells),sizeof(N_cells));
+      if (in.good() == false) return false;
+
+      BlockIndex::Population& population = index.populations[popName];
+      population.cellIds.resize(N_cells);
+      population.offsets.resize(N_cells);
+      population.blockCounts.resize(N_cells);
+      in.read(reinterpret_cast<char*>(population.cellIds.data()),N_cells*sizeof(uint64_t));
+      in.read(reinterpret_cast<char*>(population.offsets.data()),N_cells*sizeof(uint64_t));
+      in.read(reinterpret_cast<char*>(population.blockCounts.data()),N_cells*sizeof(uint32_t));
+      if (in.good() == false) return false;
+   }
+   return true;
+}
+
+/** Write the velocity block index of the given VLSV file to its sidecar file. The index is 
+ * written to a temporary file first so that concurrent readers never see a partial index.
+ * @param fileName Name of the VLSV file.
+ * @param index Block index to write.
+ * @return If true, the index was written.*/
+bool writeBlockIndex(const string& fileName,const BlockIndex& index) {
+   uint64_t size;
+   int64_t mtime;
+   if (getFileStamp(fileName,size,mtime) == false) return false;
+
+   stringstream ss;
+   ss << fileName << ".blockindex." << getpid();
+   const string tmpName = ss.str();
+   {
+      ofstream out(tmpName.c_str(),ios::binary);
+      if (out.good() == false) return false;
+
+      const uint64_t N_populations = index.populations.size();
+      out.write(blockIndexMagic,sizeof(blockIndexMagic));
+      out.write(reinterpret_cast<const char*>(&size),sizeof(size));
+      out.write(reinterpret_cast<const char*>(&mtime),sizeof(mtime));
+      out.write(reinterpret_cast<const char*>(&N_populations),sizeof(N_populations));
+      for (map<string,BlockIndex::Population>::const_iterator it=index.populations.begin(); it!=index.populations.end(); ++it) {
+         const uint64_t nameLength = it->first.size();
+         const uint64_t N_cells = it->second.cellIds.size();
+         out.write(reinterpret_cast<const char*>(&nameLength),sizeof(nameLength));
+         out.write(it->first.data(),nameLength);
+         out.write(reinterpret_cast<const char*>(&N_cells),sizeof(N_cells));
+         out.write(reinterpret_cast<const char*>(it->second.cellIds.data()),N_cells*sizeof(uint64_t));
+         out.write(reinterpret_cast<const char*>(it->second.offsets.data()),N_cells*sizeof(uint64_t));
+         out.write(reinterpret_cast<const char*>(it->second.blockCounts.data()),N_cells*sizeof(uint32_t));
+      }
+      if (out.good() == false) {
+         out.close();
+         remove(tmpName.c_str());
+         return false;
       }
    }
+   if (rename(tmpName.c_str(),(fileName + ".blockindex").c_str()) != 0) {
+      remove(tmpName.c_str());
+      return false;
+   }
+   return true;
+}
+
+/** Get the velocity block index of the VLSV file, from its sidecar file if one is up to date 
+ * and otherwise by reading the file. A rebuilt index is stored in the sidecar file.
+ * @param vlsvReader VLSV reader that has input file open.
+ * @param fileName Name of the VLSV file.
+ * @param meshName Name of the spatial mesh.
+ * @param useSidecar If false, the sidecar file is neither read nor written.
+ * @param index Block index where the locations are written.
+ * @return If true, the index is available.*/
+bool getBlockIndex(vlsvinterface::Reader& vlsvReader,const string& fileName,const string& meshName,
+                   const bool useSidecar,BlockIndex& index) {
+   if (useSidecar == true && readBlockIndex(fileName,index) == true) {
+      if (runDebug == true) cerr << "Using block index '" << fileName << ".blockindex'" << endl;
+      return true;
+   }
+   if (buildBlockIndex(vlsvReader,meshName,index) == false) return false;
+   if (useSidecar == true && writeBlockIndex(fileName,index) == false) {
+      if (runDebug == true) cerr << "Could not write block index '" << fileName << ".blockindex'" << endl;
+   }
+   return true;
+}
 
+/** Write the velocity mesh and distribution of one particle population of one spatial cell.
+ * @param out Output file.
+ * @param cellStruct Velocity mesh metadata of the population.
+ * @param popName Name of the particle population.
+ * @param blockIds Global IDs of the velocity blocks of the cell.
+ * @param transform Transformation matrix, written if writeTransform is true.
+ * @param writeTransform If true, the mesh is transformed (rotated and/or translated).
+ * @param blockVariableName Name of the block variable, empty if the population has none.
+ * @param dataType Datatype of the block variable.
+ * @param vectorSize Vector size of the block variable, number of values per block.
+ * @param dataSize Size of one value of the block variable in bytes.
+ * @param blockData The block variable of the cell.
+ * @return If true, the distribution was written successfully.*/
+bool writeVelocityBlocks(vlsv::Writer& out,
+                         const CellStructure& cellStruct,
+                         const string& popName,
+                         const vector<uint64_t>& blockIds,
+                         const Real* transform,
+                         const bool writeTransform,
+                         const string& blockVariableName,
+                         const datatype::type dataType,
+                         const uint64_t vectorSize,
+                         const uint64_t dataSize,
+                         const char* blockData
+                        ) {
+   bool success = true;
    string outputMeshName = "VelGrid_" + popName;
    int cellsInBlocksPerDirection = 4;
-   
-   // Transformation (translation + rotation) matrix, defaults 
-   // to identity matrix. Modified if rotate and/or plasmaFrame are true.
-   Real transform[16];
-   for (int i=0; i<16; ++i) transform[i] = 0;
-   transform[0 ] = 1;
-   transform[5 ] = 1;
-   transform[10] = 1;
-   transform[15] = 1;
-
-   if (plasmaFrame == true) {
-      Real V_bulk[3];
-      getBulkVelocity(V_bulk,vlsvReader,meshName,popName,cellID);
-      applyTranslation(V_bulk,transform);
-   }
-
-   // Write transform matrix (if needed)
-   if (rotate == true) {
-      Real B[3];
-      //Note: allocates memory and stores the vector value into B_ptr
-      getB(B,vlsvReader,meshName,cellID);
-      applyRotation(B,transform);
-   }
-
-   if (plasmaFrame == true || rotate == true) {
+   const size_t N_blocks = blockIds.size();
+
+   if (writeTransform == true) {
       map<string,string> attributes;
       attributes["name"] = "transmat";
       if (out.writeArray("TRANSFORM",attributes,16,1,transform) == false) success = false;
    }
 
-   // Read velocity block global IDs and write them out
-   vector<uint64_t> blockIds;
-   if (vlsvReader.getBlockIds(cellID,blockIds,popName) == false ) {
-      cerr << "Trying older Vlasiator file format..." << endl;
-      if (vlsvReader.getBlockIds(cellID,blockIds,"") == false) {
-         cerr << "ERROR, failed to read IDs at " << __FILE__ << ":" << __LINE__ << endl;
-         success = false;
-         return success;
-      }
-   }
-   const size_t N_blocks = blockIds.size();
-   
    map<string,string> attributes;
    attributes["name"] = outputMeshName;
    attributes["type"] = vlsv::mesh::STRING_UCD_AMR;
@@ -801,7 +886,7 @@ bool convertVelocityBlocks2(
    ss << (uint32_t)cellStruct.maxVelRefLevel;
    attributes["max_refinement_level"] = ss.str();
    attributes["geometry"] = vlsv::geometry::STRING_CARTESIAN;
-   if (plasmaFrame == true || rotate == true) attributes["transform"] = "transmat";
+   if (writeTransform == true) attributes["transform"] = "transmat";
 
    if (out.writeArray("MESH",attributes,blockIds.size(),1,&(blockIds[0])) == false) success = false;
    
@@ -820,6 +905,9 @@ bool convertVelocityBlocks2(
    attributes["name"] = "CellID";
    if (out.writeArray("VARIABLE",attributes,cellIDs.size(),1,&(cellIDs[0])) == false) success = false;
    attributes.clear();
+     {
+        vector<uint64_t> ().swap(cellIDs);
+     }
 
    // Make domain size array
    uint64_t domainSize[2];
@@ -827,9 +915,6 @@ bool convertVelocityBlocks2(
    domainSize[1] = 0;
    attributes["mesh"] = outputMeshName;
    if (out.writeArray("MESH_DOMAIN_SIZES",attributes,1,2,domainSize) == false) success = false;
-     {
-        vector<uint64_t> ().swap(blockIds);
-     }
    
    attributes["mesh"] = "VelBlocks_" + popName;
    if (out.writeArray("MESH_DOMAIN_SIZES",attributes,1,2,domainSize) == false) success = false;
@@ -932,171 +1017,298 @@ bool convertVelocityBlocks2(
    }
 
    // ***** Convert variables ***** //
-   
-   // Get the names of velocity mesh variables. NOTE: This will find _all_ particle populations
-   // which are stored in their separate meshes.
-   set<string> blockVarNames;
-   const string attributeName = "name";
-   if (vlsvReader.getUniqueAttributeValues( "BLOCKVARIABLE", attributeName, blockVarNames) == false) {
-      cerr << "ERROR, FAILED TO GET UNIQUE ATTRIBUTE VALUES AT " << __FILE__ << " " << __LINE__ << endl;
+   if (success == true && blockVariableName.empty() == false) {
+      attributes.clear();
+      attributes["name"] = blockVariableName;
+      attributes["mesh"] = outputMeshName;
+      if (out.writeArray("VARIABLE",
+                         attributes,
+                         vlsv::getStringDatatype(dataType),
+                         N_blocks * blockSize,
+                         vectorSize/blockSize,
+                         dataSize,
+                         blockData) == false) success = false;
    }
+   return success;
+}
 
-   //Writing VLSV file
-   if (success == true) {
-      for (set<string>::iterator it = blockVarNames.begin(); it != blockVarNames.end(); ++it) {
-         // Only accept the population that belongs to this mesh
-         if (*it != popName) continue;
+// Velocity distribution of one particle population in a spatial cell, read for a batched extraction
+struct CellDistribution {
+   bool found;                    /**< If false, the cell has no blocks of this population.*/
+   vector<uint64_t> blockIds;     /**< Global IDs of the velocity blocks.*/
+   vector<char> blockData;        /**< Block variable of the population, if the file has one.*/
+   Real transform[16];            /**< Translation and/or rotation of the velocity mesh.*/
+};
+
+// Velocity mesh metadata and block variable layout of one particle population
+struct PopulationData {
+   string indexName;              /**< Name of the population in the block index, empty for old-style files.*/
+   string popName;                /**< Name of the population in the output file.*/
+   bool meshRead;                 /**< If false, velocity mesh metadata could not be read.*/
+   CellStructure cellStruct;
+   string blockVariableName;      /**< Name of the block variable, empty if the population has none.*/
+   datatype::type dataType;
+   uint64_t vectorSize;
+   uint64_t dataSize;
+   uint64_t blockIdSize;
+   datatype::type blockIdType;
+   vector<CellDistribution> cells;
+};
+
+/** Read the velocity block IDs and the block variable of a batch of cells for one population. 
+ * The requested block ranges are sorted by their offset in the file and ranges closer than 
+ * coalesceGapBlocks to each other are read with a single read call.
+ * @param vlsvReader VLSV reader that has input file open.
+ * @param meshName Name of the spatial mesh.
+ * @param population Index of the population's blocks.
+ * @param cellIds The cells of the batch.
+ * @param popData Population metadata, the cells' block data are written here.
+ * @return If true, the blocks were read successfully.*/
+bool readBlockBatch(vlsvinterface::Reader& vlsvReader,
+                    const string& meshName,
+                    const BlockIndex::Population& population,
+                    const vector<uint64_t>& cellIds,
+                    PopulationData& popData) {
+   list<pair<string,string> > idAttribs;
+   if (popData.indexName.size() > 0) idAttribs.push_back(make_pair("name",popData.indexName));
+   list<pair<string,string> > varAttribs;
+   varAttribs.push_back(make_pair("name",popData.blockVariableName));
+   varAttribs.push_back(make_pair("mesh",meshName));
+
+   // Block ranges of the cells, sorted by offset
+   vector<pair<uint64_t,size_t> > ranges;
+   vector<uint32_t> blockCounts(cellIds.size(),0);
+   for (size_t c=0; c<cellIds.size(); ++c) {
+      uint64_t offset;
+      popData.cells[c].found = population.find(cellIds[c],offset,blockCounts[c]);
+      if (popData.cells[c].found == true) ranges.push_back(make_pair(offset,c));
+   }
+   sort(ranges.begin(),ranges.end());
+
+   const uint64_t blockDataSize = popData.vectorSize * popData.dataSize;
+   vector<char> idBuffer;
+   vector<char> dataBuffer;
+   size_t first = 0;
+   while (first < ranges.size()) {
+      // Extend the run while the next range starts close enough to its end
+      const uint64_t runBegin = ranges[first].first;
+      uint64_t runEnd = runBegin + blockCounts[ranges[first].second];
+      size_t last = first+1;
+      while (last < ranges.size() && ranges[last].first <= runEnd + coalesceGapBlocks) {
+         runEnd = max(runEnd,ranges[last].first + blockCounts[ranges[last].second]);
+         ++last;
+      }
+      const uint64_t N_run = runEnd - runBegin;
 
-         list<pair<string, string> > attribs;
-         attribs.push_back(make_pair("name", *it));
-         attribs.push_back(make_pair("mesh", meshName));
-         datatype::type dataType;
-         uint64_t arraySize, vectorSize, dataSize;
-         if (vlsvReader.getArrayInfo("BLOCKVARIABLE", attribs, arraySize, vectorSize, dataType, dataSize) == false) {
-            cerr << "Could not read BLOCKVARIABLE array info in " << __FILE__ << ":" << __LINE__ << endl;
+      if (N_run > 0) {
+         idBuffer.resize(N_run * popData.blockIdSize);
+         if (vlsvReader.readArray("BLOCKIDS",idAttribs,runBegin,N_run,idBuffer.data()) == false) {
+            cerr << "ERROR, FAILED TO READ BLOCKIDS AT " << __FILE__ << " " << __LINE__ << endl;
             return false;
          }
-	 
-         char* buffer = new char[N_blocks * vectorSize * dataSize];
-         if (vlsvReader.readArray("BLOCKVARIABLE", attribs, vlsvReader.getBlockOffset(cellID), N_blocks, buffer) == false) {
-            cerr << "ERROR could not read block variable in " << __FILE__ << ":" << __LINE__ << endl;
-            delete[] buffer;
-            return success;
+         if (popData.blockVariableName.empty() == false) {
+            dataBuffer.resize(N_run * blockDataSize);
+            if (vlsvReader.readArray("BLOCKVARIABLE",varAttribs,runBegin,N_run,dataBuffer.data()) == false) {
+               cerr << "ERROR could not read block variable in " << __FILE__ << ":" << __LINE__ << endl;
+               return false;
+            }
          }
-
-         attributes["name"] = *it;
-         attributes["mesh"] = outputMeshName;
-         if (out.writeArray("VARIABLE",
-                            attributes,
-                            vlsv::getStringDatatype(dataType),
-                            N_blocks * blockSize,
-                            vectorSize/blockSize,
-                            dataSize,
-                            buffer) == false) success = false;
-         
-         delete [] buffer; buffer = NULL;
       }
-   }
-   
-   vlsvReader.clearCellsWithBlocks();
-   return success;   
-}
-
-//Creates a cell id list of type std::unordered set and saves it in the input parameters
-//Input:
-//[0] vlsvReader -- some vlsv reader with a file open
-//Output:
-//[0] cellIdList -- Inputs a list of cell ids here
-//[1] sizeOfCellIdList -- Inputs the size of the cell id list here
-template <class T>
-bool createCellIdList( T & vlsvReader, unordered_set<uint64_t> & cellIdList ) {
-   if( cellIdList.empty() == false ) {
-      cerr << "ERROR, PASSED A NON-EMPTY CELL ID LIST AT " << __FILE__ << " " << __LINE__ <<  endl;
-      return false;
-   }
-   //meshname should be "SpatialGrid" and tag should be "CELLSWITHBLOCKS"
-   const string meshName = "SpatialGrid";
-   const string tagName = "CELLSWITHBLOCKS";
-   //For reading in attributes 
-   list< pair<string, string> > attributes;
-   attributes.push_back( make_pair("mesh", meshName) );
-
-   //Get a list of possible CellIDs from the file under CELLSWITHBLOCKS:
-   //Declare vectorSize, arraySize, .., so we know the size of the array we're going to read:
-   datatype::type dataType;
-   uint64_t arraySize, vectorSize, dataSize; //used to store info on the data we want to retrieve (needed for readArray)
-   //Read arraySize, vectorSize, dataType and dataSize and store them with getArrayInfo:
-   if (vlsvReader.getArrayInfo( tagName, attributes, arraySize, vectorSize, dataType, dataSize ) == false) {
-      cerr << "Could not find array " << tagName << " at: " << __FILE__ << " " << __LINE__ << endl;
-      exit(1); //error, terminate program
-      return false; //Shouldn't actually even get this far but whatever
-   }
-   //Check to make sure that the vectorSize is 1 as the CellIdList should be (Assuming so later on):
-   if( vectorSize != 1 ) {
-      cerr << tagName << "'s vector size is not 1 at: " << __FILE__ << " " << __LINE__ << endl;
-      exit(1);
-      return false;
-   }
-
-   //We now have the arraySize and everything else needed
-   //Create a buffer -- the size is determined by the data we received from getArrayInfo
-   char * buffer = new char[arraySize * vectorSize * dataSize];
-   const int beginningPoint = 0; //Read from the beginning ( 0 ) up to arraySize ( arraySize )
-   //Read data into the buffer with readArray:
-   if (vlsvReader.readArray(tagName, attributes, beginningPoint, arraySize, buffer) == false) {
-      cerr << "Failed to read block metadata for mesh '" << meshName << "' at: ";
-      cerr << __FILE__ << " " << __LINE__ << endl;
-      delete[] buffer;
-      exit(1);
-      return false;
-   }
 
-
-   //Reinterpret the buffer and point cellIdList in the right direction:
-   uint64_t * _cellIdList = reinterpret_cast<uint64_t*>(buffer);
-   //Reserve space for the cell id list:
-   cellIdList.rehash( (uint64_t)(arraySize * 1.25) );
-   for( uint64_t i = 0; i < arraySize; ++i ) {
-      cellIdList.insert( (uint64_t)( _cellIdList[i] ) );
+      for (size_t r=first; r<last; ++r) {
+         CellDistribution& cell = popData.cells[ranges[r].second];
+         const uint64_t begin = ranges[r].first - runBegin;
+         const uint32_t N_blocks = blockCounts[ranges[r].second];
+         cell.blockIds.resize(N_blocks);
+         for (uint32_t b=0; b<N_blocks; ++b) {
+            cell.blockIds[b] = convUInt(idBuffer.data() + (begin+b)*popData.blockIdSize,popData.blockIdType,popData.blockIdSize);
+         }
+         if (popData.blockVariableName.empty() == false) {
+            cell.blockData.assign(dataBuffer.begin() + begin*blockDataSize,dataBuffer.begin() + (begin+N_blocks)*blockDataSize);
+         }
+      }
+      first = last;
    }
-   delete[] buffer;
    return true;
 }
 
-/** Driver function for convertVelocityBlocks. Reads the names of 
- * existing particle species and calls convertVelocityBlocks2 for 
- * each of them.
- * @param vlsvReader VLSV file reader that has input file open.
- * @param fname Name of the input file.
+/** Extract the velocity distributions of all particle populations of any number of spatial cells. 
+ * The block data of a batch of cells is read in one sorted pass per population, after which the 
+ * output files of the cells are written by parallel threads.
+ * @param vlsvReader VLSV reader that has input file open.
+ * @param fileName Name of the input file.
  * @param meshName Name of the spatial mesh.
- * @param cellStruct Struct containing mesh metadata.
- * @param cellID ID of the spatial cell whose distribution function(s) are to be extracted.
+ * @param index Velocity block index of the input file.
+ * @param cellIdList The cells to extract.
+ * @param outputFilePaths Output file name of each cell.
  * @param rotate If true, distribution function(s) are rotated so that the magnetic field points 
  * along +vz axis.
  * @param plasmaFrame If true, distribution function(s) are translated to local plasma rest frame.
- * @return If true, all distributions were extracted successfully.*/
-bool convertVelocityBlocks2(
-                            vlsvinterface::Reader& vlsvReader,
-                            const string& fname,
-                            const string& meshName,
-                            CellStructure& cellStruct,
-                            const uint64_t& cellID,
-                            const bool rotate,
-                            const bool plasmaFrame
-                           ) {
-   // Read names of all existing particle species
-   set<string> popNames;
-   if (vlsvReader.getUniqueAttributeValues("BLOCKIDS","name",popNames) == false) {
-      cerr << "ERROR could not read population names in " << __FILE__ << ":" << __LINE__ << endl;
-      return false;
+ * @param extracted Return argument, whether each cell was extracted successfully.
+ * @return If false, the extraction could not be started.*/
+bool extractVelocityBlocks(vlsvinterface::Reader& vlsvReader,
+                           const string& fileName,
+                           const string& meshName,
+                           const BlockIndex& index,
+                           const vector<uint64_t>& cellIdList,
+                           const vector<string>& outputFilePaths,
+                           const bool rotate,
+                           const bool plasmaFrame,
+                           vector<bool>& extracted
+                          ) {
+   extracted.assign(cellIdList.size(),false);
+   if (runDebug == true) {
+      cerr << "Found " << index.populations.size() << " particle populations" << endl;
    }
 
-   if (runDebug == true) {
-      cerr << "Found " << popNames.size() << " particle populations" << endl;
+   // Velocity mesh metadata and block variable layout of each population
+   set<string> blockVarNames;
+   if (vlsvReader.getUniqueAttributeValues("BLOCKVARIABLE","name",blockVarNames) == false) {
+      cerr << "ERROR, FAILED TO GET UNIQUE ATTRIBUTE VALUES AT " << __FILE__ << " " << __LINE__ << endl;
    }
+   vector<PopulationData> pops;
+   for (map<string,BlockIndex::Population>::const_iterator it=index.populations.begin(); it!=index.populations.end(); ++it) {
+      PopulationData popData;
+      popData.indexName = it->first;
+      popData.popName = it->first.empty() ? "avgs" : it->first;
+      if (runDebug == true) cerr << "Population '" << popData.popName << "' meshName '" << meshName << "'" << endl;
+
+      popData.meshRead = true;
+      if (setVelocityMeshVariables(vlsvReader,popData.cellStruct,popData.popName) == false) {
+         cerr << "Trying older Vlasiator file format..." << endl;
+         if (setVelocityMeshVariables(vlsvReader,popData.cellStruct) == false) {
+            cerr << "ERROR, failed to read velocity mesh metadata in " << __FILE__ << ":" << __LINE__ << endl;
+            popData.meshRead = false;
+         }
+      }
 
-   // Open output file
-   vlsv::Writer out;
-   if (out.open(fname,MPI_COMM_SELF,0) == false) {
-      cerr << "ERROR, failed to open output file with vlsv::Writer at " << __FILE__ << " " << __LINE__ << endl;
-      return false;
+      list<pair<string,string> > attribs;
+      if (popData.indexName.size() > 0) attribs.push_back(make_pair("name",popData.indexName));
+      uint64_t arraySize, vectorSize;
+      if (vlsvReader.getArrayInfo("BLOCKIDS",attribs,arraySize,vectorSize,popData.blockIdType,popData.blockIdSize) == false
+          || popData.blockIdType != datatype::type::UINT) {
+         cerr << "ERROR, COULD NOT FIND BLOCKIDS FOR '" << popData.indexName << "' AT " << __FILE__ << " " << __LINE__ << endl;
+         popData.meshRead = false;
+      }
+
+      // Only the block variable that belongs to this population is extracted
+      if (blockVarNames.find(popData.popName) != blockVarNames.end()) {
+         attribs.clear();
+         attribs.push_back(make_pair("name",popData.popName));
+         attribs.push_back(make_pair("mesh",meshName));
+         if (vlsvReader.getArrayInfo("BLOCKVARIABLE",attribs,arraySize,popData.vectorSize,popData.dataType,popData.dataSize) == false) {
+            cerr << "Could not read BLOCKVARIABLE array info in " << __FILE__ << ":" << __LINE__ << endl;
+            popData.meshRead = false;
+         } else {
+            popData.blockVariableName = popData.popName;
+         }
+      }
+      pops.push_back(popData);
    }
-   
-   bool success = true;
-   if (popNames.size() > 0) {
-      for (set<string>::iterator it=popNames.begin(); it!=popNames.end(); ++it) {
-         if (runDebug == true) cerr << "Population '" << *it << "' meshName '" << meshName << "'" << endl;
-         if (vlsvReader.setCellsWithBlocks(meshName,*it) == false) {success = false; continue;}
-         if (convertVelocityBlocks2(vlsvReader,fname,meshName,cellStruct,cellID,rotate,plasmaFrame,out,*it) == false) success = false;
+
+   // Positions of the cells in the spatial variable arrays, needed for frame transformations
+   unordered_map<uint64_t,uint64_t> cellIndices;
+   if (rotate == true || plasmaFrame == true) {
+      if (getCellIndices(vlsvReader,meshName,cellIndices) == false) {
+         cerr << "Error: failed to read cell IDs in " << __FILE__ << ":" << __LINE__ << endl;
+         return false;
       }
-   } else {
-      if (runDebug == true) cerr << "Extracting old-style population 'avgs'" << endl;
-      if (vlsvReader.setCellsWithBlocks(meshName,"") == false) {success = false;}
-      if (convertVelocityBlocks2(vlsvReader,fname,meshName,cellStruct,cellID,rotate,plasmaFrame,out,"avgs") == false) success = false;
    }
 
-   out.close();
-   return success;
+   // Output files are written concurrently only if MPI allows it
+   int mpiThreadLevel;
+   MPI_Query_thread(&mpiThreadLevel);
+   const bool parallelWrite = (mpiThreadLevel == MPI_THREAD_MULTIPLE);
+
+   size_t batchBegin = 0;
+   while (batchBegin < cellIdList.size()) {
+      // Take cells into the batch until their blocks would exceed the memory budget
+      size_t batchEnd = batchBegin;
+      uint64_t batchBytes = 0;
+      while (batchEnd < cellIdList.size()) {
+         uint64_t cellBytes = 0;
+         for (size_t p=0; p<pops.size(); ++p) {
+            uint64_t offset;
+            uint32_t N_blocks;
+            if (index.populations.at(pops[p].indexName).find(cellIdList[batchEnd],offset,N_blocks) == false) continue;
+            cellBytes += N_blocks * (sizeof(uint64_t) + 64*sizeof(uint64_t));
+            if (pops[p].blockVariableName.empty() == false) cellBytes += N_blocks * pops[p].vectorSize * pops[p].dataSize;
+         }
+         if (batchEnd > batchBegin && batchBytes + cellBytes > batchMemoryBudget) break;
+         batchBytes += cellBytes;
+         ++batchEnd;
+      }
+      const vector<uint64_t> batchCells(cellIdList.begin()+batchBegin,cellIdList.begin()+batchEnd);
+
+      // Read the blocks of the batch
+      vector<bool> readOk(batchCells.size(),true);
+      for (size_t p=0; p<pops.size(); ++p) {
+         pops[p].cells.clear();
+         pops[p].cells.resize(batchCells.size());
+         if (pops[p].meshRead == false || readBlockBatch(vlsvReader,meshName,index.populations.at(pops[p].indexName),batchCells,pops[p]) == false) {
+            readOk.assign(readOk.size(),false);
+         }
+      }
+
+      // Frame transformations read spatial variables of the cells
+      for (size_t c=0; c<batchCells.size(); ++c) {
+         Real B[3];
+         unordered_map<uint64_t,uint64_t>::const_iterator cellIndex = cellIndices.end();
+         if (rotate == true || plasmaFrame == true) {
+            cellIndex = cellIndices.find(batchCells[c]);
+            if (cellIndex == cellIndices.end()) {
+               cerr << "Spatial cell #" << batchCells[c] << " not found in " << __FILE__ << ":" << __LINE__ << endl;
+               exit(1);
+            }
+         }
+         //Note: reads the vector value into B
+         if (rotate == true) getB(B,vlsvReader,meshName,cellIndex->second);
+         for (size_t p=0; p<pops.size(); ++p) {
+            // Transformation (translation + rotation) matrix, defaults 
+            // to identity matrix. Modified if rotate and/or plasmaFrame are true.
+            Real* transform = pops[p].cells[c].transform;
+            for (int i=0; i<16; ++i) transform[i] = 0;
+            transform[0 ] = 1;
+            transform[5 ] = 1;
+            transform[10] = 1;
+            transform[15] = 1;
+            if (plasmaFrame == true) {
+               Real V_bulk[3];
+               getBulkVelocity(V_bulk,vlsvReader,meshName,pops[p].popName,cellIndex->second);
+               applyTranslation(V_bulk,transform);
+            }
+            if (rotate == true) applyRotation(B,transform);
+         }
+      }
+
+      // Write the output files
+      #pragma omp parallel for schedule(dynamic) if(parallelWrite)
+      for (size_t c=0; c<batchCells.size(); ++c) {
+         if (readOk[c] == false) continue;
+         const string& fname = outputFilePaths[batchBegin+c];
+         vlsv::Writer out;
+         if (out.open(fname,MPI_COMM_SELF,0) == false) {
+            cerr << "ERROR, failed to open output file with vlsv::Writer at " << __FILE__ << " " << __LINE__ << endl;
+            continue;
+         }
+         bool success = true;
+         for (size_t p=0; p<pops.size(); ++p) {
+            const CellDistribution& cell = pops[p].cells[c];
+            if (cell.found == false) {
+               cerr << "COULDNT FIND CELL ID " << batchCells[c] << " FOR POPULATION '" << pops[p].popName << "' AT " << __FILE__ << " " << __LINE__ << endl;
+               success = false;
+               continue;
+            }
+            if (writeVelocityBlocks(out,pops[p].cellStruct,pops[p].popName,cell.blockIds,cell.transform,
+                                    plasmaFrame == true || rotate == true,pops[p].blockVariableName,
+                                    pops[p].dataType,pops[p].vectorSize,pops[p].dataSize,cell.blockData.data()) == false) success = false;
+         }
+         out.close();
+         extracted[batchBegin+c] = success;
+      }
+      batchBegin = batchEnd;
+   }
+   return true;
 }
 
 //Calculates the cell coordinates and outputs into *coordinates 
@@ -1463,7 +1675,7 @@ bool setSpatialCellVariables(Reader& vlsvReader,CellStructure& cellStruct) {
 //Output:
 //[0] Returns the cell id in uint64_t
 uint64_t getCellIdFromCoords( const CellStructure & cellStruct, 
-                              const unordered_set<uint64_t> cellIdList,
+                              const unordered_set<uint64_t> & cellIdList,
                               const array<Real, 3> coords) {
    if( coords.empty() ) {
       cerr << "ERROR, PASSED AN EMPTY STD::ARRAY FOR COORDINATES AT " << __FILE__ << " " << __LINE__ << endl;
@@ -1541,6 +1753,7 @@ bool retrieveOptions( const int argn, char *args[], UserOptions & mainOptions )
          ("cellidlist", po::value< vector<uint64_t>>()->multitoken(), "Set list of cell ids")
          ("rotate", "Rotate velocities so that they face z-axis")
          ("plasmaFrame", "Shift the distribution so that the bulk velocity is 0")
+         ("noindex", "Do not read or write the velocity block index file <input file>.blockindex (OPTIONAL)")
          ("coordinates", po::value< vector<Real> >()->multitoken(), "Set spatial coordinates x y z")
          ("unit", po::value<string>(), "Sets the units. Options: re, km, m (OPTIONAL)")
          ("point1", po::value< vector<Real> >()->multitoken(), "Set the starting point x y z of a line")
@@ -1592,7 +1805,7 @@ bool retrieveOptions( const int argn, char *args[], UserOptions & mainOptions )
       }
       //Check for rotation
       if( vm.count("rotate") ) {
-         //Rotate the vectors (used in convertVelocityBlocks2 as an argument)
+         //Rotate the vectors (used in extractVelocityBlocks as an argument)
          rotateVectors = true;
       }
       if (vm.count("debug") ) {
@@ -1604,6 +1817,10 @@ bool retrieveOptions( const int argn, char *args[], UserOptions & mainOptions )
          // Shift the velocity distribution to plasma frame
          plasmaFrame = true;
       }
+      if( vm.count("noindex") ) {
+         // Locate the velocity blocks from the input file only
+         mainOptions.useBlockIndex = false;
+      }
       //Check for cell id input
       if( vm.count("cellid") ) {
          //Save input
@@ -1814,6 +2031,22 @@ void extractDistribution( const string & fileName, const UserOptions & mainOptio
    CellStructure cellStruct;
    setSpatialCellVariables( vlsvReader, cellStruct );
 
+   //Locations of the velocity blocks of all cells, from the sidecar index file if possible
+   BlockIndex blockIndex;
+   if( getBlockIndex( vlsvReader, fileName, meshName, mainOptions.useBlockIndex, blockIndex ) == false ) {
+      cerr << "ERROR, FAILED TO READ VELOCITY BLOCK LOCATIONS FROM '" << fileName << "' AT " << __FILE__ << " " << __LINE__ << endl;
+      vlsvReader.close();
+      return;
+   }
+
+   //The cells that have a velocity distribution of any population
+   unordered_set<uint64_t> cellIdList_velocity;
+   if( mainOptions.getCellIdFromCoordinates || mainOptions.getCellIdFromLine ) {
+      for( map<string,BlockIndex::Population>::const_iterator pop = blockIndex.populations.begin(); pop != blockIndex.populations.end(); ++pop ) {
+         cellIdList_velocity.insert( pop->second.cellIds.begin(), pop->second.cellIds.end() );
+      }
+   }
+
    //Declare a vector for holding multiple cell ids (Note: Used only if we want to calculate the cell id along a line)
    vector<uint64_t> cellIdList;
 
@@ -1822,10 +2055,6 @@ void extractDistribution( const string & fileName, const UserOptions & mainOptio
    //previously used syntax)
    if( mainOptions.getCellIdFromCoordinates ) {
 
-      //Get the cell id list of cell ids with velocity distribution
-      unordered_set<uint64_t> cellIdList_velocity;
-      createCellIdList( vlsvReader, cellIdList_velocity );
-
       //Get the cell id from coordinates
       //Note: By the way, this is not the same as bool getCellIdFromCoordinates (should change the name)
       const uint64_t cellID = getCellIdFromCoords( cellStruct, cellIdList_velocity, mainOptions.coordinates );
@@ -1842,10 +2071,6 @@ void extractDistribution( const string & fileName, const UserOptions & mainOptio
       //calculating the cell ids from a line clearer)
       cellIdList.push_back( cellID );
    } else if( mainOptions.getCellIdFromLine ) {
-      //Get the cell id list of cell ids with velocity distribution
-      unordered_set<uint64_t> cellIdList_velocity;
-      createCellIdList( vlsvReader, cellIdList_velocity );
-
       //Now there are multiple cell ids so do the same treatment for the cell ids as with getCellIdFromCoordinates
       //but now for multiple cell ids
 
@@ -1899,19 +2124,14 @@ void extractDistribution( const string & fileName, const UserOptions & mainOptio
    }
 
    //Next task is to iterate through the cell ids and save files:
-   //Save all of the cell ids' velocities into files:
-   vector<uint64_t>::iterator it;
-   //declare extractNum for keeping track of which extraction is going on and informing the user (used in the iteration)
-   int extractNum = 1;
    //Give some info on how many extractions there are and what the save path is:
    cout << "Save path: " << mainOptions.outputDirectoryPath.front() << endl;
    cout << "Total number of extractions: " << cellIdList.size() << endl;
-   //Iterate:
-   for( it = cellIdList.begin(); it != cellIdList.end(); ++it ) {
+   //Output file name of each cell id:
+   vector<string> outputFilePaths;
+   for( vector<uint64_t>::const_iterator it = cellIdList.begin(); it != cellIdList.end(); ++it ) {
       //get the cell id from the iterator:
       const uint64_t cellID = *it;
-      //Print out the cell id:
-      cout << "Cell id: " << cellID << endl;
       // Create a new file suffix for the output file:
       stringstream ss1;
       ss1 << ".vlsv";
@@ -1938,26 +2158,31 @@ void extractDistribution( const string & fileName, const UserOptions & mainOptio
    
       pos = outputFileName.find(".");
       if (pos != string::npos) outputFileName.replace(0, pos, newPrefix);
-      
-      string slicePrefix = "VelSlice";
-      string outputSliceName = fileName;
-      pos = outputSliceName.find(".");
-      if (pos != string::npos) outputSliceName.replace(0,pos,slicePrefix);
 
       //Declare the file path (used in DBCreate to save the file in the correct location)
       string outputFilePath;
       //Get the path (outputDirectoryPath was retrieved from user input and it's a vector<string>):
       outputFilePath.append( mainOptions.outputDirectoryPath.front() );
       //The complete file path is still missing the file name, so add it to the end:
-      outputFilePath.append( outputFileName );      
-
-      // Extract velocity grid from VLSV file, if possible, and write as vlsv file:
-      bool velGridExtracted = true;
-      //slice disabled by default, enable for specific testing. TODO: add command line interface for enabling it
-      //convertSlicedVelocityMesh(vlsvReader,outputSliceName,*it2,cellStruct);
-      if (convertVelocityBlocks2(vlsvReader, outputFilePath, meshName, cellStruct, cellID, mainOptions.rotateVectors, mainOptions.plasmaFrame ) == false) {
-         velGridExtracted = false;
-      } else {
+      outputFilePath.append( outputFileName );
+      outputFilePaths.push_back( outputFilePath );
+   }
+
+   // Extract velocity grids from VLSV file, if possible, and write as vlsv files:
+   //slice disabled by default, enable for specific testing. TODO: add command line interface for enabling it
+   //convertSlicedVelocityMesh(vlsvReader,outputSliceName,*it2,cellStruct);
+   vector<bool> velGridExtracted;
+   if( extractVelocityBlocks( vlsvReader, fileName, meshName, blockIndex, cellIdList, outputFilePaths,
+                              mainOptions.rotateVectors, mainOptions.plasmaFrame, velGridExtracted ) == false ) {
+      cerr << "ERROR, FAILED TO EXTRACT VELOCITY GRIDS FROM '" << fileName << "' AT: " << __FILE__ << " " << __LINE__ << endl;
+   }
+
+   //declare extractNum for keeping track of which extraction is going on and informing the user (used in the iteration)
+   int extractNum = 1;
+   for( size_t i = 0; i < cellIdList.size(); ++i ) {
+      //Print out the cell id:
+      cout << "Cell id: " << cellIdList[i] << endl;
+      if( velGridExtracted[i] == true ) {
          //Display message for the user:
          if( mainOptions.getCellIdFromLine ) {
             //Extracting multiple cell ids:
@@ -1971,12 +2196,10 @@ void extractDistribution( const string & fileName, const UserOptions & mainOptio
             //Single cell id:
             cout << "\t extracted from '" << fileName << "'" << endl;
          }
-      }
-
-      // If velocity grid was not extracted, delete the file:
-      if (velGridExtracted == false) {
+      } else {
+         // If velocity grid was not extracted, delete the file:
          cerr << "ERROR, FAILED TO EXTRACT VELOCITY GRID AT: " << __FILE__ << " " << __LINE__ << endl;
-         if (remove(outputFilePath.c_str()) != 0) {
+         if (remove(outputFilePaths[i].c_str()) != 0) {
             cerr << "\t ERROR: failed to remote dummy output file!" << endl;
          }
       }
@@ -1986,8 +2209,9 @@ void extractDistribution( const string & fileName, const UserOptions & mainOptio
 }
 
 int main(int argn, char* args[]) {
-   int ntasks, rank;
-   MPI_Init(&argn, &args);
+   int ntasks, rank, mpiThreadLevel;
+   // Output files of a batch of cells are written by concurrent threads if MPI supports it
+   MPI_Init_thread(&argn, &args, MPI_THREAD_MULTIPLE, &mpiThreadLevel);
    MPI_Comm_size(MPI_COMM_WORLD, &ntasks);
    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
@@ -31,6 +31,8 @@
 
 #include <cstdlib>
 #include <array>
+#include <map>
+#include <string>
 #include <vector>
 
 #include "definitions.h"
@@ -50,6 +52,20 @@ struct CellStructure {
    Real slicedCoordValues[3];
 };
 
+//Locations of the velocity blocks of the spatial cells in a VLSV file, per particle population.
+//Cached in a sidecar file next to the VLSV file so that repeated extractions from the same 
+//file do not need to re-read CELLSWITHBLOCKS and BLOCKSPERCELL.
+struct BlockIndex {
+   struct Population {
+      std::vector<uint64_t> cellIds;       /**< Cells that have blocks of this population, sorted.*/
+      std::vector<uint64_t> offsets;       /**< Offset of the first block of each cell in BLOCKIDS and BLOCKVARIABLE.*/
+      std::vector<uint32_t> blockCounts;   /**< Number of blocks in each cell.*/
+
+      bool find(const uint64_t cellId,uint64_t& offset,uint32_t& blockCount) const;
+   };
+   std::map<std::string,Population> populations; /**< Keyed by population name, the name is empty in old-style files.*/
+};
+
 template<typename REAL>
 struct NodeCrd {
    static REAL EPS;
@@ -75,6 +91,7 @@ public:
    bool getCellIdFromCoordinates;
    bool rotateVectors;
    bool plasmaFrame;
+   bool useBlockIndex;
    uint64_t cellId;
    std::vector<uint64_t> cellIdList;
    uint32_t numberOfCoordinatesInALine;
@@ -89,6 +106,7 @@ public:
       getCellIdFromCoordinates = false;
       rotateVectors = false;
       plasmaFrame =false;
+      useBlockIndex = true;
       cellId = std::numeric_limits<uint64_t>::max();
       numberOfCoordinatesInALine = 0;
    }
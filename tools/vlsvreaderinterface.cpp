@@ -203,10 +203,8 @@ namespace vlsvinterface {
       return true;
    }
 
-   bool Reader::setCellsWithBlocks(const std::string& meshName,const std::string& popName) {
-      if(cellsWithBlocksLocations.empty() == false) {
-         cellsWithBlocksLocations.clear();
-      }
+   bool Reader::readCellsWithBlocks(const std::string& meshName,const std::string& popName,
+                                    std::vector<uint64_t>& cellIds,std::vector<uint64_t>& blockCounts) {
       vlsv::datatype::type cwb_dataType;
       uint64_t cwb_arraySize, cwb_vectorSize, cwb_dataSize;
       list<pair<string, string> > attribs;
@@ -254,6 +252,7 @@ namespace vlsvinterface {
       //Read array info -- stores output in nb_arraySize, nb_vectorSize, nb_dataType, nb_dataSize
       if (getArrayInfo("BLOCKSPERCELL", attribs, nb_arraySize, nb_vectorSize, nb_dataType, nb_dataSize) == false) {
          cerr << "ERROR, COULD NOT FIND ARRAY BLOCKSPERCELL AT " << __FILE__ << " " << __LINE__ << endl;
+         delete[] cwb_buffer;
          return false;
       }
    
@@ -267,20 +266,38 @@ namespace vlsvinterface {
          return false;
       }
    
-      // Input cellswithblock locations:
-      uint64_t blockOffset = 0;
-      uint64_t N_blocks;
+      // Cells and their block counts in file order, the blocks of the cells are stored in the same order
+      cellIds.resize(cwb_arraySize);
+      blockCounts.resize(cwb_arraySize);
       for (uint64_t cell = 0; cell < cwb_arraySize; ++cell) {
-         const uint64_t readCellID = convUInt(cwb_buffer + cell*cwb_dataSize, cwb_dataType, cwb_dataSize);
-         N_blocks = convUInt(nb_buffer + cell*nb_dataSize, nb_dataType, nb_dataSize);
-         const pair<uint64_t, uint32_t> input = make_pair( blockOffset, N_blocks );
-         //Insert the location and number of blocks into the map
-         cellsWithBlocksLocations.insert( make_pair(readCellID, input) );
-         blockOffset += N_blocks;
+         cellIds[cell] = convUInt(cwb_buffer + cell*cwb_dataSize, cwb_dataType, cwb_dataSize);
+         blockCounts[cell] = convUInt(nb_buffer + cell*nb_dataSize, nb_dataType, nb_dataSize);
       }
    
       delete[] cwb_buffer;
       delete[] nb_buffer;
+      return true;
+   }
+
+   bool Reader::setCellsWithBlocks(const std::string& meshName,const std::string& popName) {
+      if(cellsWithBlocksLocations.empty() == false) {
+         cellsWithBlocksLocations.clear();
+      }
+      vector<uint64_t> cellIds;
+      vector<uint64_t> blockCounts;
+      if (readCellsWithBlocks(meshName, popName, cellIds, blockCounts) == false) {
+         return false;
+      }
+   
+      // Input cellswithblock locations:
+      uint64_t blockOffset = 0;
+      for (uint64_t cell = 0; cell < cellIds.size(); ++cell) {
+         const pair<uint64_t, uint32_t> input = make_pair( blockOffset, blockCounts[cell] );
+         //Insert the location and number of blocks into the map
+         cellsWithBlocksLocations.insert( make_pair(cellIds[cell], input) );
+         blockOffset += blockCounts[cell];
+      }
+   
       cellsWithBlocksSet = true;
       return true;
    }
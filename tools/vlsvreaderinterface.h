@@ -59,6 +59,8 @@ namespace vlsvinterface {
          cellIdLocations.clear();
          cellIdsSet = false;
       }
+      bool readCellsWithBlocks(const std::string& meshName,const std::string& popName,
+                               std::vector<uint64_t>& cellIds,std::vector<uint64_t>& blockCounts);
       bool setCellsWithBlocks(const std::string& meshName,const std::string& popName);
       inline void clearCellsWithBlocks() {
          cellsWithBlocksLocations.clear();
@@ -0,0 +1,272 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <mpi.h>
+#include "tracer.h"
+#include "common.h"
+#include "parameters.h"
+#include "logger.h"
+
+extern Logger logFile;
+
+using namespace std;
+typedef Parameters P;
+
+namespace tracer {
+
+   enum Category {
+      PHASE,
+      BARRIER
+   };
+
+   struct Event {
+      double begin;
+      double end;
+      uint32_t name;
+      uint32_t category;
+   };
+
+   // Number of ranks listed in the barrier summary
+   static const size_t N_SUMMARY_ENTRIES = 5;
+
+   static bool active = false;
+   // Time origin, taken right after a barrier so that the ranks are aligned to within the barrier exit skew
+   static double origin = 0.0;
+   static vector<string> names;
+   static unordered_map<string, uint32_t> nameIds;
+   // Open phases, innermost last
+   static vector<pair<uint32_t, double>> openPhases;
+   // Ring buffer of events since the last write
+   static vector<Event> events;
+   static size_t nextEvent = 0;
+   static uint64_t recordedEvents = 0;
+   // Wait of each barrier since the last write, in call order which is the same on all ranks
+   static vector<double> barrierWaits;
+   static vector<uint32_t> barrierNames;
+
+   static uint32_t getNameId(const string& name) {
+      auto it = nameIds.find(name);
+      if (it != nameIds.end()) {
+         return it->second;
+      }
+      const uint32_t id = names.size();
+      names.push_back(name);
+      nameIds[name] = id;
+      return id;
+   }
+
+   static void record(const uint32_t name, const Category category, const double begin, const double end) {
+      events[nextEvent] = {begin - origin, end - origin, name, category};
+      nextEvent = (nextEvent + 1) % events.size();
+      ++recordedEvents;
+   }
+
+   static string escape(const string& text) {
+      string escaped;
+      for (const char c : text) {
+         if (c == '"' || c == '\\') {
+            escaped += '\\';
+         }
+         escaped += c;
+      }
+      return escaped;
+   }
+
+   // Log which ranks arrived last at the barriers since the last write
+   static void summarizeBarriers(const int myRank, const uint tstep) {
+      const uint64_t nLocal = barrierWaits.size();
+      uint64_t nMin, nMax;
+      MPI_Allreduce(&nLocal, &nMin, 1, MPI_UINT64_T, MPI_MIN, MPI_COMM_WORLD);
+      MPI_Allreduce(&nLocal, &nMax, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+      if (nMin != nMax) {
+         if (myRank == MASTER_RANK) {
+            logFile << "(TRACE) tstep = " << tstep << " ranks recorded different numbers of barriers, no barrier summary" << endl << writeVerbose;
+         }
+         return;
+      }
+      if (nMin == 0) {
+         return;
+      }
+
+      // The rank that waited least in a barrier was the last to arrive, and the
+      // longest wait is how long it held up the others
+      struct WaitRank { double wait; int rank; };
+      vector<WaitRank> local(nLocal), last(nLocal);
+      for (size_t b=0; b<nLocal; ++b) {
+         local[b] = {barrierWaits[b], myRank};
+      }
+      vector<double> longest(nLocal);
+      MPI_Reduce(local.data(), last.data(), nLocal, MPI_DOUBLE_INT, MPI_MINLOC, MASTER_RANK, MPI_COMM_WORLD);
+      MPI_Reduce(barrierWaits.data(), longest.data(), nLocal, MPI_DOUBLE, MPI_MAX, MASTER_RANK, MPI_COMM_WORLD);
+      if (myRank != MASTER_RANK) {
+         return;
+      }
+
+      // Total time held up and number of times last, per barrier and rank
+      map<pair<uint32_t, int>, pair<double, uint64_t>> heldUp;
+      for (size_t b=0; b<nLocal; ++b) {
+         auto& entry = heldUp[make_pair(barrierNames[b], last[b].rank)];
+         entry.first += longest[b];
+         ++entry.second;
+      }
+      vector<pair<double, pair<uint32_t, int>>> ranking;
+      for (const auto& entry : heldUp) {
+         ranking.push_back(make_pair(entry.second.first, entry.first));
+      }
+      sort(ranking.begin(), ranking.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+      for (size_t r=0; r<min(ranking.size(), N_SUMMARY_ENTRIES); ++r) {
+         const auto& key = ranking[r].second;
+         logFile << "(TRACE) tstep = " << tstep << " rank " << key.second << " arrived last at " << names[key.first]
+                 << " " << heldUp[key].second << " times, holding up the other ranks for " << ranking[r].first << " s" << endl << writeVerbose;
+      }
+   }
+
+   // Write the events of all ranks into one trace file and start a new window
+   static void write(const uint tstep) {
+      int myRank, nRanks;
+      MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+      MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+      // Each rank writes its own part of the traceEvents array, starting with its process name
+      stringstream text;
+      text.setf(ios::fixed);
+      text.precision(3);
+      if (myRank == 0) {
+         text << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+      } else {
+         text << ",\n";
+      }
+      text << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << myRank << ",\"args\":{\"name\":\"rank " << myRank << "\"}}";
+      text << ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":" << myRank << ",\"args\":{\"sort_index\":" << myRank << "}}";
+      const size_t nEvents = min<uint64_t>(recordedEvents, events.size());
+      const size_t first = recordedEvents > events.size() ? nextEvent : 0;
+      for (size_t e=0; e<nEvents; ++e) {
+         const Event& event = events[(first + e) % events.size()];
+         text << ",\n{\"name\":\"" << escape(names[event.name]) << "\",\"cat\":\"" << (event.category == BARRIER ? "barrier" : "phase")
+              << "\",\"ph\":\"X\",\"pid\":" << myRank << ",\"tid\":0,\"ts\":" << event.begin * 1e6
+              << ",\"dur\":" << (event.end - event.begin) * 1e6 << "}";
+      }
+      if (myRank == nRanks - 1) {
+         text << "\n]}\n";
+      }
+      const string data = text.str();
+
+      uint64_t size = data.size(), offset = 0, dropped = recordedEvents - nEvents, totalDropped = 0;
+      MPI_Exscan(&size, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+      if (myRank == 0) {
+         offset = 0;
+      }
+      MPI_Reduce(&dropped, &totalDropped, 1, MPI_UINT64_T, MPI_SUM, MASTER_RANK, MPI_COMM_WORLD);
+
+      char fileName[1024];
+      snprintf(fileName, sizeof(fileName), "%s_%07u.json", P::traceFilePrefix.c_str(), tstep);
+      MPI_File file;
+      if (MPI_File_open(MPI_COMM_WORLD, fileName, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+         if (myRank == MASTER_RANK) {
+            logFile << "(TRACE) ERROR could not open " << fileName << ", trace not written" << endl << writeVerbose;
+         }
+      } else {
+         MPI_File_set_size(file, 0);
+         MPI_File_write_at_all(file, offset, data.data(), data.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+         MPI_File_close(&file);
+         if (myRank == MASTER_RANK) {
+            logFile << "(TRACE) tstep = " << tstep << " wrote " << fileName;
+            if (totalDropped > 0) {
+               logFile << ", " << totalDropped << " events were overwritten, increase io.trace_buffer_size to keep them";
+            }
+            logFile << endl << writeVerbose;
+         }
+      }
+
+      summarizeBarriers(myRank, tstep);
+
+      nextEvent = 0;
+      recordedEvents = 0;
+      barrierWaits.clear();
+      barrierNames.clear();
+   }
+
+   void initialize() {
+      active = P::traceBufferSize > 0;
+      if (!active) {
+         return;
+      }
+      events.resize(P::traceBufferSize);
+      MPI_Barrier(MPI_COMM_WORLD);
+      origin = MPI_Wtime();
+   }
+
+   bool enabled() {
+      return active;
+   }
+
+   void start(const string& name) {
+      if (!active) {
+         return;
+      }
+      openPhases.push_back(make_pair(getNameId(name), MPI_Wtime()));
+   }
+
+   void stop() {
+      if (!active || openPhases.empty()) {
+         return;
+      }
+      record(openPhases.back().first, PHASE, openPhases.back().second, MPI_Wtime());
+      openPhases.pop_back();
+   }
+
+   void barrier(const string& name) {
+      if (!active) {
+         MPI_Barrier(MPI_COMM_WORLD);
+         return;
+      }
+      const double begin = MPI_Wtime();
+      MPI_Barrier(MPI_COMM_WORLD);
+      const double end = MPI_Wtime();
+      const uint32_t id = getNameId(name);
+      record(id, BARRIER, begin, end);
+      // Bounded like the event buffer, all ranks stop adding at the same barrier
+      if (barrierWaits.size() < events.size()) {
+         barrierWaits.push_back(end - begin);
+         barrierNames.push_back(id);
+      }
+   }
+
+   void endStep() {
+      if (active && P::traceInterval > 0 && P::tstep % P::traceInterval == 0) {
+         write(P::tstep);
+      }
+   }
+
+   void finalize() {
+      if (active) {
+         write(P::tstep);
+      }
+   }
+}
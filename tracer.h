@@ -0,0 +1,67 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <string>
+
+/* Per-rank timeline of the solver phases and barriers.
+ *
+ * When io.trace_buffer_size is nonzero every rank records the begin and end
+ * time of the major phases of a time step (translation per dimension and
+ * population, acceleration per population, field solver, coupling, IO, load
+ * balance) and of the waits in barriers into a ring buffer of that many events.
+ * Every io.trace_interval:th step, and at the end of the run, the buffers of all
+ * ranks are written into a single file io.trace_file_prefix_<tstep>.json in the
+ * Chrome trace event format, which can be opened in Perfetto or chrome://tracing.
+ * Each rank is shown as its own process.
+ *
+ * At each write the master rank also logs, per barrier, which ranks arrived last
+ * and how long the other ranks waited for them.
+ *
+ * Phases are recorded by the master thread outside of OpenMP parallel regions
+ * and nest like phiprof timers. With tracing disabled the calls return at once. */
+namespace tracer {
+
+   /*! Set up the ring buffer and a common time origin for all ranks. Collective.*/
+   void initialize();
+
+   /*! True if phases are recorded.*/
+   bool enabled();
+
+   /*! Begin a phase on this rank.*/
+   void start(const std::string& name);
+
+   /*! End the innermost phase on this rank.*/
+   void stop();
+
+   /*! MPI_Barrier on MPI_COMM_WORLD. When tracing, the wait is recorded under the given name.*/
+   void barrier(const std::string& name);
+
+   /*! Finish a time step, writes the trace on every io.trace_interval:th step. Collective.*/
+   void endStep();
+
+   /*! Write the events not yet written. Collective.*/
+   void finalize();
+}
+
+#endif
@@ -38,12 +38,26 @@
 #else
    // GPU allocation factors are stored in arch/gpu_base.hpp
    static const double BLOCK_ALLOCATION_FACTOR = 1.1;
+   #ifdef VELOCITY_BLOCK_POOL
+      // Block data is allocated in size classes from a process-wide pool, see velocity_block_pool.h
+      #include "velocity_block_pool.h"
+   #endif
 #endif
 
 using namespace std;
 
 namespace vmesh {
 
+#ifndef USE_GPU
+   #ifdef VELOCITY_BLOCK_POOL
+   typedef std::vector<Realf,block_pool::pool_allocator<Realf,WID3> > BlockDataVector;
+   typedef std::vector<Real,block_pool::pool_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> > BlockParametersVector;
+   #else
+   typedef std::vector<Realf,aligned_allocator<Realf,WID3> > BlockDataVector;
+   typedef std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> > BlockParametersVector;
+   #endif
+#endif
+
 #ifdef USE_GPU
    class VelocityBlockContainer : public Managed {
 #else
@@ -107,8 +121,8 @@ namespace vmesh {
       split::SplitVector<Realf> *block_data;
       split::SplitVector<Real> *parameters;
 #else
-      std::vector<Realf,aligned_allocator<Realf,WID3> > *block_data;
-      std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> > *parameters;
+      BlockDataVector *block_data;
+      BlockParametersVector *parameters;
 #endif
 
    };
@@ -121,8 +135,8 @@ namespace vmesh {
       parameters= new split::SplitVector<Real>(capacity);
       attachedStream = 0;
 #else
-      block_data = new std::vector<Realf,aligned_allocator<Realf,WID3>>(capacity);
-      parameters = new std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS>>(capacity);
+      block_data = new BlockDataVector(capacity);
+      parameters = new BlockParametersVector(capacity);
 #endif
       block_data->clear();
       parameters->clear();
@@ -139,8 +153,8 @@ namespace vmesh {
       block_data= new split::SplitVector<Realf>(*(other.block_data));
       parameters= new split::SplitVector<Real>(*(other.parameters));
 #else
-      block_data = new std::vector<Realf,aligned_allocator<Realf,WID3>>(*(other.block_data));
-      parameters = new std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS>>(*(other.parameters));
+      block_data = new BlockDataVector(*(other.block_data));
+      parameters = new BlockParametersVector(*(other.parameters));
 #endif
       currentCapacity = other.currentCapacity;
       numberOfBlocks = other.numberOfBlocks;
@@ -155,8 +169,8 @@ namespace vmesh {
       block_data= new split::SplitVector<Realf>(*(other.block_data));
       parameters= new split::SplitVector<Real>(*(other.parameters));
 #else
-      block_data = new std::vector<Realf,aligned_allocator<Realf,WID3>>(*(other.block_data));
-      parameters = new std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS>>(*(other.parameters));
+      block_data = new BlockDataVector(*(other.block_data));
+      parameters = new BlockParametersVector(*(other.parameters));
 #endif
       currentCapacity = other.currentCapacity;
       numberOfBlocks = other.numberOfBlocks;
@@ -180,8 +194,8 @@ namespace vmesh {
       parameters->clear();
       parameters->shrink_to_fit();
 #else
-      std::vector<Realf,aligned_allocator<Realf,WID3> > *dummy_data = new std::vector<Realf,aligned_allocator<Realf,WID3> >(1);
-      std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> > *dummy_parameters = new std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> >(1);
+      BlockDataVector *dummy_data = new BlockDataVector(1);
+      BlockParametersVector *dummy_parameters = new BlockParametersVector(1);
       // initialization with zero capacity returns null pointers
       block_data->swap(*dummy_data);
       parameters->swap(*dummy_parameters);
@@ -472,7 +486,7 @@ namespace vmesh {
 #ifdef USE_GPU
          split::SplitVector<Realf> *dummy_data = new split::SplitVector<Realf>(newCapacity*WID3);
 #else
-         std::vector<Realf,aligned_allocator<Realf,WID3> > *dummy_data = new std::vector<Realf,aligned_allocator<Realf,WID3> >(newCapacity*WID3);
+         BlockDataVector *dummy_data = new BlockDataVector(newCapacity*WID3);
 #endif
          for (size_t i=0; i<numberOfBlocks*WID3; ++i) (*dummy_data)[i] = (*block_data)[i];
          dummy_data->swap(*block_data);
@@ -482,7 +496,7 @@ namespace vmesh {
 #ifdef USE_GPU
          split::SplitVector<Real> *dummy_parameters = new split::SplitVector<Real>(newCapacity*BlockParams::N_VELOCITY_BLOCK_PARAMS);
 #else
-         std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> > *dummy_parameters = new std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> >(newCapacity*BlockParams::N_VELOCITY_BLOCK_PARAMS);
+         BlockParametersVector *dummy_parameters = new BlockParametersVector(newCapacity*BlockParams::N_VELOCITY_BLOCK_PARAMS);
 #endif
          for (size_t i=0; i<numberOfBlocks*BlockParams::N_VELOCITY_BLOCK_PARAMS; ++i) (*dummy_parameters)[i] = (*parameters)[i];
          dummy_parameters->swap(*parameters);
@@ -533,6 +547,13 @@ namespace vmesh {
          // and at least two in case of having zero blocks.
          // The order of velocity blocks is unaltered.
          currentCapacity = 2 + numberOfBlocks * BLOCK_ALLOCATION_FACTOR;
+         #ifdef VELOCITY_BLOCK_POOL
+         // Use all of the slack in the pool size class, and reserve exactly that
+         // so that std::vector does not double the buffer on its own.
+         currentCapacity = BlockDataVector::allocator_type::capacity_for(currentCapacity*WID3) / WID3;
+         block_data->reserve(currentCapacity*WID3);
+         parameters->reserve(currentCapacity*BlockParams::N_VELOCITY_BLOCK_PARAMS);
+         #endif
          block_data->resize(currentCapacity*WID3);
          parameters->resize(currentCapacity*BlockParams::N_VELOCITY_BLOCK_PARAMS);
       }
@@ -0,0 +1,286 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "definitions.h"
+
+// Two-level global to local ID index of the blocks of a velocity mesh. Used by
+// VelocityMesh instead of OpenBucketHashtable when compiled with -DVELOCITY_BLOCK_INDEX.
+//
+// The velocity grid is divided into super-blocks of 4x4x4 blocks. The top level is a
+// dense array over the bounding box of the occupied super-blocks, pointing to a table
+// of the 64 local IDs of each occupied super-block. A lookup is two array reads, the
+// block indices are computed from the global ID with multiplications by precomputed
+// reciprocals instead of integer divisions. As
+// the blocks of a population form a compact cloud, the bounding box stays small. It
+// grows when blocks are added outside of it and is only reset by clear(). Tables of
+// super-blocks that become empty are reused.
+//
+// The interface is the part of OpenBucketHashtable that VelocityMesh uses. Iterators
+// only give read access to the key and value; values are modified through at().
+template <typename GID, typename LID> class VelocityBlockIndex {
+private:
+   static constexpr int SUPER_BITS = 2;                    // Logarithm (base two) of the super-block side in blocks
+   static constexpr uint32_t SUPER_MASK = (1u << SUPER_BITS) - 1;
+   static constexpr uint32_t TABLE_SIZE = 1u << (3 * SUPER_BITS);
+   static constexpr uint32_t NO_TABLE = 0;                  // Table 0 is always empty, so missing super-blocks need no check
+   static constexpr uint32_t BOX_MARGIN = 2;                // Super-blocks added on each side when the box grows
+   static constexpr LID EMPTY = vmesh::INVALID_LOCALID;
+
+   uint32_t gridLength[3];   // Velocity grid size in blocks
+   uint64_t inverseLength[2];  // Fixed point reciprocals of the x and y grid lengths, 0 for a length of one
+   uint32_t superLength[3];  // Velocity grid size in super-blocks
+   uint32_t boxMin[3];       // First super-block of the bounding box
+   uint32_t boxLength[3];    // Size of the bounding box in super-blocks
+   size_t fill;              // Number of stored keys
+   std::vector<uint32_t> box;        // Table index of each super-block in the bounding box
+   std::vector<LID> tables;          // Local IDs of each table, EMPTY for missing blocks, starting with the empty table
+   std::vector<uint32_t> occupancy;  // Number of stored keys in each table
+   std::vector<uint32_t> freeTables; // Tables not in use
+
+   // Reciprocal for divide(), ceil(2^64 / d)
+   static inline uint64_t reciprocal(const uint32_t d) {
+      return d > 1 ? UINT64_MAX / d + 1 : 0;
+   }
+
+   // Quotient and remainder of a 32-bit unsigned division, exact for all n (Lemire et al. 2019)
+   static inline uint32_t divide(const uint32_t n, const uint32_t d, const uint64_t inverse, uint32_t& r) {
+      const uint32_t q = inverse == 0 ? n : (uint32_t)(((__uint128_t)inverse * n) >> 64);
+      r = n - q * d;
+      return q;
+   }
+
+   // Block indices of a global ID, false if the ID is outside of the grid
+   inline bool indices(const GID& key, uint32_t& i, uint32_t& j, uint32_t& k) const {
+      k = divide(divide(key, gridLength[0], inverseLength[0], i), gridLength[1], inverseLength[1], j);
+      return k < gridLength[2];
+   }
+
+   // Position in the box of the super-block of a block, false if it is outside of the box
+   inline bool boxIndex(const uint32_t i, const uint32_t j, const uint32_t k, size_t& index) const {
+      const uint32_t si = (i >> SUPER_BITS) - boxMin[0];
+      const uint32_t sj = (j >> SUPER_BITS) - boxMin[1];
+      const uint32_t sk = (k >> SUPER_BITS) - boxMin[2];
+      index = ((size_t)sk * boxLength[1] + sj) * boxLength[0] + si;
+      // Unsigned wrap-around also catches super-blocks below the box
+      return (si < boxLength[0]) & (sj < boxLength[1]) & (sk < boxLength[2]);
+   }
+
+   static inline uint32_t tableOffset(const uint32_t i, const uint32_t j, const uint32_t k) {
+      return ((((k & SUPER_MASK) << SUPER_BITS) | (j & SUPER_MASK)) << SUPER_BITS) | (i & SUPER_MASK);
+   }
+
+   // Slot of a key, or nullptr if the key is not stored. Keys outside of the box are
+   // redirected to the empty table instead of branching, as lookups of missing
+   // neighbours are frequent and unpredictable.
+   inline const LID* slot(const GID& key) const {
+      if (fill == 0) {
+         return nullptr;
+      }
+      uint32_t i, j, k;
+      size_t index;
+      const bool inside = indices(key, i, j, k) & boxIndex(i, j, k, index);
+      const uint32_t table = box.data()[inside ? index : 0] & (inside ? ~0u : NO_TABLE);
+      const LID* s = tables.data() + ((size_t)table * TABLE_SIZE + tableOffset(i, j, k));
+      return *s == EMPTY ? nullptr : s;
+   }
+
+   // Grow the bounding box to contain the given super-block
+   void growBox(const uint32_t si, const uint32_t sj, const uint32_t sk) {
+      const uint32_t s[3] = {si, sj, sk};
+      uint32_t newMin[3], newLength[3];
+      for (int d = 0; d < 3; d++) {
+         uint32_t lo = s[d] >= BOX_MARGIN ? s[d] - BOX_MARGIN : 0;
+         uint32_t hi = std::min(s[d] + BOX_MARGIN + 1, superLength[d]);
+         if (boxLength[d] > 0) {
+            lo = std::min(lo, boxMin[d]);
+            hi = std::max(hi, boxMin[d] + boxLength[d]);
+         }
+         newMin[d] = lo;
+         newLength[d] = hi - lo;
+      }
+
+      std::vector<uint32_t> newBox((size_t)newLength[0] * newLength[1] * newLength[2], NO_TABLE);
+      for (uint32_t k = 0; k < boxLength[2]; k++) {
+         for (uint32_t j = 0; j < boxLength[1]; j++) {
+            for (uint32_t i = 0; i < boxLength[0]; i++) {
+               const size_t newIndex = ((size_t)(k + boxMin[2] - newMin[2]) * newLength[1] + (j + boxMin[1] - newMin[1])) * newLength[0]
+                                       + (i + boxMin[0] - newMin[0]);
+               newBox[newIndex] = box[((size_t)k * boxLength[1] + j) * boxLength[0] + i];
+            }
+         }
+      }
+      box.swap(newBox);
+      for (int d = 0; d < 3; d++) {
+         boxMin[d] = newMin[d];
+         boxLength[d] = newLength[d];
+      }
+   }
+
+public:
+   // Iterator to a stored key. Only gives read access, comparable to end().
+   class iterator {
+      std::pair<GID, LID> entry;
+      const LID* position;
+
+   public:
+      iterator(const LID* position, const GID& key) : entry(key, position ? *position : EMPTY), position(position) {}
+
+      bool operator==(const iterator& other) const { return position == other.position; }
+      bool operator!=(const iterator& other) const { return position != other.position; }
+      const std::pair<GID, LID>& operator*() const { return entry; }
+      const std::pair<GID, LID>* operator->() const { return &entry; }
+   };
+   typedef iterator const_iterator;
+
+   VelocityBlockIndex() : gridLength{0, 0, 0}, inverseLength{0, 0}, superLength{0, 0, 0}, boxMin{0, 0, 0}, boxLength{0, 0, 0}, fill(0) {}
+
+   // Set the size of the velocity grid in blocks. Ignored unless the index is empty.
+   void setGridLength(const uint32_t length[3]) {
+      if (fill > 0 || (length[0] == gridLength[0] && length[1] == gridLength[1] && length[2] == gridLength[2])) {
+         return;
+      }
+      clear();
+      for (int d = 0; d < 3; d++) {
+         gridLength[d] = length[d];
+         superLength[d] = (length[d] + SUPER_MASK) >> SUPER_BITS;
+      }
+      inverseLength[0] = reciprocal(length[0]);
+      inverseLength[1] = reciprocal(length[1]);
+   }
+
+   // Element access by reference, the key has to exist
+   LID& at(const GID& key) {
+      const LID* s = slot(key);
+      if (s == nullptr) {
+         throw std::out_of_range("Element not found in VelocityBlockIndex.at");
+      }
+      return const_cast<LID&>(*s);
+   }
+
+   const LID& at(const GID& key) const {
+      const LID* s = slot(key);
+      if (s == nullptr) {
+         throw std::out_of_range("Element not found in VelocityBlockIndex.at");
+      }
+      return *s;
+   }
+
+   size_t size() const { return fill; }
+
+   // Allocated memory in units of one key-value pair, for comparison with the hashtable
+   size_t bucket_count() const {
+      return (box.capacity() * sizeof(uint32_t) + tables.capacity() * sizeof(LID) + occupancy.capacity() * sizeof(uint32_t)
+              + freeTables.capacity() * sizeof(uint32_t)) / (sizeof(GID) + sizeof(LID));
+   }
+
+   size_t count(const GID& key) const { return slot(key) == nullptr ? 0 : 1; }
+
+   void clear() {
+      std::vector<uint32_t>().swap(box);
+      std::vector<LID>().swap(tables);
+      std::vector<uint32_t>().swap(occupancy);
+      std::vector<uint32_t>().swap(freeTables);
+      for (int d = 0; d < 3; d++) {
+         boxMin[d] = 0;
+         boxLength[d] = 0;
+      }
+      fill = 0;
+   }
+
+   iterator end() const { return iterator(nullptr, vmesh::INVALID_GLOBALID); }
+
+   iterator find(const GID& key) const { return iterator(slot(key), key); }
+
+   // Insert a key-value pair. If the key exists already, its value is kept.
+   // Keys outside of the velocity grid are not inserted.
+   std::pair<iterator, bool> insert(const std::pair<GID, LID>& element) {
+      uint32_t i, j, k;
+      if (!indices(element.first, i, j, k)) {
+         return std::make_pair(end(), false);
+      }
+      size_t index;
+      if (!boxIndex(i, j, k, index)) {
+         growBox(i >> SUPER_BITS, j >> SUPER_BITS, k >> SUPER_BITS);
+         boxIndex(i, j, k, index);
+      }
+      if (tables.empty()) {
+         tables.resize(TABLE_SIZE, EMPTY);
+         occupancy.push_back(0);
+      }
+      if (box[index] == NO_TABLE) {
+         if (freeTables.empty()) {
+            box[index] = occupancy.size();
+            occupancy.push_back(0);
+            tables.resize(tables.size() + TABLE_SIZE, EMPTY);
+         } else {
+            box[index] = freeTables.back();
+            freeTables.pop_back();
+         }
+      }
+      const uint32_t table = box[index];
+      LID& s = tables[(size_t)table * TABLE_SIZE + tableOffset(i, j, k)];
+      if (s != EMPTY) {
+         return std::make_pair(iterator(&s, element.first), false);
+      }
+      s = element.second;
+      occupancy[table]++;
+      fill++;
+      return std::make_pair(iterator(&s, element.first), true);
+   }
+
+   // Remove the element the iterator points to
+   void erase(const iterator& it) {
+      if (it == end()) {
+         return;
+      }
+      uint32_t i, j, k;
+      size_t index;
+      indices(it->first, i, j, k);
+      boxIndex(i, j, k, index);
+      const uint32_t table = box[index];
+      tables[(size_t)table * TABLE_SIZE + tableOffset(i, j, k)] = EMPTY;
+      fill--;
+      if (--occupancy[table] == 0) {
+         box[index] = NO_TABLE;
+         freeTables.push_back(table);
+      }
+   }
+
+   void swap(VelocityBlockIndex<GID, LID>& other) {
+      std::swap(gridLength, other.gridLength);
+      std::swap(inverseLength, other.inverseLength);
+      std::swap(superLength, other.superLength);
+      std::swap(boxMin, other.boxMin);
+      std::swap(boxLength, other.boxLength);
+      std::swap(fill, other.fill);
+      box.swap(other.box);
+      tables.swap(other.tables);
+      occupancy.swap(other.occupancy);
+      freeTables.swap(other.freeTables);
+   }
+};
@@ -0,0 +1,309 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "memoryallocation.h"
+#include "velocity_block_pool.h"
+
+namespace block_pool {
+
+   // Smallest size class is 2^MIN_CLASS_EXP bytes. Buffers larger than
+   // 2^MAX_CLASS_EXP bytes bypass the pool and go directly to the heap.
+   static const int MIN_CLASS_EXP = 9;
+   static const int MAX_CLASS_EXP = 40;
+   static const int SUBCLASSES = 4;
+   static const int N_CLASSES = SUBCLASSES*(MAX_CLASS_EXP-MIN_CLASS_EXP) + 1;
+   // Number of free buffers per class kept in each thread before spilling to the shared depot
+   static const size_t THREAD_CACHE_DEPTH = 4;
+
+   static std::atomic<uint64_t> bytesInUse {0};
+   static std::atomic<uint64_t> bytesRequested {0};
+   static std::atomic<uint64_t> bytesCached {0};
+   static std::atomic<uint64_t> bytesHighWaterMark {0};
+   static std::atomic<uint64_t> allocations {0};
+   static std::atomic<uint64_t> poolHits {0};
+   static std::atomic<uint64_t> heapReleases {0};
+   static std::atomic<uint64_t> maxCachedBytes {1ul << 30};
+
+   /*! Returns the size class of a request of the given size, or -1 if the
+    * request is too large to be pooled.*/
+   static int sizeClass(const size_t bytes) {
+      if (bytes <= (1ul << MIN_CLASS_EXP)) {
+         return 0;
+      }
+      if (bytes > (1ul << MAX_CLASS_EXP)) {
+         return -1;
+      }
+      // 2^e < bytes <= 2^(e+1)
+      int e = 63 - __builtin_clzl(bytes-1);
+      const size_t base = 1ul << e;
+      const size_t step = base / SUBCLASSES;
+      const int sub = (bytes - base + step - 1) / step;
+      return SUBCLASSES*(e-MIN_CLASS_EXP) + sub;
+   }
+
+   /*! Size of the buffers in the given size class in bytes.*/
+   static size_t classBytes(const int cls) {
+      if (cls == 0) {
+         return 1ul << MIN_CLASS_EXP;
+      }
+      const int e = MIN_CLASS_EXP + (cls-1) / SUBCLASSES;
+      const int sub = (cls-1) % SUBCLASSES + 1;
+      const size_t base = 1ul << e;
+      return base + sub * (base / SUBCLASSES);
+   }
+
+   struct ThreadCache;
+
+   /*! Shared free lists, used when a thread cache is full or empty. Also keeps
+    * track of the thread caches so that the cache limit covers them.*/
+   struct Depot {
+      std::mutex lock;
+      std::vector<void*> freeLists[N_CLASSES];
+      std::vector<ThreadCache*> threadCaches;
+   };
+
+   static Depot& depot() {
+      static Depot d;
+      return d;
+   }
+
+   static void* heapAllocate(const size_t bytes) {
+      void* p = NULL;
+#ifdef USE_JEMALLOC
+      if (je_posix_memalign(&p,POOL_ALIGNMENT,bytes) != 0) {
+#else
+      if (posix_memalign(&p,POOL_ALIGNMENT,bytes) != 0) {
+#endif
+         return NULL;
+      }
+      return p;
+   }
+
+   static void heapFree(void* p) {
+#ifdef USE_JEMALLOC
+      je_free(p);
+#else
+      free(p);
+#endif
+   }
+
+   static void releaseToHeap(void* p,const size_t size) {
+      heapFree(p);
+      bytesCached -= size;
+      ++heapReleases;
+   }
+
+   /*! Per-thread free lists. Buffers left here when the thread exits are
+    * handed to the depot. The lock is only contended when setMaxCachedBytes()
+    * or trim() empty the caches of all threads; it is taken after the depot
+    * lock, never the other way round.*/
+   struct ThreadCache {
+      std::mutex lock;
+      std::vector<void*> freeLists[N_CLASSES];
+
+      ThreadCache() {
+         Depot& d = depot();
+         std::lock_guard<std::mutex> guard(d.lock);
+         d.threadCaches.push_back(this);
+      }
+
+      ~ThreadCache() {
+         Depot& d = depot();
+         std::lock_guard<std::mutex> guard(d.lock);
+         std::lock_guard<std::mutex> localGuard(lock);
+         for (int c=0; c<N_CLASSES; ++c) {
+            d.freeLists[c].insert(d.freeLists[c].end(),freeLists[c].begin(),freeLists[c].end());
+            freeLists[c].clear();
+         }
+         for (size_t t=0; t<d.threadCaches.size(); ++t) {
+            if (d.threadCaches[t] == this) {
+               d.threadCaches[t] = d.threadCaches.back();
+               d.threadCaches.pop_back();
+               break;
+            }
+         }
+      }
+   };
+
+   static ThreadCache& threadCache() {
+      static thread_local ThreadCache cache;
+      return cache;
+   }
+
+   static void updateHighWaterMark() {
+      const uint64_t total = bytesInUse + bytesCached;
+      uint64_t previous = bytesHighWaterMark.load(std::memory_order_relaxed);
+      while (total > previous && !bytesHighWaterMark.compare_exchange_weak(previous,total,std::memory_order_relaxed)) {}
+   }
+
+   /*! Rounds a request up to the size of the buffer the pool would return for it.*/
+   size_t roundUpBytes(const size_t bytes) {
+      const int cls = sizeClass(bytes);
+      if (cls < 0) {
+         return bytes;
+      }
+      return classBytes(cls);
+   }
+
+   /*! Allocate a buffer of at least the given size, aligned to POOL_ALIGNMENT.
+    * Returns NULL if the heap allocation fails.*/
+   void* allocate(const size_t bytes) {
+      ++allocations;
+      const int cls = sizeClass(bytes);
+      if (cls < 0) {
+         void* p = heapAllocate(bytes);
+         if (p != NULL) {
+            bytesInUse += bytes;
+            bytesRequested += bytes;
+            updateHighWaterMark();
+         }
+         return p;
+      }
+      const size_t size = classBytes(cls);
+
+      void* p = NULL;
+      ThreadCache& cache = threadCache();
+      {
+         std::lock_guard<std::mutex> localGuard(cache.lock);
+         std::vector<void*>& local = cache.freeLists[cls];
+         if (!local.empty()) {
+            p = local.back();
+            local.pop_back();
+         }
+      }
+      if (p == NULL) {
+         Depot& d = depot();
+         std::lock_guard<std::mutex> guard(d.lock);
+         if (!d.freeLists[cls].empty()) {
+            p = d.freeLists[cls].back();
+            d.freeLists[cls].pop_back();
+         }
+      }
+
+      if (p != NULL) {
+         ++poolHits;
+         bytesCached -= size;
+      } else {
+         p = heapAllocate(size);
+         if (p == NULL) {
+            return NULL;
+         }
+      }
+#ifdef INITIALIZE_ALIGNED_MALLOC_WITH_NAN
+      memset(p, ~0u, size);
+#endif
+      bytesInUse += size;
+      bytesRequested += bytes;
+      updateHighWaterMark();
+      return p;
+   }
+
+   /*! Return a buffer obtained from allocate() with the same size argument.
+    * The buffer is kept for reuse unless the cache limit would be exceeded.*/
+   void deallocate(void* p,const size_t bytes) {
+      if (p == NULL) {
+         return;
+      }
+      const int cls = sizeClass(bytes);
+      if (cls < 0) {
+         heapFree(p);
+         bytesInUse -= bytes;
+         bytesRequested -= bytes;
+         return;
+      }
+      const size_t size = classBytes(cls);
+      bytesInUse -= size;
+      bytesRequested -= bytes;
+      bytesCached += size;
+
+      if (bytesCached > maxCachedBytes) {
+         releaseToHeap(p,size);
+         return;
+      }
+      ThreadCache& cache = threadCache();
+      {
+         std::lock_guard<std::mutex> localGuard(cache.lock);
+         std::vector<void*>& local = cache.freeLists[cls];
+         if (local.size() < THREAD_CACHE_DEPTH) {
+            local.push_back(p);
+            return;
+         }
+      }
+      Depot& d = depot();
+      std::lock_guard<std::mutex> guard(d.lock);
+      d.freeLists[cls].push_back(p);
+   }
+
+   /*! Release the buffers of a free list to the heap, largest first, until
+    * at most limit bytes are cached.*/
+   static void releaseAbove(std::vector<void*> (&freeLists)[N_CLASSES],const uint64_t limit) {
+      for (int c=N_CLASSES-1; c>=0 && bytesCached > limit; --c) {
+         while (!freeLists[c].empty() && bytesCached > limit) {
+            releaseToHeap(freeLists[c].back(),classBytes(c));
+            freeLists[c].pop_back();
+         }
+      }
+   }
+
+   /*! Set the maximum amount of free memory kept in the pool, including the
+    * caches of all threads. Excess buffers are released immediately, first
+    * from the shared depot and then from the thread caches.*/
+   void setMaxCachedBytes(const size_t bytes) {
+      maxCachedBytes = bytes;
+      Depot& d = depot();
+      std::lock_guard<std::mutex> guard(d.lock);
+      releaseAbove(d.freeLists,bytes);
+      for (ThreadCache* cache : d.threadCaches) {
+         std::lock_guard<std::mutex> localGuard(cache->lock);
+         releaseAbove(cache->freeLists,bytes);
+      }
+   }
+
+   /*! Return all free buffers of all threads and of the shared depot to the heap.*/
+   void trim() {
+      Depot& d = depot();
+      std::lock_guard<std::mutex> guard(d.lock);
+      releaseAbove(d.freeLists,0);
+      for (ThreadCache* cache : d.threadCaches) {
+         std::lock_guard<std::mutex> localGuard(cache->lock);
+         releaseAbove(cache->freeLists,0);
+      }
+   }
+
+   Statistics getStatistics() {
+      Statistics s;
+      s.bytesInUse = bytesInUse;
+      s.bytesRequested = bytesRequested;
+      s.bytesCached = bytesCached;
+      s.bytesHighWaterMark = bytesHighWaterMark;
+      s.allocations = allocations;
+      s.poolHits = poolHits;
+      s.heapReleases = heapReleases;
+      return s;
+   }
+
+} // namespace block_pool
@@ -0,0 +1,142 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2024 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef VELOCITY_BLOCK_POOL_H
+#define VELOCITY_BLOCK_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+/*! Process-wide pool for the velocity block buffers of VelocityBlockContainer.
+ *
+ * Block data is kept contiguous per cell (all solvers index it as
+ * getData() + blockLID*WID3), so the pool works at buffer granularity:
+ * requests are rounded up to a size class (four classes per power of two,
+ * i.e. at most 25% internal slack) and freed buffers are kept on free lists
+ * instead of being returned to the heap. A buffer released by one cell, e.g.
+ * in shrink_to_fit after load balance, is handed to the next cell requesting
+ * the same class, so the heap does not fragment under the constant grow/shrink
+ * cycle of the block containers.
+ *
+ * The pool recycles whole buffers, it does not allocate individual blocks:
+ * growing a container still allocates a buffer of the next size class and
+ * copies the blocks over, as std::vector does without the pool. Keeping the
+ * block data contiguous is what all solvers rely on, so per-block slabs with
+ * stable addresses are not provided.
+ *
+ * Each thread has a small cache per class behind an uncontended lock; overflow
+ * goes to a shared depot, so buffers freed on one thread can be reused on
+ * another. The total amount of cached memory, thread caches included, is
+ * bounded by setMaxCachedBytes(), buffers beyond that are returned to the heap.
+ */
+namespace block_pool {
+
+   /*! Alignment of all pooled buffers in bytes. Covers the WID3 alignment
+    * requested for block data also with WID=8.*/
+   const std::size_t POOL_ALIGNMENT = 512;
+
+   /*! Counters describing the state of the pool on this process.*/
+   struct Statistics {
+      uint64_t bytesInUse;         /*!< Bytes in buffers currently handed out to containers.*/
+      uint64_t bytesRequested;     /*!< Bytes actually requested for those buffers (before size class rounding).*/
+      uint64_t bytesCached;        /*!< Bytes in free buffers kept for reuse, in the depot and all thread caches.*/
+      uint64_t bytesHighWaterMark; /*!< Maximum of bytesInUse+bytesCached seen so far.*/
+      uint64_t allocations;        /*!< Number of allocate() calls served.*/
+      uint64_t poolHits;           /*!< Number of allocations served from a free list.*/
+      uint64_t heapReleases;       /*!< Number of buffers returned to the heap because the cache was full.*/
+   };
+
+   void* allocate(const std::size_t bytes);
+   void deallocate(void* p,const std::size_t bytes);
+   std::size_t roundUpBytes(const std::size_t bytes);
+   void setMaxCachedBytes(const std::size_t bytes);
+   void trim();
+   Statistics getStatistics();
+
+   /*! Standard allocator handing out buffers from the block pool. Alignment
+    * is given in bytes as in aligned_allocator; anything up to POOL_ALIGNMENT
+    * is satisfied by the pool.*/
+   template <typename T, std::size_t Alignment>
+   class pool_allocator {
+   public:
+      typedef T * pointer;
+      typedef const T * const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef T value_type;
+      typedef std::size_t size_type;
+      typedef std::ptrdiff_t difference_type;
+
+      static_assert(Alignment <= POOL_ALIGNMENT,"pool_allocator alignment exceeds block pool alignment");
+
+      template <typename U>
+      struct rebind {
+         typedef pool_allocator<U, Alignment> other;
+      };
+
+      pool_allocator() { }
+      pool_allocator(const pool_allocator&) { }
+      template <typename U> pool_allocator(const pool_allocator<U, Alignment>&) { }
+      ~pool_allocator() { }
+
+      bool operator==(const pool_allocator& other) const {
+         return true;
+      }
+      bool operator!=(const pool_allocator& other) const {
+         return !(*this == other);
+      }
+
+      std::size_t max_size() const {
+         return (static_cast<std::size_t>(0) - static_cast<std::size_t>(1)) / sizeof(T);
+      }
+
+      /*! Number of elements that fit in the buffer allocate(n) would return.*/
+      static std::size_t capacity_for(const std::size_t n) {
+         return roundUpBytes(n * sizeof(T)) / sizeof(T);
+      }
+
+      T * allocate(const std::size_t n) const {
+         if (n == 0) {
+            return NULL;
+         }
+         if (n > max_size()) {
+            throw std::length_error("pool_allocator<T>::allocate() - Integer overflow.");
+         }
+         void * const pv = block_pool::allocate(n * sizeof(T));
+         if (pv == NULL) {
+            throw std::bad_alloc();
+         }
+         return static_cast<T *>(pv);
+      }
+
+      void deallocate(T * const p, const std::size_t n) const {
+         block_pool::deallocate(p, n * sizeof(T));
+      }
+
+   private:
+      pool_allocator& operator=(const pool_allocator&);
+   };
+
+} // namespace block_pool
+
+#endif
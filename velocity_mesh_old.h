@@ -36,10 +36,19 @@
 
 //#include "object_wrapper.h"
 #include "open_bucket_hashtable.h"
+#ifdef VELOCITY_BLOCK_INDEX
+   #include "velocity_block_index.h"
+#endif
 #include "velocity_mesh_parameters.h"
 
 namespace vmesh {
 
+   #ifdef VELOCITY_BLOCK_INDEX
+   typedef VelocityBlockIndex<vmesh::GlobalID,vmesh::LocalID> GlobalToLocalMap;
+   #else
+   typedef OpenBucketHashtable<vmesh::GlobalID,vmesh::LocalID> GlobalToLocalMap;
+   #endif
+
    class VelocityMesh {
     public:      
       VelocityMesh();
@@ -110,15 +119,17 @@ namespace vmesh {
       size_t meshID;
 
       std::vector<vmesh::GlobalID> *localToGlobalMap;
-      OpenBucketHashtable<vmesh::GlobalID,vmesh::LocalID> *globalToLocalMap;
+      GlobalToLocalMap *globalToLocalMap;
       //std::unordered_map<vmesh::GlobalID,vmesh::LocalID> globalToLocalMap;
+
+      void setIndexGrid();
    };
 
    // ***** DEFINITIONS OF TEMPLATE MEMBER FUNCTIONS ***** //
 
    inline VelocityMesh::VelocityMesh() { 
       meshID = std::numeric_limits<size_t>::max();
-      globalToLocalMap = new OpenBucketHashtable<vmesh::GlobalID,vmesh::LocalID>();
+      globalToLocalMap = new GlobalToLocalMap();
       localToGlobalMap = new std::vector<vmesh::GlobalID>(1);
       localToGlobalMap->clear();
    }
@@ -130,7 +141,7 @@ namespace vmesh {
 
    inline VelocityMesh::VelocityMesh(const VelocityMesh& other) {
       meshID = other.meshID;
-      globalToLocalMap = new OpenBucketHashtable<vmesh::GlobalID,vmesh::LocalID>(*(other.globalToLocalMap));
+      globalToLocalMap = new GlobalToLocalMap(*(other.globalToLocalMap));
       if (other.localToGlobalMap->size() > 0) {
          localToGlobalMap = new std::vector<vmesh::GlobalID>(*(other.localToGlobalMap));
       } else {
@@ -143,7 +154,7 @@ namespace vmesh {
       delete globalToLocalMap;
       delete localToGlobalMap;
       meshID = other.meshID;
-      globalToLocalMap = new OpenBucketHashtable<vmesh::GlobalID,vmesh::LocalID>(*(other.globalToLocalMap));
+      globalToLocalMap = new GlobalToLocalMap(*(other.globalToLocalMap));
       if (other.localToGlobalMap->size() > 0) {
          localToGlobalMap = new std::vector<vmesh::GlobalID>(*(other.localToGlobalMap));
       } else {
@@ -540,6 +551,7 @@ namespace vmesh {
    inline bool VelocityMesh::push_back(const vmesh::GlobalID& globalID) {
       if (size() >= (*vmesh::getMeshWrapper()->velocityMeshes)[meshID].max_velocity_blocks) return false;
       if (globalID == invalidGlobalID()) return false;
+      setIndexGrid();
 
       auto position
         = globalToLocalMap->insert(std::make_pair(globalID,localToGlobalMap->size()));
@@ -558,7 +570,8 @@ namespace vmesh {
          std::cerr << ", max is " << (*vmesh::getMeshWrapper()->velocityMeshes)[meshID].max_velocity_blocks << std::endl;
          return false;
       }
-         
+
+      setIndexGrid();
       for (size_t b=0; b<blocks.size(); ++b) {
          globalToLocalMap->insert(std::make_pair(blocks[b],localToGlobalMap->size()+b));
       }
@@ -573,6 +586,7 @@ namespace vmesh {
 
    inline void VelocityMesh::setGrid() {
       globalToLocalMap->clear();
+      setIndexGrid();
       for (size_t i=0; i<localToGlobalMap->size(); ++i) {
          globalToLocalMap->insert(std::make_pair(localToGlobalMap->at(i),i));
       }
@@ -580,6 +594,7 @@ namespace vmesh {
 
    inline bool VelocityMesh::setGrid(const std::vector<vmesh::GlobalID>& globalIDs) {
       globalToLocalMap->clear();
+      setIndexGrid();
       for (vmesh::LocalID i=0; i<globalIDs.size(); ++i) {
          globalToLocalMap->insert(std::make_pair(globalIDs[i],i));
       }
@@ -594,6 +609,14 @@ namespace vmesh {
       return true;
    }
    
+   /** The two-level index needs the size of the velocity grid, which is
+    * only known once the mesh has been set. Called before blocks are added.*/
+   inline void VelocityMesh::setIndexGrid() {
+      #ifdef VELOCITY_BLOCK_INDEX
+      globalToLocalMap->setGridLength((*vmesh::getMeshWrapper()->velocityMeshes)[meshID].gridLength);
+      #endif
+   }
+
    inline void VelocityMesh::setNewSize(const vmesh::LocalID& newSize) {
       localToGlobalMap->resize(newSize);
    }
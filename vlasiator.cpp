@@ -51,11 +51,16 @@
 #include "fieldsolver/fs_common.h"
 #include "projects/project.h"
 #include "grid.h"
+#include "cellcost.h"
+#include "perfmetrics.h"
+#include "tracer.h"
 #include "iowrite.h"
 #include "ioread.h"
 
 #include "object_wrapper.h"
+#include "globals.h"
 #include "velocity_mesh_parameters.h"
+#include "velocity_block_pool.h"
 #include "fieldsolver/gridGlue.hpp"
 #include "fieldsolver/derivatives.hpp"
 
@@ -74,26 +79,18 @@ void fpehandler(int sig_num)
 
 #include "phiprof.hpp"
 
-Logger logFile, diagnostic;
-static dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry> mpiGrid;
-
 using namespace std;
 
-int globalflags::bailingOut = 0;
-bool globalflags::writeRestart = 0;
-bool globalflags::balanceLoad = 0;
-bool globalflags::ionosphereJustSolved = false;
-
-ObjectWrapper objectWrapper;
-
 void addTimedBarrier(string name){
 #ifdef NDEBUG
-//let's not do  a barrier
-   return;
+//let's not do  a barrier, unless it is traced
+   if (!tracer::enabled()) {
+      return;
+   }
 #endif
    int bt=phiprof::initializeTimer(name,"Barriers","MPI");
    phiprof::start(bt);
-   MPI_Barrier(MPI_COMM_WORLD);
+   tracer::barrier(name);
    phiprof::stop(bt);
 }
 
@@ -132,29 +129,21 @@ void computeNewTimeStep(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
          const Real *parameters = cell->get_block_parameters(popID);
          const Real HALF = 0.5;
          Real popMin = std::numeric_limits<Real>::max();
-#pragma omp parallel
-         {
-            Real threadMin = std::numeric_limits<Real>::max();
-            arch::parallel_reduce<arch::min>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
-                                             ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lthreadMin){
-                                                const Real VX
-                                                   =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
-                                                   + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
-                                                const Real VY
-                                                   =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
-                                                   + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
-                                                const Real VZ
-                                                   =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
-                                                   + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
-                                                lthreadMin[0] = min(dx / fabs(VX), lthreadMin[0]);
-                                                lthreadMin[0] = min(dy / fabs(VY), lthreadMin[0]);
-                                                lthreadMin[0] = min(dz / fabs(VZ), lthreadMin[0]);
-                                             }, threadMin);
-#pragma omp critical
-            {
-               popMin = min(threadMin, popMin);
-            }
-         }
+         arch::parallel_reduce<arch::min>({WID, WID, WID, (uint)cell->get_number_of_velocity_blocks(popID)},
+                                          ARCH_LOOP_LAMBDA (const uint i, const uint j, const uint k, const uint n, Real *lmin){
+                                             const Real VX
+                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VXCRD]
+                                                + (i + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVX];
+                                             const Real VY
+                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VYCRD]
+                                                + (j + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVY];
+                                             const Real VZ
+                                                =          parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::VZCRD]
+                                                + (k + HALF)*parameters[n * BlockParams::N_VELOCITY_BLOCK_PARAMS + BlockParams::DVZ];
+                                             lmin[0] = min(dx / fabs(VX), lmin[0]);
+                                             lmin[0] = min(dy / fabs(VY), lmin[0]);
+                                             lmin[0] = min(dz / fabs(VZ), lmin[0]);
+                                          }, popMin);
          cell->set_max_r_dt(popID, popMin);
          cell->parameters[CellParams::MAXRDT] = min(popMin, cell->parameters[CellParams::MAXRDT]);
       }
@@ -246,26 +235,6 @@ void computeNewTimeStep(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
    phiprof::stop("compute-timestep");
 }
 
-ObjectWrapper& getObjectWrapper() {
-   return objectWrapper;
-}
-
-/** Get local cell IDs. This function creates a cached copy of the
- * cell ID lists to significantly improve performance. The cell ID
- * cache is recalculated every time the mesh partitioning changes.
- * @return Local cell IDs.*/
-const std::vector<CellID>& getLocalCells() {
-   return Parameters::localCells;
-}
-
-void recalculateLocalCellsCache() {
-     {
-        vector<CellID> dummy;
-        dummy.swap(Parameters::localCells);
-     }
-   Parameters::localCells = mpiGrid.get_cells();
-}
-
 int main(int argn,char* args[]) {
    int myRank, doBailout=0;
    const creal DT_EPSILON=1e-12;
@@ -319,6 +288,9 @@ int main(int argn,char* args[]) {
    getObjectWrapper().addParameters();
    readparameters.parse();
    P::getParameters();
+   #ifdef VELOCITY_BLOCK_POOL
+   block_pool::setMaxCachedBytes(P::blockPoolMaxCached * pow(2,30));
+   #endif
 
    getObjectWrapper().addPopulationParameters();
    sysBoundaryContainer.addParameters();
@@ -462,6 +434,7 @@ int main(int argn,char* args[]) {
                    << std::endl;
       }
    }
+   recordFsGridDecomposition(technicalGrid);
    phiprof::stop("Init fieldsolver grids");
 
    // Initialize grid.  After initializeGrid local cells have dist
@@ -696,6 +669,7 @@ int main(int argn,char* args[]) {
    int writeRestartNow; // declared outside main loop
    bool overrideRebalanceNow = false; // declared outside main loop
 
+   tracer::initialize();
    addTimedBarrier("barrier-end-initialization");
 
    phiprof::start("Simulation");
@@ -709,8 +683,10 @@ int main(int argn,char* args[]) {
          wallTimeRestartCounter <= P::exitAfterRestarts) {
 
       addTimedBarrier("barrier-loop-start");
+      perfmetrics::beginStep();
 
       phiprof::start("IO");
+      tracer::start("IO");
 
       phiprof::start("checkExternalCommands");
       if(myRank ==  MASTER_RANK) {
@@ -880,6 +856,7 @@ int main(int argn,char* args[]) {
          phiprof::stop("write-restart");
       }
 
+      tracer::stop();
       phiprof::stop("IO");
       addTimedBarrier("barrier-end-io");
 
@@ -892,8 +869,7 @@ int main(int argn,char* args[]) {
       }
 
       //Re-loadbalance if needed
-      //TODO - add LB measure and do LB if it exceeds threshold
-      if(((P::tstep % P::rebalanceInterval == 0 && P::tstep > P::tstep_min) || overrideRebalanceNow)) {
+      if(((cellcost::rebalanceScheduled(P::tstep) && P::tstep > P::tstep_min) || overrideRebalanceNow)) {
          logFile << "(LB): Start load balance, tstep = " << P::tstep << " t = " << P::t << endl << writeVerbose;
          // Refinement includes LB
          if (!dtIsChanged && P::adaptRefinement && P::tstep % (P::rebalanceInterval * P::refineMultiplier) == 0 && P::t > P::refineAfter) {
@@ -907,12 +883,16 @@ int main(int argn,char* args[]) {
             calculateAcceleration(mpiGrid,0.0);
             phiprof::stop("compute-dt");
          }
+         const double balanceStart = MPI_Wtime();
+         tracer::start("load-balance");
          balanceLoad(mpiGrid, sysBoundaryContainer);
+         tracer::stop();
          addTimedBarrier("barrier-end-load-balance");
          phiprof::start("Shrink_to_fit");
          // * shrink to fit after LB * //
          shrink_to_fit_grid_data(mpiGrid);
          phiprof::stop("Shrink_to_fit");
+         cellcost::recordRebalance(MPI_Wtime() - balanceStart);
          logFile << "(LB): ... done!"  << endl << writeVerbose;
          P::prepareForRebalance = false;
 
@@ -962,7 +942,11 @@ int main(int argn,char* args[]) {
          }
       }
 
-      if (P::tstep % P::rebalanceInterval == P::rebalanceInterval-1 || P::prepareForRebalance == true) {
+      // An imbalance-triggered rebalance is prepared during this step and done at the start of the next one
+      if (cellcost::rebalanceDue()) {
+         P::prepareForRebalance = true;
+      }
+      if (cellcost::rebalanceScheduled(P::tstep+1) || P::prepareForRebalance == true) {
          if(P::prepareForRebalance == true) {
             overrideRebalanceNow = true;
          } else {
@@ -974,21 +958,34 @@ int main(int argn,char* args[]) {
          }
       }
 
+      cellcost::beginStep(mpiGrid, cells);
+      double vlasovTime = 0.0;
+
       phiprof::start("Propagate");
       //Propagate the state of simulation forward in time by dt:
 
       phiprof::start("Spatial-space");
+      double vlasovStart = MPI_Wtime();
       if( P::propagateVlasovTranslation) {
          calculateSpatialTranslation(mpiGrid,P::dt);
       } else {
          calculateSpatialTranslation(mpiGrid,0.0);
       }
+      const double translationTime = MPI_Wtime() - vlasovStart;
+      vlasovTime += translationTime;
+      perfmetrics::addStageTime(perfmetrics::TRANSLATION, translationTime);
       phiprof::stop("Spatial-space",computedCells,"Cells");
 
       // Apply boundary conditions
       if (P::propagateVlasovTranslation || P::propagateVlasovAcceleration ) {
          phiprof::start("Update system boundaries (Vlasov post-translation)");
-         sysBoundaryContainer.applySysBoundaryVlasovConditions(mpiGrid, P::t+0.5*P::dt, false);
+         const double boundaryStart = MPI_Wtime();
+         double boundaryComputeTime = 0.0;
+         sysBoundaryContainer.applySysBoundaryVlasovConditions(mpiGrid, P::t+0.5*P::dt, false, &boundaryComputeTime);
+         const double boundaryTime = MPI_Wtime() - boundaryStart;
+         vlasovTime += boundaryTime;
+         perfmetrics::addStageTime(perfmetrics::VLASOV_BOUNDARIES, boundaryTime);
+         cellcost::distributeBoundaryTime(mpiGrid, cells, boundaryComputeTime);
          phiprof::stop("Update system boundaries (Vlasov post-translation)");
          addTimedBarrier("barrier-boundary-conditions");
       }
@@ -1011,14 +1008,18 @@ int main(int argn,char* args[]) {
       // moments for t + dt are computed (field uses t and t+0.5dt)
       if (P::propagateField) {
          phiprof::start("Propagate Fields");
+         const double fieldStart = MPI_Wtime();
 
          phiprof::start("fsgrid-coupling-in");
+         tracer::start("fsgrid-coupling-in");
          // Copy moments over into the fsgrid.
          //setupTechnicalFsGrid(mpiGrid, cells, technicalGrid);
          feedMomentsIntoFsGrid(mpiGrid, cells, momentsGrid, technicalGrid, false);
          feedMomentsIntoFsGrid(mpiGrid, cells, momentsDt2Grid, technicalGrid, true);
+         tracer::stop();
          phiprof::stop("fsgrid-coupling-in");
 
+         tracer::start("field-solver");
          propagateFields(
             perBGrid,
             perBDt2Grid,
@@ -1037,13 +1038,17 @@ int main(int argn,char* args[]) {
             P::dt,
             P::fieldSolverSubcycles
          );
+         tracer::stop();
 
          phiprof::start("getFieldsFromFsGrid");
+         tracer::start("fsgrid-coupling-out");
          // Copy results back from fsgrid.
          volGrid.updateGhostCells();
          technicalGrid.updateGhostCells();
          getFieldsFromFsGrid(volGrid, BgBGrid, EGradPeGrid, technicalGrid, mpiGrid, cells);
+         tracer::stop();
          phiprof::stop("getFieldsFromFsGrid");
+         perfmetrics::addStageTime(perfmetrics::FIELDS, MPI_Wtime() - fieldStart);
          phiprof::stop("Propagate Fields",cells.size(),"SpatialCells");
          addTimedBarrier("barrier-after-field-solver");
       }
@@ -1055,6 +1060,7 @@ int main(int argn,char* args[]) {
       // Map current data down into the ionosphere
       // TODO check: have we set perBGrid correctly here, or is it possibly perBDt2Grid in some cases??
       if(SBC::ionosphereGrid.nodes.size() > 0 && ((P::t > SBC::Ionosphere::solveCount * SBC::Ionosphere::couplingInterval && SBC::Ionosphere::couplingInterval > 0) || SBC::Ionosphere::couplingInterval == 0)) {
+         tracer::start("ionosphere-coupling");
          FieldTracing::calculateIonosphereFsgridCoupling(technicalGrid, perBGrid, dPerBGrid, SBC::ionosphereGrid.nodes, SBC::Ionosphere::radius);
          SBC::ionosphereGrid.mapDownBoundaryData(perBGrid, dPerBGrid, momentsGrid, volGrid, technicalGrid);
          SBC::ionosphereGrid.calculateConductivityTensor(SBC::Ionosphere::F10_7, SBC::Ionosphere::recombAlpha, SBC::Ionosphere::backgroundIonisation);
@@ -1063,6 +1069,7 @@ int main(int argn,char* args[]) {
          int nIterations, nRestarts;
          Real residual, minPotentialN, maxPotentialN, minPotentialS, maxPotentialS;
          SBC::ionosphereGrid.solve(nIterations, nRestarts, residual, minPotentialN, maxPotentialN, minPotentialS, maxPotentialS);
+         tracer::stop();
          logFile << "tstep = " << P::tstep
          << " t = " << P::t
          << " ionosphere iterations = " << nIterations
@@ -1087,22 +1094,37 @@ int main(int argn,char* args[]) {
       }
 
       phiprof::start("Velocity-space");
+      vlasovStart = MPI_Wtime();
       if ( P::propagateVlasovAcceleration ) {
          calculateAcceleration(mpiGrid,P::dt);
+         const double accelerationTime = MPI_Wtime() - vlasovStart;
+         vlasovTime += accelerationTime;
+         perfmetrics::addStageTime(perfmetrics::ACCELERATION, accelerationTime);
          addTimedBarrier("barrier-after-ad just-blocks");
       } else {
          //zero step to set up moments _v
          calculateAcceleration(mpiGrid, 0.0);
+         const double accelerationTime = MPI_Wtime() - vlasovStart;
+         vlasovTime += accelerationTime;
+         perfmetrics::addStageTime(perfmetrics::ACCELERATION, accelerationTime);
       }
       phiprof::stop("Velocity-space",computedCells,"Cells");
       addTimedBarrier("barrier-after-acceleration");
 
       if (P::propagateVlasovTranslation || P::propagateVlasovAcceleration ) {
          phiprof::start("Update system boundaries (Vlasov post-acceleration)");
-         sysBoundaryContainer.applySysBoundaryVlasovConditions(mpiGrid, P::t+0.5*P::dt, true);
+         const double boundaryStart = MPI_Wtime();
+         double boundaryComputeTime = 0.0;
+         sysBoundaryContainer.applySysBoundaryVlasovConditions(mpiGrid, P::t+0.5*P::dt, true, &boundaryComputeTime);
+         const double boundaryTime = MPI_Wtime() - boundaryStart;
+         vlasovTime += boundaryTime;
+         perfmetrics::addStageTime(perfmetrics::VLASOV_BOUNDARIES, boundaryTime);
+         cellcost::distributeBoundaryTime(mpiGrid, cells, boundaryComputeTime);
          phiprof::stop("Update system boundaries (Vlasov post-acceleration)");
          addTimedBarrier("barrier-boundary-conditions");
       }
+      cellcost::endStep(mpiGrid, cells);
+      cellcost::recordStep(mpiGrid, cells, vlasovTime);
 
       phiprof::start("Compute interp moments");
       // *here we compute rho and rho_v for timestep t + dt, so next
@@ -1132,6 +1154,9 @@ int main(int argn,char* args[]) {
          s << "The timestep dt=" << P::dt << " went below bailout.bailout_min_dt (" << to_string(P::bailout_min_dt) << ")." << endl;
          bailout(true, s.str(), __FILE__, __LINE__);
       }
+      perfmetrics::endStep(mpiGrid, cells, computedCells / WID3);
+      tracer::endStep();
+
       //Move forward in time
       P::meshRepartitioned = false;
       globalflags::ionosphereJustSolved = false;
@@ -1144,6 +1169,7 @@ int main(int argn,char* args[]) {
 
    phiprof::stop("Simulation");
    phiprof::start("Finalization");
+   tracer::finalize();
    if (P::propagateField ) {
       finalizeFieldPropagator();
    }
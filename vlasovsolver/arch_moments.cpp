@@ -314,11 +314,14 @@ void calculateMoments_R(
  * are stored to SpatialCell::parameters in _V variables. This function is AMR safe.
  * @param mpiGrid Parallel grid library.
  * @param cells Vector containing the spatial cells to be calculated.
- * @param computeSecond If true, second velocity moments are calculated.*/
+ * @param computeSecond If true, second velocity moments are calculated.
+ * @param fusedSums If given, velocity sums produced by the solver are used instead of
+ * reading the distribution function, in the cells and populations where they exist.*/
 void calculateMoments_V(
    dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
    const std::vector<CellID>& cells,
-   const bool& computeSecond) {
+   const bool& computeSecond,
+   const FusedVelocitySums* fusedSums) {
 
    phiprof::start("Compute _V moments");
 
@@ -362,10 +365,17 @@ void calculateMoments_V(
          Real array[4] = {0};
 
          // Calculate species' contribution to first velocity moments
-         blockVelocityFirstMoments(data,
-                                   blockParams,
-                                   array,
-                                   nBlocks);
+         const Real* sums = fusedSums ? fusedSums->get(cells[c], popID) : NULL;
+         if (sums != NULL) {
+            for (uint i=0; i<4; ++i) {
+               array[i] = sums[i];
+            }
+         } else {
+            blockVelocityFirstMoments(data,
+                                      blockParams,
+                                      array,
+                                      nBlocks);
+         }
 
          // Store species' contribution to bulk velocity moments
          Population &pop = cell->get_population(popID);
@@ -427,13 +437,24 @@ void calculateMoments_V(
          Real array[3] = {0};
 
          // Calculate species' contribution to second velocity moments
-         blockVelocitySecondMoments(data,
-                                    blockParams,
-                                    cell->parameters[CellParams::VX_R],
-                                    cell->parameters[CellParams::VY_R],
-                                    cell->parameters[CellParams::VZ_R],
-                                    array,
-                                    nBlocks);
+         const Real* sums = fusedSums ? fusedSums->get(cells[c], popID) : NULL;
+         if (sums != NULL) {
+            // sum(f*(v-V0)^2) = sum(f*v^2) - 2*V0*sum(f*v) + V0^2*sum(f)
+            const Real averageV[3] = {cell->parameters[CellParams::VX_R],
+                                      cell->parameters[CellParams::VY_R],
+                                      cell->parameters[CellParams::VZ_R]};
+            for (uint i=0; i<3; ++i) {
+               array[i] = sums[4+i] - 2.0*averageV[i]*sums[1+i] + averageV[i]*averageV[i]*sums[0];
+            }
+         } else {
+            blockVelocitySecondMoments(data,
+                                       blockParams,
+                                       cell->parameters[CellParams::VX_R],
+                                       cell->parameters[CellParams::VY_R],
+                                       cell->parameters[CellParams::VZ_R],
+                                       array,
+                                       nBlocks);
+         }
 
          // Store species' contribution to 2nd bulk velocity moments
          Population &pop = cell->get_population(popID);
@@ -25,6 +25,8 @@
 
 #include <vector>
 #include <limits>
+#include <unordered_map>
+#include <cstdint>
 #include <dccrg.hpp>
 #include <dccrg_cartesian_geometry.hpp>
 
@@ -55,9 +57,45 @@ void calculateMoments_R(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
                               const std::vector<CellID>& cells,
                               const bool& computeSecond);
 
+/** Velocity sums of each population accumulated by the last sweep of a solver,
+ * so that the moments do not need another pass over the distribution function.
+ * The sums of one cell are sum(f*DV3), sum(f*v_i*DV3) and sum(f*v_i*v_i*DV3), i=x,y,z.*/
+struct FusedVelocitySums {
+   static const uint N_SUMS = 7;
+
+   /** Clear the sums, cells gives the cells that can have sums.*/
+   void reset(const std::vector<CellID>& cells, const uint nPopulations) {
+      index.clear();
+      for (size_t c=0; c<cells.size(); ++c) {
+         index[cells[c]] = c;
+      }
+      sums.assign(nPopulations, std::vector<Real>(N_SUMS*cells.size(), 0.0));
+      valid.assign(nPopulations, std::vector<uint8_t>(cells.size(), 0));
+   }
+   /** Sums of the cell for the solver to write, marks them valid. Returns NULL if the cell is not known.*/
+   Real* set(const CellID cellID, const uint popID) {
+      const auto it = index.find(cellID);
+      if (it == index.end()) return NULL;
+      valid[popID][it->second] = 1;
+      return sums[popID].data() + N_SUMS*it->second;
+   }
+   /** Sums of the cell, or NULL if the solver did not produce them.*/
+   const Real* get(const CellID cellID, const uint popID) const {
+      if (popID >= valid.size()) return NULL;
+      const auto it = index.find(cellID);
+      if (it == index.end() || valid[popID][it->second] == 0) return NULL;
+      return sums[popID].data() + N_SUMS*it->second;
+   }
+
+   std::unordered_map<CellID,size_t> index;
+   std::vector<std::vector<Real>> sums;
+   std::vector<std::vector<uint8_t>> valid;
+};
+
 void calculateMoments_V(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
                         const std::vector<CellID>& cells,
-                        const bool& computeSecond);
+                        const bool& computeSecond,
+                        const FusedVelocitySums* fusedSums=NULL);
 
 
 // ***** TEMPLATE FUNCTION DEFINITIONS ***** //
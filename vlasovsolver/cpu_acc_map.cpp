@@ -24,6 +24,10 @@
 #include <cmath>
 #include <algorithm>
 #include <utility>
+#include <array>
+#ifdef _OPENMP
+   #include <omp.h>
+#endif
 
 #include "vec.h"
 #include "../object_wrapper.h"
@@ -33,6 +37,7 @@
 #include "cpu_1d_ppm.hpp"
 #include "cpu_1d_plm.hpp"
 #include "cpu_acc_map.hpp"
+#include "arch_moments.h"
 
 using namespace std;
 using namespace spatial_cell;
@@ -108,16 +113,34 @@ void inline swapBlockIndices(velocity_block_indices_t &blockIndices, const uint
    is the lagrangian departure grid (so th grid at timestep +dt,
    tracked backwards by -dt)
 
-   TODO: parallelize with openMP over block-columns. If one also
-   pre-creates new blocks in a separate loop first (serial operation),
-   then the openmp parallization would scale well (better than over
-   spatial cells), and would not need synchronization.
+   The block column sets (all columns along the dimension with the
+   other dimensions being equal) are independent of each other. First
+   the target extent of every set is computed, together with the blocks
+   it adds and removes. By default each set then creates its target
+   blocks, removes its source blocks that are not target blocks and is
+   mapped, one set after the other.
+
+   In cells with at least splitBlockThreshold blocks, when called from
+   within a parallel region, the sets are instead mapped as OpenMP
+   tasks, so that threads which are done with their own cells help out
+   with the largest ones. All target blocks are then created before and
+   all removed blocks removed after the mapping, so that block data does
+   not move while the sets are mapped. This changes the local ID order
+   of the blocks, and the cell temporarily holds its source blocks and
+   all new target blocks at the same time. If that does not fit in
+   max_velocity_blocks, the sets are mapped one after the other instead.
+
+   If velocitySums is given, the velocity sums of FusedVelocitySums are
+   accumulated from the target blocks right after each set is mapped,
+   while the data is still in cache.
 
 */
 bool map_1d(SpatialCell* spatial_cell,
             const uint popID,
             Realv intersection, Realv intersection_di, Realv intersection_dj,Realv intersection_dk,
-            const uint dimension) {
+            const uint dimension,
+            const vmesh::LocalID splitBlockThreshold,
+            Real* velocitySums) {
    no_subnormals(); // Needed by Agner's vectorclass
 
    Realv dv,v_min;
@@ -130,8 +153,14 @@ bool map_1d(SpatialCell* spatial_cell,
    vmesh::VelocityBlockContainer* blockContainer = spatial_cell->get_velocity_blocks(popID);
 
    //nothing to do if no blocks
-   if(vmesh->size() == 0)
+   if(vmesh->size() == 0) {
+      if (velocitySums) {
+         for (uint i=0; i<FusedVelocitySums::N_SUMS; ++i) {
+            velocitySums[i] = 0.0;
+         }
+      }
       return true;
+   }
 
 
    // Velocity grid refinement level, has no effect but is
@@ -200,24 +229,19 @@ bool map_1d(SpatialCell* spatial_cell,
    std::vector<uint> columnNumBlocks;
    std::vector<uint> setColumnOffsets;
    std::vector<uint> setNumColumns;
-   std::vector<int> columnMinBlockK;
-   std::vector<int> columnMaxBlockK;
 
    sortBlocklistByDimension(vmesh, dimension, blocks,
                             columnBlockOffsets, columnNumBlocks,
                             setColumnOffsets, setNumColumns);
 
-   // loop over block column sets  (all columns along the dimension with the other dimensions being equal )
+   std::vector<int> columnMinBlockK(columnNumBlocks.size());
+   std::vector<int> columnMaxBlockK(columnNumBlocks.size());
 
-/*
-     values array used to store column data The max size is the worst
-     case scenario with every second block having content, creating up
-     to ( MAX_BLOCKS_PER_DIM / 2 + 1) columns with each needing three
-     blocks (two for padding)
-*/
-   Vec values[(3 * ( MAX_BLOCKS_PER_DIM / 2 + 1)) * WID3 / VECL];
-   /*pointers to target block datas*/
-   Realf *blockIndexToBlockData[MAX_BLOCKS_PER_DIM];
+   // Compute the target extent of each column, and the blocks each set adds (true) and removes (false)
+   std::vector<velocity_block_indices_t> setFirstIndices(setColumnOffsets.size());
+   std::vector<std::pair<vmesh::GlobalID,bool>> blockChanges;
+   std::vector<uint> setBlockChangeOffsets(setColumnOffsets.size() + 1, 0);
+   uint nNewBlocks = 0;
    bool isTargetBlock[MAX_BLOCKS_PER_DIM];
    bool isSourceBlock[MAX_BLOCKS_PER_DIM];
 
@@ -225,24 +249,13 @@ bool map_1d(SpatialCell* spatial_cell,
       uint8_t refLevel = 0;
       //init
       for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
-         blockIndexToBlockData[blockK] =  NULL;
          isTargetBlock[blockK] = false;
          isSourceBlock[blockK] = false;
       }
 
-      //Load data into values array (this also zeroes the original data)
-      uint valuesColumnOffset = 0; //offset to values array for data in a column in this set
-      for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
-         const vmesh::LocalID n_cblocks = columnNumBlocks[columnIndex];
-         vmesh::GlobalID* cblocks = blocks + columnBlockOffsets[columnIndex]; //column blocks
-         loadColumnBlockData(vmesh, blockContainer, cblocks, n_cblocks, dimension, values + valuesColumnOffset);
-         valuesColumnOffset += (n_cblocks + 2) * (WID3/VECL); // there are WID3/VECL elements of type Vec per block
-      }
-
-
       /*need x,y coordinate of this column set of blocks, take it from first
         block in first column*/
-      velocity_block_indices_t setFirstBlockIndices;
+      velocity_block_indices_t& setFirstBlockIndices = setFirstIndices[setIndex];
       vmesh->getIndices(blocks[columnBlockOffsets[setColumnOffsets[setIndex]]],
                        refLevel,
                        setFirstBlockIndices[0], setFirstBlockIndices[1], setFirstBlockIndices[2]);
@@ -346,47 +359,96 @@ bool map_1d(SpatialCell* spatial_cell,
          }
 
          //store also for each column firstBlockIndexK, and lastBlockIndexK
-         columnMinBlockK.push_back(firstBlockIndexK);
-         columnMaxBlockK.push_back(lastBlockIndexK);
+         columnMinBlockK[columnIndex] = firstBlockIndexK;
+         columnMaxBlockK[columnIndex] = lastBlockIndexK;
       }
 
-      //now add target blocks that do not yet exist and remove source blocks
+      //now record target blocks that do not yet exist and source blocks
       //that are not target blocks
       for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
-         if(isTargetBlock[blockK] && !isSourceBlock[blockK] )  {
+         if(isTargetBlock[blockK] != isSourceBlock[blockK]) {
             const int targetBlock =
                setFirstBlockIndices[0] * block_indices_to_id[0] +
                setFirstBlockIndices[1] * block_indices_to_id[1] +
                blockK                  * block_indices_to_id[2];
-            addVelocityBlock(targetBlock, vmesh, blockContainer);
-
+            blockChanges.push_back(std::make_pair(targetBlock, isTargetBlock[blockK]));
+            if(isTargetBlock[blockK]) {
+               nNewBlocks++;
+            }
          }
-         if(!isTargetBlock[blockK] && isSourceBlock[blockK] )  {
-            const int targetBlock =
-               setFirstBlockIndices[0] * block_indices_to_id[0] +
-               setFirstBlockIndices[1] * block_indices_to_id[1] +
-               blockK                  * block_indices_to_id[2];
+      }
+      setBlockChangeOffsets[setIndex + 1] = blockChanges.size();
+   }
 
-            spatial_cell->remove_velocity_block(targetBlock, popID);
+   const uint nSets = setColumnOffsets.size();
+   bool splitSets = false;
+#ifdef _OPENMP
+   splitSets = vmesh->size() >= splitBlockThreshold && splitBlockThreshold > 0 && omp_in_parallel() && omp_get_num_threads() > 1;
+#endif
+   if (splitSets && vmesh->size() + nNewBlocks > vmesh->getMaxVelocityBlocks()) {
+      splitSets = false;
+   }
+
+   //add target blocks that do not yet exist and remove source blocks that are not target blocks,
+   //either of one set or of all sets
+   auto changeBlocks = [&](const uint firstSet, const uint endSet, const bool add, const bool remove) {
+      for (uint c = setBlockChangeOffsets[firstSet]; c < setBlockChangeOffsets[endSet]; ++c) {
+         if (blockChanges[c].second && add) {
+            addVelocityBlock(blockChanges[c].first, vmesh, blockContainer);
+         }
+         if (!blockChanges[c].second && remove) {
+            spatial_cell->remove_velocity_block(blockChanges[c].first, popID);
          }
       }
+   };
 
-     /*now store pointer to blocks, cannot do it at the same time as adding
-      them since they might move due to re-allocations or migrated when
-      removing blocks*/
-      for (int blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
-         if(isTargetBlock[blockK])  {
-            const int targetBlock =
-               setFirstBlockIndices[0] * block_indices_to_id[0] +
-               setFirstBlockIndices[1] * block_indices_to_id[1] +
-               blockK                  * block_indices_to_id[2];
-            const vmesh::LocalID tblockLID = vmesh->getLocalID(targetBlock);
-            // Get pointer to target block data.
-            blockIndexToBlockData[blockK] = blockContainer->getData(tblockLID);
-         }
+   // Map the column sets. Each set only touches its own blocks.
+   std::vector<std::array<Real,FusedVelocitySums::N_SUMS>> setSums(velocitySums ? nSets : 0);
+   auto mapColumnSet = [&](const uint setIndex) {
+      no_subnormals(); // the set may be mapped by another thread
+
+/*
+     values array used to store column data The max size is the worst
+     case scenario with every second block having content, creating up
+     to ( MAX_BLOCKS_PER_DIM / 2 + 1) columns with each needing three
+     blocks (two for padding)
+*/
+      Vec values[(3 * ( MAX_BLOCKS_PER_DIM / 2 + 1)) * WID3 / VECL];
+      /*pointers to target block datas*/
+      Realf *blockIndexToBlockData[MAX_BLOCKS_PER_DIM];
+      const velocity_block_indices_t& setFirstBlockIndices = setFirstIndices[setIndex];
+
+      //Load data into values array (this also zeroes the original data)
+      uint valuesColumnOffset = 0; //offset to values array for data in a column in this set
+      for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
+         const vmesh::LocalID n_cblocks = columnNumBlocks[columnIndex];
+         vmesh::GlobalID* cblocks = blocks + columnBlockOffsets[columnIndex]; //column blocks
+         loadColumnBlockData(vmesh, blockContainer, cblocks, n_cblocks, dimension, values + valuesColumnOffset);
+         valuesColumnOffset += (n_cblocks + 2) * (WID3/VECL); // there are WID3/VECL elements of type Vec per block
       }
 
+      if (!splitSets) {
+         changeBlocks(setIndex, setIndex + 1, true, true);
+      }
 
+      vmesh::LocalID blockIndexToLID[MAX_BLOCKS_PER_DIM];
+
+      //store pointers to the target blocks of the columns
+      for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
+         blockIndexToBlockData[blockK] = NULL;
+      }
+      for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
+         for (int blockK = columnMinBlockK[columnIndex]; blockK <= columnMaxBlockK[columnIndex]; blockK++){
+            if(blockIndexToBlockData[blockK] == NULL) {
+               const int targetBlock =
+                  setFirstBlockIndices[0] * block_indices_to_id[0] +
+                  setFirstBlockIndices[1] * block_indices_to_id[1] +
+                  blockK                  * block_indices_to_id[2];
+               blockIndexToLID[blockK] = vmesh->getLocalID(targetBlock);
+               blockIndexToBlockData[blockK] = blockContainer->getData(blockIndexToLID[blockK]);
+            }
+         }
+      }
 
       // loop over columns in set and do the mapping
       valuesColumnOffset = 0; //offset to values array for data in a column in this set
@@ -636,7 +698,64 @@ bool map_1d(SpatialCell* spatial_cell,
          valuesColumnOffset += (n_cblocks + 2) * (WID3/VECL) ;// there are WID3/VECL elements of type Vec per block
       } //for loop over columns
 
+      if (velocitySums) {
+         // the target blocks of this set are final now
+         std::array<Real,FusedVelocitySums::N_SUMS>& sums = setSums[setIndex];
+         sums.fill(0.0);
+         for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
+            if(blockIndexToBlockData[blockK] == NULL) continue;
+            const Realf* avgs = blockIndexToBlockData[blockK];
+            const Real* blockParams = blockContainer->getParameters(blockIndexToLID[blockK]);
+            const Real DV3 = blockParams[BlockParams::DVX]*blockParams[BlockParams::DVY]*blockParams[BlockParams::DVZ];
+            for (uint k=0; k<WID; ++k) {
+               const Real VZ = blockParams[BlockParams::VZCRD] + (k+0.5)*blockParams[BlockParams::DVZ];
+               for (uint j=0; j<WID; ++j) {
+                  const Real VY = blockParams[BlockParams::VYCRD] + (j+0.5)*blockParams[BlockParams::DVY];
+                  for (uint i=0; i<WID; ++i) {
+                     const Real VX = blockParams[BlockParams::VXCRD] + (i+0.5)*blockParams[BlockParams::DVX];
+                     const Real f = avgs[cellIndex(i,j,k)] * DV3;
+                     sums[0] += f;
+                     sums[1] += f*VX;
+                     sums[2] += f*VY;
+                     sums[3] += f*VZ;
+                     sums[4] += f*VX*VX;
+                     sums[5] += f*VY*VY;
+                     sums[6] += f*VZ*VZ;
+                  }
+               }
+            }
+         }
+      }
+   };
+
+#ifdef _OPENMP
+   if (splitSets) {
+      changeBlocks(0, nSets, true, false);
+      #pragma omp taskloop num_tasks(4*omp_get_num_threads())
+      for (uint setIndex=0; setIndex<nSets; ++setIndex) {
+         mapColumnSet(setIndex);
+      }
+      changeBlocks(0, nSets, false, true);
+   } else
+#endif
+   {
+      for (uint setIndex=0; setIndex<nSets; ++setIndex) {
+         mapColumnSet(setIndex);
+      }
+   }
+
+   // Sum the sets in a fixed order, so that the result does not depend on the threading
+   if (velocitySums) {
+      for (uint i=0; i<FusedVelocitySums::N_SUMS; ++i) {
+         velocitySums[i] = 0.0;
+      }
+      for (uint setIndex=0; setIndex<nSets; ++setIndex) {
+         for (uint i=0; i<FusedVelocitySums::N_SUMS; ++i) {
+            velocitySums[i] += setSums[setIndex][i];
+         }
+      }
    }
+
    delete [] blocks;
    return true;
 }
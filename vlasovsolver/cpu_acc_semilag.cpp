@@ -79,12 +79,17 @@ uint getAccelerationSubcycles(SpatialCell* spatial_cell, Real dt, const uint pop
  * @param blockContainer Velocity block data container.
  * @param map_order Order in which vx,vy,vz mappings are performed. 
  * @param dt Time step of one subcycle.
+ * @param splitBlockThreshold Cells with at least this many blocks are mapped as OpenMP tasks, 0 disables.
+ * This changes the local ID order of their blocks, see map_1d.
+ * @param velocitySums If given, the velocity sums of FusedVelocitySums are computed in the last mapping.
 */
 
 void cpu_accelerate_cell(SpatialCell* spatial_cell,
                          const uint popID,     
                          const uint map_order,
-                         const Real& dt) {
+                         const Real& dt,
+                         const vmesh::LocalID splitBlockThreshold,
+                         Real* velocitySums) {
    //double t1 = MPI_Wtime();
 
    vmesh::VelocityMesh* vmesh    = spatial_cell->get_velocity_mesh(popID);
@@ -114,9 +119,9 @@ void cpu_accelerate_cell(SpatialCell* spatial_cell,
                                     intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk);
           phiprof::stop("compute-intersections");
           phiprof::start("compute-mapping");
-          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0); // map along x
-          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1); // map along y
-          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2); // map along z
+          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0,splitBlockThreshold); // map along x
+          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1,splitBlockThreshold); // map along y
+          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2,splitBlockThreshold,velocitySums); // map along z
           phiprof::stop("compute-mapping");
           break;
           
@@ -131,9 +136,9 @@ void cpu_accelerate_cell(SpatialCell* spatial_cell,
                                     intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk);
           phiprof::stop("compute-intersections");
           phiprof::start("compute-mapping");
-          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1); // map along y
-          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2); // map along z
-          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0); // map along x
+          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1,splitBlockThreshold); // map along y
+          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2,splitBlockThreshold); // map along z
+          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0,splitBlockThreshold,velocitySums); // map along x
           phiprof::stop("compute-mapping");
           break;
 
@@ -148,9 +153,9 @@ void cpu_accelerate_cell(SpatialCell* spatial_cell,
                                     intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk);
           phiprof::stop("compute-intersections");
           phiprof::start("compute-mapping");
-          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2); // map along z
-          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0); // map along x
-          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1); // map along y
+          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2,splitBlockThreshold); // map along z
+          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0,splitBlockThreshold); // map along x
+          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1,splitBlockThreshold,velocitySums); // map along y
           phiprof::stop("compute-mapping");
           break;
    }
@@ -35,7 +35,9 @@ void cpu_accelerate_cell(
         spatial_cell::SpatialCell* spatial_cell,
         const uint popID,
         const uint map_order,
-        const Real& dt);
+        const Real& dt,
+        const vmesh::LocalID splitBlockThreshold=0,
+        Real* velocitySums=NULL);
 
 #endif
 
@@ -4,6 +4,7 @@ using namespace std;
 using namespace spatial_cell;
 
 #include "cpu_trans_pencils.hpp"
+#include "../parallel_filter.h"
 
 std::array<setOfPencils,3> DimensionPencils;
 std::array<std::unordered_set<CellID>,3> DimensionTargetCells;
@@ -634,14 +635,16 @@ void getSeedIds(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGr
    // These neighborhoods now include the AMR addition beyond the regular vlasov stencil
    int neighborhood = getNeighborhood(dimension,VLASOV_STENCIL_WIDTH);
 
+   // Flag the seeds here and compact them afterwards, so that seedIds keeps
+   // the order of localPropagatedCells irrespective of threading
+   vector<uint8_t> isSeedId(localPropagatedCells.size(), 0);
 #pragma omp parallel for
    for (uint i=0; i<localPropagatedCells.size(); i++) {
       CellID celli = localPropagatedCells[i];
 
       bool addToSeedIds = P::amrTransShortPencils;
       if (addToSeedIds) {
-#pragma omp critical
-         seedIds.push_back(celli);
+         isSeedId[i] = 1;
          continue;
       }
       auto myIndices = mpiGrid.mapping.get_indices(celli);
@@ -679,8 +682,7 @@ void getSeedIds(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGr
          }
       } // finish check A
       if ( addToSeedIds ) {
-#pragma omp critical
-         seedIds.push_back(celli);
+         isSeedId[i] = 1;
          continue;
       }
       myRefLevel = mpiGrid.get_refinement_level(celli);
@@ -726,8 +728,7 @@ void getSeedIds(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGr
       } // Finish B check
 
       if ( addToSeedIds ) {
-         #pragma omp critical
-         seedIds.push_back(celli);
+         isSeedId[i] = 1;
          continue;
       }
       /* Proceed with C, checking if the next two negative neighbours have the same refinement level as ccell, but the
@@ -755,10 +756,10 @@ void getSeedIds(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGr
       } // Finish C check
 
       if ( addToSeedIds ) {
-#pragma omp critical
-         seedIds.push_back(celli);
+         isSeedId[i] = 1;
       }
    }
+   parallelFilter(localPropagatedCells, [&isSeedId](const size_t i) { return isSeedId[i] != 0; }, seedIds);
 
    if(debug) {
       cout << "Rank " << myRank << ", Seed ids are: ";
@@ -789,6 +790,9 @@ void check_ghost_cells(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>
    }
 
    std::vector<CellID> pencilIdsToSplit;
+   // Flagged in the loop and compacted in pencil order afterwards, as the order of splitting
+   // determines the ids of the new pencils
+   std::vector<uint8_t> splitPencil(pencils.N, 0);
 
 // Thread this loop here
 #pragma omp parallel for
@@ -873,12 +877,11 @@ void check_ghost_cells(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>
          }
          // Let's avoid modifying pencils while we are looping over it. Write down the indices of pencils
          // that need to be split and split them later.
-#pragma omp critical
-         {
-            pencilIdsToSplit.push_back(pencili);
-         }
+         splitPencil[pencili] = 1;
       }
    }
+   parallelCompact(pencils.N, [&splitPencil](const size_t i) { return splitPencil[i] != 0; },
+                   [](const size_t i) { return (CellID)i; }, pencilIdsToSplit);
 
    // No threading here! Splitting requires knowledge of all
    // already existing pencils.
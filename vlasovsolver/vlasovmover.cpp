@@ -22,7 +22,10 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <sstream>
 #include <vector>
+#include <algorithm>
+#include <functional>
 #include <stdint.h>
 
 #ifdef _OPENMP
@@ -36,6 +39,9 @@
 #include "../spatial_cell.hpp"
 #include "../vlasovmover.h"
 #include "../grid.h"
+#include "../cellcost.h"
+#include "../parallel_filter.h"
+#include "../tracer.h"
 #include "../definitions.h"
 #include "../object_wrapper.h"
 #include "../mpiconversion.h"
@@ -91,11 +97,12 @@ void calculateSpatialTranslation(
 
    int bt=phiprof::initializeTimer("barrier-trans-pre-z","Barriers","MPI");
    phiprof::start(bt);
-   MPI_Barrier(MPI_COMM_WORLD);
+   tracer::barrier("barrier-trans-pre-z");
    phiprof::stop(bt);
 
     // ------------- SLICE - map dist function in Z --------------- //
    if(P::zcells_ini > 1){
+      tracer::start("translation-z");
 
       trans_timer=phiprof::initializeTimer("transfer-stencil-data-z","MPI");
       phiprof::start(trans_timer);
@@ -122,7 +129,7 @@ void calculateSpatialTranslation(
 
       bt=phiprof::initializeTimer("barrier-trans-pre-update_remote-z","Barriers","MPI");
       phiprof::start(bt);
-      MPI_Barrier(MPI_COMM_WORLD);
+      tracer::barrier("barrier-trans-pre-update_remote-z");
       phiprof::stop(bt);
 
       trans_timer=phiprof::initializeTimer("update_remote-z","MPI");
@@ -135,16 +142,18 @@ void calculateSpatialTranslation(
       update_remote_mapping_contribution_amr(mpiGrid, 2,-1,popID);
 #endif
       phiprof::stop("update_remote-z");
+      tracer::stop();
 
    }
 
    bt=phiprof::initializeTimer("barrier-trans-pre-x","Barriers","MPI");
    phiprof::start(bt);
-   MPI_Barrier(MPI_COMM_WORLD);
+   tracer::barrier("barrier-trans-pre-x");
    phiprof::stop(bt);
 
    // ------------- SLICE - map dist function in X --------------- //
    if(P::xcells_ini > 1){
+      tracer::start("translation-x");
 
       trans_timer=phiprof::initializeTimer("transfer-stencil-data-x","MPI");
       phiprof::start(trans_timer);
@@ -171,7 +180,7 @@ void calculateSpatialTranslation(
 
       bt=phiprof::initializeTimer("barrier-trans-pre-update_remote-x","Barriers","MPI");
       phiprof::start(bt);
-      MPI_Barrier(MPI_COMM_WORLD);
+      tracer::barrier("barrier-trans-pre-update_remote-x");
       phiprof::stop(bt);
 
       trans_timer=phiprof::initializeTimer("update_remote-x","MPI");
@@ -184,16 +193,18 @@ void calculateSpatialTranslation(
       update_remote_mapping_contribution_amr(mpiGrid, 0,-1,popID);
 #endif
       phiprof::stop("update_remote-x");
+      tracer::stop();
 
    }
 
    bt=phiprof::initializeTimer("barrier-trans-pre-y","Barriers","MPI");
    phiprof::start(bt);
-   MPI_Barrier(MPI_COMM_WORLD);
+   tracer::barrier("barrier-trans-pre-y");
    phiprof::stop(bt);
 
    // ------------- SLICE - map dist function in Y --------------- //
    if(P::ycells_ini > 1) {
+      tracer::start("translation-y");
 
       trans_timer=phiprof::initializeTimer("transfer-stencil-data-y","MPI");
       phiprof::start(trans_timer);
@@ -220,7 +231,7 @@ void calculateSpatialTranslation(
 
       bt=phiprof::initializeTimer("barrier-trans-pre-update_remote-y","Barriers","MPI");
       phiprof::start(bt);
-      MPI_Barrier(MPI_COMM_WORLD);
+      tracer::barrier("barrier-trans-pre-update_remote-y");
       phiprof::stop(bt);
 
       trans_timer=phiprof::initializeTimer("update_remote-y","MPI");
@@ -233,12 +244,13 @@ void calculateSpatialTranslation(
       update_remote_mapping_contribution_amr(mpiGrid, 1,-1,popID);
 #endif
       phiprof::stop("update_remote-y");
+      tracer::stop();
 
    }
 
    bt=phiprof::initializeTimer("barrier-trans-post-trans","Barriers","MPI");
    phiprof::start(bt);
-   MPI_Barrier(MPI_COMM_WORLD);
+   tracer::barrier("barrier-trans-post-trans");
    phiprof::stop(bt);
 
    // MPI_Barrier(MPI_COMM_WORLD);
@@ -309,7 +321,10 @@ void calculateSpatialTranslation(
    for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
       string profName = "translate "+getObjectWrapper().particleSpecies[popID].name;
       phiprof::start(profName);
+      tracer::start(profName);
       SpatialCell::setCommunicatedSpecies(popID);
+      // Only the mapping kernels add to time, the stencil transfers and remote updates are left out of the cost
+      const Real computeTimeBefore = time;
       //      std::cout << "I am at line " << __LINE__ << " of " << __FILE__ << std::endl;
       calculateSpatialTranslation(
          mpiGrid,
@@ -324,6 +339,10 @@ void calculateSpatialTranslation(
          popID,
          time
       );
+      if (cellcost::sampling()) {
+         cellcost::distributeTime(mpiGrid, local_propagated_cells, time - computeTimeBefore, popID);
+      }
+      tracer::stop();
       phiprof::stop(profName);
    }
 
@@ -362,35 +381,97 @@ momentCalculation:
   --------------------------------------------------
 */
 
+#ifdef DEBUG_MOMENTS
+/** Check the velocity sums produced by the mapping against ones recomputed from the
+ * distribution function of the cell. They differ only by the summation order, exits if
+ * any sum is off by more than a relative tolerance. The first moments can cancel, so
+ * they are compared against sqrt(sum(f)*sum(f*v_i*v_i)), which bounds them.
+ * @param cell Spatial cell that was just accelerated.
+ * @param popID Particle population ID.
+ * @param velocitySums Sums of the last mapping, see FusedVelocitySums.*/
+static void checkFusedVelocitySums(SpatialCell* cell, const uint popID, const Real* velocitySums) {
+   const Real tolerance = 1e-10;
+   const uint nBlocks = cell->get_number_of_velocity_blocks(popID);
+   Real firstMoments[4] = {0};
+   Real secondMoments[3] = {0};
+   if (nBlocks > 0) {
+      Realf* data = cell->get_data(popID);
+      Real* blockParams = cell->get_block_parameters(popID);
+      blockVelocityFirstMoments(data, blockParams, firstMoments, nBlocks);
+      blockVelocitySecondMoments(data, blockParams, (Real)0.0, (Real)0.0, (Real)0.0, secondMoments, nBlocks);
+   }
+   Real recomputed[FusedVelocitySums::N_SUMS];
+   Real scale[FusedVelocitySums::N_SUMS];
+   recomputed[0] = firstMoments[0];
+   scale[0] = fabs(firstMoments[0]);
+   for (uint i=0; i<3; ++i) {
+      recomputed[1+i] = firstMoments[1+i];
+      recomputed[4+i] = secondMoments[i];
+      scale[1+i] = sqrt(fabs(firstMoments[0]*secondMoments[i]));
+      scale[4+i] = fabs(secondMoments[i]);
+   }
+   for (uint i=0; i<FusedVelocitySums::N_SUMS; ++i) {
+      if (fabs(velocitySums[i] - recomputed[i]) > tolerance*scale[i]) {
+         stringstream ss;
+         ss << "ERROR in fused velocity sums in " << __FILE__ << ":" << __LINE__ << endl;
+         ss << "\t cell " << cell->parameters[CellParams::CELLID] << " population " << popID << " sum " << i;
+         ss << ": fused " << velocitySums[i] << " recomputed " << recomputed[i] << endl;
+         cerr << ss.str();
+         exit(1);
+      }
+   }
+}
+#endif
+
 /** Accelerate the given population to new time t+dt.
  * This function is AMR safe.
  * @param popID Particle population ID.
- * @param globalMaxSubcycles Number of times acceleration is subcycled.
  * @param step The current subcycle step.
  * @param mpiGrid Parallel grid library.
  * @param propagatedCells List of cells in which the population is accelerated.
- * @param dt Timestep.*/
-void calculateAcceleration(const uint popID,const uint globalMaxSubcycles,const uint step,
+ * @param dt Timestep.
+ * @param fusedSums If not NULL, velocity sums are produced by the mapping and used for the moments.*/
+void calculateAcceleration(const uint popID,const uint step,
                            dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
                            const std::vector<CellID>& propagatedCells,
-                           const Real& dt) {
+                           const Real& dt,
+                           FusedVelocitySums* fusedSums) {
    // Set active population
    SpatialCell::setCommunicatedSpecies(popID);
 
    // Calculate velocity moments, these are needed to
    // calculate the transforms used in the accelerations.
    // Calculated moments are stored in the "_V" variables.
-   calculateMoments_V(mpiGrid, propagatedCells, false);
+   // After the first substep these come from the previous mapping if fusedSums is given.
+   calculateMoments_V(mpiGrid, propagatedCells, false, fusedSums);
 
    //generate pseudo-random order which is always the same irrespective of parallelization, restarts, etc.
    std::size_t rndInt = std::hash<uint>()(P::tstep);
    uint map_order=rndInt%3;
 
+   // Schedule the cells largest-first so that the largest ones do not end up
+   // as the last tasks. Cells holding more than one thread's share of all blocks
+   // have their block column sets mapped by several threads.
+   vector<pair<vmesh::LocalID,CellID>> cellOrder(propagatedCells.size());
+   uint64_t totalBlocks = 0;
+   for (size_t c=0; c<propagatedCells.size(); ++c) {
+      cellOrder[c] = make_pair(mpiGrid[propagatedCells[c]]->get_number_of_velocity_blocks(popID), propagatedCells[c]);
+      totalBlocks += cellOrder[c].first;
+   }
+   std::sort(cellOrder.begin(), cellOrder.end(), std::greater<pair<vmesh::LocalID,CellID>>());
+   vmesh::LocalID splitBlockThreshold = 0;
+#ifdef _OPENMP
+   const vmesh::LocalID minSplitBlocks = 1024; // below this the tasking overhead is not worth it
+   if (omp_get_max_threads() > 1) {
+      splitBlockThreshold = max((vmesh::LocalID)(totalBlocks / omp_get_max_threads()), minSplitBlocks);
+   }
+#endif
+
    // Semi-Lagrangian acceleration for those cells which are subcycled,
    // dimension-by-dimension
    #pragma omp parallel for schedule(dynamic,1)
-   for (size_t c=0; c<propagatedCells.size(); ++c) {
-      const CellID cellID = propagatedCells[c];
+   for (size_t c=0; c<cellOrder.size(); ++c) {
+      const CellID cellID = cellOrder[c].second;
       const Real maxVdt = mpiGrid[cellID]->get_max_v_dt(popID);
 
       //compute subcycle dt. The length is maxVdt on all steps
@@ -411,22 +492,39 @@ void calculateAcceleration(const uint popID,const uint globalMaxSubcycles,const
       }
 
       phiprof::start("cell-semilag-acc");
+      const double costStart = cellcost::sampling() ? MPI_Wtime() : 0.0;
 #ifdef USE_GPU
       gpu_accelerate_cell(mpiGrid[cellID],popID,map_order,subcycleDt);
 #else
-      cpu_accelerate_cell(mpiGrid[cellID],popID,map_order,subcycleDt);
+      Real* velocitySums = fusedSums ? fusedSums->set(cellID, popID) : NULL;
+      cpu_accelerate_cell(mpiGrid[cellID],popID,map_order,subcycleDt,splitBlockThreshold,velocitySums);
+#ifdef DEBUG_MOMENTS
+      if (velocitySums != NULL) {
+         checkFusedVelocitySums(mpiGrid[cellID], popID, velocitySums);
+      }
+#endif
 #endif
+      if (cellcost::sampling()) {
+         cellcost::addCellTime(mpiGrid[cellID], MPI_Wtime() - costStart);
+      }
       phiprof::stop("cell-semilag-acc");
    }
-   //global adjust after each subcycle to keep number of blocks managable. Even the ones not
-   //accelerating anyore participate. It is important to keep
-   //the spatial dimension to make sure that we do not loose
-   //stuff streaming in from other cells, perhaps not connected
-   //to the existing distribution function in the cell.
-   //- All cells update and communicate their lists of content blocks
-   //- Only cells which were accerelated on this step need to be adjusted (blocks removed or added).
-   //- Not done here on last step (done after loop)
-   if(step < (globalMaxSubcycles - 1)) adjustVelocityBlocks(mpiGrid, propagatedCells, false, popID);
+}
+
+/** Exchange the local maximum number of acceleration subcycles with the given processes.
+ * @param maxSubcycles Local maximum number of subcycles.
+ * @param processes Neighbour processes, has to be symmetric between processes.
+ * @return Maximum number of subcycles of each of the processes.*/
+static vector<int> exchangeMaxSubcycles(const int maxSubcycles, const vector<int>& processes) {
+   const int subcycleTag = 0x5AC0;
+   vector<int> neighborSubcycles(processes.size(), 0);
+   vector<MPI_Request> requests(2*processes.size(), MPI_REQUEST_NULL);
+   for (size_t i=0; i<processes.size(); ++i) {
+      MPI_Irecv(&(neighborSubcycles[i]), 1, MPI_INT, processes[i], subcycleTag, MPI_COMM_WORLD, &(requests[2*i]));
+      MPI_Isend(&maxSubcycles, 1, MPI_INT, processes[i], subcycleTag, MPI_COMM_WORLD, &(requests[2*i+1]));
+   }
+   MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+   return neighborSubcycles;
 }
 
 /** Accelerate all particle populations to new time t+dt.
@@ -442,6 +540,14 @@ void calculateAcceleration(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    int myRank;
    MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
 
+   // With P::vlasovPipelineAcceleration the remote block list update of a population
+   // stays in flight while the next population is accelerated.
+   int pendingPopID = -1;
+
+   // With P::vlasovFusedMoments the mapping produces the velocity sums for the moments
+   FusedVelocitySums fusedSums;
+   FusedVelocitySums* fusedSumsPtr = NULL;
+
    if (dt == 0.0 && P::tstep > 0) {
 
       // Even if acceleration is turned off we need to adjust velocity blocks
@@ -455,11 +561,17 @@ void calculateAcceleration(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    }
    phiprof::start("semilag-acc");
 
+   if (P::vlasovFusedMoments) {
+      fusedSums.reset(cells, getObjectWrapper().particleSpecies.size());
+      fusedSumsPtr = &fusedSums;
+   }
+
    // Accelerate all particle species
    for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
       uint gpuMaxBlockCount = 0; // would be better to be over all populations
       int maxSubcycles=0;
-      int globalMaxSubcycles;
+
+      tracer::start("accelerate "+getObjectWrapper().particleSpecies[popID].name);
 
       // Set active population
       SpatialCell::setCommunicatedSpecies(popID);
@@ -469,7 +581,8 @@ void calculateAcceleration(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
       // volume) do not need to be propagated:
       phiprof::start("Gather subcycles and propagated cells");
       vector<CellID> propagatedCells;
-      #pragma omp parallel for
+      vector<uint8_t> isPropagated(cells.size(), 0);
+      #pragma omp parallel for reduction(max:maxSubcycles)
       for (size_t c=0; c<cells.size(); ++c) {
          SpatialCell* SC = mpiGrid[cells[c]];
          const vmesh::VelocityMesh* vmesh = SC->get_velocity_mesh(popID);
@@ -480,8 +593,7 @@ void calculateAcceleration(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
             uint blockCount = vmesh->size();
             if (blockCount != 0){
                //do not propagate spatial cells with no blocks
-               #pragma omp critical
-               propagatedCells.push_back(cells[c]);
+               isPropagated[c] = 1;
             }
             //prepare for acceleration, updates max dt for each cell, it
             //needs to be set to somthing sensible for _all_ cells, even if
@@ -501,6 +613,8 @@ void calculateAcceleration(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
 #endif
          }
       }
+      // Keep the local cell order so that the list is the same from run to run
+      parallelFilter(cells, [&isPropagated](const size_t c) { return isPropagated[c] != 0; }, propagatedCells);
       phiprof::stop("Gather subcycles and propagated cells");
 
 #ifdef USE_GPU
@@ -511,37 +625,84 @@ void calculateAcceleration(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
       phiprof::stop("gpu allocation verifications");
 #endif
 
-      // Compute global maximum for number of subcycles
-      MPI_Allreduce(&maxSubcycles, &globalMaxSubcycles, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+      // Subcycling only needs to stay in step with the neighbouring processes: blocks are
+      // adjusted between substeps based on the content of the nearest neighbours, so a process
+      // keeps doing rounds as long as it or any of its neighbours is still subcycling.
+      phiprof::start("Exchange neighbour subcycles");
+      const vector<int> neighborProcesses = getNearestNeighborProcesses(mpiGrid);
+      const vector<int> neighborSubcycles = exchangeMaxSubcycles(maxSubcycles, neighborProcesses);
+      int rounds = maxSubcycles;
+      for (const int n : neighborSubcycles) {
+         rounds = max(rounds, n);
+      }
+      phiprof::stop("Exchange neighbour subcycles");
 
       // TODO: move subcycling to lower level call in order to optimize GPU memory calls
 
-      // substep global max times
-      for(uint step=0; step<(uint)globalMaxSubcycles; ++step) {
+      for(uint step=0; step<(uint)rounds; ++step) {
          if(step > 0) {
             // prune list of cells to propagate to only contained those which are now subcycled
             vector<CellID> temp;
+            parallelFilter(propagatedCells, [&](const size_t c) {
+                  return step < getAccelerationSubcycles(mpiGrid[propagatedCells[c]], dt, popID);
+               }, temp);
+            propagatedCells.swap(temp);
+         }
+         // Accelerate population over one subcycle step
+         if (propagatedCells.size() > 0) {
+            calculateAcceleration(popID,step,mpiGrid,propagatedCells,dt,fusedSumsPtr);
+         }
+
+         //adjust after each subcycle to keep number of blocks managable. It is important to
+         //keep the spatial dimension to make sure that we do not loose stuff streaming in from
+         //other cells, perhaps not connected to the existing distribution function in the cell.
+         //- Only cells which are accelerated again on the next step need to be adjusted.
+         //- Content lists are only exchanged with neighbour processes where either side is
+         //  still subcycling; finished cells are adjusted in the final adjust after the loop.
+         //- Not done here on last step (done after loop)
+         if (step + 1 < (uint)rounds) {
+            vector<CellID> subcycledCells;
             for (const auto& cell: propagatedCells) {
-               if (step < getAccelerationSubcycles(mpiGrid[cell], dt, popID) ) {
-                  temp.push_back(cell);
+               if (step + 1 < getAccelerationSubcycles(mpiGrid[cell], dt, popID)) {
+                  subcycledCells.push_back(cell);
                }
             }
-
-            propagatedCells.swap(temp);
+            vector<int> exchangeProcesses;
+            for (size_t i=0; i<neighborProcesses.size(); ++i) {
+               if ((uint)max(maxSubcycles, neighborSubcycles[i]) > step + 1) {
+                  exchangeProcesses.push_back(neighborProcesses[i]);
+               }
+            }
+            adjustVelocityBlocksLocally(mpiGrid, subcycledCells, exchangeProcesses, popID);
          }
-         // Accelerate population over one subcycle step
-         calculateAcceleration(popID,(uint)globalMaxSubcycles,step,mpiGrid,propagatedCells,dt);
       } // for-loop over acceleration substeps
 
+      // the final adjust communicates through dccrg, so the previous population has to be completed first
+      if (pendingPopID >= 0) {
+         finishRemoteVelocityBlockListUpdate(mpiGrid, pendingPopID);
+         pendingPopID = -1;
+      }
+
       // final adjust for all cells, also fixing remote cells.
-      adjustVelocityBlocks(mpiGrid, cells, true, popID);
+      if (P::vlasovPipelineAcceleration) {
+         adjustVelocityBlocks(mpiGrid, cells, false, popID);
+         startRemoteVelocityBlockListUpdate(mpiGrid, popID);
+         pendingPopID = popID;
+      } else {
+         adjustVelocityBlocks(mpiGrid, cells, true, popID);
+      }
+      tracer::stop();
    } // for-loop over particle species
 
+   if (pendingPopID >= 0) {
+      finishRemoteVelocityBlockListUpdate(mpiGrid, pendingPopID);
+   }
+
    phiprof::stop("semilag-acc");
 
    // Recalculate "_V" velocity moments
   momentCalculation:
-   calculateMoments_V(mpiGrid, cells, true);
+   calculateMoments_V(mpiGrid, cells, true, fusedSumsPtr);
 
    // Set CellParams::MAXVDT to be the minimum dt of all per-species values
 #pragma omp parallel for